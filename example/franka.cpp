@@ -1,5 +1,6 @@
 #include <ros_introspection_test/FrankaError.h>
 #include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/flag_bitset.hpp>
 
 
 void Register(RosIntrospection::Parser* parser,
@@ -16,27 +17,23 @@ void Register(RosIntrospection::Parser* parser,
                 definition);
 }
 
-void DeserializeAndPrint(RosIntrospection::Parser* parser,
-                         const std::string& topic_name,
-                         std::vector<uint8_t> & buffer)
+void PrintErrors(const RosIntrospection::FlagLayout& layout,
+                 std::vector<uint8_t> & buffer)
 {
-
     using namespace RosIntrospection;
-    FlatMessage flat_container;
-    parser->deserializeIntoFlatContainer( topic_name,
-                                          Span<uint8_t>(buffer),
-                                          &flat_container, 100 );
 
-    for(auto& it: flat_container.value)
+    // no Variant or StringTreeLeaf: the 36 bools are packed into a bitset
+    FlagBitset flags;
+    if( !layout.pack( Span<uint8_t>(buffer), &flags ) )
     {
-        bool value = it.second.convert<int8_t>();
-
-        if( value )
-        {
-            std::cout << it.first.toStdString() << " : "
-                      << it.second.convert<double>() << std::endl;
-        }
+        // most of the messages have no errors
+        return;
     }
+
+    flags.forEachSet( [&](size_t index)
+    {
+        std::cout << layout.names()[index] << " : 1" << std::endl;
+    });
 }
 
 template <typename Message>
@@ -60,6 +57,9 @@ int main(int argc, char **argv)
              ros::message_traits::DataType<FrankaError>::value(),
              ros::message_traits::Definition<FrankaError>::value());
 
+    // the table with the name of each flag is built only once
+    RosIntrospection::MessageSchema schema( *parser.getMessageInfo("error") );
+    RosIntrospection::FlagLayout layout( schema );
 
     FrankaError sample{};
     sample.cartesian_reflex = true;
@@ -68,7 +68,7 @@ int main(int argc, char **argv)
     // usually you get this serialized message from topic_tools::ShapeShifter or rosbag::Message
     std::vector<uint8_t> serialized_msg = getSerializedMessage(sample);
 
-    DeserializeAndPrint(&parser, "error", serialized_msg);
+    PrintErrors(layout, serialized_msg);
     return 0;
 }
 
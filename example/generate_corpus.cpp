@@ -0,0 +1,150 @@
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/message_corpus.hpp>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include <cstdlib>
+
+using namespace RosIntrospection;
+
+// Write a bag with one second of data and the typical shapes of real robots:
+// long arrays of strings, nested arrays and large images.
+static void WriteSyntheticBag(const std::string& filename)
+{
+    rosbag::Bag bag( filename, rosbag::bagmode::Write );
+
+    for (int i=0; i<100; i++)
+    {
+        const ros::Time time( 1000, i * 10000000 );
+
+        sensor_msgs::Imu imu;
+        imu.header.seq = i;
+        imu.header.stamp = time;
+        imu.header.frame_id = "imu_link";
+        imu.linear_acceleration.z = 9.81 + 0.01 * (i % 7);
+        imu.angular_velocity.x = 0.001 * i;
+        bag.write( "/imu", time, imu );
+
+        sensor_msgs::JointState joint_state;
+        joint_state.header.seq = i;
+        joint_state.header.stamp = time;
+        for (int j=0; j<40; j++)
+        {
+            joint_state.name.push_back( "left_arm_manipulator_joint_" + std::to_string(j) );
+            joint_state.position.push_back( 0.01 * (i + j) );
+            joint_state.velocity.push_back( 0.1 * j );
+            joint_state.effort.push_back( j % 5 );
+        }
+        bag.write( "/joint_states", time, joint_state );
+
+        if( i % 2 == 0 )
+        {
+            tf2_msgs::TFMessage tf_msg;
+            tf_msg.transforms.resize( 30 );
+            for (int t=0; t<30; t++)
+            {
+                geometry_msgs::TransformStamped& transform = tf_msg.transforms[t];
+                transform.header.seq = i;
+                transform.header.stamp = time;
+                transform.header.frame_id = ( t == 0 ) ? "odom" : "link_" + std::to_string(t-1);
+                transform.child_frame_id  = "link_" + std::to_string(t);
+                transform.transform.translation.x = 0.1 * t;
+                transform.transform.rotation.w = 1.0;
+            }
+            bag.write( "/tf", time, tf_msg );
+        }
+
+        if( i % 10 == 0 )
+        {
+            sensor_msgs::Image image;
+            image.header.seq = i;
+            image.header.stamp = time;
+            image.header.frame_id = "camera_optical_frame";
+            image.height = 480;
+            image.width = 640;
+            image.encoding = "rgb8";
+            image.step = image.width * 3;
+            image.data.resize( image.step * image.height );
+            for (size_t p=0; p < image.data.size(); p++){
+                image.data[p] = static_cast<uint8_t>( (p + i) % 251 );
+            }
+            bag.write( "/camera/image_raw", time, image );
+        }
+    }
+    bag.close();
+}
+
+// usage: generate_corpus [--synthetic] input.bag output.corpus
+//
+// Saves the definitions and the serialized messages of a bag into a MessageCorpus,
+// that can be replayed by ros_introspection_replay.
+// With --synthetic, input.bag is created first (see WriteSyntheticBag).
+int main(int argc, char** argv)
+{
+    const bool synthetic = ( argc == 4 && std::string(argv[1]) == "--synthetic" );
+    if( argc != 3 && !synthetic ){
+        printf("Usage: generate_corpus [--synthetic] input.bag output.corpus\n");
+        return 1;
+    }
+    const std::string bag_file    = argv[argc-2];
+    const std::string corpus_file = argv[argc-1];
+
+    if( synthetic ){
+        WriteSyntheticBag( bag_file );
+    }
+
+    rosbag::Bag bag;
+
+    try{
+        bag.open( bag_file );
+    }
+    catch( rosbag::BagException&  ex)
+    {
+        printf("rosbag::open thrown an exception: %s\n", ex.what());
+        return -1;
+    }
+
+    rosbag::View bag_view ( bag );
+
+    MessageCorpus corpus;
+    std::map<std::string, uint32_t> topic_index;
+
+    for(const rosbag::ConnectionInfo* connection: bag_view.getConnections() )
+    {
+        CorpusTopic topic;
+        topic.name       = connection->topic;
+        topic.datatype   = connection->datatype;
+        topic.md5sum     = connection->md5sum;
+        topic.definition = connection->msg_def;
+        topic_index[topic.name] = corpus.addTopic( topic );
+    }
+
+    std::vector<uint8_t> buffer;
+
+    for(const rosbag::MessageInstance& msg_instance: bag_view)
+    {
+        buffer.resize( msg_instance.size() );
+        ros::serialization::OStream stream(buffer.data(), buffer.size());
+        msg_instance.write(stream);
+
+        corpus.addMessage( topic_index[ msg_instance.getTopic() ],
+                           msg_instance.getTime(), Span<uint8_t>(buffer) );
+    }
+
+    try{
+        corpus.save( corpus_file );
+    }
+    catch( std::exception& ex )
+    {
+        printf("%s\n", ex.what());
+        return -1;
+    }
+    printf("saved %d topics and %d messages (%d bytes) into %s\n",
+           (int)corpus.topics().size(), (int)corpus.messagesCount(),
+           (int)corpus.totalBytes(), corpus_file.c_str());
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/decoder_codegen.hpp>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <cstdlib>
+#include <fstream>
+
+using namespace RosIntrospection;
+
+// Flags used to compile the plugin (include directories). Defined by CMake.
+#ifndef DECODER_PLUGIN_FLAGS
+#define DECODER_PLUGIN_FLAGS ""
+#endif
+
+// Single quotes for the shell, that keep spaces and special characters.
+static std::string ShellQuote(const std::string& text)
+{
+    std::string quoted = "'";
+    for(char c: text)
+    {
+        if( c == '\'' ){
+            quoted += "'\\''";
+        }
+        else{
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+// usage: generate_decoders input.bag output.so
+//
+// Generates a specialized decoder for each type found in the bag and
+// compiles them into a plugin with the local compiler ($CXX or c++).
+// The source code is saved next to the plugin (output.so.cpp).
+//
+// Load the plugin with DecoderPlugin and pass it to a SpecializedParser,
+// for instance: rosbag_example input.bag output.so
+int main(int argc, char** argv)
+{
+    if( argc != 3 ){
+        printf("Usage: generate_decoders input.bag output.so\n");
+        return 1;
+    }
+
+    const std::string plugin_file = argv[2];
+    const std::string source_file = plugin_file + ".cpp";
+
+    Parser parser;
+    rosbag::Bag bag;
+
+    try{
+        bag.open( argv[1] );
+    }
+    catch( rosbag::BagException&  ex)
+    {
+        printf("rosbag::open thrown an exception: %s\n", ex.what());
+        return -1;
+    }
+
+    rosbag::View bag_view ( bag );
+
+    DecoderGenerator generator;
+
+    for(const rosbag::ConnectionInfo* connection: bag_view.getConnections() )
+    {
+        const std::string&  topic_name =  connection->topic;
+        parser.registerMessageDefinition(topic_name,
+                                         ROSType(connection->datatype),
+                                         connection->msg_def);
+        try{
+            MessageSchema schema( *parser.getMessageInfo(topic_name) );
+            generator.addType( connection->md5sum, schema );
+        }
+        catch( std::exception& ex )
+        {
+            printf("skipping %s: %s\n", connection->datatype.c_str(), ex.what());
+        }
+    }
+
+    {
+        std::ofstream source( source_file.c_str() );
+        source << generator.source();
+    }
+    printf("generated %d decoders into %s\n", (int)generator.typesCount(), source_file.c_str());
+
+    const char* compiler = getenv("CXX");
+    const std::string command = std::string( compiler ? compiler : "c++" ) +
+            " -std=c++11 -O2 -shared -fPIC " + DECODER_PLUGIN_FLAGS +
+            " " + ShellQuote( source_file ) + " -o " + ShellQuote( plugin_file );
+
+    printf("%s\n", command.c_str());
+    if( system( command.c_str() ) != 0 )
+    {
+        printf("compilation failed\n");
+        return -1;
+    }
+
+    // check that it can be loaded
+    try{
+        DecoderPlugin plugin( plugin_file );
+        printf("plugin %s contains %d decoders\n", plugin_file.c_str(), (int)plugin.entries().size());
+    }
+    catch( std::exception& ex )
+    {
+        printf("%s\n", ex.what());
+        return -1;
+    }
+    return 0;
+}
@@ -1,46 +1,20 @@
 #include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/generic_subscriber.hpp>
 #include <ros/ros.h>
-#include <topic_tools/shape_shifter.h>
 
 using namespace RosIntrospection;
-using topic_tools::ShapeShifter;
 
-void topicCallback(const ShapeShifter::ConstPtr& msg,
-                   const std::string &topic_name,
-                   RosIntrospection::Parser& parser)
+void printTopic(const GenericSubscriber::Topic& topic)
 {
-
-    const std::string&  datatype   =  msg->getDataType();
-    const std::string&  definition =  msg->getMessageDefinition();
-
-    // don't worry if you do this more than once: already registered message are not overwritten.
-    parser.registerMessageDefinition( topic_name,
-                                      RosIntrospection::ROSType(datatype),
-                                      definition );
-
-    // reuse these opbects to improve efficiency ("static" makes them persistent)
-    std::vector<uint8_t> buffer;
-    FlatMessage   flat_container;
-    RenamedValues renamed_value;
-
-    // copy raw memory into the buffer
-    buffer.resize( msg->size() );
-    ros::serialization::OStream stream(buffer.data(), buffer.size());
-    msg->write(stream);
-
-    // deserialize and rename the vectors
-    parser.deserializeIntoFlatContainer( topic_name, Span<uint8_t>(buffer), &flat_container, 100);
-    parser.applyNameTransform( topic_name, flat_container, &renamed_value );
-
     // Print the content of the message
-    printf("--------- %s ----------\n", topic_name.c_str() );
-    for (auto it: renamed_value)
+    printf("--------- %s ----------\n", topic.name.c_str() );
+    for (const auto& it: topic.renamed_values)
     {
         const std::string& key = it.first;
         const Variant& value   = it.second;
         printf(" %s = %f\n", key.c_str(), value.convert<double>() );
     }
-    for (auto it: flat_container.name)
+    for (const auto& it: topic.flat_container.name)
     {
         const std::string& key    = it.first.toStdString();
         const std::string& value  = it.second;
@@ -49,13 +23,11 @@ void topicCallback(const ShapeShifter::ConstPtr& msg,
 }
 
 
-// usage: pass the name of the file as command line argument
+// usage: pass the name of the topic as command line argument
 int main(int argc, char** argv)
 {
-    Parser parser;
-
     if( argc != 2 ){
-        printf("Usage: rosbag_example topic_name\n");
+        printf("Usage: generic_subscriber topic_name\n");
         return 1;
     }
     const std::string topic_name = argv[1];
@@ -63,13 +35,27 @@ int main(int argc, char** argv)
     ros::init(argc, argv, "universal_subscriber");
     ros::NodeHandle nh;
 
-    //who is afraid of lambdas and boost::functions ?
-    boost::function<void(const topic_tools::ShapeShifter::ConstPtr&) > callback;
-    callback = [&parser, topic_name](const topic_tools::ShapeShifter::ConstPtr& msg) -> void
+    // The GenericSubscriber owns, for each topic, the Parser, the buffer,
+    // FlatMessage and RenamedValues that are reused by every callback.
+    GenericSubscriber subscriber(nh);
+    GenericSubscriber::TopicHandle handle = subscriber.subscribe(topic_name, 10, printTopic);
+
+    // optionally, process only the latest message every 1/max_rate seconds.
+    // The others are discarded before being copied or deserialized.
+    // The timer releases the message of each interval as soon as the interval ends,
+    // without waiting for the next message.
+    double max_rate = 0;
+    ros::NodeHandle("~").param("max_rate", max_rate, 0.0);
+    ros::Timer flush_timer;
+    if( max_rate > 0 )
     {
-        topicCallback(msg, topic_name, parser) ;
-    };
-    ros::Subscriber subscriber = nh.subscribe(topic_name, 10, callback);
+        subscriber.setDownsampling( handle, DownsamplePolicy::LatestPerInterval( 1.0 / max_rate ) );
+        flush_timer = nh.createTimer( ros::Duration( 1.0 / max_rate ),
+                                      [&subscriber](const ros::TimerEvent&)
+        {
+            subscriber.flushEndedIntervals();
+        });
+    }
 
     ros::spin();
     return 0;
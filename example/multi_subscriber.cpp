@@ -1,49 +1,28 @@
 #include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/generic_subscriber.hpp>
+#include <ros_introspection_test/topic_scheduler.hpp>
 #include <ros/ros.h>
-#include <topic_tools/shape_shifter.h>
+#include <algorithm>
 
 using namespace RosIntrospection;
 
-void topicCallback(const topic_tools::ShapeShifter::ConstPtr& msg,
-                   const std::string &topic_name,
-                   RosIntrospection::Parser& parser)
-{
-
-    const std::string&  datatype   =  msg->getDataType();
-    const std::string&  definition =  msg->getMessageDefinition();
-
-    // don't worry if you do this more than once: already registered message are not overwritten.
-    parser.registerMessageDefinition( topic_name,
-                                      RosIntrospection::ROSType(datatype),
-                                      definition );
-
-    // reuse these opbects to improve efficiency ("static" makes them persistent)
-    static std::vector<uint8_t> buffer;
-    static std::map<std::string,FlatMessage>   flat_containers;
-    static std::map<std::string,RenamedValues> renamed_vectors;
-
-    FlatMessage&   flat_container = flat_containers[topic_name];
-    RenamedValues& renamed_values = renamed_vectors[topic_name];
-
-    // copy raw memory into the buffer
-    buffer.resize( msg->size() );
-    ros::serialization::OStream stream(buffer.data(), buffer.size());
-    msg->write(stream);
+typedef TopicScheduler<topic_tools::ShapeShifter::ConstPtr> Scheduler;
 
-
-    // deserialize and rename the vectors
-    parser.deserializeIntoFlatContainer( topic_name, Span<uint8_t>(buffer), &flat_container, 100);
-    parser.applyNameTransform( topic_name, flat_container, &renamed_values );
+void printTopic(const GenericSubscriber::Topic& topic)
+{
+    // topics might be processed in parallel by the Scheduler
+    static std::mutex print_mutex;
+    std::lock_guard<std::mutex> lock(print_mutex);
 
     // Print the content of the message
-    printf("--------- %s ----------\n", topic_name.c_str() );
-    for (auto it: renamed_values)
+    printf("--------- %s ----------\n", topic.name.c_str() );
+    for (const auto& it: topic.renamed_values)
     {
         const std::string& key = it.first;
         const Variant& value   = it.second;
         printf(" %s = %f\n", key.c_str(), value.convert<double>() );
     }
-    for (auto it: flat_container.name)
+    for (const auto& it: topic.flat_container.name)
     {
         const std::string& key    = it.first.toStdString();
         const std::string& value  = it.second;
@@ -51,12 +30,34 @@ void topicCallback(const topic_tools::ShapeShifter::ConstPtr& msg,
     }
 }
 
+// print the topics sorted by CPU time
+// (counters are collected only if compiled with -DENABLE_PARSER_PROBES=ON)
+void printProbeReport(const ParserProbe& probe)
+{
+    typedef std::pair<std::string, ProbeCounters> TopicCounters;
+    const auto snapshot = probe.snapshot();
+    std::vector<TopicCounters> topics( snapshot.begin(), snapshot.end() );
+
+    std::sort( topics.begin(), topics.end(), [](const TopicCounters& a, const TopicCounters& b)
+    {
+        return a.second.totalTimeNs() > b.second.totalTimeNs();
+    });
+
+    printf("%-40s %10s %12s %10s %10s %10s\n",
+           "topic", "messages", "bytes", "truncated", "deser_ms", "rename_ms");
+    for (const auto& it: topics)
+    {
+        const ProbeCounters& c = it.second;
+        printf("%-40s %10lu %12lu %10lu %10.2f %10.2f\n", it.first.c_str(),
+               (unsigned long)c.messages, (unsigned long)c.bytes, (unsigned long)c.truncated,
+               c.deserialize_ns * 1e-6, c.rename_ns * 1e-6 );
+    }
+}
+
 
 // usage: pass the name of the file as command line argument
 int main(int argc, char** argv)
 {
-    Parser parser;
-
     if( argc == 1 ){
         printf("Usage: rosbag_example list_of_topics_names\n");
         return 1;
@@ -99,21 +100,95 @@ int main(int argc, char** argv)
 
     ros::NodeHandle nh;
 
-    // subscribers will be created dynamically, one for each element in topic_names
-    std::vector<ros::Subscriber> subscribers;
+    // By default, messages are processed by the spinner thread, one after the other.
+    // With worker_threads > 0, the callbacks only enqueue the messages and a pool of
+    // threads processes them: a burst on one topic doesn't delay the others.
+    int worker_threads = 0;
+    ros::NodeHandle("~").param("worker_threads", worker_threads, 0);
 
+    // one subscriber for each element in topic_names.
+    // Each topic is identified by its handle: no lookup by name in the callbacks.
+    GenericSubscriber subscriber(nh);
+
+    // optionally, process only the latest message every 1/max_rate seconds, for each topic.
+    // The others are discarded before reaching the Scheduler.
+    double max_rate = 0;
+    ros::NodeHandle("~").param("max_rate", max_rate, 0.0);
+
+    // callbacks are not invoked before ros::spin(), the Scheduler can be added later
+    std::vector<GenericSubscriber::TopicHandle> subscriber_handles;
     for (const std::string& topic_name: topic_names)
     {
-        //who is afraid of lambdas and boost::functions ?
-        boost::function<void(const topic_tools::ShapeShifter::ConstPtr&) > callback;
-        callback = [&parser, topic_name](const topic_tools::ShapeShifter::ConstPtr& msg) -> void
+        GenericSubscriber::TopicHandle handle = subscriber.subscribe(topic_name, 10, printTopic);
+        if( max_rate > 0 )
+        {
+            subscriber.setDownsampling( handle, DownsamplePolicy::LatestPerInterval( 1.0 / max_rate ) );
+        }
+        subscriber_handles.push_back( handle );
+    }
+
+    std::unique_ptr<Scheduler> scheduler;
+    if( worker_threads > 0 )
+    {
+        // the TopicHandles of the Scheduler and of the GenericSubscriber are mapped
+        // explicitly, in both directions.
+        std::vector<Scheduler::TopicHandle> scheduler_topic( subscriber_handles.size() );
+        std::vector<GenericSubscriber::TopicHandle> subscriber_topic;
+        for (GenericSubscriber::TopicHandle handle: subscriber_handles)
+        {
+            if( handle >= scheduler_topic.size() )
+            {
+                scheduler_topic.resize( handle + 1 );
+            }
+            scheduler_topic[handle] = subscriber_topic.size();
+            subscriber_topic.push_back( handle );
+        }
+
+        scheduler.reset( new Scheduler( worker_threads,
+                                        [&subscriber, subscriber_topic](Scheduler::TopicHandle topic,
+                                                                        topic_tools::ShapeShifter::ConstPtr& msg)
+        {
+            subscriber.processMessage( subscriber_topic[topic], msg );
+        }) );
+
+        for (size_t i=0; i<subscriber_topic.size(); i++)
+        {
+            const Scheduler::TopicHandle topic = scheduler->addTopic( 100, Scheduler::DROP_OLDEST );
+            if( topic != i )
+            {
+                throw std::runtime_error("unexpected Scheduler TopicHandle");
+            }
+        }
+        Scheduler* scheduler_ptr = scheduler.get();
+        subscriber.setDispatcher( [scheduler_ptr, scheduler_topic](GenericSubscriber::TopicHandle handle,
+                                                                   const topic_tools::ShapeShifter::ConstPtr& msg)
+        {
+            scheduler_ptr->push( scheduler_topic[handle], msg );
+        });
+        scheduler->start();
+    }
+
+    // release the message of each interval when it ends, without waiting for the next one
+    ros::Timer flush_timer;
+    if( max_rate > 0 )
+    {
+        flush_timer = nh.createTimer( ros::Duration( 1.0 / max_rate ),
+                                      [&subscriber](const ros::TimerEvent&)
         {
-            topicCallback(msg, topic_name, parser) ;
-        };
-        subscribers.push_back( nh.subscribe(topic_name, 10, callback) );
+            subscriber.flushEndedIntervals();
+        });
     }
 
     ros::spin();
 
+    if( scheduler )
+    {
+        scheduler->stop();
+    }
+
+    if( ParserProbe::enabled() )
+    {
+        printProbeReport( subscriber.probe() );
+    }
     return 0;
 }
@@ -1,19 +1,33 @@
 #include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/decoder_plugin.hpp>
+#include <ros_introspection_test/bag_prefetcher.hpp>
 #include <ros/ros.h>
 #include <rosbag/bag.h>
 #include <rosbag/view.h>
+#include <memory>
 
 using namespace RosIntrospection;
 
-// usage: pass the name of the file as command line argument
+// usage: pass the name of the file as command line argument.
+// Optionally, a plugin created by generate_decoders as second argument.
 int main(int argc, char** argv)
 {
-    if( argc != 2 ){
+    if( argc != 2 && argc != 3 ){
         printf("Usage: pass the name of a file as first argument\n");
         return 1;
     }
 
-    Parser parser;
+    // the plugin must outlive the parser that uses its decoders
+    std::unique_ptr<DecoderPlugin> plugin;
+    FlatDecoderRegistry decoders;
+    if( argc == 3 )
+    {
+        plugin.reset( new DecoderPlugin( argv[2] ) );
+        plugin->registerInto( decoders );
+    }
+
+    // it behaves like the Parser, but uses the specialized decoders when available
+    SpecializedParser parser( decoders );
     rosbag::Bag bag;
 
     try{
@@ -35,7 +49,8 @@ int main(int argc, char** argv)
         const std::string&  datatype   =  connection->datatype;
         const std::string&  definition =  connection->msg_def;
         // register the type using the topic_name as identifier.
-        parser.registerMessageDefinition(topic_name, ROSType(datatype), definition);
+        parser.registerMessageDefinition(topic_name, ROSType(datatype), definition,
+                                         connection->md5sum);
     }
 
     // it is efficient to reuse the same instance of FlatMessage and RenamedValues
@@ -43,25 +58,21 @@ int main(int argc, char** argv)
     std::map<std::string, FlatMessage>   flat_containers;
     std::map<std::string, RenamedValues> renamed_vectors;
 
-    // This buffer will store the raw bytes where the message is encoded
-    std::vector<uint8_t> buffer;
+    // the chunks of the bag are decompressed on a background thread,
+    // while the messages already read are deserialized here
+    BagPrefetcher prefetcher( bag_view );
+    PrefetchedMessage message;
 
-    for(rosbag::MessageInstance msg_instance: bag_view)
+    while( prefetcher.next( message ) )
     {
-        const std::string& topic_name  = msg_instance.getTopic();
-
-        // write the message into the buffer
-        const size_t msg_size  = msg_instance.size();
-        buffer.resize(msg_size);
-        ros::serialization::OStream stream(buffer.data(), buffer.size());
-        msg_instance.write(stream);
+        const std::string& topic_name  = *message.topic;
 
         FlatMessage&   flat_container = flat_containers[topic_name];
         RenamedValues& renamed_values = renamed_vectors[topic_name];
 
         // deserialize and rename the vectors
         parser.deserializeIntoFlatContainer( topic_name,
-                                             Span<uint8_t>(buffer),
+                                             message.buffer,
                                              &flat_container, 100 );
         // applyNameTransform will convert  flat_container.value into renamed_values
         // using, if previously registered, some "rules".
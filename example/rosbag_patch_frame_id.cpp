@@ -0,0 +1,116 @@
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/message_patcher.hpp>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <topic_tools/shape_shifter.h>
+#include <std_msgs/Header.h>
+#include <memory>
+
+using namespace RosIntrospection;
+
+// usage: rosbag_patch_frame_id input.bag output.bag new_frame_id
+//
+// Every std_msgs/Header in the bag gets the new frame_id.
+// Messages are never deserialized: the patcher copies the untouched bytes
+// and writes the new string, even if it has a different size.
+int main(int argc, char** argv)
+{
+    if( argc != 4 ){
+        printf("Usage: rosbag_patch_frame_id input.bag output.bag new_frame_id\n");
+        return 1;
+    }
+
+    const std::string new_frame_id = argv[3];
+
+    Parser parser;
+    rosbag::Bag input_bag;
+    rosbag::Bag output_bag;
+
+    try{
+        input_bag.open( argv[1] );
+        output_bag.open( argv[2], rosbag::bagmode::Write );
+    }
+    catch( rosbag::BagException&  ex)
+    {
+        printf("rosbag::open thrown an exception: %s\n", ex.what());
+        return -1;
+    }
+
+    rosbag::View bag_view ( input_bag );
+
+    const ROSType header_type( ros::message_traits::DataType<std_msgs::Header>::value() );
+
+    // the header is rewritten as a whole: seq and stamp are copied,
+    // frame_id is replaced.
+    MessagePatcher::RewriteCallback rewriteHeader =
+            [&new_frame_id](const ROSType&, const Span<uint8_t>& original, std::vector<uint8_t>& output)
+    {
+        // seq (uint32) + stamp (time)
+        const size_t fixed_part = sizeof(uint32_t) * 3;
+        output.insert( output.end(), original.data(), original.data() + fixed_part );
+
+        const uint32_t string_size = static_cast<uint32_t>( new_frame_id.size() );
+        const uint8_t* size_ptr = reinterpret_cast<const uint8_t*>( &string_size );
+        output.insert( output.end(), size_ptr, size_ptr + sizeof(uint32_t) );
+        output.insert( output.end(), new_frame_id.begin(), new_frame_id.end() );
+    };
+
+    // one patcher for each topic containing a Header, nullptr otherwise
+    std::map<std::string, std::unique_ptr<MessagePatcher>> patchers;
+
+    for(const rosbag::ConnectionInfo* connection: bag_view.getConnections() )
+    {
+        const std::string&  topic_name =  connection->topic;
+        parser.registerMessageDefinition(topic_name,
+                                         ROSType(connection->datatype),
+                                         connection->msg_def);
+
+        std::unique_ptr<MessagePatcher>& patcher = patchers[topic_name];
+        if( !patcher )
+        {
+            patcher.reset( new MessagePatcher(parser, topic_name) );
+            if( patcher->schema().findMessage( header_type.baseName() ) >= 0 )
+            {
+                patcher->rewriteType( header_type, rewriteHeader );
+            }
+            else{
+                patcher.reset();
+            }
+        }
+    }
+
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> patched_buffer;
+    topic_tools::ShapeShifter shape_shifter;
+
+    for(rosbag::MessageInstance msg_instance: bag_view)
+    {
+        const std::string& topic_name  = msg_instance.getTopic();
+
+        buffer.resize( msg_instance.size() );
+        ros::serialization::OStream stream(buffer.data(), buffer.size());
+        msg_instance.write(stream);
+
+        std::vector<uint8_t>* output = &buffer;
+
+        const std::unique_ptr<MessagePatcher>& patcher = patchers[topic_name];
+        if( patcher )
+        {
+            patcher->apply( Span<uint8_t>(buffer), &patched_buffer );
+            output = &patched_buffer;
+        }
+
+        shape_shifter.morph( msg_instance.getMD5Sum(),
+                             msg_instance.getDataType(),
+                             msg_instance.getMessageDefinition(), "" );
+
+        ros::serialization::IStream read_stream( output->data(), output->size() );
+        shape_shifter.read( read_stream );
+
+        output_bag.write( topic_name, msg_instance.getTime(), shape_shifter,
+                          msg_instance.getConnectionHeader() );
+    }
+    output_bag.close();
+    return 0;
+}
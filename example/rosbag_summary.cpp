@@ -0,0 +1,78 @@
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/leaf_aggregator.hpp>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+using namespace RosIntrospection;
+
+// usage: pass the name of the file as command line argument.
+// Prints count, min, max, mean, standard deviation and median of every numerical field.
+int main(int argc, char** argv)
+{
+    if( argc != 2 ){
+        printf("Usage: pass the name of a file as first argument\n");
+        return 1;
+    }
+
+    Parser parser;
+    rosbag::Bag bag;
+
+    try{
+        bag.open( argv[1] );
+    }
+    catch( rosbag::BagException&  ex)
+    {
+        printf("rosbag::open thrown an exception: %s\n", ex.what());
+        return -1;
+    }
+
+    rosbag::View bag_view ( bag );
+
+    for(const rosbag::ConnectionInfo* connection: bag_view.getConnections() )
+    {
+        parser.registerMessageDefinition( connection->topic,
+                                          ROSType(connection->datatype),
+                                          connection->msg_def );
+    }
+
+    // one aggregator per topic: memory doesn't grow with the number of messages
+    std::map<std::string, FlatMessage>    flat_containers;
+    std::map<std::string, LeafAggregator> aggregators;
+
+    std::vector<uint8_t> buffer;
+
+    for(const rosbag::MessageInstance& msg_instance: bag_view)
+    {
+        const std::string& topic_name  = msg_instance.getTopic();
+
+        buffer.resize( msg_instance.size() );
+        ros::serialization::OStream stream(buffer.data(), buffer.size());
+        msg_instance.write(stream);
+
+        FlatMessage& flat_container = flat_containers[topic_name];
+        parser.deserializeIntoFlatContainer( topic_name,
+                                             Span<uint8_t>(buffer),
+                                             &flat_container, 100 );
+        // no need to call applyNameTransform
+        aggregators[topic_name].update( flat_container );
+    }
+
+    for(const auto& it: aggregators)
+    {
+        const LeafAggregator& aggregator = it.second;
+        printf("--------- %s (%lu messages) ----------\n", it.first.c_str(),
+               static_cast<unsigned long>(aggregator.messagesCount()) );
+
+        for(size_t i=0; i < aggregator.size(); i++)
+        {
+            printf(" %s: count %lu min %f max %f mean %f stddev %f median %f\n",
+                   aggregator.keys()[i].c_str(),
+                   static_cast<unsigned long>(aggregator.count(i)),
+                   aggregator.min(i), aggregator.max(i), aggregator.mean(i),
+                   std::sqrt( aggregator.variance(i) ),
+                   aggregator.quantile(i, 0.5) );
+        }
+    }
+    return 0;
+}
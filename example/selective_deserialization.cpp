@@ -1,4 +1,5 @@
 #include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/stamp_extractor.hpp>
 #include <geometry_msgs/TransformStamped.h>
 
 
@@ -19,6 +20,7 @@ int main(int argc, char **argv)
     // Let's create a random one
     TransformStamped tr;
     tr.header.seq = 42;
+    tr.header.stamp = ros::Time(1500000000, 42000);
     tr.header.frame_id = "this_one";
 
     tr.transform.translation.x = 1;
@@ -52,6 +54,18 @@ int main(int argc, char **argv)
     std::cout << "Seq: "   << header.seq << std::endl;
     std::cout << "Frame: " << header.frame_id << std::endl;
 
+    // If only the stamp is needed, its position is computed once per topic:
+    // here it is at a fixed offset, and nothing else is read.
+    StampExtractor stamp_extractor;
+    stamp_extractor.registerTopic( parser, topic_name );
+
+    ros::Time stamp;
+    if( stamp_extractor.extractStamp( topic_name, Span<uint8_t>(raw_buffer), stamp ) )
+    {
+        std::cout << "Stamp: " << stamp.sec << "." << stamp.nsec
+                  << " (offset " << stamp_extractor.locator( topic_name )->fixedOffset() << ")" << std::endl;
+    }
+
     return 0;
 }
 
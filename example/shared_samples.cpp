@@ -0,0 +1,115 @@
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/shared_sample_ring.hpp>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace RosIntrospection;
+
+// "/imu/data" -> "/ros_introspection_imu_data"
+std::string RingName(const std::string& topic)
+{
+    std::string name = "/ros_introspection";
+    for(char c: topic)
+    {
+        name.push_back( c == '/' ? '_' : c );
+    }
+    return name;
+}
+
+// Deserialize the messages of a bag once, and publish them into shared memory.
+int Publish(const char* filename)
+{
+    rosbag::Bag bag;
+    try{
+        bag.open( filename );
+    }
+    catch( rosbag::BagException&  ex)
+    {
+        printf("rosbag::open thrown an exception: %s\n", ex.what());
+        return -1;
+    }
+
+    rosbag::View bag_view ( bag );
+    Parser parser;
+    std::map<std::string, std::unique_ptr<SharedSampleWriter>> writers;
+
+    for(const rosbag::ConnectionInfo* connection: bag_view.getConnections() )
+    {
+        parser.registerMessageDefinition( connection->topic,
+                                          ROSType(connection->datatype),
+                                          connection->msg_def );
+        if( writers.count( connection->topic ) == 0 )
+        {
+            writers[connection->topic].reset( new SharedSampleWriter( RingName(connection->topic) ) );
+            printf("publishing %s into %s\n", connection->topic.c_str(),
+                   RingName(connection->topic).c_str() );
+        }
+    }
+
+    FlatMessage flat_container;
+    std::vector<uint8_t> buffer;
+    const auto start = std::chrono::steady_clock::now();
+    const ros::Time first_time = bag_view.getBeginTime();
+
+    for(const rosbag::MessageInstance& msg_instance: bag_view)
+    {
+        const std::string& topic_name  = msg_instance.getTopic();
+        const double time = ( msg_instance.getTime() - first_time ).toSec();
+
+        // replay at the original rate
+        std::this_thread::sleep_until( start + std::chrono::duration<double>(time) );
+
+        buffer.resize( msg_instance.size() );
+        ros::serialization::OStream stream(buffer.data(), buffer.size());
+        msg_instance.write(stream);
+
+        parser.deserializeIntoFlatContainer( topic_name, Span<uint8_t>(buffer),
+                                             &flat_container, 100 );
+        writers[topic_name]->publish( msg_instance.getTime().toSec(), flat_container );
+    }
+    return 0;
+}
+
+// Print the samples of a topic published by another process.
+int Read(const char* topic)
+{
+    SharedSampleReader reader( RingName(topic) );
+    reader.seekToEnd();
+    SharedSample sample;
+
+    while( true )
+    {
+        if( !reader.next( sample ) )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+            continue;
+        }
+        printf("--------- %s %.3f (lost %lu) ----------\n", topic, sample.time,
+               static_cast<unsigned long>(reader.lostCount()) );
+        for(size_t i=0; i < sample.values.size(); i++)
+        {
+            if( sample.values[i] == sample.values[i] ){
+                printf(" %s = %f\n", reader.keys()[i].c_str(), sample.values[i] );
+            }
+        }
+    }
+    return 0;
+}
+
+// usage:
+//    shared_samples publish file.bag
+//    shared_samples read /topic_name     (as many processes as you want)
+int main(int argc, char** argv)
+{
+    if( argc == 3 && std::string(argv[1]) == "publish" ){
+        return Publish( argv[2] );
+    }
+    if( argc == 3 && std::string(argv[1]) == "read" ){
+        return Read( argv[2] );
+    }
+    printf("Usage: shared_samples publish file.bag | shared_samples read /topic\n");
+    return 1;
+}
@@ -0,0 +1,256 @@
+#ifndef ROS_INTROSPECTION_TEST_BAG_PREFETCHER_HPP
+#define ROS_INTROSPECTION_TEST_BAG_PREFETCHER_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <rosbag/view.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace RosIntrospection{
+
+/// A message read by the BagPrefetcher.
+struct PrefetchedMessage
+{
+  /// owned by the rosbag::Bag.
+  const std::string* topic;
+  ros::Time time;
+  /// valid until the next call to BagPrefetcher::next().
+  Span<uint8_t> buffer;
+};
+
+/**
+ * @brief Reads the messages of a rosbag::View on a background thread, while the
+ * caller deserializes the previous ones.
+ *
+ * Reading a bag means decompressing its chunks (LZ4 or BZ2) and copying each
+ * message out of them: the background thread writes the messages, one after the
+ * other, into a batch of about batch_size bytes. There are max_batches batches
+ * (2 by default: double buffering): when all of them are full, the background
+ * thread waits, so the memory is bounded.
+ *
+ * next() gives a Span pointing directly into the batch: no other copy is done.
+ * The total time is close to the slowest stage, instead of the sum of the two.
+ *
+ * The View must outlive the BagPrefetcher, and must not be used by anyone else
+ * while the BagPrefetcher exists.
+ */
+class BagPrefetcher
+{
+public:
+
+  explicit BagPrefetcher(rosbag::View& view,
+                         size_t batch_size = 4*1024*1024,
+                         size_t max_batches = 2);
+
+  ~BagPrefetcher();
+
+  BagPrefetcher(const BagPrefetcher&) = delete;
+  BagPrefetcher& operator=(const BagPrefetcher&) = delete;
+
+  /**
+   * @brief Get the next message, in the order of the View. Returns false at the end.
+   * Rethrows the exception thrown by rosbag on the background thread, if any.
+   */
+  bool next(PrefetchedMessage& message);
+
+  /// Number of times next() had to wait for the background thread.
+  size_t stallsCount() const { return _stalls; }
+
+private:
+
+  struct Entry
+  {
+    const std::string* topic;
+    ros::Time time;
+    size_t offset;
+    size_t size;
+  };
+
+  struct Batch
+  {
+    std::vector<uint8_t> data;
+    std::vector<Entry> entries;
+  };
+
+  void readLoop();
+
+  /// Wait for an empty batch. Returns nullptr if stopped.
+  Batch* acquireEmpty();
+
+  void publish(Batch* batch);
+
+  rosbag::View& _view;
+  const size_t _batch_size;
+
+  std::vector<std::unique_ptr<Batch>> _batches;
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<Batch*> _empty;
+  std::deque<Batch*> _ready;
+  bool _finished;
+  bool _stop;
+  std::exception_ptr _error;
+
+  // owned by the caller of next()
+  Batch* _current;
+  size_t _current_index;
+  size_t _stalls;
+
+  std::thread _thread;
+};
+
+//---------------------------------------------------------------------------
+
+inline BagPrefetcher::BagPrefetcher(rosbag::View& view, size_t batch_size,
+                                    size_t max_batches):
+  _view(view),
+  _batch_size(batch_size),
+  _finished(false),
+  _stop(false),
+  _current(nullptr),
+  _current_index(0),
+  _stalls(0)
+{
+  if( max_batches < 2 ){
+    throw std::runtime_error("BagPrefetcher: at least 2 batches are needed");
+  }
+  for(size_t i=0; i < max_batches; i++)
+  {
+    _batches.emplace_back( new Batch );
+    _batches.back()->data.reserve( batch_size );
+    _empty.push_back( _batches.back().get() );
+  }
+  _thread = std::thread( &BagPrefetcher::readLoop, this );
+}
+
+inline BagPrefetcher::~BagPrefetcher()
+{
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _stop = true;
+  }
+  _cond.notify_all();
+  _thread.join();
+}
+
+inline BagPrefetcher::Batch* BagPrefetcher::acquireEmpty()
+{
+  std::unique_lock<std::mutex> lock( _mutex );
+  _cond.wait( lock, [this](){ return _stop || !_empty.empty(); } );
+  if( _stop ){
+    return nullptr;
+  }
+  Batch* batch = _empty.front();
+  _empty.pop_front();
+  return batch;
+}
+
+inline void BagPrefetcher::publish(Batch *batch)
+{
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _ready.push_back( batch );
+  }
+  _cond.notify_all();
+}
+
+inline void BagPrefetcher::readLoop()
+{
+  Batch* batch = nullptr;
+  try{
+    for(const rosbag::MessageInstance& msg_instance: _view)
+    {
+      if( !batch )
+      {
+        batch = acquireEmpty();
+        if( !batch ){
+          return;
+        }
+        batch->data.clear();
+        batch->entries.clear();
+      }
+
+      // decompression happens here, inside rosbag
+      Entry entry;
+      entry.topic  = &msg_instance.getTopic();
+      entry.time   = msg_instance.getTime();
+      entry.offset = batch->data.size();
+      entry.size   = msg_instance.size();
+
+      batch->data.resize( entry.offset + entry.size );
+      ros::serialization::OStream stream( batch->data.data() + entry.offset, entry.size );
+      msg_instance.write( stream );
+      batch->entries.push_back( entry );
+
+      if( batch->data.size() >= _batch_size )
+      {
+        publish( batch );
+        batch = nullptr;
+      }
+    }
+  }
+  catch( ... )
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _error = std::current_exception();
+  }
+
+  std::lock_guard<std::mutex> lock( _mutex );
+  if( batch && !batch->entries.empty() ){
+    _ready.push_back( batch );
+  }
+  _finished = true;
+  _cond.notify_all();
+}
+
+inline bool BagPrefetcher::next(PrefetchedMessage &message)
+{
+  if( _current && _current_index >= _current->entries.size() )
+  {
+    // the caller is done with this batch: give it back to the background thread
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _empty.push_back( _current );
+    }
+    _cond.notify_all();
+    _current = nullptr;
+  }
+
+  if( !_current )
+  {
+    std::unique_lock<std::mutex> lock( _mutex );
+    if( _ready.empty() && !_finished ){
+      _stalls++;
+    }
+    _cond.wait( lock, [this](){ return !_ready.empty() || _finished; } );
+
+    if( _ready.empty() )
+    {
+      if( _error )
+      {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception( error );
+      }
+      return false;
+    }
+    _current = _ready.front();
+    _ready.pop_front();
+    _current_index = 0;
+  }
+
+  const Entry& entry = _current->entries[ _current_index++ ];
+  message.topic  = entry.topic;
+  message.time   = entry.time;
+  message.buffer = Span<uint8_t>( _current->data.data() + entry.offset, entry.size );
+  return true;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_BAG_PREFETCHER_HPP
@@ -0,0 +1,439 @@
+#ifndef ROS_INTROSPECTION_TEST_BAG_QUERY_HPP
+#define ROS_INTROSPECTION_TEST_BAG_QUERY_HPP
+
+#include <ros_introspection_test/field_reader.hpp>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <rosbag/query.h>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/// Glob matching with '*' (any sequence, including '/') and '?' (any character).
+inline bool GlobMatch(const char* pattern, const char* text)
+{
+  const char* star = nullptr;
+  const char* star_text = nullptr;
+  while( *text )
+  {
+    if( *pattern == '*' )
+    {
+      star = pattern++;
+      star_text = text;
+    }
+    else if( *pattern == '?' || *pattern == *text )
+    {
+      pattern++;
+      text++;
+    }
+    else if( star )
+    {
+      pattern = star + 1;
+      text = ++star_text;
+    }
+    else{
+      return false;
+    }
+  }
+  while( *pattern == '*' ){
+    pattern++;
+  }
+  return *pattern == '\0';
+}
+
+/// A message returned by BagQuery::run().
+struct QueryRecord
+{
+  const std::string* topic;
+  ros::Time time;
+  /// the serialized message. Use BagQuery::parser() to deserialize it.
+  Span<uint8_t> buffer;
+  /// leaves selected with BagQuery::select(), with key "topic/path".
+  const RenamedValues* values;
+  /// string leaves selected with BagQuery::select().
+  const std::vector<std::pair<std::string, std::string>>* strings;
+};
+
+/**
+ * @brief Query-style reader of a rosbag.
+ *
+ *     BagQuery query(bag);
+ *     query.topics("/imu*")
+ *          .relativeTimeRange(3600, 3602)
+ *          .select("/imu/linear_acceleration/z")
+ *          .where("/imu/linear_acceleration/z > 15");
+ *     query.run( callback );
+ *
+ * The filters are applied as early as possible:
+ *  - topics and time range are passed to rosbag::View, that uses the index of the
+ *    bag to load only the chunks containing matching messages.
+ *  - messages of other topics are never copied.
+ *  - select() and where() read only the fields on their path (see FieldReader),
+ *    without deserializing the entire message.
+ *
+ * Only the fields on the paths are read, with bounds checks. Messages that can't be
+ * read (for instance in a corrupted bag) are skipped and counted; the rest of the
+ * buffer is never checked.
+ *
+ * A condition applies only to the topic it refers to; when the path contains
+ * arrays selected with '#', it is true if any of the elements satisfies it.
+ */
+class BagQuery
+{
+public:
+
+  typedef std::function<void(const QueryRecord&)> Callback;
+
+  explicit BagQuery(const rosbag::Bag& bag);
+
+  /// Topics matching the glob (for instance "/robot/*/joint_states"). All the topics if never called.
+  BagQuery& topics(const std::string& glob);
+
+  BagQuery& timeRange(const ros::Time& begin, const ros::Time& end);
+
+  /// Time range in seconds, relative to the beginning of the bag.
+  BagQuery& relativeTimeRange(double begin, double end);
+
+  /// Leaf to extract, starting with the name of the topic, e.g. "/imu/linear_acceleration/z".
+  BagQuery& select(const std::string& path);
+
+  /// Condition "path op number", where op is one of < <= > >= == !=
+  BagQuery& where(const std::string& condition);
+
+  /// Throws std::runtime_error if a path is not valid. Returns the number of records.
+  size_t run(const Callback& callback);
+
+  /// Types of the topics matched by the last call of run().
+  const Parser& parser() const { return _parser; }
+
+  /// Messages read from the bag during the last run(), including the ones discarded by where().
+  size_t messagesRead() const { return _messages_read; }
+
+  /// Messages of the last run() discarded because they are not consistent with their type.
+  size_t malformedCount() const { return _malformed; }
+
+private:
+
+  enum Comparison { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL };
+
+  struct Condition
+  {
+    std::string path;
+    Comparison comparison;
+    double value;
+  };
+
+  struct TopicState
+  {
+    std::unique_ptr<MessageSchema> schema;
+    std::vector<FieldReader> selected;
+    std::vector<std::pair<FieldReader, Condition>> conditions;
+  };
+
+  static Condition ParseCondition(const std::string& condition);
+
+  static bool Compare(double value, Comparison comparison, double reference);
+
+  /// Topic and relative path of a query path; nullptr if the topic is not selected.
+  TopicState* findTopic(const std::string& path, std::string& field_path);
+
+  const rosbag::Bag& _bag;
+  std::vector<std::string> _globs;
+  ros::Time _begin;
+  ros::Time _end;
+  double _relative_begin;
+  double _relative_end;
+  bool _relative;
+  std::vector<std::string> _selected_paths;
+  std::vector<Condition> _conditions;
+
+  Parser _parser;
+  std::unordered_map<std::string, TopicState> _topics;
+  size_t _messages_read;
+  size_t _malformed;
+};
+
+//---------------------------------------------------------------------------
+
+inline BagQuery::BagQuery(const rosbag::Bag &bag):
+  _bag(bag),
+  _begin(ros::TIME_MIN),
+  _end(ros::TIME_MAX),
+  _relative_begin(0),
+  _relative_end(0),
+  _relative(false),
+  _messages_read(0),
+  _malformed(0)
+{
+}
+
+inline BagQuery &BagQuery::topics(const std::string &glob)
+{
+  _globs.push_back( glob );
+  return *this;
+}
+
+inline BagQuery &BagQuery::timeRange(const ros::Time &begin, const ros::Time &end)
+{
+  _begin = begin;
+  _end = end;
+  _relative = false;
+  return *this;
+}
+
+inline BagQuery &BagQuery::relativeTimeRange(double begin, double end)
+{
+  _relative_begin = begin;
+  _relative_end = end;
+  _relative = true;
+  return *this;
+}
+
+inline BagQuery &BagQuery::select(const std::string &path)
+{
+  _selected_paths.push_back( path );
+  return *this;
+}
+
+inline BagQuery &BagQuery::where(const std::string &condition)
+{
+  _conditions.push_back( ParseCondition( condition ) );
+  return *this;
+}
+
+inline BagQuery::Condition BagQuery::ParseCondition(const std::string &condition)
+{
+  static const char* operators[6] = { "<=", ">=", "==", "!=", "<", ">" };
+  static const Comparison comparisons[6] = { LESS_EQUAL, GREATER_EQUAL, EQUAL, NOT_EQUAL, LESS, GREATER };
+
+  for(int i=0; i<6; i++)
+  {
+    const size_t pos = condition.find( operators[i] );
+    if( pos == std::string::npos ){
+      continue;
+    }
+    Condition output;
+    output.comparison = comparisons[i];
+
+    const std::string lhs = condition.substr( 0, pos );
+    const std::string rhs = condition.substr( pos + std::strlen(operators[i]) );
+    const size_t first = lhs.find_first_not_of(' ');
+    const size_t last  = lhs.find_last_not_of(' ');
+    if( first == std::string::npos ){
+      break;
+    }
+    output.path = lhs.substr( first, last - first + 1 );
+    try{
+      size_t parsed = 0;
+      output.value = std::stod( rhs, &parsed );
+      if( rhs.find_first_not_of(' ', parsed) != std::string::npos ){
+        break;
+      }
+    }
+    catch( std::exception& ){
+      break;
+    }
+    return output;
+  }
+  throw std::runtime_error( "BagQuery: invalid condition: " + condition );
+}
+
+inline bool BagQuery::Compare(double value, Comparison comparison, double reference)
+{
+  switch( comparison )
+  {
+  case LESS:          return value <  reference;
+  case LESS_EQUAL:    return value <= reference;
+  case GREATER:       return value >  reference;
+  case GREATER_EQUAL: return value >= reference;
+  case EQUAL:         return value == reference;
+  case NOT_EQUAL:     return value != reference;
+  }
+  return false;
+}
+
+inline BagQuery::TopicState *BagQuery::findTopic(const std::string &path, std::string &field_path)
+{
+  // the longest topic that is a prefix of the path. Leading '/' is optional
+  const size_t path_start = (!path.empty() && path[0] == '/') ? 1 : 0;
+  TopicState* output = nullptr;
+  size_t best_length = 0;
+
+  for(auto& it: _topics)
+  {
+    const std::string& topic = it.first;
+    const size_t topic_start = (!topic.empty() && topic[0] == '/') ? 1 : 0;
+    const size_t length = topic.size() - topic_start;
+
+    if( length > best_length && path.size() > path_start + length &&
+        path.compare( path_start, length, topic, topic_start, length ) == 0 &&
+        path[path_start + length] == '/' )
+    {
+      best_length = length;
+      output = &it.second;
+      field_path = path.substr( path_start + length + 1 );
+    }
+  }
+  return output;
+}
+
+inline size_t BagQuery::run(const Callback &callback)
+{
+  _topics.clear();
+  _messages_read = 0;
+  _malformed = 0;
+
+  // topics selected by the globs
+  rosbag::View full_view( _bag );
+  std::vector<std::string> topic_names;
+
+  for(const rosbag::ConnectionInfo* connection: full_view.getConnections() )
+  {
+    const std::string& topic_name = connection->topic;
+    bool match = _globs.empty();
+    for(size_t i=0; !match && i < _globs.size(); i++)
+    {
+      match = GlobMatch( _globs[i].c_str(), topic_name.c_str() );
+    }
+    if( !match || _topics.count(topic_name) ){
+      continue;
+    }
+    _parser.registerMessageDefinition( topic_name, ROSType(connection->datatype), connection->msg_def );
+    TopicState& state = _topics[topic_name];
+    state.schema.reset( new MessageSchema( *_parser.getMessageInfo(topic_name) ) );
+    topic_names.push_back( topic_name );
+  }
+
+  std::string field_path;
+  for(const std::string& path: _selected_paths)
+  {
+    TopicState* state = findTopic( path, field_path );
+    if( !state ){
+      throw std::runtime_error( "BagQuery: no selected topic matches the path: " + path );
+    }
+    state->selected.push_back( FieldReader( *state->schema, field_path ) );
+  }
+  for(const Condition& condition: _conditions)
+  {
+    TopicState* state = findTopic( condition.path, field_path );
+    if( !state ){
+      throw std::runtime_error( "BagQuery: no selected topic matches the path: " + condition.path );
+    }
+    FieldReader reader( *state->schema, field_path );
+    if( reader.leaf().type_id == STRING ){
+      throw std::runtime_error( "BagQuery: condition on a string: " + condition.path );
+    }
+    state->conditions.push_back( std::make_pair( reader, condition ) );
+  }
+
+  if( topic_names.empty() ){
+    return 0;
+  }
+
+  ros::Time begin = _begin;
+  ros::Time end   = _end;
+  if( _relative )
+  {
+    const ros::Time bag_start = full_view.getBeginTime();
+    begin = bag_start + ros::Duration( _relative_begin );
+    end   = bag_start + ros::Duration( _relative_end );
+  }
+
+  rosbag::View view( _bag, rosbag::TopicQuery(topic_names), begin, end );
+
+  std::vector<uint8_t> buffer;
+  RenamedValues values;
+  std::vector<std::pair<std::string, std::string>> strings;
+  std::string key;
+  size_t records = 0;
+
+  for(const rosbag::MessageInstance& msg_instance: view)
+  {
+    const std::string& topic_name = msg_instance.getTopic();
+    auto it = _topics.find( topic_name );
+    if( it == _topics.end() ){
+      continue;
+    }
+    const TopicState& state = it->second;
+
+    buffer.resize( msg_instance.size() );
+    ros::serialization::OStream stream( buffer.data(), buffer.size() );
+    msg_instance.write( stream );
+    _messages_read++;
+
+    const Span<uint8_t> span( buffer );
+    bool accepted = true;
+    size_t value_count  = 0;
+    size_t string_count = 0;
+
+    // conditions first: the selected fields of discarded messages are never read
+    try{
+      for(size_t c=0; accepted && c < state.conditions.size(); c++)
+      {
+        const Condition& condition = state.conditions[c].second;
+        auto anyElement = [&condition](const SchemaField& leaf, const Span<uint8_t>& buf,
+                                       size_t offset, const std::vector<uint32_t>&) -> bool
+        {
+          const double value = ReadLeafValue( leaf, buf, offset ).convert<double>();
+          return Compare( value, condition.comparison, condition.value );
+        };
+        accepted = state.conditions[c].first.visit( span, anyElement );
+      }
+      for(size_t r=0; accepted && r < state.selected.size(); r++)
+      {
+        const FieldReader& reader = state.selected[r];
+        auto collect = [&](const SchemaField& leaf, const Span<uint8_t>& buf,
+                           size_t offset, const std::vector<uint32_t>& indices) -> bool
+        {
+          reader.key( indices, key );
+          if( leaf.type_id == STRING )
+          {
+            if( strings.size() <= string_count ){
+              strings.resize( string_count + 1 );
+            }
+            auto& entry = strings[string_count++];
+            entry.first.assign( topic_name ).append("/").append( key );
+            ReadLeafString( buf, offset, entry.second );
+          }
+          else{
+            if( values.size() <= value_count ){
+              values.resize( value_count + 1 );
+            }
+            auto& entry = values[value_count++];
+            entry.first.assign( topic_name ).append("/").append( key );
+            entry.second = ReadLeafValue( leaf, buf, offset );
+          }
+          return false;
+        };
+        reader.visit( span, collect );
+      }
+    }
+    catch( std::runtime_error& )
+    {
+      _malformed++;
+      continue;
+    }
+    if( !accepted ){
+      continue;
+    }
+    values.resize( value_count );
+    strings.resize( string_count );
+
+    QueryRecord record;
+    record.topic   = &topic_name;
+    record.time    = msg_instance.getTime();
+    record.buffer  = span;
+    record.values  = &values;
+    record.strings = &strings;
+    callback( record );
+    records++;
+  }
+  return records;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_BAG_QUERY_HPP
@@ -0,0 +1,242 @@
+#ifndef ROS_INTROSPECTION_TEST_BUFFER_VALIDATOR_HPP
+#define ROS_INTROSPECTION_TEST_BUFFER_VALIDATOR_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <cstring>
+#include <limits>
+
+namespace RosIntrospection{
+
+/// Why a buffer was rejected by the BufferValidator.
+struct ValidationError
+{
+  /// position of the length prefix (or of the end of the message) that is not valid.
+  size_t offset;
+  const char* reason;
+};
+
+/**
+ * @brief Checks, in a single pass, that a serialized message is consistent
+ * with its MessageSchema:
+ *
+ *  - every length prefix (strings and dynamic arrays) fits into the remaining bytes,
+ *    considering the minimum serialized size of each element. A corrupted prefix
+ *    can't cause a read past the end of the buffer or a gigantic allocation.
+ *  - arrays are not longer than max_array_length, the only limit for arrays of
+ *    empty messages.
+ *  - the message ends exactly at the end of the buffer.
+ *
+ * Fields with a fixed size are skipped in O(1) and no memory is allocated.
+ * Once a buffer is accepted, it can be walked without any other bounds check
+ * (see MessageSchema::skipMessage<false> and FieldReader::visitValidated).
+ *
+ * The MessageSchema must outlive the BufferValidator.
+ */
+class BufferValidator
+{
+public:
+
+  explicit BufferValidator(const MessageSchema& schema,
+                           uint32_t max_array_length = std::numeric_limits<uint32_t>::max());
+
+  bool validate(const Span<uint8_t>& buffer, ValidationError* error = nullptr) const;
+
+  /// Minimum serialized size of a message of the schema (all dynamic arrays and strings empty).
+  size_t minimumSize(int32_t msg_index) const { return _minimum_size[msg_index]; }
+
+private:
+
+  size_t computeMinimumSize(int32_t msg_index, std::vector<bool>& computed);
+
+  size_t minimumElementSize(const SchemaField& field) const;
+
+  bool validateMessage(int32_t msg_index, const Span<uint8_t>& buffer, size_t& offset,
+                       ValidationError& error) const;
+
+  bool validateField(const SchemaField& field, const Span<uint8_t>& buffer, size_t& offset,
+                     ValidationError& error) const;
+
+  bool readLength(const Span<uint8_t>& buffer, size_t& offset, uint32_t& length,
+                  ValidationError& error) const;
+
+  static bool Fail(ValidationError& error, size_t offset, const char* reason)
+  {
+    error.offset = offset;
+    error.reason = reason;
+    return false;
+  }
+
+  const MessageSchema* _schema;
+  uint32_t _max_array_length;
+  std::vector<size_t> _minimum_size;
+};
+
+//---------------------------------------------------------------------------
+
+inline BufferValidator::BufferValidator(const MessageSchema &schema, uint32_t max_array_length):
+  _schema(&schema),
+  _max_array_length(max_array_length)
+{
+  const size_t count = schema.messages().size();
+  _minimum_size.assign( count, 0 );
+  std::vector<bool> computed( count, false );
+  for(size_t i=0; i < count; i++)
+  {
+    computeMinimumSize( static_cast<int32_t>(i), computed );
+  }
+}
+
+inline size_t BufferValidator::computeMinimumSize(int32_t msg_index, std::vector<bool>& computed)
+{
+  if( computed[msg_index] ){
+    return _minimum_size[msg_index];
+  }
+  // MessageSchema already rejected recursive definitions
+  size_t size = 0;
+  for(const SchemaField& field: _schema->message( msg_index ).fields)
+  {
+    if( field.message_index >= 0 ){
+      computeMinimumSize( field.message_index, computed );
+    }
+    if( field.array_size < 0 ){
+      size += sizeof(uint32_t);
+    }
+    else{
+      size += minimumElementSize( field ) * static_cast<size_t>( field.array_size );
+    }
+  }
+  _minimum_size[msg_index] = size;
+  computed[msg_index] = true;
+  return size;
+}
+
+inline size_t BufferValidator::minimumElementSize(const SchemaField &field) const
+{
+  if( field.builtin_size >= 0 ){
+    return static_cast<size_t>( field.builtin_size );
+  }
+  if( field.message_index >= 0 ){
+    return _minimum_size[ field.message_index ];
+  }
+  return sizeof(uint32_t); // STRING
+}
+
+inline bool BufferValidator::validate(const Span<uint8_t> &buffer, ValidationError *error) const
+{
+  ValidationError local_error;
+  ValidationError& err = error ? *error : local_error;
+
+  if( _schema->messages().empty() ){
+    return Fail( err, 0, "empty schema" );
+  }
+  size_t offset = 0;
+  if( !validateMessage( 0, buffer, offset, err ) ){
+    return false;
+  }
+  if( offset != buffer.size() ){
+    return Fail( err, offset, "unexpected bytes after the end of the message" );
+  }
+  return true;
+}
+
+inline bool BufferValidator::readLength(const Span<uint8_t> &buffer, size_t &offset,
+                                        uint32_t &length, ValidationError &error) const
+{
+  if( buffer.size() - offset < sizeof(uint32_t) ){
+    return Fail( error, offset, "truncated length prefix" );
+  }
+  std::memcpy( &length, buffer.data() + offset, sizeof(uint32_t) );
+  offset += sizeof(uint32_t);
+  return true;
+}
+
+inline bool BufferValidator::validateMessage(int32_t msg_index, const Span<uint8_t> &buffer,
+                                             size_t &offset, ValidationError &error) const
+{
+  const SchemaMessage& msg = _schema->message( msg_index );
+  if( msg.fixed_size >= 0 )
+  {
+    if( buffer.size() - offset < static_cast<size_t>(msg.fixed_size) ){
+      return Fail( error, offset, "truncated message" );
+    }
+    offset += msg.fixed_size;
+    return true;
+  }
+  for(const SchemaField& field: msg.fields)
+  {
+    if( !validateField( field, buffer, offset, error ) ){
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool BufferValidator::validateField(const SchemaField &field, const Span<uint8_t> &buffer,
+                                           size_t &offset, ValidationError &error) const
+{
+  const size_t prefix_offset = offset;
+  uint32_t length = 1;
+
+  if( field.array_size >= 0 )
+  {
+    length = static_cast<uint32_t>( field.array_size );
+  }
+  else if( !readLength( buffer, offset, length, error ) )
+  {
+    return false;
+  }
+
+  if( field.is_array && length > _max_array_length ){
+    return Fail( error, prefix_offset, "array longer than max_array_length" );
+  }
+
+  const size_t element_size = minimumElementSize( field );
+
+  // elements without content (empty messages) are never serialized:
+  // their arrays are bounded only by max_array_length
+  if( element_size == 0 ){
+    return true;
+  }
+  if( length > ( buffer.size() - offset ) / element_size )
+  {
+    return Fail( error, prefix_offset, field.is_array ? "array length exceeds the size of the buffer" :
+                                                        "truncated field" );
+  }
+
+  // fixed size: O(1)
+  int32_t fixed_size = field.builtin_size;
+  if( field.message_index >= 0 ){
+    fixed_size = _schema->message( field.message_index ).fixed_size;
+  }
+  if( fixed_size >= 0 )
+  {
+    offset += static_cast<size_t>(length) * fixed_size;
+    return true;
+  }
+
+  for(uint32_t i=0; i < length; i++)
+  {
+    if( field.message_index >= 0 )
+    {
+      if( !validateMessage( field.message_index, buffer, offset, error ) ){
+        return false;
+      }
+    }
+    else{ // STRING
+      const size_t string_offset = offset;
+      uint32_t string_size = 0;
+      if( !readLength( buffer, offset, string_size, error ) ){
+        return false;
+      }
+      if( string_size > buffer.size() - offset ){
+        return Fail( error, string_offset, "string length exceeds the size of the buffer" );
+      }
+      offset += string_size;
+    }
+  }
+  return true;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_BUFFER_VALIDATOR_HPP
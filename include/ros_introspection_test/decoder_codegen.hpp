@@ -0,0 +1,192 @@
+#ifndef ROS_INTROSPECTION_TEST_DECODER_CODEGEN_HPP
+#define ROS_INTROSPECTION_TEST_DECODER_CODEGEN_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <ros_introspection_test/decoder_plugin.hpp>
+#include <sstream>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Generates the C++ source code of a decoder plugin: one straight-line
+ * FlatDecodeFunction for each registered type, exported with the
+ * function ROS_INTROSPECTION_TEST_DECODER_PLUGIN_SYMBOL.
+ *
+ * The generated functions visit the fields in the same order as the Parser,
+ * therefore they can be used by a SpecializedParser (see DecoderPlugin).
+ */
+class DecoderGenerator
+{
+public:
+
+  /// Types with the same MD5 sum are added only once.
+  void addType(const std::string& md5sum, const MessageSchema& schema);
+
+  size_t typesCount() const { return _types.size(); }
+
+  std::string source() const;
+
+private:
+
+  struct Type
+  {
+    std::string md5sum;
+    MessageSchema schema;
+  };
+
+  static void generateMessage(std::ostream& out, size_t type_index,
+                              const MessageSchema& schema, int32_t msg_index);
+
+  static std::string functionName(size_t type_index, int32_t msg_index);
+
+  std::vector<Type> _types;
+};
+
+//---------------------------------------------------------------------------
+
+inline void DecoderGenerator::addType(const std::string &md5sum, const MessageSchema &schema)
+{
+  for(const Type& type: _types)
+  {
+    if( type.md5sum == md5sum ){
+      return;
+    }
+  }
+  Type type;
+  type.md5sum = md5sum;
+  type.schema = schema;
+  _types.push_back( std::move(type) );
+}
+
+inline std::string DecoderGenerator::functionName(size_t type_index, int32_t msg_index)
+{
+  return "decode_" + std::to_string(type_index) + "_" + std::to_string(msg_index);
+}
+
+/// Statement that decodes a single element of a builtin field, empty if not supported.
+inline const char* GeneratedBuiltinCall(BuiltinType type)
+{
+  switch( type )
+  {
+  case BOOL:     return "d.value<bool>();";
+  case CHAR:     return "d.value<char>();";
+  case BYTE:
+  case UINT8:    return "d.value<uint8_t>();";
+  case UINT16:   return "d.value<uint16_t>();";
+  case UINT32:   return "d.value<uint32_t>();";
+  case UINT64:   return "d.value<uint64_t>();";
+  case INT8:     return "d.value<int8_t>();";
+  case INT16:    return "d.value<int16_t>();";
+  case INT32:    return "d.value<int32_t>();";
+  case INT64:    return "d.value<int64_t>();";
+  case FLOAT32:  return "d.value<float>();";
+  case FLOAT64:  return "d.value<double>();";
+  case TIME:     return "d.time();";
+  case DURATION: return "d.duration();";
+  case STRING:   return "d.string();";
+  default:       return "";
+  }
+}
+
+inline void DecoderGenerator::generateMessage(std::ostream &out, size_t type_index,
+                                              const MessageSchema &schema, int32_t msg_index)
+{
+  const SchemaMessage& msg = schema.message( msg_index );
+
+  out << "// " << msg.datatype << "\n";
+  out << "void " << functionName(type_index, msg_index) << "(FlatDecoder& d)\n{\n";
+
+  for(const SchemaField& field: msg.fields)
+  {
+    std::string element;
+    if( field.message_index >= 0 ){
+      element = functionName(type_index, field.message_index) + "(d);";
+    }
+    else{
+      element = GeneratedBuiltinCall( field.type_id );
+      if( element.empty() )
+      {
+        throw std::runtime_error( "DecoderGenerator: unsupported type " + field.type_name );
+      }
+    }
+
+    if( !field.is_array )
+    {
+      out << "  " << element << " // " << field.name << "\n";
+    }
+    else if( field.array_size < 0 )
+    {
+      out << "  { // " << field.name << "\n"
+          << "    const uint32_t size = d.arrayLength();\n"
+          << "    for(uint32_t i=0; i<size && d.ok(); i++){ " << element << " }\n"
+          << "  }\n";
+    }
+    else if( field.message_index < 0 && field.type_id != STRING &&
+             field.type_id != TIME && field.type_id != DURATION )
+    {
+      // "d.value<T>();" => "d.values<T>(N);"
+      std::string values = element;
+      values.replace( values.find("value<"), 6, "values<" );
+      values.replace( values.find("()"), 2, "(" + std::to_string(field.array_size) + ")" );
+      out << "  " << values << " // " << field.name << "\n";
+    }
+    else
+    {
+      out << "  for(uint32_t i=0; i<" << field.array_size << " && d.ok(); i++){ "
+          << element << " } // " << field.name << "\n";
+    }
+  }
+  out << "}\n\n";
+}
+
+inline std::string DecoderGenerator::source() const
+{
+  std::ostringstream out;
+  out << "// Generated by generate_decoders. Do not edit.\n"
+      << "#include <ros_introspection_test/decoder_plugin.hpp>\n\n"
+      << "using RosIntrospection::FlatDecoder;\n\n"
+      << "namespace {\n\n";
+
+  for(size_t t=0; t < _types.size(); t++)
+  {
+    const MessageSchema& schema = _types[t].schema;
+    for(size_t m=0; m < schema.messages().size(); m++)
+    {
+      out << "void " << functionName(t, m) << "(FlatDecoder& d);\n";
+    }
+  }
+  out << "\n";
+
+  for(size_t t=0; t < _types.size(); t++)
+  {
+    const MessageSchema& schema = _types[t].schema;
+    for(size_t m=0; m < schema.messages().size(); m++)
+    {
+      generateMessage( out, t, schema, static_cast<int32_t>(m) );
+    }
+  }
+
+  out << "const RosIntrospection::FlatDecoderPluginEntry entries[] = {\n";
+  for(size_t t=0; t < _types.size(); t++)
+  {
+    out << "  { \"" << _types[t].md5sum << "\", \""
+        << _types[t].schema.message(0).datatype << "\", &"
+        << functionName(t, 0) << " },\n";
+  }
+  out << "  { nullptr, nullptr, nullptr }\n"
+      << "};\n\n"
+      << "} // end namespace\n\n"
+      << "extern \"C\" const RosIntrospection::FlatDecoderPluginEntry* "
+      << ROS_INTROSPECTION_TEST_DECODER_PLUGIN_SYMBOL
+      << "(uint32_t* abi_version, uint32_t* count)\n"
+      << "{\n"
+      << "  *abi_version = " << ROS_INTROSPECTION_TEST_DECODER_PLUGIN_ABI << ";\n"
+      << "  *count = " << _types.size() << ";\n"
+      << "  return entries;\n"
+      << "}\n";
+  return out.str();
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_DECODER_CODEGEN_HPP
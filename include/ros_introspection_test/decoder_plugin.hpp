@@ -0,0 +1,100 @@
+#ifndef ROS_INTROSPECTION_TEST_DECODER_PLUGIN_HPP
+#define ROS_INTROSPECTION_TEST_DECODER_PLUGIN_HPP
+
+#include <ros_introspection_test/flat_decoder.hpp>
+#include <dlfcn.h>
+#include <stdexcept>
+
+/// Incremented every time FlatDecoder or FlatDecoderPluginEntry change layout.
+#define ROS_INTROSPECTION_TEST_DECODER_PLUGIN_ABI 1
+
+/// Name of the function exported by the plugins.
+#define ROS_INTROSPECTION_TEST_DECODER_PLUGIN_SYMBOL "ros_introspection_decoders"
+
+namespace RosIntrospection{
+
+struct FlatDecoderPluginEntry
+{
+  const char* md5sum;
+  const char* datatype;
+  FlatDecodeFunction decode;
+};
+
+/// Signature of the function exported (extern "C") by a plugin.
+typedef const FlatDecoderPluginEntry* (*FlatDecoderPluginFunction)(uint32_t* abi_version, uint32_t* count);
+
+/**
+ * @brief Shared library containing specialized decoders, created by the tool
+ * generate_decoders.
+ *
+ * The decoders are valid as long as this object exists: destroy it only after
+ * the SpecializedParser that uses them.
+ */
+class DecoderPlugin
+{
+public:
+
+  /// Throws std::runtime_error if the library can't be loaded or was built with a different ABI.
+  explicit DecoderPlugin(const std::string& filename);
+
+  ~DecoderPlugin();
+
+  DecoderPlugin(const DecoderPlugin&) = delete;
+  DecoderPlugin& operator=(const DecoderPlugin&) = delete;
+
+  /// Returns the number of decoders added.
+  size_t registerInto(FlatDecoderRegistry& registry) const;
+
+  const std::vector<FlatDecoderPluginEntry>& entries() const { return _entries; }
+
+private:
+  void* _handle;
+  std::vector<FlatDecoderPluginEntry> _entries;
+};
+
+//---------------------------------------------------------------------------
+
+inline DecoderPlugin::DecoderPlugin(const std::string &filename)
+{
+  _handle = dlopen( filename.c_str(), RTLD_NOW | RTLD_LOCAL );
+  if( !_handle )
+  {
+    throw std::runtime_error( std::string("Can't load decoder plugin: ") + dlerror() );
+  }
+
+  FlatDecoderPluginFunction function = reinterpret_cast<FlatDecoderPluginFunction>(
+        dlsym( _handle, ROS_INTROSPECTION_TEST_DECODER_PLUGIN_SYMBOL ) );
+  if( !function )
+  {
+    dlclose( _handle );
+    throw std::runtime_error( std::string("Not a decoder plugin: ") + filename );
+  }
+
+  uint32_t abi_version = 0;
+  uint32_t count = 0;
+  const FlatDecoderPluginEntry* entries = function( &abi_version, &count );
+  if( abi_version != ROS_INTROSPECTION_TEST_DECODER_PLUGIN_ABI )
+  {
+    dlclose( _handle );
+    throw std::runtime_error( std::string("Decoder plugin built with a different version: ") + filename );
+  }
+  _entries.assign( entries, entries + count );
+}
+
+inline DecoderPlugin::~DecoderPlugin()
+{
+  dlclose( _handle );
+}
+
+inline size_t DecoderPlugin::registerInto(FlatDecoderRegistry &registry) const
+{
+  for(const FlatDecoderPluginEntry& entry: _entries)
+  {
+    registry.add( entry.md5sum, entry.decode );
+  }
+  return _entries.size();
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_DECODER_PLUGIN_HPP
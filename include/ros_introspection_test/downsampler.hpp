@@ -0,0 +1,255 @@
+#ifndef ROS_INTROSPECTION_TEST_DOWNSAMPLER_HPP
+#define ROS_INTROSPECTION_TEST_DOWNSAMPLER_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace RosIntrospection{
+
+/// How a Downsampler selects the messages of a topic.
+struct DownsamplePolicy
+{
+  enum Type {
+    KEEP_ALL,
+    /// one message out of N.
+    EVERY_NTH,
+    /// the most recent message of each time interval.
+    LATEST_PER_INTERVAL,
+    /// the messages with the minimum and maximum value of a leaf, in each time interval.
+    MIN_MAX_PER_INTERVAL
+  };
+
+  Type type;
+  uint32_t every_nth;
+  double period;
+  /// MIN_MAX_PER_INTERVAL only: path of the leaf, as in FieldReader (first element if array).
+  std::string field_path;
+
+  static DownsamplePolicy KeepAll()
+  {
+    return DownsamplePolicy( KEEP_ALL, 1, 0, std::string() );
+  }
+
+  static DownsamplePolicy EveryNth(uint32_t n)
+  {
+    return DownsamplePolicy( EVERY_NTH, n, 0, std::string() );
+  }
+
+  /// period in seconds, e.g. 1.0/30.0 for 30 Hz.
+  static DownsamplePolicy LatestPerInterval(double period)
+  {
+    return DownsamplePolicy( LATEST_PER_INTERVAL, 1, period, std::string() );
+  }
+
+  static DownsamplePolicy MinMaxPerInterval(double period, const std::string& field_path)
+  {
+    return DownsamplePolicy( MIN_MAX_PER_INTERVAL, 1, period, field_path );
+  }
+
+  DownsamplePolicy(): DownsamplePolicy( KEEP_ALL, 1, 0, std::string() ) {}
+
+private:
+  DownsamplePolicy(Type policy_type, uint32_t n, double policy_period, const std::string& path):
+    type(policy_type), every_nth(n), period(policy_period), field_path(path) {}
+};
+
+/**
+ * @brief Decides which messages of a topic should be processed, before they are
+ * copied or deserialized. Messages are only stored by copy of the Message handle
+ * (for instance a ShapeShifter::ConstPtr).
+ *
+ * Interval policies release the messages of an interval when the first message of
+ * a following interval arrives, when flushEnded() is called with a time of a
+ * following interval, or when flush() is called. If only push() is used, they add
+ * a latency of up to one period, and the last message of a topic that stops
+ * publishing is never released: call flushEnded() periodically (for instance
+ * from a timer) to avoid it.
+ *
+ * Not thread-safe.
+ */
+template <typename Message>
+class Downsampler
+{
+public:
+
+  /// Throws std::runtime_error if the policy is not valid.
+  explicit Downsampler(const DownsamplePolicy& policy = DownsamplePolicy());
+
+  const DownsamplePolicy& policy() const { return _policy; }
+
+  /// If true, push() must receive the value of policy().field_path.
+  bool needsValue() const { return _policy.type == DownsamplePolicy::MIN_MAX_PER_INTERVAL; }
+
+  /**
+   * @brief Offer a new message, received at time (seconds).
+   * Returns the number of messages to process (at most 2), written into output in time order.
+   * NaN values are never selected as minimum or maximum.
+   */
+  size_t push(double time, const Message& msg, double value, Message* output);
+
+  size_t push(double time, const Message& msg, Message* output)
+  {
+    return push( time, msg, std::nan(""), output );
+  }
+
+  /// Release the messages of the current interval.
+  size_t flush(Message* output);
+
+  /// Release the messages of the current interval, if time belongs to a following one.
+  size_t flushEnded(double time, Message* output)
+  {
+    if( !_pending || intervalIndex( time ) == _interval ){
+      return 0;
+    }
+    return flush( output );
+  }
+
+  uint64_t receivedCount() const { return _received; }
+
+  uint64_t forwardedCount() const { return _forwarded; }
+
+private:
+
+  struct Candidate
+  {
+    Message msg;
+    uint64_t sequence;
+    double value;
+    bool valid;
+  };
+
+  int64_t intervalIndex(double time) const
+  {
+    return static_cast<int64_t>( std::floor( time / _policy.period ) );
+  }
+
+  DownsamplePolicy _policy;
+  uint64_t _received;
+  uint64_t _forwarded;
+
+  bool _pending;
+  int64_t _interval;
+  Candidate _latest;
+  Candidate _min;
+  Candidate _max;
+};
+
+//---------------------------------------------------------------------------
+
+template <typename Message> inline
+Downsampler<Message>::Downsampler(const DownsamplePolicy &policy):
+  _policy(policy),
+  _received(0),
+  _forwarded(0),
+  _pending(false),
+  _interval(0)
+{
+  if( _policy.type == DownsamplePolicy::EVERY_NTH && _policy.every_nth == 0 ){
+    throw std::runtime_error("Downsampler: N must be greater than zero");
+  }
+  if( ( _policy.type == DownsamplePolicy::LATEST_PER_INTERVAL ||
+        _policy.type == DownsamplePolicy::MIN_MAX_PER_INTERVAL ) && !(_policy.period > 0) ){
+    throw std::runtime_error("Downsampler: the period must be greater than zero");
+  }
+  if( _policy.type == DownsamplePolicy::MIN_MAX_PER_INTERVAL && _policy.field_path.empty() ){
+    throw std::runtime_error("Downsampler: MIN_MAX_PER_INTERVAL needs the path of a field");
+  }
+  _latest.valid = _min.valid = _max.valid = false;
+}
+
+template <typename Message> inline
+size_t Downsampler<Message>::flush(Message *output)
+{
+  if( !_pending ){
+    return 0;
+  }
+  _pending = false;
+  size_t count = 0;
+
+  if( _policy.type == DownsamplePolicy::MIN_MAX_PER_INTERVAL && _min.valid )
+  {
+    const bool min_first = ( _min.sequence <= _max.sequence );
+    const Candidate& first  = min_first ? _min : _max;
+    const Candidate& second = min_first ? _max : _min;
+    output[count++] = first.msg;
+    if( first.sequence != second.sequence ){
+      output[count++] = second.msg;
+    }
+  }
+  else{
+    // LATEST_PER_INTERVAL, or no valid value in this interval
+    output[count++] = _latest.msg;
+  }
+  _latest.msg = Message();
+  _min.msg = Message();
+  _max.msg = Message();
+  _latest.valid = _min.valid = _max.valid = false;
+
+  _forwarded += count;
+  return count;
+}
+
+template <typename Message> inline
+size_t Downsampler<Message>::push(double time, const Message &msg, double value, Message *output)
+{
+  _received++;
+
+  switch( _policy.type )
+  {
+  case DownsamplePolicy::KEEP_ALL:
+    output[0] = msg;
+    _forwarded++;
+    return 1;
+
+  case DownsamplePolicy::EVERY_NTH:
+    if( (_received - 1) % _policy.every_nth == 0 )
+    {
+      output[0] = msg;
+      _forwarded++;
+      return 1;
+    }
+    return 0;
+
+  case DownsamplePolicy::LATEST_PER_INTERVAL:
+  case DownsamplePolicy::MIN_MAX_PER_INTERVAL:
+    break;
+  }
+
+  size_t count = 0;
+  const int64_t interval = intervalIndex( time );
+  if( _pending && interval != _interval )
+  {
+    count = flush( output );
+  }
+  _pending = true;
+  _interval = interval;
+
+  _latest.msg = msg;
+  _latest.sequence = _received;
+  _latest.valid = true;
+
+  if( needsValue() && value == value )
+  {
+    if( !_min.valid || value < _min.value )
+    {
+      _min.msg = msg;
+      _min.sequence = _received;
+      _min.value = value;
+      _min.valid = true;
+    }
+    if( !_max.valid || value > _max.value )
+    {
+      _max.msg = msg;
+      _max.sequence = _received;
+      _max.value = value;
+      _max.valid = true;
+    }
+  }
+  return count;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_DOWNSAMPLER_HPP
@@ -0,0 +1,295 @@
+#ifndef ROS_INTROSPECTION_TEST_FIELD_READER_HPP
+#define ROS_INTROSPECTION_TEST_FIELD_READER_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+
+namespace RosIntrospection{
+
+/**
+ * @brief The FieldReader reads the values of a single leaf path, like
+ * "linear_acceleration/z" or "transforms.#/transform/translation/x",
+ * directly from the serialized message.
+ *
+ * Only the fields on the path are visited: the ones before them are skipped,
+ * in O(1) when their size is fixed, and the ones after them are never touched.
+ *
+ * The indices passed to the visitor are stored in a buffer of the FieldReader,
+ * allocated once: visit() doesn't allocate memory, but the same FieldReader must
+ * not be visited by two threads at once (use the overloads that take the indices).
+ *
+ * The MessageSchema must outlive the FieldReader.
+ */
+class FieldReader
+{
+public:
+
+  FieldReader(): _schema(nullptr) {}
+
+  /// Throws std::runtime_error if the path is not valid or is not a builtin leaf.
+  FieldReader(const MessageSchema& schema, const std::string& path);
+
+  const std::string& path() const { return _path; }
+
+  /// The leaf field.
+  const SchemaField& leaf() const { return *_leaf; }
+
+  /// Number of arrays selected with '#', i.e. size of the indices passed to the visitor.
+  size_t wildcards() const { return _wildcards; }
+
+  /**
+   * @brief Invoke the visitor for each element matching the path:
+   *
+   *     bool visitor(const SchemaField& leaf, const Span<uint8_t>& buffer, size_t offset,
+   *                  const std::vector<uint32_t>& indices);
+   *
+   * offset is the position of the leaf in the buffer. If the visitor returns true,
+   * the visit is interrupted and visit() returns true.
+   */
+  template <typename Visitor>
+  bool visit(const Span<uint8_t>& buffer, Visitor& visitor) const
+  {
+    return visit( buffer, visitor, _indices );
+  }
+
+  /// Same as visit(), with a vector of indices owned by the caller (cleared first).
+  template <typename Visitor>
+  bool visit(const Span<uint8_t>& buffer, Visitor& visitor, std::vector<uint32_t>& indices) const;
+
+  /**
+   * @brief Same as visit(), but the walk doesn't check the bounds of the buffer,
+   * that must have been accepted by a BufferValidator of the same schema.
+   */
+  template <typename Visitor>
+  bool visitValidated(const Span<uint8_t>& buffer, Visitor& visitor) const
+  {
+    return visitValidated( buffer, visitor, _indices );
+  }
+
+  template <typename Visitor>
+  bool visitValidated(const Span<uint8_t>& buffer, Visitor& visitor,
+                      std::vector<uint32_t>& indices) const;
+
+  /// The path where '#' are replaced by the indices, for instance "position.3".
+  void key(const std::vector<uint32_t>& indices, std::string& output) const;
+
+private:
+
+  struct Step
+  {
+    int32_t msg_index;
+    size_t field_index;
+    int32_t array_index;
+    /// Offset of the field from the beginning of the message, -1 if not fixed.
+    int32_t fixed_offset;
+  };
+
+  template <bool Checked, typename Visitor>
+  bool visitStep(size_t step_index, const Span<uint8_t>& buffer, size_t offset,
+                 std::vector<uint32_t>& indices, Visitor& visitor) const;
+
+  const MessageSchema* _schema;
+  std::string _path;
+  std::vector<Step> _steps;
+  const SchemaField* _leaf;
+  size_t _wildcards;
+  // "position.#" is stored as ["position."] and ["", after the index]
+  std::vector<std::string> _key_parts;
+  // scratch buffer of visit(), reserved with _wildcards elements
+  mutable std::vector<uint32_t> _indices;
+};
+
+/// Value of a builtin leaf, other than STRING, at the given offset.
+inline Variant ReadLeafValue(const SchemaField& leaf, const Span<uint8_t>& buffer, size_t offset)
+{
+  return ReadFromBufferToVariant( leaf.type_id, buffer, offset );
+}
+
+/// Value of a STRING leaf at the given offset.
+inline void ReadLeafString(const Span<uint8_t>& buffer, size_t offset, std::string& output)
+{
+  uint32_t string_size = 0;
+  ReadFromBuffer( buffer, offset, string_size );
+  if( offset + string_size > buffer.size() ){
+    ThrowBufferOverrun();
+  }
+  output.assign( reinterpret_cast<const char*>( buffer.data() + offset ), string_size );
+}
+
+//---------------------------------------------------------------------------
+
+inline FieldReader::FieldReader(const MessageSchema &schema, const std::string &path):
+  _schema(&schema),
+  _path(path),
+  _wildcards(0)
+{
+  const std::vector<SchemaPathStep> steps = schema.resolvePath( path );
+
+  int32_t msg_index = 0;
+  std::string key_part;
+
+  for(const SchemaPathStep& path_step: steps)
+  {
+    const SchemaMessage& msg = schema.message( msg_index );
+    const SchemaField& field = msg.fields[path_step.field_index];
+
+    Step step;
+    step.msg_index   = msg_index;
+    step.field_index = path_step.field_index;
+    step.array_index = field.is_array ? path_step.array_index : 0;
+    step.fixed_offset = 0;
+
+    for(size_t i=0; i < path_step.field_index; i++)
+    {
+      const SchemaField& prev = msg.fields[i];
+      int32_t size = prev.builtin_size;
+      if( prev.message_index >= 0 ){
+        size = schema.message( prev.message_index ).fixed_size;
+      }
+      if( size < 0 || prev.array_size < 0 )
+      {
+        step.fixed_offset = -1;
+        break;
+      }
+      step.fixed_offset += size * prev.array_size;
+    }
+    _steps.push_back( step );
+
+    if( &path_step != &steps.front() ){
+      key_part += "/";
+    }
+    key_part += field.name;
+    if( field.is_array )
+    {
+      key_part += ".";
+      if( step.array_index < 0 )
+      {
+        _key_parts.push_back( key_part );
+        key_part.clear();
+        _wildcards++;
+      }
+      else{
+        key_part += std::to_string( step.array_index );
+      }
+    }
+    _leaf = &field;
+    msg_index = field.message_index;
+  }
+  _key_parts.push_back( key_part );
+  _indices.reserve( _wildcards );
+
+  if( _leaf->message_index >= 0 )
+  {
+    throw std::runtime_error( "FieldReader: the path is not a leaf: " + path );
+  }
+}
+
+template <typename Visitor> inline
+bool FieldReader::visit(const Span<uint8_t> &buffer, Visitor &visitor,
+                        std::vector<uint32_t>& indices) const
+{
+  // an exception thrown by a previous visit may have left some indices
+  indices.clear();
+  return visitStep<true>( 0, buffer, 0, indices, visitor );
+}
+
+template <typename Visitor> inline
+bool FieldReader::visitValidated(const Span<uint8_t> &buffer, Visitor &visitor,
+                                 std::vector<uint32_t>& indices) const
+{
+  indices.clear();
+  return visitStep<false>( 0, buffer, 0, indices, visitor );
+}
+
+template <bool Checked, typename Visitor> inline
+bool FieldReader::visitStep(size_t step_index, const Span<uint8_t> &buffer, size_t offset,
+                            std::vector<uint32_t>& indices, Visitor &visitor) const
+{
+  const Step& step = _steps[step_index];
+  const SchemaMessage& msg = _schema->message( step.msg_index );
+  const SchemaField& field = msg.fields[step.field_index];
+
+  if( step.fixed_offset >= 0 )
+  {
+    offset += step.fixed_offset;
+  }
+  else {
+    for(size_t i=0; i < step.field_index; i++)
+    {
+      offset = _schema->skipField<Checked>( msg.fields[i], buffer, offset );
+    }
+  }
+
+  const bool last = ( step_index + 1 == _steps.size() );
+  uint32_t first = 0;
+  uint32_t count = 1;
+
+  if( field.is_array )
+  {
+    const uint32_t length = _schema->readArrayLength<Checked>( field, buffer, offset );
+    if( step.array_index >= 0 )
+    {
+      if( static_cast<uint32_t>(step.array_index) >= length ){
+        return false;
+      }
+      first = step.array_index;
+    }
+    else{
+      count = length;
+    }
+    // skip the elements before the first one
+    int32_t element_size = field.builtin_size;
+    if( field.message_index >= 0 ){
+      element_size = _schema->message( field.message_index ).fixed_size;
+    }
+    if( element_size >= 0 )
+    {
+      offset += static_cast<size_t>(first) * element_size;
+    }
+    else{
+      for(uint32_t i=0; i < first; i++){
+        offset = _schema->skipElement<Checked>( field, buffer, offset );
+      }
+    }
+  }
+  if( Checked && offset > buffer.size() ){
+    ThrowBufferOverrun();
+  }
+
+  const bool wildcard = field.is_array && step.array_index < 0;
+
+  for(uint32_t i=0; i < count; i++)
+  {
+    if( wildcard ){
+      indices.push_back( i );
+    }
+    const bool stop = last ? visitor( field, buffer, offset, indices ) :
+                             visitStep<Checked>( step_index + 1, buffer, offset, indices, visitor );
+    if( wildcard ){
+      indices.pop_back();
+    }
+    if( stop ){
+      return true;
+    }
+    if( i + 1 < count ){
+      offset = _schema->skipElement<Checked>( field, buffer, offset );
+    }
+  }
+  return false;
+}
+
+inline void FieldReader::key(const std::vector<uint32_t> &indices, std::string &output) const
+{
+  output.clear();
+  for(size_t i=0; i < _key_parts.size(); i++)
+  {
+    output.append( _key_parts[i] );
+    if( i < indices.size() && i + 1 < _key_parts.size() )
+    {
+      output.append( std::to_string( indices[i] ) );
+    }
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_FIELD_READER_HPP
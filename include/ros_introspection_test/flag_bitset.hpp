@@ -0,0 +1,269 @@
+#ifndef ROS_INTROSPECTION_TEST_FLAG_BITSET_HPP
+#define ROS_INTROSPECTION_TEST_FLAG_BITSET_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace RosIntrospection{
+
+/// A packed set of boolean flags: bit i is set if the flag i of a FlagLayout is not zero.
+class FlagBitset
+{
+public:
+
+  FlagBitset(): _size(0) {}
+
+  size_t size() const { return _size; }
+
+  bool test(size_t index) const
+  {
+    return ( _words[index / 64] >> (index % 64) ) & 1;
+  }
+
+  bool any() const
+  {
+    for(uint64_t word: _words){
+      if( word ) return true;
+    }
+    return false;
+  }
+
+  /// Number of flags set.
+  size_t count() const
+  {
+    size_t total = 0;
+    for(uint64_t word: _words){
+      total += __builtin_popcountll( word );
+    }
+    return total;
+  }
+
+  /// Invoke callback(index) for each flag set, in increasing order.
+  template <typename Callback>
+  void forEachSet(Callback callback) const
+  {
+    for(size_t w=0; w < _words.size(); w++)
+    {
+      uint64_t word = _words[w];
+      while( word )
+      {
+        callback( w*64 + __builtin_ctzll( word ) );
+        word &= word - 1;
+      }
+    }
+  }
+
+  const std::vector<uint64_t>& words() const { return _words; }
+
+  /// Resize to a number of flags and clear them.
+  void reset(size_t size)
+  {
+    _size = size;
+    _words.assign( (size + 63) / 64, 0 );
+  }
+
+private:
+
+  friend class FlagLayout;
+
+  size_t _size;
+  std::vector<uint64_t> _words;
+};
+
+/**
+ * @brief The FlagLayout finds the flags of a message type, i.e. the fields
+ * bool, byte, int8 and uint8, including fixed-length arrays of bool, and
+ * the sub-messages that are not in an array.
+ *
+ * pack() converts them into a FlagBitset, reading up to 8 consecutive flags
+ * at once, without creating any Variant or StringTreeLeaf.
+ * The name of each flag (the "static leaf table") is computed only once.
+ *
+ * Dynamic arrays and arrays of messages are skipped.
+ * The MessageSchema must outlive the FlagLayout.
+ */
+class FlagLayout
+{
+public:
+
+  FlagLayout(): _schema(nullptr) {}
+
+  explicit FlagLayout(const MessageSchema& schema);
+
+  /// Number of flags.
+  size_t size() const { return _names.size(); }
+
+  /// Path of each flag, for instance "cartesian_reflex" or "flags.3".
+  const std::vector<std::string>& names() const { return _names; }
+
+  /**
+   * @brief Read all the flags of the message. Returns output->any().
+   * Throws std::runtime_error if the buffer is too short.
+   */
+  bool pack(const Span<uint8_t>& buffer, FlagBitset* output) const;
+
+private:
+
+  // a sequence of consecutive flags, preceded by fields and then bytes to skip
+  struct Run
+  {
+    size_t skip_bytes;
+    std::vector<const SchemaField*> skip_fields;
+    uint32_t first_flag;
+    uint32_t count;
+  };
+
+  void addMessage(int32_t msg_index, const std::string& prefix);
+
+  static bool IsFlag(BuiltinType type)
+  {
+    return type == BOOL || type == BYTE || type == INT8 || type == UINT8;
+  }
+
+  static void SetBits(std::vector<uint64_t>& words, size_t position, uint64_t bits);
+
+  const MessageSchema* _schema;
+  std::vector<Run> _runs;
+  std::vector<std::string> _names;
+
+  // used only by the constructor: what must be skipped before the next run
+  size_t _pending_bytes;
+  std::vector<const SchemaField*> _pending_fields;
+};
+
+//---------------------------------------------------------------------------
+
+inline FlagLayout::FlagLayout(const MessageSchema &schema):
+  _schema(&schema),
+  _pending_bytes(0)
+{
+  if( schema.messages().empty() ){
+    throw std::runtime_error("FlagLayout: empty schema");
+  }
+  addMessage( 0, std::string() );
+  // what follows the last flag is never read
+  _pending_bytes = 0;
+  _pending_fields.clear();
+}
+
+inline void FlagLayout::addMessage(int32_t msg_index, const std::string &prefix)
+{
+  for(const SchemaField& field: _schema->message( msg_index ).fields)
+  {
+    const std::string name = prefix + field.name;
+
+    if( !field.is_array && field.message_index >= 0 )
+    {
+      addMessage( field.message_index, name + "/" );
+      continue;
+    }
+
+    const bool is_flag = IsFlag( field.type_id ) &&
+        ( !field.is_array || ( field.type_id == BOOL && field.array_size >= 0 ) );
+
+    if( !is_flag )
+    {
+      int32_t fixed_size = field.builtin_size;
+      if( field.message_index >= 0 ){
+        fixed_size = _schema->message( field.message_index ).fixed_size;
+      }
+      if( fixed_size >= 0 && field.array_size >= 0 ){
+        _pending_bytes += static_cast<size_t>(fixed_size) * field.array_size;
+      }
+      else{
+        // a run always skips its fields first, then its bytes: keep the order
+        if( _pending_bytes > 0 )
+        {
+          _runs.push_back( Run{ _pending_bytes, _pending_fields,
+                                static_cast<uint32_t>(_names.size()), 0 } );
+          _pending_bytes = 0;
+          _pending_fields.clear();
+        }
+        _pending_fields.push_back( &field );
+      }
+      continue;
+    }
+
+    const uint32_t count = static_cast<uint32_t>( field.array_size );
+    // extend the previous run if nothing is in between
+    if( !_runs.empty() && _pending_bytes == 0 && _pending_fields.empty() &&
+        _runs.back().count > 0 )
+    {
+      _runs.back().count += count;
+    }
+    else{
+      _runs.push_back( Run{ _pending_bytes, _pending_fields,
+                            static_cast<uint32_t>(_names.size()), count } );
+      _pending_bytes = 0;
+      _pending_fields.clear();
+    }
+
+    if( !field.is_array ){
+      _names.push_back( name );
+    }
+    else{
+      for(uint32_t i=0; i < count; i++){
+        _names.push_back( name + "." + std::to_string(i) );
+      }
+    }
+  }
+}
+
+inline void FlagLayout::SetBits(std::vector<uint64_t> &words, size_t position, uint64_t bits)
+{
+  const size_t word = position / 64;
+  const size_t shift = position % 64;
+  words[word] |= bits << shift;
+  if( shift > 56 && (bits >> (64 - shift)) ){
+    words[word+1] |= bits >> (64 - shift);
+  }
+}
+
+inline bool FlagLayout::pack(const Span<uint8_t> &buffer, FlagBitset *output) const
+{
+  output->reset( _names.size() );
+  bool any = false;
+  size_t offset = 0;
+
+  for(const Run& run: _runs)
+  {
+    for(const SchemaField* field: run.skip_fields){
+      offset = _schema->skipField( *field, buffer, offset );
+    }
+    offset += run.skip_bytes;
+    if( run.count == 0 ){
+      continue;
+    }
+    if( offset > buffer.size() || buffer.size() - offset < run.count ){
+      ThrowBufferOverrun();
+    }
+
+    const uint8_t* data = buffer.data() + offset;
+    for(uint32_t i=0; i < run.count; i += 8)
+    {
+      const uint32_t bytes = std::min<uint32_t>( 8, run.count - i );
+      uint64_t chunk = 0;
+      std::memcpy( &chunk, data + i, bytes );
+
+      // SWAR: the lowest bit of each byte becomes 1 if the byte is not zero...
+      chunk |= chunk >> 4;
+      chunk |= chunk >> 2;
+      chunk |= chunk >> 1;
+      chunk &= 0x0101010101010101ULL;
+      // ...then the 8 bits are gathered into the top byte
+      const uint64_t bits = ( chunk * 0x0102040810204080ULL ) >> 56;
+      if( bits )
+      {
+        any = true;
+        SetBits( output->_words, run.first_flag + i, bits );
+      }
+    }
+    offset += run.count;
+  }
+  return any;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_FLAG_BITSET_HPP
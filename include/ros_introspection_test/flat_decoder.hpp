@@ -0,0 +1,504 @@
+#ifndef ROS_INTROSPECTION_TEST_FLAT_DECODER_HPP
+#define ROS_INTROSPECTION_TEST_FLAT_DECODER_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <cstring>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief The FlatDecoder is the interface used by type-specific decoders
+ * (hand-written, generated or loaded from a plugin) to update a FlatMessage.
+ *
+ * A specialized decoder is a straight-line sequence of calls that follows the
+ * serialization order of the message, for instance for a std_msgs/Header:
+ *
+ *   decoder.value<uint32_t>();   // seq
+ *   decoder.time();              // stamp
+ *   decoder.string();            // frame_id
+ *
+ * In MEASURE mode nothing is written: the decoder only counts the values and
+ * records the length of the dynamic arrays (the "shape" of the message).
+ *
+ * In FILL mode the values are written, in place, into a FlatMessage that was
+ * previously filled by Parser::deserializeIntoFlatContainer with a message of
+ * the same shape: the keys (StringTreeLeaf) are reused as they are.
+ * If the shape is different, ok() returns false.
+ */
+class FlatDecoder
+{
+public:
+
+  enum Mode { MEASURE, FILL };
+
+  FlatDecoder(Mode mode,
+              const Span<uint8_t>& buffer,
+              FlatMessage* output,
+              std::vector<uint32_t>* shape,
+              uint32_t max_array_size);
+
+  template <typename T> void value();
+
+  void time();
+
+  void duration();
+
+  void string();
+
+  /// Fixed-size array of builtins.
+  template <typename T> void values(uint32_t count);
+
+  /// Read the length of a dynamic array. Returns 0 if decoding failed.
+  uint32_t arrayLength();
+
+  bool ok() const { return _ok; }
+
+  /// True if ok() and the entire FlatMessage was written.
+  bool complete() const;
+
+  size_t valueCount() const { return _value_index; }
+  size_t nameCount()  const { return _name_index; }
+
+private:
+
+  bool consume(size_t bytes);
+
+  template <typename T> T read();
+
+  void writeValue(const Variant& value);
+
+  Mode _mode;
+  const Span<uint8_t>& _buffer;
+  size_t _offset;
+  FlatMessage* _output;
+  std::vector<uint32_t>* _shape;
+  size_t _shape_index;
+  uint32_t _max_array_size;
+  size_t _value_index;
+  size_t _name_index;
+  bool _ok;
+};
+
+typedef void (*FlatDecodeFunction)(FlatDecoder&);
+
+/// Specialized decoders, identified by the MD5 sum of the message definition.
+class FlatDecoderRegistry
+{
+public:
+
+  void add(const std::string& md5sum, FlatDecodeFunction function)
+  {
+    _decoders[md5sum] = function;
+  }
+
+  /// nullptr if not found
+  FlatDecodeFunction find(const std::string& md5sum) const
+  {
+    auto it = _decoders.find(md5sum);
+    return (it == _decoders.end()) ? nullptr : it->second;
+  }
+
+  size_t size() const { return _decoders.size(); }
+
+private:
+  std::unordered_map<std::string, FlatDecodeFunction> _decoders;
+};
+
+/**
+ * @brief Parser that uses a specialized decoder, when available for the MD5 sum
+ * of the registered type, and falls back to Parser::deserializeIntoFlatContainer otherwise.
+ *
+ * The output is identical to the dynamic one: keys come from the Parser,
+ * values from the specialized decoder. This is verified on the first message of
+ * each topic; if there is any difference, the decoder is disabled for that topic.
+ *
+ * The fast path is used when the FlatMessage was last filled by the Parser for the
+ * same topic (it can be shared by many topics) and the message has the same array
+ * sizes as the previous one. Each topic remembers the container that holds its keys,
+ * together with the tree and the number of keys, so no state is kept per container.
+ * When the array sizes of a topic change, the next message skips the fast path and
+ * goes straight to the Parser, until two consecutive messages have the same sizes.
+ */
+class SpecializedParser
+{
+public:
+
+  explicit SpecializedParser(const FlatDecoderRegistry& registry): _registry(registry) {}
+
+  /// Same as Parser::registerMessageDefinition. md5sum is used to find a specialized decoder.
+  void registerMessageDefinition(const std::string& message_identifier,
+                                 const ROSType& main_type,
+                                 const std::string& definition,
+                                 const std::string& md5sum);
+
+  bool deserializeIntoFlatContainer(const std::string& msg_identifier,
+                                    Span<uint8_t> buffer,
+                                    FlatMessage* flat_container_output,
+                                    const uint32_t max_array_size);
+
+  void applyNameTransform(const std::string& msg_identifier,
+                          const FlatMessage& container,
+                          RenamedValues* renamed_value)
+  {
+    _parser.applyNameTransform(msg_identifier, container, renamed_value);
+  }
+
+  Parser& parser() { return _parser; }
+
+  /// True if a specialized decoder was found and verified for this topic.
+  bool isSpecialized(const std::string& msg_identifier) const;
+
+  /// Number of messages decoded with the specialized decoder.
+  uint64_t specializedCount(const std::string& msg_identifier) const;
+
+private:
+
+  struct Topic
+  {
+    FlatDecodeFunction decode;
+    enum State { UNVERIFIED, VERIFIED, DISABLED } state;
+    std::vector<uint32_t> shape;
+    std::vector<uint32_t> previous_shape;
+    bool shape_changed;
+    uint64_t specialized_count;
+
+    // the container that holds the keys of this topic, with the current shape
+    const FlatMessage* keys_container;
+    const StringTree* keys_tree;
+    size_t keys_value_count;
+    size_t keys_name_count;
+
+    bool ownsKeys(const FlatMessage* container) const
+    {
+      return keys_container == container &&
+          container->tree == keys_tree &&
+          container->value.size() == keys_value_count &&
+          container->name.size()  == keys_name_count;
+    }
+  };
+
+  bool verify(Topic& topic, const Span<uint8_t>& buffer,
+              const FlatMessage& reference, uint32_t max_array_size);
+
+  /// Same type and same bits (NaN is equal to NaN).
+  static bool SameValue(const Variant& a, const Variant& b);
+
+  const FlatDecoderRegistry& _registry;
+  Parser _parser;
+  std::unordered_map<std::string, Topic> _topics;
+};
+
+//---------------------------------------------------------------------------
+
+inline FlatDecoder::FlatDecoder(Mode mode,
+                                const Span<uint8_t> &buffer,
+                                FlatMessage *output,
+                                std::vector<uint32_t> *shape,
+                                uint32_t max_array_size):
+  _mode(mode),
+  _buffer(buffer),
+  _offset(0),
+  _output(output),
+  _shape(shape),
+  _shape_index(0),
+  _max_array_size(max_array_size),
+  _value_index(0),
+  _name_index(0),
+  _ok(true)
+{
+  if( _mode == MEASURE ){
+    _shape->clear();
+  }
+}
+
+inline bool FlatDecoder::consume(size_t bytes)
+{
+  if( !_ok || _offset + bytes > _buffer.size() )
+  {
+    _ok = false;
+    return false;
+  }
+  _offset += bytes;
+  return true;
+}
+
+template <typename T> inline
+T FlatDecoder::read()
+{
+  T value = T();
+  const size_t offset = _offset;
+  if( consume( sizeof(T) ) ){
+    std::memcpy( &value, _buffer.data() + offset, sizeof(T) );
+  }
+  return value;
+}
+
+inline void FlatDecoder::writeValue(const Variant &value)
+{
+  if( _mode == FILL )
+  {
+    if( _value_index >= _output->value.size() ){
+      _ok = false;
+      return;
+    }
+    _output->value[_value_index].second = value;
+  }
+  _value_index++;
+}
+
+template <typename T> inline
+void FlatDecoder::value()
+{
+  const T value = read<T>();
+  if( _ok ){
+    writeValue( Variant(value) );
+  }
+}
+
+inline void FlatDecoder::time()
+{
+  const uint32_t sec  = read<uint32_t>();
+  const uint32_t nsec = read<uint32_t>();
+  if( _ok ){
+    writeValue( Variant( ros::Time(sec, nsec) ) );
+  }
+}
+
+inline void FlatDecoder::duration()
+{
+  const int32_t sec  = read<int32_t>();
+  const int32_t nsec = read<int32_t>();
+  if( _ok ){
+    writeValue( Variant( ros::Duration(sec, nsec) ) );
+  }
+}
+
+inline void FlatDecoder::string()
+{
+  const uint32_t length = read<uint32_t>();
+  const size_t offset = _offset;
+  if( !consume(length) ){
+    return;
+  }
+  if( _mode == FILL )
+  {
+    if( _name_index >= _output->name.size() ){
+      _ok = false;
+      return;
+    }
+    _output->name[_name_index].second.assign(
+          reinterpret_cast<const char*>( _buffer.data() + offset ), length );
+  }
+  _name_index++;
+}
+
+template <typename T> inline
+void FlatDecoder::values(uint32_t count)
+{
+  if( count > _max_array_size ){
+    _ok = false; // the Parser would skip this array
+    return;
+  }
+  for(uint32_t i=0; i<count && _ok; i++){
+    value<T>();
+  }
+}
+
+inline uint32_t FlatDecoder::arrayLength()
+{
+  const uint32_t length = read<uint32_t>();
+  if( !_ok ){
+    return 0;
+  }
+  if( length > _max_array_size )
+  {
+    _ok = false;
+    return 0;
+  }
+  if( _mode == MEASURE )
+  {
+    _shape->push_back( length );
+  }
+  else if( _shape_index >= _shape->size() || (*_shape)[_shape_index] != length )
+  {
+    _ok = false;
+    return 0;
+  }
+  _shape_index++;
+  return length;
+}
+
+inline bool FlatDecoder::complete() const
+{
+  return _ok &&
+      _value_index == _output->value.size() &&
+      _name_index  == _output->name.size() &&
+      _shape_index == _shape->size();
+}
+
+//---------------------------------------------------------------------------
+
+inline void SpecializedParser::registerMessageDefinition(const std::string &message_identifier,
+                                                         const ROSType &main_type,
+                                                         const std::string &definition,
+                                                         const std::string &md5sum)
+{
+  _parser.registerMessageDefinition( message_identifier, main_type, definition );
+
+  if( _topics.count(message_identifier) == 0 )
+  {
+    Topic topic;
+    topic.decode = _registry.find( md5sum );
+    topic.state  = topic.decode ? Topic::UNVERIFIED : Topic::DISABLED;
+    topic.shape_changed = false;
+    topic.specialized_count = 0;
+    topic.keys_container = nullptr;
+    topic.keys_tree = nullptr;
+    topic.keys_value_count = 0;
+    topic.keys_name_count = 0;
+    _topics.insert( std::make_pair(message_identifier, topic) );
+  }
+}
+
+inline bool SpecializedParser::verify(Topic &topic, const Span<uint8_t> &buffer,
+                                      const FlatMessage &reference, uint32_t max_array_size)
+{
+  FlatMessage copy = reference;
+  FlatDecoder decoder( FlatDecoder::FILL, buffer, &copy, &topic.shape, max_array_size );
+  topic.decode( decoder );
+  if( !decoder.complete() ){
+    return false;
+  }
+  for(size_t i=0; i < copy.value.size(); i++)
+  {
+    if( !SameValue( copy.value[i].second, reference.value[i].second ) ){
+      return false;
+    }
+  }
+  for(size_t i=0; i < copy.name.size(); i++)
+  {
+    if( copy.name[i].second != reference.name[i].second ){
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T> inline
+bool SameBits(const Variant& a, const Variant& b)
+{
+  const T value_a = a.extract<T>();
+  const T value_b = b.extract<T>();
+  return std::memcmp( &value_a, &value_b, sizeof(T) ) == 0;
+}
+
+inline bool SpecializedParser::SameValue(const Variant &a, const Variant &b)
+{
+  if( a.getTypeID() != b.getTypeID() ){
+    return false;
+  }
+  switch( a.getTypeID() )
+  {
+  case BOOL:    return SameBits<bool>( a, b );
+  case BYTE:
+  case UINT8:   return SameBits<uint8_t>( a, b );
+  case CHAR:
+  case INT8:    return SameBits<int8_t>( a, b );
+  case UINT16:  return SameBits<uint16_t>( a, b );
+  case UINT32:  return SameBits<uint32_t>( a, b );
+  case UINT64:  return SameBits<uint64_t>( a, b );
+  case INT16:   return SameBits<int16_t>( a, b );
+  case INT32:   return SameBits<int32_t>( a, b );
+  case INT64:   return SameBits<int64_t>( a, b );
+  case FLOAT32: return SameBits<float>( a, b );
+  case FLOAT64: return SameBits<double>( a, b );
+  case TIME:
+  {
+    const ros::Time time_a = a.extract<ros::Time>();
+    const ros::Time time_b = b.extract<ros::Time>();
+    return time_a.sec == time_b.sec && time_a.nsec == time_b.nsec;
+  }
+  case DURATION:
+  {
+    const ros::Duration duration_a = a.extract<ros::Duration>();
+    const ros::Duration duration_b = b.extract<ros::Duration>();
+    return duration_a.sec == duration_b.sec && duration_a.nsec == duration_b.nsec;
+  }
+  default: break;
+  }
+  return false;
+}
+
+inline bool SpecializedParser::deserializeIntoFlatContainer(const std::string &msg_identifier,
+                                                            Span<uint8_t> buffer,
+                                                            FlatMessage *flat_container_output,
+                                                            const uint32_t max_array_size)
+{
+  auto it = _topics.find( msg_identifier );
+  Topic* topic = (it == _topics.end()) ? nullptr : &it->second;
+
+  if( topic && topic->state == Topic::VERIFIED && !topic->shape_changed &&
+      topic->ownsKeys( flat_container_output ) )
+  {
+    FlatDecoder decoder( FlatDecoder::FILL, buffer, flat_container_output,
+                         &topic->shape, max_array_size );
+    topic->decode( decoder );
+    if( decoder.complete() )
+    {
+      topic->specialized_count++;
+      return true;
+    }
+  }
+
+  const bool entire_message = _parser.deserializeIntoFlatContainer( msg_identifier, buffer,
+                                                                    flat_container_output,
+                                                                    max_array_size );
+  if( !topic || topic->state == Topic::DISABLED ){
+    return entire_message;
+  }
+  // the keys of the container were overwritten
+  topic->keys_container = nullptr;
+
+  // learn the shape of this message, to decode the next one
+  topic->previous_shape.swap( topic->shape );
+  FlatDecoder measure( FlatDecoder::MEASURE, buffer, nullptr, &topic->shape, max_array_size );
+  topic->decode( measure );
+
+  const bool same_count = measure.ok() &&
+      measure.valueCount() == flat_container_output->value.size() &&
+      measure.nameCount()  == flat_container_output->name.size();
+  // the first message has no previous shape to compare
+  topic->shape_changed = topic->state == Topic::VERIFIED &&
+      ( !same_count || topic->shape != topic->previous_shape );
+
+  if( topic->state == Topic::UNVERIFIED && same_count )
+  {
+    topic->state = verify( *topic, buffer, *flat_container_output, max_array_size ) ?
+          Topic::VERIFIED : Topic::DISABLED;
+  }
+  if( topic->state == Topic::VERIFIED && same_count )
+  {
+    topic->keys_container   = flat_container_output;
+    topic->keys_tree        = flat_container_output->tree;
+    topic->keys_value_count = flat_container_output->value.size();
+    topic->keys_name_count  = flat_container_output->name.size();
+  }
+  return entire_message;
+}
+
+inline bool SpecializedParser::isSpecialized(const std::string &msg_identifier) const
+{
+  auto it = _topics.find( msg_identifier );
+  return it != _topics.end() && it->second.state == Topic::VERIFIED;
+}
+
+inline uint64_t SpecializedParser::specializedCount(const std::string &msg_identifier) const
+{
+  auto it = _topics.find( msg_identifier );
+  return (it == _topics.end()) ? 0 : it->second.specialized_count;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_FLAT_DECODER_HPP
@@ -0,0 +1,423 @@
+#ifndef ROS_INTROSPECTION_TEST_GENERIC_SUBSCRIBER_HPP
+#define ROS_INTROSPECTION_TEST_GENERIC_SUBSCRIBER_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/parser_probe.hpp>
+#include <ros_introspection_test/downsampler.hpp>
+#include <ros_introspection_test/raw_predicate.hpp>
+#include <ros/ros.h>
+#include <topic_tools/shape_shifter.h>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace RosIntrospection{
+
+/**
+ * @brief The GenericSubscriber subscribes to topics of any type and
+ * deserializes them.
+ *
+ * Each topic owns its Parser, buffer, FlatMessage and RenamedValues, that are reused
+ * from one message to the next: once they reached their final capacity, no more
+ * memory is allocated. The state of a topic is selected by the TopicHandle bound
+ * into the ROS callback, without any lookup by name.
+ *
+ * A DownsamplePolicy can be assigned to each topic: messages that are discarded
+ * are never copied nor deserialized, and they don't reach the Dispatcher.
+ *
+ * It is safe to use with ros::MultiThreadedSpinner or ros::AsyncSpinner:
+ * callbacks of the same topic are serialized, different topics run in parallel.
+ * Since applyNameTransform modifies the Parser, each topic has a Parser of its
+ * own: the only lock shared by the topics is taken once, when a topic is
+ * registered.
+ */
+class GenericSubscriber
+{
+public:
+
+  typedef size_t TopicHandle;
+
+  struct Topic
+  {
+    std::string name;
+    std::vector<uint8_t> buffer;
+    FlatMessage flat_container;
+    RenamedValues renamed_values;
+    /// the ShapeShifter being processed. Valid only inside the callback.
+    topic_tools::ShapeShifter::ConstPtr message;
+  };
+
+  /// Invoked after deserialization and renaming, while the topic is locked.
+  typedef std::function<void(const Topic&)> Callback;
+
+  /// Receives the messages from the ROS subscribers instead of processMessage().
+  typedef std::function<void(TopicHandle, const topic_tools::ShapeShifter::ConstPtr&)> Dispatcher;
+
+  explicit GenericSubscriber(const ros::NodeHandle& node_handle,
+                             uint32_t max_array_size = 100);
+
+  /// Without NodeHandle: only addTopic() can be used.
+  explicit GenericSubscriber(uint32_t max_array_size = 100);
+
+  /// Rules must be registered before the first message of the topics of that type.
+  void registerRenamingRules(const ROSType& type, const std::vector<SubstitutionRule>& rules);
+
+  /**
+   * By default messages are processed by the thread of the ROS spinner.
+   * A dispatcher can forward them somewhere else (for instance a TopicScheduler)
+   * that will eventually call processMessage(). Set it before subscribing.
+   */
+  void setDispatcher(const Dispatcher& dispatcher) { _dispatcher = dispatcher; }
+
+  /// Not thread-safe: subscribe to all the topics before starting a multi-threaded spinner.
+  TopicHandle subscribe(const std::string& topic_name, uint32_t queue_size, const Callback& callback);
+
+  /**
+   * Same as subscribe(), but without ROS subscriber: the messages are passed to
+   * receiveMessage() by the caller (for instance, read from a rosbag).
+   */
+  TopicHandle addTopic(const std::string& topic_name, const Callback& callback);
+
+  /**
+   * Messages received at a higher rate than needed are discarded as soon as they
+   * arrive. Not thread-safe: call it before starting the spinner.
+   * Throws std::runtime_error if the policy is not valid.
+   *
+   * The field_path of MIN_MAX_PER_INTERVAL must be a numeric leaf. It can be checked
+   * only once the type of the topic is known: if the first message shows that it
+   * isn't, an error is logged and the topic falls back to LATEST_PER_INTERVAL.
+   *
+   * The intervals are measured with ros::Time::now() when the message is received,
+   * not with the stamp of the message. Call flushEndedIntervals() periodically,
+   * otherwise the last message of an interval waits for the next message of the topic.
+   */
+  void setDownsampling(TopicHandle handle, const DownsamplePolicy& policy);
+
+  DownsamplePolicy downsampling(TopicHandle handle) const;
+
+  /// Process the messages retained by the interval policies (for instance, before shutdown).
+  void flushDownsampling();
+
+  /// Process the messages of the intervals that ended before ros::Time::now().
+  /// Call it from a ros::Timer, with the period of the downsampling.
+  void flushEndedIntervals();
+
+  /// Messages discarded by the DownsamplePolicy of the topic.
+  uint64_t droppedCount(TopicHandle handle) const;
+
+  const Topic& topic(TopicHandle handle) const { return _topics[handle]->state; }
+
+  size_t topicsCount() const { return _topics.size(); }
+
+  /// Statistics of each topic (if compiled with ENABLE_PARSER_PROBES).
+  const ParserProbe& probe() const { return _probe; }
+
+  /// Downsampling, then dispatch or process. Called by the ROS subscriber of the topic.
+  void receiveMessage(TopicHandle handle, const topic_tools::ShapeShifter::ConstPtr& msg);
+
+  /// Deserialize, rename and invoke the callback.
+  void processMessage(TopicHandle handle, const topic_tools::ShapeShifter::ConstPtr& msg);
+
+private:
+
+  struct TopicEntry
+  {
+    Topic state;
+    Callback callback;
+    std::mutex mutex;
+
+    // written once by registerTopic()
+    std::once_flag registered;
+    Parser parser;
+    // counters of the topic, resolved by addTopic()
+    ParserProbe::TopicProbe probe;
+
+    // used before the message is processed, protected by downsample_mutex
+    Downsampler<topic_tools::ShapeShifter::ConstPtr> downsampler;
+    mutable std::mutex downsample_mutex;
+    // MIN_MAX_PER_INTERVAL only: read a single field of the message
+    std::unique_ptr<MessageSchema> value_schema;
+    std::unique_ptr<FieldReader> value_reader;
+    std::vector<uint8_t> value_buffer;
+  };
+
+  /// Register the definition and the renaming rules into the Parser of the topic.
+  void registerTopic(TopicEntry& entry, const topic_tools::ShapeShifter::ConstPtr& msg);
+
+  void forwardMessage(TopicHandle handle, const topic_tools::ShapeShifter::ConstPtr& msg);
+
+  /// Throws std::runtime_error if field_path is not a numeric leaf.
+  static std::unique_ptr<FieldReader> CreateValueReader(const MessageSchema& schema,
+                                                        const std::string& field_path);
+
+  /// Value of the field used by MIN_MAX_PER_INTERVAL, NaN if not available.
+  double readDownsampleValue(TopicEntry& entry, const topic_tools::ShapeShifter::ConstPtr& msg);
+
+  /// All the intervals if time is NaN, otherwise those that ended before time.
+  void flushIntervals(double time);
+
+  std::unique_ptr<ros::NodeHandle> _node_handle;
+  uint32_t _max_array_size;
+
+  std::vector<std::pair<ROSType, std::vector<SubstitutionRule>>> _renaming_rules;
+  std::mutex _rules_mutex;
+
+  ParserProbe _probe;
+  Dispatcher _dispatcher;
+
+  std::vector<std::unique_ptr<TopicEntry>> _topics;
+  std::vector<ros::Subscriber> _subscribers;
+};
+
+//---------------------------------------------------------------------------
+
+inline GenericSubscriber::GenericSubscriber(const ros::NodeHandle &node_handle,
+                                            uint32_t max_array_size):
+  _node_handle( new ros::NodeHandle(node_handle) ),
+  _max_array_size(max_array_size)
+{
+}
+
+inline GenericSubscriber::GenericSubscriber(uint32_t max_array_size):
+  _max_array_size(max_array_size)
+{
+}
+
+inline void GenericSubscriber::registerRenamingRules(const ROSType &type,
+                                                     const std::vector<SubstitutionRule> &rules)
+{
+  std::lock_guard<std::mutex> lock(_rules_mutex);
+  _renaming_rules.push_back( std::make_pair(type, rules) );
+}
+
+inline GenericSubscriber::TopicHandle GenericSubscriber::addTopic(const std::string &topic_name,
+                                                                  const Callback &callback)
+{
+  const TopicHandle handle = _topics.size();
+
+  std::unique_ptr<TopicEntry> entry( new TopicEntry );
+  entry->state.name = topic_name;
+  entry->callback   = callback;
+  entry->probe      = _probe.topic( topic_name );
+  _topics.push_back( std::move(entry) );
+  return handle;
+}
+
+inline GenericSubscriber::TopicHandle GenericSubscriber::subscribe(const std::string &topic_name,
+                                                                   uint32_t queue_size,
+                                                                   const Callback &callback)
+{
+  if( !_node_handle ){
+    throw std::runtime_error( "GenericSubscriber: subscribe() requires a NodeHandle" );
+  }
+  const TopicHandle handle = addTopic( topic_name, callback );
+
+  boost::function<void(const topic_tools::ShapeShifter::ConstPtr&)> ros_callback =
+      [this, handle](const topic_tools::ShapeShifter::ConstPtr& msg) -> void
+  {
+    receiveMessage( handle, msg );
+  };
+  _subscribers.push_back( _node_handle->subscribe( topic_name, queue_size, ros_callback ) );
+  return handle;
+}
+
+inline void GenericSubscriber::setDownsampling(TopicHandle handle, const DownsamplePolicy &policy)
+{
+  TopicEntry& entry = *_topics[handle];
+  std::lock_guard<std::mutex> lock( entry.downsample_mutex );
+  Downsampler<topic_tools::ShapeShifter::ConstPtr> downsampler( policy );
+  std::unique_ptr<FieldReader> value_reader;
+  if( downsampler.needsValue() && entry.value_schema )
+  {
+    value_reader = CreateValueReader( *entry.value_schema, policy.field_path );
+  }
+  entry.downsampler = downsampler;
+  entry.value_reader = std::move( value_reader );
+}
+
+inline DownsamplePolicy GenericSubscriber::downsampling(TopicHandle handle) const
+{
+  const TopicEntry& entry = *_topics[handle];
+  std::lock_guard<std::mutex> lock( entry.downsample_mutex );
+  return entry.downsampler.policy();
+}
+
+inline uint64_t GenericSubscriber::droppedCount(TopicHandle handle) const
+{
+  const TopicEntry& entry = *_topics[handle];
+  std::lock_guard<std::mutex> lock( entry.downsample_mutex );
+  return entry.downsampler.receivedCount() - entry.downsampler.forwardedCount();
+}
+
+inline void GenericSubscriber::registerTopic(TopicEntry &entry,
+                                             const topic_tools::ShapeShifter::ConstPtr &msg)
+{
+  std::call_once( entry.registered, [this, &entry, &msg]()
+  {
+    // the rules are applied to the messages already registered
+    entry.parser.registerMessageDefinition( entry.state.name,
+                                            ROSType( msg->getDataType() ),
+                                            msg->getMessageDefinition() );
+    std::lock_guard<std::mutex> lock(_rules_mutex);
+    for(const auto& rules: _renaming_rules)
+    {
+      entry.parser.registerRenamingRules( rules.first, rules.second );
+    }
+  });
+}
+
+inline void GenericSubscriber::forwardMessage(TopicHandle handle,
+                                              const topic_tools::ShapeShifter::ConstPtr &msg)
+{
+  if( _dispatcher ){
+    _dispatcher( handle, msg );
+  }
+  else{
+    processMessage( handle, msg );
+  }
+}
+
+inline std::unique_ptr<FieldReader> GenericSubscriber::CreateValueReader(const MessageSchema &schema,
+                                                                         const std::string &field_path)
+{
+  std::unique_ptr<FieldReader> reader( new FieldReader( schema, field_path ) );
+  if( reader->leaf().type_id == STRING ){
+    throw std::runtime_error( "GenericSubscriber: can't downsample using the string field " + field_path );
+  }
+  return reader;
+}
+
+inline double GenericSubscriber::readDownsampleValue(TopicEntry &entry,
+                                                     const topic_tools::ShapeShifter::ConstPtr &msg)
+{
+  if( !entry.value_reader )
+  {
+    // the schema comes from the Parser of the topic, registered by the first message
+    if( !entry.value_schema )
+    {
+      registerTopic( entry, msg );
+      entry.value_schema.reset( new MessageSchema( *entry.parser.getMessageInfo( entry.state.name ) ) );
+    }
+    try{
+      entry.value_reader = CreateValueReader( *entry.value_schema, entry.downsampler.policy().field_path );
+    }
+    catch( std::runtime_error& err )
+    {
+      ROS_ERROR( "Downsampling of topic %s: %s. Using the latest message of each interval instead.",
+                 entry.state.name.c_str(), err.what() );
+      const double period = entry.downsampler.policy().period;
+      entry.downsampler = Downsampler<topic_tools::ShapeShifter::ConstPtr>(
+                            DownsamplePolicy::LatestPerInterval( period ) );
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+
+  entry.value_buffer.resize( msg->size() );
+  ros::serialization::OStream stream( entry.value_buffer.data(), entry.value_buffer.size() );
+  msg->write( stream );
+
+  double value = std::numeric_limits<double>::quiet_NaN();
+  auto first_element = [&value](const SchemaField& leaf, const Span<uint8_t>& buffer,
+                                size_t offset, const std::vector<uint32_t>&) -> bool
+  {
+    value = ReadLeafAsDouble( leaf.type_id, buffer, offset );
+    return true;
+  };
+  entry.value_reader->visit( Span<uint8_t>(entry.value_buffer), first_element );
+  return value;
+}
+
+inline void GenericSubscriber::receiveMessage(TopicHandle handle,
+                                              const topic_tools::ShapeShifter::ConstPtr &msg)
+{
+  TopicEntry& entry = *_topics[handle];
+  topic_tools::ShapeShifter::ConstPtr ready[2];
+  size_t count = 0;
+  {
+    std::lock_guard<std::mutex> lock( entry.downsample_mutex );
+    if( entry.downsampler.policy().type == DownsamplePolicy::KEEP_ALL )
+    {
+      ready[count++] = msg;
+    }
+    else{
+      double value = std::numeric_limits<double>::quiet_NaN();
+      if( entry.downsampler.needsValue() )
+      {
+        try{
+          value = readDownsampleValue( entry, msg );
+        }
+        catch( std::runtime_error& err )
+        {
+          // invalid message: the policy falls back to the latest message of the interval
+          ROS_WARN_THROTTLE( 5.0, "Downsampling of topic %s: %s", entry.state.name.c_str(), err.what() );
+        }
+      }
+      count = entry.downsampler.push( ros::Time::now().toSec(), msg, value, ready );
+    }
+  }
+  for(size_t i=0; i < count; i++)
+  {
+    forwardMessage( handle, ready[i] );
+  }
+}
+
+inline void GenericSubscriber::flushDownsampling()
+{
+  flushIntervals( std::numeric_limits<double>::quiet_NaN() );
+}
+
+inline void GenericSubscriber::flushEndedIntervals()
+{
+  flushIntervals( ros::Time::now().toSec() );
+}
+
+inline void GenericSubscriber::flushIntervals(double time)
+{
+  for(TopicHandle handle = 0; handle < _topics.size(); handle++)
+  {
+    TopicEntry& entry = *_topics[handle];
+    topic_tools::ShapeShifter::ConstPtr ready[2];
+    size_t count = 0;
+    {
+      std::lock_guard<std::mutex> lock( entry.downsample_mutex );
+      count = std::isnan( time ) ? entry.downsampler.flush( ready ) :
+                                   entry.downsampler.flushEnded( time, ready );
+    }
+    for(size_t i=0; i < count; i++)
+    {
+      forwardMessage( handle, ready[i] );
+    }
+  }
+}
+
+inline void GenericSubscriber::processMessage(TopicHandle handle,
+                                               const topic_tools::ShapeShifter::ConstPtr &msg)
+{
+  TopicEntry& entry = *_topics[handle];
+  Topic& topic = entry.state;
+
+  std::lock_guard<std::mutex> topic_lock( entry.mutex );
+
+  registerTopic( entry, msg );
+
+  // copy raw memory into the buffer. Same size => no allocation
+  topic.buffer.resize( msg->size() );
+  ros::serialization::OStream stream( topic.buffer.data(), topic.buffer.size() );
+  msg->write( stream );
+
+  _probe.deserializeIntoFlatContainer( entry.parser, entry.probe, Span<uint8_t>(topic.buffer),
+                                       &topic.flat_container, _max_array_size );
+  _probe.applyNameTransform( entry.parser, entry.probe, topic.flat_container, &topic.renamed_values );
+
+  topic.message = msg;
+  if( entry.callback )
+  {
+    entry.callback( topic );
+  }
+  topic.message.reset();
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_GENERIC_SUBSCRIBER_HPP
@@ -0,0 +1,292 @@
+#ifndef ROS_INTROSPECTION_TEST_INCREMENTAL_DECODER_HPP
+#define ROS_INTROSPECTION_TEST_INCREMENTAL_DECODER_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace RosIntrospection{
+
+/// A leaf emitted by the IncrementalDecoder.
+struct IncrementalLeaf
+{
+  const SchemaField* field;
+
+  /**
+   * The serialized value of a builtin, the characters of a STRING, or a fragment
+   * of a blob. Valid only during the callback.
+   */
+  Span<uint8_t> bytes;
+
+  /// True for arrays of builtins longer than max_array_size, emitted in fragments.
+  bool is_blob;
+  /// Blobs only: position of the fragment and total size, in bytes.
+  size_t blob_offset;
+  size_t blob_size;
+};
+
+/**
+ * @brief Deserializes a message that arrives in chunks (for instance from a TCP
+ * connection), without waiting for the whole payload.
+ *
+ * The decoder keeps its position in the schema between calls of feed(); each leaf
+ * is passed to the callback as soon as its bytes are complete:
+ *
+ *     void callback(const IncrementalLeaf& leaf);
+ *
+ * Values are passed by reference to the chunk when they are entirely contained in
+ * it; only values split between two chunks are copied, into a small internal buffer.
+ * Arrays of builtins longer than max_array_size (images, point clouds) are emitted
+ * as blob fragments, as they arrive: a message never needs to be stored in memory
+ * as a whole.
+ *
+ * The MessageSchema must outlive the IncrementalDecoder.
+ */
+class IncrementalDecoder
+{
+public:
+
+  explicit IncrementalDecoder(const MessageSchema& schema, uint32_t max_array_size = 100);
+
+  /// Start a new message.
+  void reset();
+
+  /**
+   * @brief Decode the next chunk of the message. Returns the number of bytes consumed,
+   * that is smaller than chunk.size() only if the message is finished.
+   */
+  template <typename Callback>
+  size_t feed(const Span<uint8_t>& chunk, Callback& callback);
+
+  /// True when all the fields of the message have been decoded.
+  bool finished() const { return _stack.empty(); }
+
+  /// Total number of bytes consumed since reset().
+  size_t bytesConsumed() const { return _consumed; }
+
+  /**
+   * @brief Path of the current leaf, for instance "header/frame_id" or "position.3".
+   * To be used inside the callback. Blobs have no index.
+   */
+  void key(std::string& output) const;
+
+private:
+
+  struct Frame
+  {
+    int32_t msg_index;
+    uint32_t field_index;
+    // elements of the current field
+    uint32_t length;
+    uint32_t element;
+    bool length_known;
+  };
+
+  /// Get n bytes, from the chunk or assembled in _pending. False if more input is needed.
+  bool take(size_t n, const Span<uint8_t>& chunk, size_t& offset, Span<uint8_t>& output);
+
+  const MessageSchema* _schema;
+  uint32_t _max_array_size;
+
+  std::vector<Frame> _stack;
+  std::vector<uint8_t> _pending;
+  size_t _consumed;
+
+  // STRING leaves: size read from the prefix
+  bool _string_size_known;
+  uint32_t _string_size;
+
+  // blob of the top frame
+  bool _in_blob;
+  size_t _blob_offset;
+  size_t _blob_size;
+};
+
+//---------------------------------------------------------------------------
+
+inline IncrementalDecoder::IncrementalDecoder(const MessageSchema &schema, uint32_t max_array_size):
+  _schema(&schema),
+  _max_array_size(max_array_size)
+{
+  if( schema.messages().empty() ){
+    throw std::runtime_error("IncrementalDecoder: empty schema");
+  }
+  reset();
+}
+
+inline void IncrementalDecoder::reset()
+{
+  _stack.clear();
+  _stack.push_back( Frame{ 0, 0, 0, 0, false } );
+  _pending.clear();
+  _consumed = 0;
+  _string_size_known = false;
+  _string_size = 0;
+  _in_blob = false;
+  _blob_offset = 0;
+  _blob_size = 0;
+}
+
+inline bool IncrementalDecoder::take(size_t n, const Span<uint8_t> &chunk, size_t &offset,
+                                     Span<uint8_t> &output)
+{
+  const size_t available = chunk.size() - offset;
+  if( _pending.empty() && available >= n )
+  {
+    // the usual case: no copy
+    output = Span<uint8_t>( chunk.data() + offset, n );
+    offset += n;
+    return true;
+  }
+  const size_t missing = n - _pending.size();
+  const size_t count = std::min( missing, available );
+  _pending.insert( _pending.end(), chunk.data() + offset, chunk.data() + offset + count );
+  offset += count;
+  if( _pending.size() < n ){
+    return false;
+  }
+  output = Span<uint8_t>( _pending.data(), n );
+  return true;
+}
+
+template <typename Callback> inline
+size_t IncrementalDecoder::feed(const Span<uint8_t> &chunk, Callback &callback)
+{
+  size_t offset = 0;
+  IncrementalLeaf leaf;
+  leaf.is_blob = false;
+  leaf.blob_offset = 0;
+  leaf.blob_size = 0;
+
+  while( !_stack.empty() )
+  {
+    Frame& frame = _stack.back();
+    const SchemaMessage& msg = _schema->message( frame.msg_index );
+
+    if( frame.field_index == msg.fields.size() )
+    {
+      _stack.pop_back();
+      if( !_stack.empty() ){
+        _stack.back().element++;
+      }
+      continue;
+    }
+    const SchemaField& field = msg.fields[frame.field_index];
+
+    if( !frame.length_known )
+    {
+      if( field.array_size >= 0 )
+      {
+        frame.length = static_cast<uint32_t>( field.array_size );
+      }
+      else{
+        Span<uint8_t> prefix;
+        if( !take( sizeof(uint32_t), chunk, offset, prefix ) ){
+          break;
+        }
+        std::memcpy( &frame.length, prefix.data(), sizeof(uint32_t) );
+        _pending.clear();
+      }
+      frame.length_known = true;
+      frame.element = 0;
+
+      _in_blob = field.is_array && field.builtin_size > 0 && frame.length > _max_array_size;
+      if( _in_blob )
+      {
+        _blob_offset = 0;
+        _blob_size = static_cast<size_t>( frame.length ) * field.builtin_size;
+      }
+    }
+
+    if( frame.element >= frame.length )
+    {
+      frame.field_index++;
+      frame.length_known = false;
+      _in_blob = false;
+      continue;
+    }
+
+    if( field.message_index >= 0 )
+    {
+      _stack.push_back( Frame{ field.message_index, 0, 0, 0, false } );
+      continue;
+    }
+
+    leaf.field = &field;
+
+    if( _in_blob )
+    {
+      // emit whatever is available, without copying
+      const size_t count = std::min( _blob_size - _blob_offset, chunk.size() - offset );
+      if( count == 0 ){
+        break;
+      }
+      leaf.bytes = Span<uint8_t>( chunk.data() + offset, count );
+      leaf.is_blob = true;
+      leaf.blob_offset = _blob_offset;
+      leaf.blob_size = _blob_size;
+      offset += count;
+      _blob_offset += count;
+      callback( leaf );
+      leaf.is_blob = false;
+
+      if( _blob_offset == _blob_size ){
+        frame.element = frame.length;
+      }
+      continue;
+    }
+
+    if( field.type_id == STRING )
+    {
+      if( !_string_size_known )
+      {
+        Span<uint8_t> prefix;
+        if( !take( sizeof(uint32_t), chunk, offset, prefix ) ){
+          break;
+        }
+        std::memcpy( &_string_size, prefix.data(), sizeof(uint32_t) );
+        _pending.clear();
+        _string_size_known = true;
+      }
+      if( !take( _string_size, chunk, offset, leaf.bytes ) ){
+        break;
+      }
+      _string_size_known = false;
+    }
+    else if( !take( field.builtin_size, chunk, offset, leaf.bytes ) )
+    {
+      break;
+    }
+
+    callback( leaf );
+    _pending.clear();
+    // the callback can't modify the stack: frame is still valid
+    frame.element++;
+  }
+
+  _consumed += offset;
+  return offset;
+}
+
+inline void IncrementalDecoder::key(std::string &output) const
+{
+  output.clear();
+  for(size_t i=0; i < _stack.size(); i++)
+  {
+    const Frame& frame = _stack[i];
+    const SchemaField& field = _schema->message( frame.msg_index ).fields[ frame.field_index ];
+    if( i > 0 ){
+      output.push_back('/');
+    }
+    output.append( field.name );
+    if( field.is_array && !( _in_blob && i+1 == _stack.size() ) )
+    {
+      output.push_back('.');
+      output.append( std::to_string( frame.element ) );
+    }
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_INCREMENTAL_DECODER_HPP
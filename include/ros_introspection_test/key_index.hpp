@@ -0,0 +1,314 @@
+#ifndef ROS_INTROSPECTION_TEST_KEY_INDEX_HPP
+#define ROS_INTROSPECTION_TEST_KEY_INDEX_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_utils.hpp>
+#include <cstring>
+
+namespace RosIntrospection{
+
+/// FNV-1a, 64 bits.
+inline uint64_t HashKey(const char* key, size_t length)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i=0; i<length; i++)
+  {
+    hash ^= static_cast<uint8_t>(key[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Open-addressing hash table (linear probing) from a key to its
+ * position in a vector of keys. Lookups don't allocate memory.
+ */
+class KeyHashTable
+{
+public:
+
+  KeyHashTable(): _mask(0) {}
+
+  /// Keys should be unique; if not, find() returns the first one.
+  void build(std::vector<std::string> keys);
+
+  /// Position of the key, -1 if not found.
+  int find(const char* key, size_t length) const;
+
+  int find(const std::string& key) const { return find( key.data(), key.size() ); }
+
+  const std::vector<std::string>& keys() const { return _keys; }
+
+private:
+
+  struct Slot
+  {
+    uint32_t hash;
+    int32_t  position;   // -1 if empty
+  };
+
+  std::vector<std::string> _keys;
+  std::vector<Slot> _slots;
+  size_t _mask;
+};
+
+/**
+ * @brief Random access by name to the values and strings of a FlatMessage:
+ *
+ *     index.sync(flat);
+ *     index.value("JointState/position.2");
+ *
+ * The index is built the first time it is used (calling toStdString() once
+ * for each leaf) and reused by the following messages of the same topic:
+ * a lookup hashes the key, then checks in O(1) that the leaf at that position
+ * is still the same. The index is rebuilt only when the layout of the message
+ * changed. The first key of a message that is not found requires a scan of the
+ * leaves (without building strings) to confirm that the layout is unchanged;
+ * the following ones are answered in O(1).
+ */
+class FlatKeyIndex
+{
+public:
+
+  FlatKeyIndex(): _msg(nullptr), _rebuild_count(0) {}
+
+  /// Call it for each new message, before the lookups. msg must outlive them.
+  void sync(const FlatMessage& msg);
+
+  /// Position in FlatMessage::value, -1 if not found.
+  int findValue(const std::string& key);
+
+  /// Position in FlatMessage::name, -1 if not found.
+  int findName(const std::string& key);
+
+  /// nullptr if not found.
+  const Variant* value(const std::string& key)
+  {
+    const int pos = findValue(key);
+    return (pos < 0) ? nullptr : &_msg->value[pos].second;
+  }
+
+  /// nullptr if not found.
+  const std::string* name(const std::string& key)
+  {
+    const int pos = findName(key);
+    return (pos < 0) ? nullptr : &_msg->name[pos].second;
+  }
+
+  /// Number of times the index was built.
+  size_t rebuildCount() const { return _rebuild_count; }
+
+private:
+
+  struct Table
+  {
+    Table(): checked(false) {}
+    KeyHashTable hash_table;
+    std::vector<StringTreeLeaf> leaves;
+    // the layout was compared with the current message
+    bool checked;
+  };
+
+  template <typename Vector>
+  int find(Table& table, const Vector& vect, const std::string& key);
+
+  const FlatMessage* _msg;
+  Table _values;
+  Table _names;
+  size_t _rebuild_count;
+};
+
+/**
+ * @brief Random access by name to RenamedValues:
+ *
+ *     index.sync(renamed);
+ *     index.get("JointState/hola/pos");
+ *
+ * Lookups compare only the candidate key; the index is rebuilt when the
+ * keys changed. As in FlatKeyIndex, the keys are compared with the index at
+ * most once per message, by the first key that is not found.
+ */
+class RenamedKeyIndex
+{
+public:
+
+  RenamedKeyIndex(): _values(nullptr), _checked(false), _rebuild_count(0) {}
+
+  /// Call it for each new message, before the lookups. values must outlive them.
+  void sync(const RenamedValues& values)
+  {
+    _values = &values;
+    _checked = false;
+  }
+
+  /// Position in RenamedValues, -1 if not found.
+  int find(const std::string& key);
+
+  /// nullptr if not found.
+  const Variant* get(const std::string& key)
+  {
+    const int pos = find(key);
+    return (pos < 0) ? nullptr : &(*_values)[pos].second;
+  }
+
+  size_t rebuildCount() const { return _rebuild_count; }
+
+private:
+  const RenamedValues* _values;
+  KeyHashTable _hash_table;
+  bool _checked;
+  size_t _rebuild_count;
+};
+
+//---------------------------------------------------------------------------
+
+inline void KeyHashTable::build(std::vector<std::string> keys)
+{
+  _keys = std::move(keys);
+
+  size_t capacity = 8;
+  while( capacity < _keys.size() * 2 ){
+    capacity *= 2;
+  }
+  _mask = capacity - 1;
+  Slot empty = { 0, -1 };
+  _slots.assign( capacity, empty );
+
+  for(size_t i=0; i < _keys.size(); i++)
+  {
+    const std::string& key = _keys[i];
+    if( find(key) >= 0 ){
+      continue; // duplicated
+    }
+    const uint64_t hash = HashKey( key.data(), key.size() );
+    size_t index = hash & _mask;
+    while( _slots[index].position >= 0 ){
+      index = (index + 1) & _mask;
+    }
+    _slots[index].hash = static_cast<uint32_t>(hash);
+    _slots[index].position = static_cast<int32_t>(i);
+  }
+}
+
+inline int KeyHashTable::find(const char *key, size_t length) const
+{
+  if( _slots.empty() ){
+    return -1;
+  }
+  const uint64_t hash = HashKey( key, length );
+  const uint32_t short_hash = static_cast<uint32_t>(hash);
+  size_t index = hash & _mask;
+
+  while( _slots[index].position >= 0 )
+  {
+    const Slot& slot = _slots[index];
+    if( slot.hash == short_hash )
+    {
+      const std::string& candidate = _keys[slot.position];
+      if( candidate.size() == length && std::memcmp( candidate.data(), key, length ) == 0 ){
+        return slot.position;
+      }
+    }
+    index = (index + 1) & _mask;
+  }
+  return -1;
+}
+
+//---------------------------------------------------------------------------
+
+template <typename Vector> inline
+int FlatKeyIndex::find(Table &table, const Vector &vect, const std::string &key)
+{
+  int pos = table.hash_table.find( key );
+  if( pos >= 0 && static_cast<size_t>(pos) < vect.size() &&
+      IsSameLeaf( vect[pos].first, table.leaves[pos] ) )
+  {
+    return pos;
+  }
+
+  if( table.checked ){
+    return -1;
+  }
+  // not found: is the layout the same?
+  table.checked = true;
+  bool same_layout = ( vect.size() == table.leaves.size() );
+  for(size_t i=0; same_layout && i < vect.size(); i++)
+  {
+    same_layout = IsSameLeaf( vect[i].first, table.leaves[i] );
+  }
+  if( same_layout ){
+    return -1;
+  }
+
+  std::vector<std::string> keys;
+  keys.reserve( vect.size() );
+  table.leaves.resize( vect.size() );
+  for(size_t i=0; i < vect.size(); i++)
+  {
+    table.leaves[i] = vect[i].first;
+    keys.push_back( vect[i].first.toStdString() );
+  }
+  table.hash_table.build( std::move(keys) );
+  _rebuild_count++;
+
+  return table.hash_table.find( key );
+}
+
+inline void FlatKeyIndex::sync(const FlatMessage &msg)
+{
+  _msg = &msg;
+  _values.checked = false;
+  _names.checked = false;
+}
+
+inline int FlatKeyIndex::findValue(const std::string &key)
+{
+  return _msg ? find( _values, _msg->value, key ) : -1;
+}
+
+inline int FlatKeyIndex::findName(const std::string &key)
+{
+  return _msg ? find( _names, _msg->name, key ) : -1;
+}
+
+inline int RenamedKeyIndex::find(const std::string &key)
+{
+  if( !_values ){
+    return -1;
+  }
+  const RenamedValues& values = *_values;
+  int pos = _hash_table.find( key );
+  if( pos >= 0 && static_cast<size_t>(pos) < values.size() && values[pos].first == key )
+  {
+    return pos;
+  }
+  if( _checked ){
+    return -1;
+  }
+  _checked = true;
+
+  const std::vector<std::string>& keys = _hash_table.keys();
+  bool same_keys = ( values.size() == keys.size() );
+  for(size_t i=0; same_keys && i < values.size(); i++)
+  {
+    same_keys = ( values[i].first == keys[i] );
+  }
+  if( same_keys ){
+    return -1;
+  }
+
+  std::vector<std::string> new_keys;
+  new_keys.reserve( values.size() );
+  for(const auto& value: values)
+  {
+    new_keys.push_back( value.first );
+  }
+  _hash_table.build( std::move(new_keys) );
+  _rebuild_count++;
+
+  return _hash_table.find( key );
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_KEY_INDEX_HPP
@@ -0,0 +1,414 @@
+#ifndef ROS_INTROSPECTION_TEST_LEAF_AGGREGATOR_HPP
+#define ROS_INTROSPECTION_TEST_LEAF_AGGREGATOR_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_utils.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Streaming quantile estimator with bounded memory and relative error
+ * (logarithmic buckets, as in DDSketch).
+ *
+ * quantile() returns a value within relative_accuracy of the exact one, as long
+ * as no more than max_bins buckets are needed; beyond that, the buckets of the
+ * values closest to zero are merged.
+ */
+class QuantileSketch
+{
+public:
+
+  explicit QuantileSketch(double relative_accuracy = 0.01, size_t max_bins = 2048);
+
+  /// NaN and infinite values are ignored.
+  void add(double value);
+
+  /// q in [0,1]. NaN if empty.
+  double quantile(double q) const;
+
+  uint64_t count() const { return _positive.total + _negative.total + _zero_count; }
+
+  void clear();
+
+private:
+
+  // dense range of bucket counts, starting at bucket min_index
+  struct Store
+  {
+    std::vector<uint64_t> bins;
+    int32_t min_index;
+    uint64_t total;
+  };
+
+  int32_t bucketIndex(double value) const
+  {
+    return static_cast<int32_t>( std::ceil( std::log(value) * _inv_log_gamma ) );
+  }
+
+  double bucketValue(int32_t index) const
+  {
+    return 2.0 * std::pow( _gamma, index ) / ( _gamma + 1.0 );
+  }
+
+  void addToStore(Store& store, int32_t index);
+
+  double _gamma;
+  double _inv_log_gamma;
+  // smaller values are counted as zero
+  double _min_value;
+  size_t _max_bins;
+  Store _positive;
+  Store _negative;   // indices of -value
+  uint64_t _zero_count;
+};
+
+/**
+ * @brief Running statistics (count, min, max, mean, variance and optionally
+ * quantiles) of every numerical leaf of a topic.
+ *
+ * update() reads FlatMessage::value directly: keys are created with
+ * StringTreeLeaf::toStdString() only when the layout of the message changes,
+ * and the statistics are stored by column to be updated in a single pass.
+ * Memory depends only on the number of leaves, not on the number of messages.
+ *
+ * Mean and variance use Welford's algorithm. NaN and infinite values are ignored.
+ */
+class LeafAggregator
+{
+public:
+
+  /// If quantiles is false, quantile() can't be used, but update() is faster.
+  explicit LeafAggregator(bool quantiles = true, double relative_accuracy = 0.01);
+
+  void update(const FlatMessage& message);
+
+  /// Number of leaves.
+  size_t size() const { return _keys.size(); }
+
+  const std::vector<std::string>& keys() const { return _keys; }
+
+  /// Index of a leaf, -1 if not found.
+  int findKey(const std::string& key) const;
+
+  uint64_t count(size_t column) const { return _count[column]; }
+
+  /// NaN if the count is zero.
+  double min(size_t column) const  { return _count[column] ? _min[column] : NaN(); }
+  double max(size_t column) const  { return _count[column] ? _max[column] : NaN(); }
+  double mean(size_t column) const { return _count[column] ? _mean[column] : NaN(); }
+
+  /// Sample variance, NaN if the count is lower than 2.
+  double variance(size_t column) const
+  {
+    return (_count[column] > 1) ? _m2[column] / double(_count[column] - 1) : NaN();
+  }
+
+  /// Throws std::runtime_error if the quantiles are disabled.
+  double quantile(size_t column, double q) const;
+
+  uint64_t messagesCount() const { return _messages; }
+
+  /// Clear the statistics (for instance at the end of a time window). Keys are kept.
+  void reset();
+
+private:
+
+  static double NaN() { return std::numeric_limits<double>::quiet_NaN(); }
+
+  size_t addColumn(const std::string& key);
+
+  bool _quantiles;
+  double _relative_accuracy;
+  uint64_t _messages;
+
+  std::vector<std::string> _keys;
+  std::unordered_map<std::string, size_t> _key_index;
+
+  std::vector<uint64_t> _count;
+  std::vector<double> _min;
+  std::vector<double> _max;
+  std::vector<double> _mean;
+  std::vector<double> _m2;
+  std::vector<QuantileSketch> _sketches;
+
+  // layout of the previous message: column of each value
+  std::vector<size_t> _layout;
+  std::vector<StringTreeLeaf> _layout_leaves;
+  bool _identity_layout;
+
+  std::vector<double> _scratch;
+};
+
+//---------------------------------------------------------------------------
+
+inline QuantileSketch::QuantileSketch(double relative_accuracy, size_t max_bins):
+  _gamma( (1.0 + relative_accuracy) / (1.0 - relative_accuracy) ),
+  _inv_log_gamma( 1.0 / std::log(_gamma) ),
+  _min_value( 1e-9 ),
+  _max_bins( std::max<size_t>( max_bins, 1 ) ),
+  _zero_count(0)
+{
+  if( relative_accuracy <= 0 || relative_accuracy >= 1 ){
+    throw std::runtime_error("QuantileSketch: relative_accuracy must be in (0,1)");
+  }
+  clear();
+}
+
+inline void QuantileSketch::clear()
+{
+  _positive.bins.clear();
+  _positive.min_index = 0;
+  _positive.total = 0;
+  _negative = _positive;
+  _zero_count = 0;
+}
+
+inline void QuantileSketch::addToStore(Store &store, int32_t index)
+{
+  std::vector<uint64_t>& bins = store.bins;
+  store.total++;
+
+  if( bins.empty() )
+  {
+    bins.push_back(1);
+    store.min_index = index;
+    return;
+  }
+  if( index < store.min_index )
+  {
+    const size_t grow = store.min_index - index;
+    if( bins.size() + grow > _max_bins )
+    {
+      // too far from the others: merge into the lowest bucket
+      bins.front()++;
+      return;
+    }
+    bins.insert( bins.begin(), grow, 0 );
+    store.min_index = index;
+  }
+  else if( index - store.min_index >= static_cast<int32_t>(bins.size()) )
+  {
+    bins.resize( index - store.min_index + 1, 0 );
+    if( bins.size() > _max_bins )
+    {
+      // merge the lowest buckets
+      const size_t excess = bins.size() - _max_bins;
+      uint64_t merged = 0;
+      for(size_t i=0; i <= excess; i++){
+        merged += bins[i];
+      }
+      bins.erase( bins.begin(), bins.begin() + excess );
+      bins.front() = merged;
+      store.min_index += static_cast<int32_t>(excess);
+    }
+  }
+  bins[ index - store.min_index ]++;
+}
+
+inline void QuantileSketch::add(double value)
+{
+  // the bucket index of an infinite value doesn't fit into int32_t
+  if( !std::isfinite(value) ){
+    return;
+  }
+  if( value > _min_value ){
+    addToStore( _positive, bucketIndex(value) );
+  }
+  else if( value < -_min_value ){
+    addToStore( _negative, bucketIndex(-value) );
+  }
+  else{
+    _zero_count++;
+  }
+}
+
+inline double QuantileSketch::quantile(double q) const
+{
+  const uint64_t total = count();
+  if( total == 0 ){
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  q = std::min( 1.0, std::max( 0.0, q ) );
+  const double rank = q * double(total - 1);
+  double accumulated = 0;
+
+  // from the most negative to the most positive value
+  const std::vector<uint64_t>& negative = _negative.bins;
+  for(size_t i = negative.size(); i-- > 0; )
+  {
+    accumulated += negative[i];
+    if( accumulated > rank ){
+      return -bucketValue( _negative.min_index + static_cast<int32_t>(i) );
+    }
+  }
+  accumulated += _zero_count;
+  if( accumulated > rank ){
+    return 0.0;
+  }
+  const std::vector<uint64_t>& positive = _positive.bins;
+  for(size_t i = 0; i < positive.size(); i++)
+  {
+    accumulated += positive[i];
+    if( accumulated > rank ){
+      return bucketValue( _positive.min_index + static_cast<int32_t>(i) );
+    }
+  }
+  return bucketValue( _positive.min_index + static_cast<int32_t>(positive.size()) - 1 );
+}
+
+//---------------------------------------------------------------------------
+
+inline LeafAggregator::LeafAggregator(bool quantiles, double relative_accuracy):
+  _quantiles(quantiles),
+  _relative_accuracy(relative_accuracy),
+  _messages(0),
+  _identity_layout(false)
+{
+}
+
+inline int LeafAggregator::findKey(const std::string &key) const
+{
+  auto it = _key_index.find(key);
+  return (it == _key_index.end()) ? -1 : static_cast<int>(it->second);
+}
+
+inline size_t LeafAggregator::addColumn(const std::string &key)
+{
+  auto it = _key_index.find(key);
+  if( it != _key_index.end() ){
+    return it->second;
+  }
+  const size_t column = _keys.size();
+  _keys.push_back( key );
+  _key_index.insert( std::make_pair(key, column) );
+  _count.push_back( 0 );
+  _min.push_back( 0 );
+  _max.push_back( 0 );
+  _mean.push_back( 0 );
+  _m2.push_back( 0 );
+  if( _quantiles ){
+    _sketches.push_back( QuantileSketch( _relative_accuracy ) );
+  }
+  return column;
+}
+
+inline void LeafAggregator::reset()
+{
+  _messages = 0;
+  std::fill( _count.begin(), _count.end(), 0 );
+  std::fill( _mean.begin(), _mean.end(), 0.0 );
+  std::fill( _m2.begin(), _m2.end(), 0.0 );
+  for(QuantileSketch& sketch: _sketches){
+    sketch.clear();
+  }
+}
+
+inline void LeafAggregator::update(const FlatMessage &message)
+{
+  const auto& values = message.value;
+  _messages++;
+
+  bool same_layout = ( _layout_leaves.size() == values.size() && !values.empty() );
+  for(size_t i=0; same_layout && i < values.size(); i++)
+  {
+    same_layout = IsSameLeaf( _layout_leaves[i], values[i].first );
+  }
+  if( !same_layout )
+  {
+    _layout_leaves.resize( values.size() );
+    _layout.resize( values.size() );
+    _identity_layout = true;
+    for(size_t i=0; i < values.size(); i++)
+    {
+      _layout_leaves[i] = values[i].first;
+      _layout[i] = addColumn( values[i].first.toStdString() );
+      _identity_layout = _identity_layout && ( _layout[i] == i );
+    }
+  }
+
+  // convert first, then update the columns in a tight loop
+  const size_t count = values.size();
+  _scratch.resize( count );
+  for(size_t i=0; i < count; i++)
+  {
+    _scratch[i] = values[i].second.convert<double>();
+  }
+
+  const double* x = _scratch.data();
+  if( _identity_layout )
+  {
+    uint64_t* n    = _count.data();
+    double* min    = _min.data();
+    double* max    = _max.data();
+    double* mean   = _mean.data();
+    double* m2     = _m2.data();
+
+    for(size_t i=0; i < count; i++)
+    {
+      const double value = x[i];
+      if( !std::isfinite(value) ){
+        continue;
+      }
+      const uint64_t new_count = ++n[i];
+      if( new_count == 1 )
+      {
+        min[i] = value;
+        max[i] = value;
+      }
+      else{
+        min[i] = std::min( min[i], value );
+        max[i] = std::max( max[i], value );
+      }
+      const double delta = value - mean[i];
+      mean[i] += delta / double(new_count);
+      m2[i] += delta * ( value - mean[i] );
+    }
+  }
+  else{
+    for(size_t i=0; i < count; i++)
+    {
+      const double value = x[i];
+      if( !std::isfinite(value) ){
+        continue;
+      }
+      const size_t c = _layout[i];
+      const uint64_t new_count = ++_count[c];
+      if( new_count == 1 )
+      {
+        _min[c] = value;
+        _max[c] = value;
+      }
+      else{
+        _min[c] = std::min( _min[c], value );
+        _max[c] = std::max( _max[c], value );
+      }
+      const double delta = value - _mean[c];
+      _mean[c] += delta / double(new_count);
+      _m2[c] += delta * ( value - _mean[c] );
+    }
+  }
+
+  if( _quantiles )
+  {
+    for(size_t i=0; i < count; i++){
+      _sketches[ _layout[i] ].add( x[i] );
+    }
+  }
+}
+
+inline double LeafAggregator::quantile(size_t column, double q) const
+{
+  if( !_quantiles ){
+    throw std::runtime_error("LeafAggregator: quantiles are disabled");
+  }
+  return _sketches[column].quantile(q);
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_LEAF_AGGREGATOR_HPP
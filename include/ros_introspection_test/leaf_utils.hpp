@@ -0,0 +1,25 @@
+#ifndef ROS_INTROSPECTION_TEST_LEAF_UTILS_HPP
+#define ROS_INTROSPECTION_TEST_LEAF_UTILS_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+
+namespace RosIntrospection{
+
+/// True if the two leaves refer to the same node of the tree, with the same array indices.
+inline bool IsSameLeaf(const StringTreeLeaf& a, const StringTreeLeaf& b)
+{
+  if( a.node_ptr != b.node_ptr || a.index_array.size() != b.index_array.size() ){
+    return false;
+  }
+  for(size_t i=0; i < a.index_array.size(); i++)
+  {
+    if( a.index_array[i] != b.index_array[i] ){
+      return false;
+    }
+  }
+  return true;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_LEAF_UTILS_HPP
@@ -0,0 +1,546 @@
+#ifndef ROS_INTROSPECTION_TEST_LINEAR_RENAMER_HPP
+#define ROS_INTROSPECTION_TEST_LINEAR_RENAMER_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/string_dictionary.hpp>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief The LinearRenamer converts a FlatMessage into RenamedValues, like
+ * Parser::applyNameTransform, in time proportional to the size of the message,
+ * independently of the number of rules.
+ *
+ * Rules have the same meaning as SubstitutionRule:
+ *
+ *    addRule("transforms.#.transform", "transforms.#.header.frame_id", "transforms.#")
+ *
+ *    tf/transforms.3/transform/rotation/x  ->  tf/transforms.world/rotation/x
+ *
+ * The part of the key matched by the pattern is replaced by the substitution,
+ * where '#' and '@' are replaced by the string found at the alias.
+ * The pattern may contain more than one '#' (nested arrays); the indices of
+ * the alias are matched with the first indices of the pattern.
+ *
+ * The rules are matched only once for each node of the StringTree; then each
+ * message requires:
+ *  - one pass over FlatMessage::name to build, for each alias, an index
+ *    from array position to name.
+ *  - one pass over FlatMessage::value to write the keys, reusing the memory of
+ *    the previous output.
+ *
+ * When a NameEncoder is passed to apply() and the names and the leaves are the
+ * same as in the previous message, the keys already stored in renamed_values
+ * are kept and only the values are copied.
+ *
+ * Use one instance per topic, or at least per thread.
+ */
+class LinearRenamer
+{
+public:
+
+  LinearRenamer(): _last_output(nullptr) {}
+
+  /// Throws std::runtime_error if the rule is not valid. Call it before apply().
+  void addRule(const std::string& pattern,
+               const std::string& alias,
+               const std::string& substitution);
+
+  void apply(const FlatMessage& container, RenamedValues* renamed_values);
+
+  /**
+   * @brief Same as above. names must have been updated with the same container.
+   * renamed_values must be the output of the previous call, not modified.
+   */
+  void apply(const FlatMessage& container, const NameEncoder& names,
+             RenamedValues* renamed_values);
+
+  /// Number of StringTree nodes analyzed so far.
+  size_t cachedNodes() const { return _value_nodes.size() + _name_nodes.size(); }
+
+private:
+
+  struct Token
+  {
+    std::string text;
+    char separator;   // character before the token, 0 for the first one
+    int index;        // ordinal of the array index, -1 if it is not an index
+  };
+
+  struct Segment
+  {
+    enum Kind { LITERAL, INDEX, NAME } kind;
+    std::string text;
+    size_t index;
+  };
+
+  struct Rule
+  {
+    std::vector<std::string> pattern;
+    std::string substitution;
+    size_t alias;
+    size_t pattern_indices;
+  };
+
+  struct Alias
+  {
+    std::vector<std::string> tokens;
+    size_t indices;
+    // filled by each message: packed indices and name, sorted by index
+    std::vector<std::pair<uint64_t, const std::string*>> names;
+    size_t cursor;
+  };
+
+  struct ValueNode
+  {
+    std::vector<Segment> plain;
+    std::vector<Segment> renamed;
+    int rule;
+    size_t first_index;
+  };
+
+  struct NameNode
+  {
+    int alias;
+    size_t first_index;
+  };
+
+  static std::vector<std::string> SplitRule(const std::string& rule);
+
+  static std::vector<Token> Tokenize(const std::string& key);
+
+  /// Position of the first occurrence of pattern in tokens, -1 if not found.
+  static int Find(const std::vector<Token>& tokens, const std::vector<std::string>& pattern,
+                  bool at_the_end);
+
+  static void AppendLiteral(std::vector<Segment>& segments, const std::string& text);
+
+  static void AppendTokens(std::vector<Segment>& segments, const std::vector<Token>& tokens,
+                           size_t begin, size_t end);
+
+  static uint64_t PackIndices(const StringTreeLeaf& leaf, size_t first, size_t count);
+
+  static void Assemble(const std::vector<Segment>& segments, const StringTreeLeaf& leaf,
+                       const std::string* name, std::string& output);
+
+  const ValueNode& valueNode(const StringTreeLeaf& leaf);
+
+  const NameNode& nameNode(const StringTreeLeaf& leaf);
+
+  static const std::string* FindName(Alias& alias, uint64_t key);
+
+  std::vector<Rule> _rules;
+  std::vector<Alias> _aliases;
+  std::unordered_map<const StringTreeNode*, ValueNode> _value_nodes;
+  std::unordered_map<const StringTreeNode*, NameNode> _name_nodes;
+
+  // to reuse the keys of the previous output
+  std::vector<StringTreeLeaf> _layout_leaves;
+  const RenamedValues* _last_output;
+};
+
+//---------------------------------------------------------------------------
+
+inline std::vector<std::string> LinearRenamer::SplitRule(const std::string &rule)
+{
+  std::vector<std::string> tokens;
+  std::string current;
+  for(char c: rule)
+  {
+    if( c == '.' || c == '/' )
+    {
+      if( !current.empty() ){
+        tokens.push_back( current );
+      }
+      current.clear();
+    }
+    else{
+      current.push_back( c );
+    }
+  }
+  if( !current.empty() ){
+    tokens.push_back( current );
+  }
+  return tokens;
+}
+
+inline std::vector<LinearRenamer::Token> LinearRenamer::Tokenize(const std::string &key)
+{
+  // "tf/transforms.3/transform/x" -> [tf] [transforms] [#0] [transform] [x]
+  std::vector<Token> tokens;
+  Token current = { std::string(), 0, -1 };
+  int indices = 0;
+
+  auto finishToken = [&]()
+  {
+    const bool numeric = !current.text.empty() && current.separator == '.' &&
+        std::all_of( current.text.begin(), current.text.end(),
+                     [](char ch) { return std::isdigit( static_cast<unsigned char>(ch) ) != 0; } );
+    if( numeric )
+    {
+      current.text = "#";
+      current.index = indices++;
+    }
+    tokens.push_back( current );
+  };
+
+  for(char c: key)
+  {
+    if( c == '.' || c == '/' )
+    {
+      finishToken();
+      current.text.clear();
+      current.separator = c;
+      current.index = -1;
+    }
+    else{
+      current.text.push_back( c );
+    }
+  }
+  finishToken();
+  return tokens;
+}
+
+inline int LinearRenamer::Find(const std::vector<Token> &tokens,
+                               const std::vector<std::string> &pattern,
+                               bool at_the_end)
+{
+  if( pattern.empty() || pattern.size() > tokens.size() ){
+    return -1;
+  }
+  const size_t last = tokens.size() - pattern.size();
+  for(size_t start = at_the_end ? last : 0; start <= last; start++)
+  {
+    bool match = true;
+    for(size_t i=0; match && i < pattern.size(); i++)
+    {
+      const Token& token = tokens[start + i];
+      match = ( pattern[i] == "#" ) ? (token.index >= 0) :
+                                      (token.index < 0 && token.text == pattern[i]);
+    }
+    if( match ){
+      return static_cast<int>(start);
+    }
+  }
+  return -1;
+}
+
+inline void LinearRenamer::AppendLiteral(std::vector<Segment> &segments, const std::string &text)
+{
+  if( text.empty() ){
+    return;
+  }
+  if( !segments.empty() && segments.back().kind == Segment::LITERAL )
+  {
+    segments.back().text.append( text );
+  }
+  else{
+    Segment segment = { Segment::LITERAL, text, 0 };
+    segments.push_back( segment );
+  }
+}
+
+inline void LinearRenamer::AppendTokens(std::vector<Segment> &segments,
+                                        const std::vector<Token> &tokens,
+                                        size_t begin, size_t end)
+{
+  for(size_t i=begin; i<end; i++)
+  {
+    const Token& token = tokens[i];
+    if( token.separator ){
+      AppendLiteral( segments, std::string(1, token.separator) );
+    }
+    if( token.index >= 0 )
+    {
+      Segment segment = { Segment::INDEX, std::string(), static_cast<size_t>(token.index) };
+      segments.push_back( segment );
+    }
+    else{
+      AppendLiteral( segments, token.text );
+    }
+  }
+}
+
+inline void LinearRenamer::addRule(const std::string &pattern,
+                                   const std::string &alias,
+                                   const std::string &substitution)
+{
+  Rule rule;
+  rule.pattern = SplitRule( pattern );
+  rule.substitution = substitution;
+  rule.pattern_indices = std::count( rule.pattern.begin(), rule.pattern.end(), std::string("#") );
+
+  const std::vector<std::string> alias_tokens = SplitRule( alias );
+  const size_t alias_indices = std::count( alias_tokens.begin(), alias_tokens.end(), std::string("#") );
+
+  if( rule.pattern.empty() || alias_tokens.empty() ){
+    throw std::runtime_error("LinearRenamer: empty pattern or alias");
+  }
+  if( alias_indices > rule.pattern_indices ){
+    throw std::runtime_error("LinearRenamer: the alias has more indices than the pattern: " + alias);
+  }
+  if( alias_indices > 4 ){
+    throw std::runtime_error("LinearRenamer: at most 4 nested indices are supported: " + alias);
+  }
+
+  rule.alias = _aliases.size();
+  for(size_t i=0; i < _aliases.size(); i++)
+  {
+    if( _aliases[i].tokens == alias_tokens ){
+      rule.alias = i;
+    }
+  }
+  if( rule.alias == _aliases.size() )
+  {
+    Alias new_alias;
+    new_alias.tokens  = alias_tokens;
+    new_alias.indices = alias_indices;
+    new_alias.cursor  = 0;
+    _aliases.push_back( new_alias );
+  }
+  _rules.push_back( rule );
+
+  // the nodes must be analyzed again
+  _value_nodes.clear();
+  _name_nodes.clear();
+  _last_output = nullptr;
+}
+
+inline uint64_t LinearRenamer::PackIndices(const StringTreeLeaf &leaf, size_t first, size_t count)
+{
+  uint64_t key = 0;
+  for(size_t i=0; i<count; i++)
+  {
+    key = (key << 16) | leaf.index_array[first + i];
+  }
+  return key;
+}
+
+inline void LinearRenamer::Assemble(const std::vector<Segment> &segments,
+                                    const StringTreeLeaf &leaf,
+                                    const std::string *name,
+                                    std::string &output)
+{
+  output.clear();
+  for(const Segment& segment: segments)
+  {
+    switch( segment.kind )
+    {
+    case Segment::LITERAL:
+      output.append( segment.text );
+      break;
+    case Segment::NAME:
+      output.append( *name );
+      break;
+    case Segment::INDEX:{
+      char digits[8];
+      int length = 0;
+      uint16_t index = leaf.index_array[segment.index];
+      do{
+        digits[length++] = '0' + (index % 10);
+        index /= 10;
+      } while( index > 0 );
+      while( length > 0 ){
+        output.push_back( digits[--length] );
+      }
+    } break;
+    }
+  }
+}
+
+inline const LinearRenamer::ValueNode& LinearRenamer::valueNode(const StringTreeLeaf &leaf)
+{
+  auto it = _value_nodes.find( leaf.node_ptr );
+  if( it != _value_nodes.end() ){
+    return it->second;
+  }
+
+  // first time we see this node: match the rules
+  const std::vector<Token> tokens = Tokenize( leaf.toStdString() );
+
+  ValueNode node;
+  node.rule = -1;
+  node.first_index = 0;
+  AppendTokens( node.plain, tokens, 0, tokens.size() );
+
+  for(size_t r=0; r < _rules.size(); r++)
+  {
+    const Rule& rule = _rules[r];
+    const int start = Find( tokens, rule.pattern, false );
+    if( start < 0 ){
+      continue;
+    }
+    const size_t end = start + rule.pattern.size();
+    node.rule = static_cast<int>(r);
+
+    for(int i=start; i < static_cast<int>(end); i++)
+    {
+      if( tokens[i].index >= 0 ){
+        node.first_index = tokens[i].index;
+        break;
+      }
+    }
+
+    AppendTokens( node.renamed, tokens, 0, start );
+    if( tokens[start].separator ){
+      AppendLiteral( node.renamed, std::string(1, tokens[start].separator) );
+    }
+    for(char c: rule.substitution)
+    {
+      if( c == '#' || c == '@' )
+      {
+        Segment segment = { Segment::NAME, std::string(), 0 };
+        node.renamed.push_back( segment );
+      }
+      else{
+        AppendLiteral( node.renamed, std::string(1, c) );
+      }
+    }
+    AppendTokens( node.renamed, tokens, end, tokens.size() );
+    break;
+  }
+  return _value_nodes.insert( std::make_pair(leaf.node_ptr, node) ).first->second;
+}
+
+inline const LinearRenamer::NameNode& LinearRenamer::nameNode(const StringTreeLeaf &leaf)
+{
+  auto it = _name_nodes.find( leaf.node_ptr );
+  if( it != _name_nodes.end() ){
+    return it->second;
+  }
+  const std::vector<Token> tokens = Tokenize( leaf.toStdString() );
+
+  NameNode node;
+  node.alias = -1;
+  node.first_index = 0;
+
+  for(size_t a=0; a < _aliases.size(); a++)
+  {
+    const int start = Find( tokens, _aliases[a].tokens, true );
+    if( start < 0 ){
+      continue;
+    }
+    node.alias = static_cast<int>(a);
+    for(size_t i=start; i < tokens.size(); i++)
+    {
+      if( tokens[i].index >= 0 ){
+        node.first_index = tokens[i].index;
+        break;
+      }
+    }
+    break;
+  }
+  return _name_nodes.insert( std::make_pair(leaf.node_ptr, node) ).first->second;
+}
+
+inline const std::string* LinearRenamer::FindName(Alias &alias, uint64_t key)
+{
+  auto& names = alias.names;
+  // the values are usually visited in the same order as the names
+  if( alias.cursor >= names.size() || names[alias.cursor].first > key )
+  {
+    alias.cursor = 0;
+  }
+  while( alias.cursor < names.size() && names[alias.cursor].first < key )
+  {
+    alias.cursor++;
+  }
+  if( alias.cursor < names.size() && names[alias.cursor].first == key ){
+    return names[alias.cursor].second;
+  }
+  return nullptr;
+}
+
+inline void LinearRenamer::apply(const FlatMessage &container, const NameEncoder &names,
+                                 RenamedValues *renamed_values)
+{
+  const auto& values = container.value;
+
+  bool same_layout = names.namesUnchanged() &&
+      _last_output == renamed_values &&
+      _layout_leaves.size() == values.size() &&
+      renamed_values->size() == values.size();
+
+  for(size_t i=0; same_layout && i < values.size(); i++)
+  {
+    same_layout = IsSameLeaf( _layout_leaves[i], values[i].first );
+  }
+
+  if( same_layout )
+  {
+    for(size_t i=0; i < values.size(); i++)
+    {
+      (*renamed_values)[i].second = values[i].second;
+    }
+    return;
+  }
+
+  apply( container, renamed_values );
+
+  _layout_leaves.resize( values.size() );
+  for(size_t i=0; i < values.size(); i++)
+  {
+    _layout_leaves[i] = values[i].first;
+  }
+  _last_output = renamed_values;
+}
+
+inline void LinearRenamer::apply(const FlatMessage &container, RenamedValues *renamed_values)
+{
+  _last_output = nullptr;
+
+  for(Alias& alias: _aliases)
+  {
+    alias.names.clear();
+    alias.cursor = 0;
+  }
+
+  for(const auto& name: container.name)
+  {
+    const NameNode& node = nameNode( name.first );
+    if( node.alias >= 0 )
+    {
+      Alias& alias = _aliases[node.alias];
+      const uint64_t key = PackIndices( name.first, node.first_index, alias.indices );
+      alias.names.push_back( std::make_pair(key, &name.second) );
+    }
+  }
+  // names are sorted already, unless the alias skips the outer arrays
+  auto byIndex = [](const std::pair<uint64_t, const std::string*>& a,
+                    const std::pair<uint64_t, const std::string*>& b)
+  {
+    return a.first < b.first;
+  };
+  for(Alias& alias: _aliases)
+  {
+    if( !std::is_sorted( alias.names.begin(), alias.names.end(), byIndex ) ){
+      std::stable_sort( alias.names.begin(), alias.names.end(), byIndex );
+    }
+  }
+
+  renamed_values->resize( container.value.size() );
+
+  for(size_t i=0; i < container.value.size(); i++)
+  {
+    const StringTreeLeaf& leaf = container.value[i].first;
+    auto& output = (*renamed_values)[i];
+    output.second = container.value[i].second;
+
+    const ValueNode& node = valueNode( leaf );
+    const std::string* name = nullptr;
+    if( node.rule >= 0 )
+    {
+      Alias& alias = _aliases[ _rules[node.rule].alias ];
+      name = FindName( alias, PackIndices( leaf, node.first_index, alias.indices ) );
+    }
+    Assemble( name ? node.renamed : node.plain, leaf, name, output.first );
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_LINEAR_RENAMER_HPP
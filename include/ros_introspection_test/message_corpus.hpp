@@ -0,0 +1,228 @@
+#ifndef ROS_INTROSPECTION_TEST_MESSAGE_CORPUS_HPP
+#define ROS_INTROSPECTION_TEST_MESSAGE_CORPUS_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace RosIntrospection{
+
+/// A topic of a MessageCorpus, with everything needed to register it into a Parser.
+struct CorpusTopic
+{
+  std::string name;
+  std::string datatype;
+  std::string md5sum;
+  std::string definition;
+};
+
+/// A message of a MessageCorpus. Its bytes are returned by MessageCorpus::buffer().
+struct CorpusMessage
+{
+  uint32_t topic;
+  ros::Time time;
+  size_t offset;
+  size_t size;
+};
+
+/**
+ * @brief A list of serialized messages and the definitions of their types,
+ * stored in a single file, to replay the same data in every benchmark run.
+ *
+ * File format (little endian):
+ *
+ *     "RITCORP1"  uint32 topics_count
+ *     for each topic:   4 strings (uint32 size + characters): name, datatype, md5sum, definition
+ *     uint64 messages_count
+ *     for each message: uint32 topic, uint32 sec, uint32 nsec, uint32 size, bytes
+ *
+ * The bytes of all the messages are stored contiguously in memory, in the
+ * order they were added.
+ */
+class MessageCorpus
+{
+public:
+
+  MessageCorpus() {}
+
+  /// Returns the index of the topic. A topic with the same name is added only once.
+  uint32_t addTopic(const CorpusTopic& topic);
+
+  /// Copy a message of a topic added with addTopic().
+  void addMessage(uint32_t topic, const ros::Time& time, const Span<uint8_t>& buffer);
+
+  const std::vector<CorpusTopic>& topics() const { return _topics; }
+
+  size_t messagesCount() const { return _messages.size(); }
+
+  const CorpusMessage& message(size_t index) const { return _messages[index]; }
+
+  Span<uint8_t> buffer(size_t index)
+  {
+    const CorpusMessage& msg = _messages[index];
+    return Span<uint8_t>( _data.data() + msg.offset, msg.size );
+  }
+
+  /// Sum of the size of all the messages.
+  size_t totalBytes() const { return _data.size(); }
+
+  /// Throws std::runtime_error if the file can't be written.
+  void save(const std::string& filename) const;
+
+  /// Replace the content with the one of the file. Throws std::runtime_error if it is not valid.
+  void load(const std::string& filename);
+
+  void clear()
+  {
+    _topics.clear();
+    _messages.clear();
+    _data.clear();
+  }
+
+private:
+
+  static void WriteString(std::ofstream& file, const std::string& str);
+
+  template <typename T>
+  static void Write(std::ofstream& file, T value)
+  {
+    file.write( reinterpret_cast<const char*>(&value), sizeof(T) );
+  }
+
+  std::vector<CorpusTopic> _topics;
+  std::vector<CorpusMessage> _messages;
+  std::vector<uint8_t> _data;
+};
+
+//---------------------------------------------------------------------------
+
+inline uint32_t MessageCorpus::addTopic(const CorpusTopic &topic)
+{
+  for(size_t i=0; i < _topics.size(); i++)
+  {
+    if( _topics[i].name == topic.name ){
+      return static_cast<uint32_t>(i);
+    }
+  }
+  _topics.push_back( topic );
+  return static_cast<uint32_t>( _topics.size() - 1 );
+}
+
+inline void MessageCorpus::addMessage(uint32_t topic, const ros::Time &time,
+                                      const Span<uint8_t> &buffer)
+{
+  if( topic >= _topics.size() ){
+    throw std::runtime_error("MessageCorpus: unknown topic index");
+  }
+  CorpusMessage msg;
+  msg.topic  = topic;
+  msg.time   = time;
+  msg.offset = _data.size();
+  msg.size   = buffer.size();
+  _data.insert( _data.end(), buffer.data(), buffer.data() + buffer.size() );
+  _messages.push_back( msg );
+}
+
+inline void MessageCorpus::WriteString(std::ofstream &file, const std::string &str)
+{
+  Write<uint32_t>( file, static_cast<uint32_t>(str.size()) );
+  file.write( str.data(), str.size() );
+}
+
+inline void MessageCorpus::save(const std::string &filename) const
+{
+  std::ofstream file( filename.c_str(), std::ios::binary );
+  if( !file ){
+    throw std::runtime_error("MessageCorpus: can't open " + filename );
+  }
+  file.write( "RITCORP1", 8 );
+  Write<uint32_t>( file, static_cast<uint32_t>(_topics.size()) );
+  for(const CorpusTopic& topic: _topics)
+  {
+    WriteString( file, topic.name );
+    WriteString( file, topic.datatype );
+    WriteString( file, topic.md5sum );
+    WriteString( file, topic.definition );
+  }
+  Write<uint64_t>( file, _messages.size() );
+  for(const CorpusMessage& msg: _messages)
+  {
+    Write<uint32_t>( file, msg.topic );
+    Write<uint32_t>( file, msg.time.sec );
+    Write<uint32_t>( file, msg.time.nsec );
+    Write<uint32_t>( file, static_cast<uint32_t>(msg.size) );
+    file.write( reinterpret_cast<const char*>( _data.data() + msg.offset ), msg.size );
+  }
+  if( !file ){
+    throw std::runtime_error("MessageCorpus: error writing " + filename );
+  }
+}
+
+inline void MessageCorpus::load(const std::string &filename)
+{
+  std::ifstream file( filename.c_str(), std::ios::binary );
+  if( !file ){
+    throw std::runtime_error("MessageCorpus: can't open " + filename );
+  }
+  std::vector<uint8_t> content( (std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>() );
+  Span<uint8_t> input( content );
+  size_t offset = 0;
+
+  auto ReadBytes = [&](size_t size) -> const uint8_t*
+  {
+    if( offset > input.size() || input.size() - offset < size ){
+      throw std::runtime_error("MessageCorpus: truncated file " + filename );
+    }
+    const uint8_t* data = input.data() + offset;
+    offset += size;
+    return data;
+  };
+  auto ReadUInt32 = [&]() -> uint32_t
+  {
+    uint32_t value;
+    std::memcpy( &value, ReadBytes( sizeof(value) ), sizeof(value) );
+    return value;
+  };
+  auto ReadString = [&]() -> std::string
+  {
+    const uint32_t size = ReadUInt32();
+    const uint8_t* data = ReadBytes( size );
+    return std::string( reinterpret_cast<const char*>(data), size );
+  };
+
+  if( std::memcmp( ReadBytes(8), "RITCORP1", 8 ) != 0 ){
+    throw std::runtime_error("MessageCorpus: not a corpus file: " + filename );
+  }
+
+  clear();
+  const uint32_t topics_count = ReadUInt32();
+  for(uint32_t i=0; i < topics_count; i++)
+  {
+    CorpusTopic topic;
+    topic.name       = ReadString();
+    topic.datatype   = ReadString();
+    topic.md5sum     = ReadString();
+    topic.definition = ReadString();
+    _topics.push_back( std::move(topic) );
+  }
+
+  uint64_t messages_count;
+  std::memcpy( &messages_count, ReadBytes( sizeof(messages_count) ), sizeof(messages_count) );
+  _data.reserve( content.size() - offset );
+  for(uint64_t i=0; i < messages_count; i++)
+  {
+    const uint32_t topic = ReadUInt32();
+    const uint32_t sec   = ReadUInt32();
+    const uint32_t nsec  = ReadUInt32();
+    const uint32_t size  = ReadUInt32();
+    const uint8_t* data  = ReadBytes( size );
+    addMessage( topic, ros::Time(sec, nsec), Span<uint8_t>( const_cast<uint8_t*>(data), size ) );
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_MESSAGE_CORPUS_HPP
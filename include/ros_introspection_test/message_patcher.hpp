@@ -0,0 +1,382 @@
+#ifndef ROS_INTROSPECTION_TEST_MESSAGE_PATCHER_HPP
+#define ROS_INTROSPECTION_TEST_MESSAGE_PATCHER_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <functional>
+
+namespace RosIntrospection{
+
+/**
+ * @brief The MessagePatcher rewrites a serialized message into a new buffer,
+ * applying a list of edits that may change its size (unlike Parser::applyVisitorToBuffer).
+ *
+ * The input is read once, from the beginning to the end: the byte ranges which are
+ * not affected by any edit are copied with memcpy and only the fields that lead
+ * to an edit are actually visited.
+ *
+ * Example:
+ *
+ *   MessagePatcher patcher(parser, "tf");
+ *   patcher.replaceString("transforms.#/header/frame_id", "world");
+ *   patcher.apply( Span<uint8_t>(input), &output );
+ */
+class MessagePatcher
+{
+public:
+
+  /**
+   * Invoked for each instance of the rewritten type. "original" is the serialized
+   * instance, the callback must append its replacement to "output".
+   */
+  typedef std::function<void(const ROSType&,
+                             const Span<uint8_t>& original,
+                             std::vector<uint8_t>& output)> RewriteCallback;
+
+  /// The message_identifier must be registered already, the Parser is not used by apply().
+  MessagePatcher(const Parser& parser, const std::string& message_identifier);
+
+  /**
+   * Overwrite a string field. Arrays without index (or with '#') apply the edit
+   * to all the elements, for instance "transforms.#/header/frame_id".
+   * Specific array indices are not supported.
+   */
+  void replaceString(const std::string& field_path, const std::string& value);
+
+  /// Remove the elements of a dynamic array after the first max_size.
+  void truncateArray(const std::string& field_path, uint32_t max_size);
+
+  /// Rewrite every instance of a sub-message of the given type, wherever it is.
+  void rewriteType(const ROSType& type, const RewriteCallback& callback);
+
+  /// Remove all the edits.
+  void clear();
+
+  /**
+   * @brief Write into output the patched version of input.
+   *
+   * @return  number of edits that were actually applied.
+   */
+  size_t apply(const Span<uint8_t>& input, std::vector<uint8_t>* output) const;
+
+  const MessageSchema& schema() const { return _schema; }
+
+private:
+
+  struct Branch
+  {
+    size_t  field_index;
+    int32_t child_node;       // node used to walk the elements, -1 if none
+    int32_t replace_string;   // index in _strings, -1 if none
+    int32_t truncate_size;    // -1 if none
+  };
+
+  struct Node
+  {
+    int32_t message_index;
+    std::vector<Branch> branches;
+  };
+
+  struct Context
+  {
+    const Span<uint8_t>* input;
+    std::vector<uint8_t>* output;
+    size_t offset;
+    size_t copied;
+    size_t applied;
+  };
+
+  Branch& addPath(const std::string& field_path, const SchemaField** field);
+
+  void updateRewrittenTypes();
+
+  void flush(Context& ctx, size_t until) const;
+
+  void walkMessage(int32_t msg_index, int32_t node_index, Context& ctx) const;
+
+  void walkElement(const SchemaField& field, const Branch* branch, Context& ctx) const;
+
+  MessageSchema _schema;
+  std::vector<Node> _nodes;
+  std::vector<std::string> _strings;
+
+  // indexed by schema message
+  std::vector<RewriteCallback> _rewrite;
+  std::vector<ROSType> _rewrite_type;
+  std::vector<char> _contains_rewrite;
+};
+
+//---------------------------------------------------------------------------
+
+inline MessagePatcher::MessagePatcher(const Parser &parser, const std::string &message_identifier)
+{
+  const ROSMessageInfo* info = parser.getMessageInfo( message_identifier );
+  if( !info ){
+    throw std::runtime_error( std::string("MessagePatcher: unregistered message identifier ")
+                              + message_identifier );
+  }
+  _schema = MessageSchema( *info );
+  clear();
+}
+
+inline void MessagePatcher::clear()
+{
+  const size_t num_messages = _schema.messages().size();
+  _nodes.clear();
+  _strings.clear();
+  _rewrite.assign( num_messages, RewriteCallback() );
+  _rewrite_type.assign( num_messages, ROSType() );
+  _contains_rewrite.assign( num_messages, 0 );
+
+  Node root;
+  root.message_index = 0;
+  _nodes.push_back( root );
+}
+
+inline MessagePatcher::Branch &MessagePatcher::addPath(const std::string &field_path,
+                                                       const SchemaField** field)
+{
+  const std::vector<SchemaPathStep> steps = _schema.resolvePath( field_path );
+
+  int32_t node_index = 0;
+  size_t branch_pos = 0;
+
+  for(size_t s=0; s < steps.size(); s++)
+  {
+    if( steps[s].array_index >= 0 ){
+      throw std::runtime_error( std::string("MessagePatcher: specific array indices are not supported, use '#': ")
+                                + field_path );
+    }
+    if( s > 0 )
+    {
+      // descend into the sub-message of the previous step
+      if( _nodes[node_index].branches[branch_pos].child_node < 0 )
+      {
+        const size_t parent_field = _nodes[node_index].branches[branch_pos].field_index;
+        Node child;
+        child.message_index = _schema.message( _nodes[node_index].message_index ).fields[parent_field].message_index;
+        _nodes[node_index].branches[branch_pos].child_node = static_cast<int32_t>( _nodes.size() );
+        _nodes.push_back( child );
+      }
+      node_index = _nodes[node_index].branches[branch_pos].child_node;
+    }
+
+    std::vector<Branch>& branches = _nodes[node_index].branches;
+    branch_pos = 0;
+    while( branch_pos < branches.size() && branches[branch_pos].field_index < steps[s].field_index ){
+      branch_pos++;
+    }
+    if( branch_pos == branches.size() || branches[branch_pos].field_index != steps[s].field_index )
+    {
+      // keep the branches sorted by field, as they are visited
+      Branch new_branch;
+      new_branch.field_index    = steps[s].field_index;
+      new_branch.child_node     = -1;
+      new_branch.replace_string = -1;
+      new_branch.truncate_size  = -1;
+      branches.insert( branches.begin() + branch_pos, new_branch );
+    }
+  }
+
+  Branch& branch = _nodes[node_index].branches[branch_pos];
+  *field = &_schema.message( _nodes[node_index].message_index ).fields[ branch.field_index ];
+  return branch;
+}
+
+inline void MessagePatcher::replaceString(const std::string &field_path, const std::string &value)
+{
+  const SchemaField* field = nullptr;
+  Branch& branch = addPath( field_path, &field );
+
+  if( field->type_id != STRING ){
+    throw std::runtime_error( std::string("MessagePatcher: not a string: ") + field_path );
+  }
+  branch.replace_string = static_cast<int32_t>( _strings.size() );
+  _strings.push_back( value );
+}
+
+inline void MessagePatcher::truncateArray(const std::string &field_path, uint32_t max_size)
+{
+  const SchemaField* field = nullptr;
+  Branch& branch = addPath( field_path, &field );
+
+  if( !field->is_array || field->array_size >= 0 ){
+    throw std::runtime_error( std::string("MessagePatcher: not a dynamic array: ") + field_path );
+  }
+  branch.truncate_size = static_cast<int32_t>( max_size );
+}
+
+inline void MessagePatcher::rewriteType(const ROSType &type, const RewriteCallback &callback)
+{
+  const int32_t msg_index = _schema.findMessage( type.baseName() );
+  if( msg_index < 0 ){
+    throw std::runtime_error( std::string("MessagePatcher: type not used by this message: ")
+                              + type.baseName() );
+  }
+  _rewrite[msg_index] = callback;
+  _rewrite_type[msg_index] = type;
+  updateRewrittenTypes();
+}
+
+inline void MessagePatcher::updateRewrittenTypes()
+{
+  // a message "contains" a rewritten type if any of its fields is (or contains) one.
+  // Iterate until stable: the number of types is small and this is done once.
+  const auto& messages = _schema.messages();
+  for(size_t i=0; i < messages.size(); i++){
+    _contains_rewrite[i] = _rewrite[i] ? 1 : 0;
+  }
+  bool changed = true;
+  while( changed )
+  {
+    changed = false;
+    for(size_t i=0; i < messages.size(); i++)
+    {
+      if( _contains_rewrite[i] ) continue;
+      for(const SchemaField& field: messages[i].fields)
+      {
+        if( field.message_index >= 0 && _contains_rewrite[field.message_index] )
+        {
+          _contains_rewrite[i] = 1;
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+inline void MessagePatcher::flush(Context &ctx, size_t until) const
+{
+  if( until > ctx.copied )
+  {
+    const uint8_t* data = ctx.input->data();
+    ctx.output->insert( ctx.output->end(), data + ctx.copied, data + until );
+  }
+  ctx.copied = until;
+}
+
+inline size_t MessagePatcher::apply(const Span<uint8_t> &input, std::vector<uint8_t> *output) const
+{
+  output->clear();
+  output->reserve( input.size() );
+
+  Context ctx;
+  ctx.input   = &input;
+  ctx.output  = output;
+  ctx.offset  = 0;
+  ctx.copied  = 0;
+  ctx.applied = 0;
+
+  if( _rewrite[0] )
+  {
+    SchemaField root;
+    root.type_id = OTHER;
+    root.message_index = 0;
+    root.builtin_size = -1;
+    root.is_array = false;
+    root.array_size = 1;
+    walkElement( root, nullptr, ctx );
+  }
+  else{
+    walkMessage( 0, 0, ctx );
+  }
+  flush( ctx, input.size() );
+  return ctx.applied;
+}
+
+inline void MessagePatcher::walkMessage(int32_t msg_index, int32_t node_index, Context &ctx) const
+{
+  const SchemaMessage& msg = _schema.message( msg_index );
+  const std::vector<Branch>* branches = (node_index >= 0) ? &_nodes[node_index].branches : nullptr;
+  size_t next_branch = 0;
+
+  for(size_t f=0; f < msg.fields.size(); f++)
+  {
+    const SchemaField& field = msg.fields[f];
+
+    const Branch* branch = nullptr;
+    if( branches && next_branch < branches->size() && (*branches)[next_branch].field_index == f )
+    {
+      branch = &(*branches)[next_branch++];
+    }
+
+    const bool visit_type = field.message_index >= 0 && _contains_rewrite[field.message_index];
+
+    if( !branch && !visit_type )
+    {
+      ctx.offset = _schema.skipField( field, *ctx.input, ctx.offset );
+      continue;
+    }
+
+    const size_t length_offset = ctx.offset;
+    const uint32_t length = _schema.readArrayLength( field, *ctx.input, ctx.offset );
+    uint32_t kept = length;
+
+    if( branch && branch->truncate_size >= 0 && length > uint32_t(branch->truncate_size) )
+    {
+      kept = static_cast<uint32_t>( branch->truncate_size );
+      flush( ctx, length_offset );
+      const uint8_t* kept_ptr = reinterpret_cast<const uint8_t*>( &kept );
+      ctx.output->insert( ctx.output->end(), kept_ptr, kept_ptr + sizeof(uint32_t) );
+      ctx.copied = ctx.offset;
+      ctx.applied++;
+    }
+
+    for(uint32_t i=0; i < kept; i++)
+    {
+      walkElement( field, branch, ctx );
+    }
+
+    if( kept < length )
+    {
+      // skip the tail of the array, without copying it.
+      flush( ctx, ctx.offset );
+      for(uint32_t i=kept; i < length; i++)
+      {
+        ctx.offset = _schema.skipElement( field, *ctx.input, ctx.offset );
+      }
+      ctx.copied = ctx.offset;
+    }
+  }
+}
+
+inline void MessagePatcher::walkElement(const SchemaField &field, const Branch* branch, Context &ctx) const
+{
+  const Span<uint8_t>& input = *ctx.input;
+
+  if( field.message_index >= 0 && _rewrite[field.message_index] )
+  {
+    const size_t begin = ctx.offset;
+    ctx.offset = _schema.skipMessage( field.message_index, input, ctx.offset );
+    flush( ctx, begin );
+    const Span<uint8_t> original( input.data() + begin, ctx.offset - begin );
+    _rewrite[field.message_index]( _rewrite_type[field.message_index], original, *ctx.output );
+    ctx.copied = ctx.offset;
+    ctx.applied++;
+  }
+  else if( branch && branch->replace_string >= 0 )
+  {
+    const std::string& value = _strings[ branch->replace_string ];
+    const size_t begin = ctx.offset;
+    ctx.offset = _schema.skipElement( field, input, ctx.offset );
+    flush( ctx, begin );
+    const uint32_t string_size = static_cast<uint32_t>( value.size() );
+    const uint8_t* size_ptr = reinterpret_cast<const uint8_t*>( &string_size );
+    ctx.output->insert( ctx.output->end(), size_ptr, size_ptr + sizeof(uint32_t) );
+    ctx.output->insert( ctx.output->end(), value.begin(), value.end() );
+    ctx.copied = ctx.offset;
+    ctx.applied++;
+  }
+  else if( field.message_index >= 0 )
+  {
+    walkMessage( field.message_index, branch ? branch->child_node : -1, ctx );
+  }
+  else
+  {
+    ctx.offset = _schema.skipElement( field, input, ctx.offset );
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_MESSAGE_PATCHER_HPP
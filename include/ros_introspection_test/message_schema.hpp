@@ -0,0 +1,395 @@
+#ifndef ROS_INTROSPECTION_TEST_MESSAGE_SCHEMA_HPP
+#define ROS_INTROSPECTION_TEST_MESSAGE_SCHEMA_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace RosIntrospection{
+
+/// A non-constant field of a registered message, flattened into plain data.
+struct SchemaField
+{
+  std::string name;
+  std::string type_name;
+
+  BuiltinType type_id;
+
+  /// Size of a single element, when the field is a builtin different from STRING, -1 otherwise.
+  int32_t builtin_size;
+
+  bool is_array;
+
+  /// Number of elements when the array has a fixed length, -1 if dynamic, 1 if not an array.
+  int32_t array_size;
+
+  /// Index of the sub-message in MessageSchema::messages(), -1 if builtin.
+  int32_t message_index;
+};
+
+struct SchemaMessage
+{
+  std::string datatype;
+  std::vector<SchemaField> fields;
+
+  /// Serialized size of this message, when it doesn't depend on the content. -1 otherwise.
+  int32_t fixed_size;
+};
+
+/// One element of a path like "transforms.#/header/frame_id".
+struct SchemaPathStep
+{
+  size_t field_index;
+  /// Index of the selected element when the field is an array, -1 means "all of them".
+  int32_t array_index;
+};
+
+/**
+ * @brief The MessageSchema is a compact representation of the ROSMessageInfo
+ * registered into the Parser, designed to walk a raw buffer.
+ *
+ * messages()[0] is the main type of the topic. Sub-messages are referenced by
+ * index and their serialized size is precomputed when it is fixed,
+ * to skip them in O(1).
+ */
+class MessageSchema
+{
+public:
+
+  MessageSchema() {}
+
+  explicit MessageSchema(const ROSMessageInfo& info);
+
+  const std::vector<SchemaMessage>& messages() const { return _messages; }
+
+  const SchemaMessage& message(int32_t index) const { return _messages[index]; }
+
+  /// Index of the message with that datatype, -1 if it is not part of this schema.
+  int32_t findMessage(const std::string& datatype) const;
+
+  /**
+   * @brief Converts a path like "transforms.#/header/frame_id" or "position.2"
+   * into a list of steps, starting from the main type.
+   * Arrays without an index or with the index '#' select all the elements.
+   *
+   * Throws std::runtime_error if the path is not valid.
+   */
+  std::vector<SchemaPathStep> resolvePath(const std::string& path) const;
+
+  /// Index of the message that owns the last field of the path.
+  int32_t ownerOfPath(const std::vector<SchemaPathStep>& path) const;
+
+  /*
+   * The following functions throw std::runtime_error if the buffer is too short.
+   * With Checked = false they don't check the bounds at all: use them only on buffers
+   * accepted by a BufferValidator (see buffer_validator.hpp).
+   */
+
+  /// Number of elements of the field located at offset. Reads the prefix of dynamic arrays.
+  template <bool Checked = true>
+  uint32_t readArrayLength(const SchemaField& field, const Span<uint8_t>& buffer, size_t& offset) const;
+
+  /// Returns the offset right after the field (all its elements if it is an array).
+  template <bool Checked = true>
+  size_t skipField(const SchemaField& field, const Span<uint8_t>& buffer, size_t offset) const;
+
+  /// Returns the offset right after a single element of the field.
+  template <bool Checked = true>
+  size_t skipElement(const SchemaField& field, const Span<uint8_t>& buffer, size_t offset) const;
+
+  /// Returns the offset right after the message that starts at offset.
+  template <bool Checked = true>
+  size_t skipMessage(int32_t msg_index, const Span<uint8_t>& buffer, size_t offset) const;
+
+private:
+
+  int32_t computeFixedSize(int32_t msg_index, std::vector<int>& visiting);
+
+  std::vector<SchemaMessage> _messages;
+};
+
+//---------------------------------------------------------------------------
+
+inline void ThrowBufferOverrun()
+{
+  throw std::runtime_error("Buffer overrun while walking a RosIntrospection::MessageSchema");
+}
+
+inline MessageSchema::MessageSchema(const ROSMessageInfo& info)
+{
+  _messages.reserve( info.type_list.size() );
+
+  for(const ROSMessage& msg: info.type_list)
+  {
+    SchemaMessage schema_msg;
+    schema_msg.datatype = msg.type().baseName();
+    schema_msg.fixed_size = -1;
+    _messages.push_back( std::move(schema_msg) );
+  }
+
+  for(size_t i=0; i < info.type_list.size(); i++)
+  {
+    const ROSMessage& msg = info.type_list[i];
+    std::vector<SchemaField>& fields = _messages[i].fields;
+
+    for(const ROSField& field: msg.fields())
+    {
+      if( field.isConstant() ) {
+        continue;
+      }
+      SchemaField schema_field;
+      schema_field.name       = field.name();
+      schema_field.type_name  = field.type().baseName();
+      schema_field.type_id    = field.type().typeID();
+      schema_field.is_array   = field.isArray();
+      schema_field.array_size = field.isArray() ? field.arraySize() : 1;
+      schema_field.message_index = -1;
+      schema_field.builtin_size  = -1;
+
+      if( schema_field.type_id == OTHER )
+      {
+        schema_field.message_index = findMessage( schema_field.type_name );
+        if( schema_field.message_index < 0 )
+        {
+          throw std::runtime_error( std::string("MessageSchema: can't find the definition of ")
+                                    + schema_field.type_name );
+        }
+      }
+      else if( schema_field.type_id != STRING )
+      {
+        schema_field.builtin_size = field.type().typeSize();
+      }
+      fields.push_back( std::move(schema_field) );
+    }
+  }
+
+  std::vector<int> visiting( _messages.size(), 0 );
+  for(size_t i=0; i < _messages.size(); i++)
+  {
+    computeFixedSize( static_cast<int32_t>(i), visiting );
+  }
+}
+
+inline int32_t MessageSchema::computeFixedSize(int32_t msg_index, std::vector<int>& visiting)
+{
+  SchemaMessage& msg = _messages[msg_index];
+  if( visiting[msg_index] == 2 ) {
+    return msg.fixed_size;
+  }
+  if( visiting[msg_index] == 1 ) {
+    throw std::runtime_error("MessageSchema: recursive message definition");
+  }
+  visiting[msg_index] = 1;
+
+  int32_t total = 0;
+  for(const SchemaField& field: msg.fields)
+  {
+    int32_t element_size = field.builtin_size;
+    if( field.message_index >= 0 )
+    {
+      element_size = computeFixedSize( field.message_index, visiting );
+    }
+    if( element_size < 0 || field.array_size < 0 )
+    {
+      total = -1;
+      break;
+    }
+    total += element_size * field.array_size;
+  }
+  msg.fixed_size = total;
+  visiting[msg_index] = 2;
+  return total;
+}
+
+inline int32_t MessageSchema::findMessage(const std::string &datatype) const
+{
+  for(size_t i=0; i < _messages.size(); i++)
+  {
+    if( _messages[i].datatype == datatype ){
+      return static_cast<int32_t>(i);
+    }
+  }
+  return -1;
+}
+
+inline std::vector<SchemaPathStep> MessageSchema::resolvePath(const std::string &path) const
+{
+  std::vector<SchemaPathStep> steps;
+  if( _messages.empty() ){
+    throw std::runtime_error("MessageSchema: empty schema");
+  }
+
+  int32_t msg_index = 0;
+  size_t start = 0;
+
+  while( start <= path.size() )
+  {
+    size_t end = path.find('/', start);
+    if( end == std::string::npos ){
+      end = path.size();
+    }
+    std::string name = path.substr(start, end - start);
+    start = end + 1;
+
+    if( name.empty() ){
+      continue;
+    }
+    if( msg_index < 0 ){
+      throw std::runtime_error( std::string("MessageSchema: path goes through a builtin field: ") + path );
+    }
+
+    SchemaPathStep step;
+    step.array_index = -1;
+
+    const size_t dot = name.find('.');
+    if( dot != std::string::npos )
+    {
+      const std::string index = name.substr(dot+1);
+      name.resize(dot);
+      if( index != "#" )
+      {
+        if( index.empty() || index.find_first_not_of("0123456789") != std::string::npos ){
+          throw std::runtime_error( std::string("MessageSchema: invalid array index in path: ") + path );
+        }
+        step.array_index = std::stoi(index);
+      }
+    }
+
+    const std::vector<SchemaField>& fields = _messages[msg_index].fields;
+    size_t field_index = 0;
+    while( field_index < fields.size() && fields[field_index].name != name ){
+      field_index++;
+    }
+    if( field_index == fields.size() ){
+      throw std::runtime_error( std::string("MessageSchema: field [") + name
+                                + "] not found in path: " + path );
+    }
+    if( dot != std::string::npos && !fields[field_index].is_array ){
+      throw std::runtime_error( std::string("MessageSchema: field [") + name
+                                + "] is not an array, in path: " + path );
+    }
+    step.field_index = field_index;
+    steps.push_back( step );
+    msg_index = fields[field_index].message_index;
+  }
+
+  if( steps.empty() ){
+    throw std::runtime_error( std::string("MessageSchema: empty path") );
+  }
+  return steps;
+}
+
+inline int32_t MessageSchema::ownerOfPath(const std::vector<SchemaPathStep> &path) const
+{
+  int32_t msg_index = 0;
+  for(size_t i=0; i+1 < path.size(); i++)
+  {
+    msg_index = _messages[msg_index].fields[ path[i].field_index ].message_index;
+  }
+  return msg_index;
+}
+
+/// Read a length prefix; without bounds checking if Checked is false.
+template <bool Checked> inline
+uint32_t ReadLengthPrefix(const Span<uint8_t>& buffer, size_t& offset)
+{
+  uint32_t length = 0;
+  if( Checked ){
+    ReadFromBuffer( buffer, offset, length );
+  }
+  else{
+    std::memcpy( &length, buffer.data() + offset, sizeof(uint32_t) );
+    offset += sizeof(uint32_t);
+  }
+  return length;
+}
+
+template <bool Checked> inline
+uint32_t MessageSchema::readArrayLength(const SchemaField &field,
+                                        const Span<uint8_t> &buffer,
+                                        size_t &offset) const
+{
+  if( field.array_size >= 0 ){
+    return static_cast<uint32_t>(field.array_size);
+  }
+  return ReadLengthPrefix<Checked>( buffer, offset );
+}
+
+template <bool Checked> inline
+size_t MessageSchema::skipElement(const SchemaField &field,
+                                  const Span<uint8_t> &buffer,
+                                  size_t offset) const
+{
+  if( field.builtin_size >= 0 )
+  {
+    offset += field.builtin_size;
+  }
+  else if( field.message_index >= 0 )
+  {
+    return skipMessage<Checked>( field.message_index, buffer, offset );
+  }
+  else // STRING
+  {
+    const uint32_t string_size = ReadLengthPrefix<Checked>( buffer, offset );
+    offset += string_size;
+  }
+  if( Checked && offset > buffer.size() ){
+    ThrowBufferOverrun();
+  }
+  return offset;
+}
+
+template <bool Checked> inline
+size_t MessageSchema::skipField(const SchemaField &field,
+                                const Span<uint8_t> &buffer,
+                                size_t offset) const
+{
+  const uint32_t length = readArrayLength<Checked>( field, buffer, offset );
+
+  int32_t element_size = field.builtin_size;
+  if( field.message_index >= 0 ){
+    element_size = _messages[field.message_index].fixed_size;
+  }
+
+  if( element_size >= 0 )
+  {
+    offset += static_cast<size_t>(length) * element_size;
+    if( Checked && offset > buffer.size() ){
+      ThrowBufferOverrun();
+    }
+    return offset;
+  }
+
+  for(uint32_t i=0; i < length; i++)
+  {
+    offset = skipElement<Checked>( field, buffer, offset );
+  }
+  return offset;
+}
+
+template <bool Checked> inline
+size_t MessageSchema::skipMessage(int32_t msg_index,
+                                  const Span<uint8_t> &buffer,
+                                  size_t offset) const
+{
+  const SchemaMessage& msg = _messages[msg_index];
+  if( msg.fixed_size >= 0 )
+  {
+    offset += msg.fixed_size;
+    if( Checked && offset > buffer.size() ){
+      ThrowBufferOverrun();
+    }
+    return offset;
+  }
+  for(const SchemaField& field: msg.fields)
+  {
+    offset = skipField<Checked>( field, buffer, offset );
+  }
+  return offset;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_MESSAGE_SCHEMA_HPP
@@ -0,0 +1,364 @@
+#ifndef ROS_INTROSPECTION_TEST_PARSER_PROBE_HPP
+#define ROS_INTROSPECTION_TEST_PARSER_PROBE_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Set to 1 (cmake -DENABLE_PARSER_PROBES=ON) to enable the counters and the trace hooks.
+// When 0, ParserProbe forwards the calls to the Parser and nothing else.
+#ifndef ROS_INTROSPECTION_TEST_PROBES
+#define ROS_INTROSPECTION_TEST_PROBES 0
+#endif
+
+namespace RosIntrospection{
+
+/// Counters collected for each topic by the ParserProbe.
+struct ProbeCounters
+{
+  uint64_t messages         = 0;
+  uint64_t bytes            = 0;
+  /// messages where at least one array was larger than max_array_size.
+  uint64_t truncated        = 0;
+  uint64_t flat_values      = 0;
+  uint64_t renamed_values   = 0;
+  /// number of times the output containers had to grow their capacity.
+  uint64_t reallocations    = 0;
+  uint64_t deserialize_ns   = 0;
+  uint64_t rename_ns        = 0;
+
+  uint64_t totalTimeNs() const { return deserialize_ns + rename_ns; }
+};
+
+struct ProbeEvent
+{
+  enum Phase { BEGIN, END };
+  Phase phase;
+  /// "deserialize" or "rename"
+  const char* name;
+  const std::string* topic;
+  /// steady_clock, nanoseconds.
+  uint64_t timestamp_ns;
+};
+
+/**
+ * @brief Wrapper of the hot methods of the Parser that collects per-topic
+ * statistics and forwards begin/end events to a user-provided hook,
+ * for instance to emit LTTng tracepoints or Perfetto TRACE_EVENTs.
+ *
+ * It is thread-safe: counters can be updated from multiple spinner threads.
+ * The counters and the hook of a topic are resolved once by topic(): the calls that
+ * take a TopicProbe don't lock any mutex nor look up the topic by name.
+ */
+class ParserProbe
+{
+public:
+
+  typedef std::function<void(const ProbeEvent&)> TraceHook;
+
+private:
+#if ROS_INTROSPECTION_TEST_PROBES
+  struct AtomicCounters;
+  typedef std::shared_ptr<const TraceHook> HookPtr;
+#endif
+
+public:
+
+  /**
+   * Counters and trace hook of a topic, returned by ParserProbe::topic().
+   * Not thread-safe: each thread (or each topic protected by a mutex, as in the
+   * GenericSubscriber) must use its own TopicProbe.
+   */
+  class TopicProbe
+  {
+  public:
+    TopicProbe() {}
+    const std::string& name() const { return _name; }
+
+  private:
+    friend class ParserProbe;
+    std::string _name;
+#if ROS_INTROSPECTION_TEST_PROBES
+    AtomicCounters* _counters = nullptr;
+    HookPtr _hook;
+    uint64_t _hook_version = 0;
+#endif
+  };
+
+  static constexpr bool enabled() { return ROS_INTROSPECTION_TEST_PROBES != 0; }
+
+  /// Create the counters of the topic, if needed. Takes the mutex of the probe.
+  TopicProbe topic(const std::string& msg_identifier);
+
+  bool deserializeIntoFlatContainer(const Parser& parser,
+                                    TopicProbe& topic,
+                                    Span<uint8_t> buffer,
+                                    FlatMessage* flat_container_output,
+                                    const uint32_t max_array_size);
+
+  void applyNameTransform(Parser& parser,
+                          TopicProbe& topic,
+                          const FlatMessage& container,
+                          RenamedValues* renamed_value);
+
+  /// Same as above, but the topic is looked up (under the mutex) at each call.
+  bool deserializeIntoFlatContainer(const Parser& parser,
+                                    const std::string& msg_identifier,
+                                    Span<uint8_t> buffer,
+                                    FlatMessage* flat_container_output,
+                                    const uint32_t max_array_size)
+  {
+    TopicProbe probe = topic( msg_identifier );
+    return deserializeIntoFlatContainer( parser, probe, buffer, flat_container_output, max_array_size );
+  }
+
+  void applyNameTransform(Parser& parser,
+                          const std::string& msg_identifier,
+                          const FlatMessage& container,
+                          RenamedValues* renamed_value)
+  {
+    TopicProbe probe = topic( msg_identifier );
+    applyNameTransform( parser, probe, container, renamed_value );
+  }
+
+  /// The hook is invoked synchronously, by the thread calling the Parser.
+  /// It can be replaced at any time: calls already started use the previous one.
+  void setTraceHook(const TraceHook& hook);
+
+  /// Copy of the counters of all the topics. Empty if the probes are disabled.
+  std::map<std::string, ProbeCounters> snapshot() const;
+
+  /// Set all the counters to zero.
+  void reset();
+
+private:
+
+#if ROS_INTROSPECTION_TEST_PROBES
+  struct AtomicCounters
+  {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> truncated{0};
+    std::atomic<uint64_t> flat_values{0};
+    std::atomic<uint64_t> renamed_values{0};
+    std::atomic<uint64_t> reallocations{0};
+    std::atomic<uint64_t> deserialize_ns{0};
+    std::atomic<uint64_t> rename_ns{0};
+  };
+
+  /// Copy the current hook into the topic, if it was replaced after the last call.
+  void updateHook(TopicProbe& topic);
+
+  static void Trace(const HookPtr& hook, ProbeEvent::Phase phase, const char* name,
+                    const std::string& topic, uint64_t timestamp_ns);
+
+  mutable std::mutex _mutex;
+  // the counters are never destroyed: the TopicProbes point to them
+  std::unordered_map<std::string, std::unique_ptr<AtomicCounters>> _counters;
+  HookPtr _hook;
+  std::atomic<uint64_t> _hook_version{0};
+#endif
+};
+
+//---------------------------------------------------------------------------
+
+#if ROS_INTROSPECTION_TEST_PROBES
+
+inline uint64_t ProbeNow()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+}
+
+inline ParserProbe::TopicProbe ParserProbe::topic(const std::string &msg_identifier)
+{
+  TopicProbe topic;
+  topic._name = msg_identifier;
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::unique_ptr<AtomicCounters>& counters = _counters[msg_identifier];
+  if( !counters ){
+    counters.reset( new AtomicCounters );
+  }
+  topic._counters = counters.get();
+  topic._hook = _hook;
+  topic._hook_version = _hook_version;
+  return topic;
+}
+
+inline void ParserProbe::updateHook(TopicProbe &topic)
+{
+  if( topic._hook_version != _hook_version.load( std::memory_order_acquire ) )
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    topic._hook = _hook;
+    topic._hook_version = _hook_version;
+  }
+}
+
+inline void ParserProbe::Trace(const HookPtr& hook, ProbeEvent::Phase phase, const char *name,
+                               const std::string &topic, uint64_t timestamp_ns)
+{
+  if( hook && *hook )
+  {
+    ProbeEvent event;
+    event.phase = phase;
+    event.name  = name;
+    event.topic = &topic;
+    event.timestamp_ns = timestamp_ns;
+    (*hook)( event );
+  }
+}
+
+inline bool ParserProbe::deserializeIntoFlatContainer(const Parser &parser,
+                                                      TopicProbe &topic,
+                                                      Span<uint8_t> buffer,
+                                                      FlatMessage *flat_container_output,
+                                                      const uint32_t max_array_size)
+{
+  updateHook( topic );
+  const HookPtr& hook = topic._hook;
+  const std::string& msg_identifier = topic._name;
+  AtomicCounters& counters = *topic._counters;
+
+  const size_t value_capacity = flat_container_output->value.capacity();
+  const size_t name_capacity  = flat_container_output->name.capacity();
+  const size_t blob_capacity  = flat_container_output->blob.capacity();
+
+  const uint64_t start = ProbeNow();
+  Trace( hook, ProbeEvent::BEGIN, "deserialize", msg_identifier, start );
+
+  const bool entire_message = parser.deserializeIntoFlatContainer( msg_identifier, buffer,
+                                                                   flat_container_output,
+                                                                   max_array_size );
+  const uint64_t end = ProbeNow();
+  Trace( hook, ProbeEvent::END, "deserialize", msg_identifier, end );
+
+  counters.messages++;
+  counters.bytes += buffer.size();
+  counters.deserialize_ns += (end - start);
+  counters.flat_values += flat_container_output->value.size();
+  if( !entire_message ){
+    counters.truncated++;
+  }
+  counters.reallocations += (flat_container_output->value.capacity() != value_capacity) +
+                            (flat_container_output->name.capacity()  != name_capacity) +
+                            (flat_container_output->blob.capacity()  != blob_capacity);
+  return entire_message;
+}
+
+inline void ParserProbe::applyNameTransform(Parser &parser,
+                                            TopicProbe &topic,
+                                            const FlatMessage &container,
+                                            RenamedValues *renamed_value)
+{
+  updateHook( topic );
+  const HookPtr& hook = topic._hook;
+  const std::string& msg_identifier = topic._name;
+  AtomicCounters& counters = *topic._counters;
+  const size_t capacity = renamed_value->capacity();
+
+  const uint64_t start = ProbeNow();
+  Trace( hook, ProbeEvent::BEGIN, "rename", msg_identifier, start );
+
+  parser.applyNameTransform( msg_identifier, container, renamed_value );
+
+  const uint64_t end = ProbeNow();
+  Trace( hook, ProbeEvent::END, "rename", msg_identifier, end );
+
+  counters.rename_ns += (end - start);
+  counters.renamed_values += renamed_value->size();
+  counters.reallocations += (renamed_value->capacity() != capacity);
+}
+
+inline void ParserProbe::setTraceHook(const TraceHook &hook)
+{
+  HookPtr new_hook( new TraceHook(hook) );
+  std::lock_guard<std::mutex> lock(_mutex);
+  _hook.swap( new_hook );
+  _hook_version++;
+}
+
+inline std::map<std::string, ProbeCounters> ParserProbe::snapshot() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::map<std::string, ProbeCounters> output;
+  for(const auto& it: _counters)
+  {
+    const AtomicCounters& src = *it.second;
+    ProbeCounters& dst = output[it.first];
+    dst.messages       = src.messages;
+    dst.bytes          = src.bytes;
+    dst.truncated      = src.truncated;
+    dst.flat_values    = src.flat_values;
+    dst.renamed_values = src.renamed_values;
+    dst.reallocations  = src.reallocations;
+    dst.deserialize_ns = src.deserialize_ns;
+    dst.rename_ns      = src.rename_ns;
+  }
+  return output;
+}
+
+inline void ParserProbe::reset()
+{
+  // other threads may be using the counters: zero them, don't destroy them
+  std::lock_guard<std::mutex> lock(_mutex);
+  for(const auto& it: _counters)
+  {
+    AtomicCounters& counters = *it.second;
+    counters.messages       = 0;
+    counters.bytes          = 0;
+    counters.truncated      = 0;
+    counters.flat_values    = 0;
+    counters.renamed_values = 0;
+    counters.reallocations  = 0;
+    counters.deserialize_ns = 0;
+    counters.rename_ns      = 0;
+  }
+}
+
+#else // probes disabled
+
+inline ParserProbe::TopicProbe ParserProbe::topic(const std::string &msg_identifier)
+{
+  TopicProbe topic;
+  topic._name = msg_identifier;
+  return topic;
+}
+
+inline bool ParserProbe::deserializeIntoFlatContainer(const Parser &parser,
+                                                      TopicProbe &topic,
+                                                      Span<uint8_t> buffer,
+                                                      FlatMessage *flat_container_output,
+                                                      const uint32_t max_array_size)
+{
+  return parser.deserializeIntoFlatContainer( topic._name, buffer,
+                                              flat_container_output, max_array_size );
+}
+
+inline void ParserProbe::applyNameTransform(Parser &parser,
+                                            TopicProbe &topic,
+                                            const FlatMessage &container,
+                                            RenamedValues *renamed_value)
+{
+  parser.applyNameTransform( topic._name, container, renamed_value );
+}
+
+inline void ParserProbe::setTraceHook(const TraceHook&) {}
+
+inline std::map<std::string, ProbeCounters> ParserProbe::snapshot() const
+{
+  return std::map<std::string, ProbeCounters>();
+}
+
+inline void ParserProbe::reset() {}
+
+#endif
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_PARSER_PROBE_HPP
@@ -0,0 +1,227 @@
+#ifndef ROS_INTROSPECTION_TEST_PERF_COUNTERS_HPP
+#define ROS_INTROSPECTION_TEST_PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace RosIntrospection{
+
+/**
+ * @brief Hardware counters of the calling thread (user space only), read with perf_event_open.
+ *
+ * The counters are opened as a single group, so that they are scheduled on the PMU
+ * together and their ratios (e.g. instructions per cycle) refer to the same time
+ * slices. The first available event is the group leader; the ones that are not
+ * supported by the CPU, or not allowed (see /proc/sys/kernel/perf_event_paranoid),
+ * are not available and their value is always zero. On platforms other than Linux
+ * nothing is available.
+ *
+ * If the PMU is shared with other users the group may be multiplexed: the values are
+ * then scaled by time_enabled / time_running and multiplexed() returns true.
+ */
+class PerfCounters
+{
+public:
+
+  enum Event
+  {
+    INSTRUCTIONS = 0,
+    CYCLES,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    EVENTS_COUNT
+  };
+
+  PerfCounters();
+
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool available(Event event) const { return _fd[event] >= 0; }
+
+  /// True if at least one counter is available.
+  bool available() const;
+
+  /// Reset the counters and start counting.
+  void start();
+
+  /// Stop counting. The values are read by value().
+  void stop();
+
+  uint64_t value(Event event) const { return _value[event]; }
+
+  /// True if the group was not counting for the whole interval and the values are estimated.
+  bool multiplexed() const { return _multiplexed; }
+
+  static const char* Name(Event event);
+
+private:
+
+  int _fd[EVENTS_COUNT];
+  // position of the event in the group read, in order of creation
+  int _slot[EVENTS_COUNT];
+  int _leader;
+  int _group_size;
+  uint64_t _value[EVENTS_COUNT];
+  bool _multiplexed;
+};
+
+//---------------------------------------------------------------------------
+
+inline const char* PerfCounters::Name(Event event)
+{
+  switch( event )
+  {
+  case INSTRUCTIONS:  return "instructions";
+  case CYCLES:        return "cycles";
+  case CACHE_MISSES:  return "cache_misses";
+  case BRANCH_MISSES: return "branch_misses";
+  default: break;
+  }
+  return "";
+}
+
+inline bool PerfCounters::available() const
+{
+  for(int i=0; i < EVENTS_COUNT; i++)
+  {
+    if( _fd[i] >= 0 ){
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef __linux__
+
+inline PerfCounters::PerfCounters():
+  _leader(-1),
+  _group_size(0),
+  _multiplexed(false)
+{
+  const uint64_t configs[EVENTS_COUNT] = { PERF_COUNT_HW_INSTRUCTIONS,
+                                           PERF_COUNT_HW_CPU_CYCLES,
+                                           PERF_COUNT_HW_CACHE_MISSES,
+                                           PERF_COUNT_HW_BRANCH_MISSES };
+  for(int i=0; i < EVENTS_COUNT; i++)
+  {
+    perf_event_attr attr;
+    std::memset( &attr, 0, sizeof(attr) );
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // the members follow the leader, that is enabled by start()
+    attr.disabled = ( _leader < 0 ) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // this thread, any CPU
+    const int group_fd = ( _leader < 0 ) ? -1 : _fd[_leader];
+    _fd[i] = static_cast<int>( syscall( __NR_perf_event_open, &attr, 0, -1, group_fd, 0 ) );
+    _slot[i] = -1;
+    _value[i] = 0;
+    if( _fd[i] >= 0 )
+    {
+      if( _leader < 0 ){
+        _leader = i;
+      }
+      _slot[i] = _group_size++;
+    }
+  }
+}
+
+inline PerfCounters::~PerfCounters()
+{
+  for(int i=0; i < EVENTS_COUNT; i++)
+  {
+    if( _fd[i] >= 0 ){
+      close( _fd[i] );
+    }
+  }
+}
+
+inline void PerfCounters::start()
+{
+  for(int i=0; i < EVENTS_COUNT; i++)
+  {
+    _value[i] = 0;
+  }
+  _multiplexed = false;
+  if( _leader >= 0 )
+  {
+    ioctl( _fd[_leader], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( _fd[_leader], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+  }
+}
+
+inline void PerfCounters::stop()
+{
+  if( _leader < 0 ){
+    return;
+  }
+  ioctl( _fd[_leader], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+
+  // { nr, time_enabled, time_running, value[nr] }
+  uint64_t data[3 + EVENTS_COUNT];
+  const ssize_t expected = static_cast<ssize_t>( (3 + _group_size) * sizeof(uint64_t) );
+  if( read( _fd[_leader], data, sizeof(data) ) < expected ){
+    return;
+  }
+  const uint64_t time_enabled = data[1];
+  const uint64_t time_running = data[2];
+  _multiplexed = ( time_running < time_enabled );
+
+  for(int i=0; i < EVENTS_COUNT; i++)
+  {
+    if( _slot[i] < 0 ){
+      continue;
+    }
+    const uint64_t count = data[3 + _slot[i]];
+    if( !_multiplexed ){
+      _value[i] = count;
+    }
+    else if( time_running > 0 ){
+      _value[i] = static_cast<uint64_t>( static_cast<double>(count) *
+                                         time_enabled / time_running );
+    }
+  }
+}
+
+#else
+
+inline PerfCounters::PerfCounters():
+  _leader(-1),
+  _group_size(0),
+  _multiplexed(false)
+{
+  for(int i=0; i < EVENTS_COUNT; i++)
+  {
+    _fd[i] = -1;
+    _slot[i] = -1;
+    _value[i] = 0;
+  }
+}
+
+inline PerfCounters::~PerfCounters() {}
+
+inline void PerfCounters::start() {}
+
+inline void PerfCounters::stop() {}
+
+#endif
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_PERF_COUNTERS_HPP
@@ -0,0 +1,574 @@
+#ifndef ROS_INTROSPECTION_TEST_RAW_PREDICATE_HPP
+#define ROS_INTROSPECTION_TEST_RAW_PREDICATE_HPP
+
+#include <ros_introspection_test/field_reader.hpp>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace RosIntrospection{
+
+/// Numeric value of a builtin leaf, other than STRING, at the given offset.
+inline double ReadLeafAsDouble(BuiltinType type, const Span<uint8_t>& buffer, size_t offset)
+{
+  switch( type )
+  {
+  case BOOL:
+  case BYTE:
+  case UINT8:   { uint8_t  v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case CHAR:
+  case INT8:    { int8_t   v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case UINT16:  { uint16_t v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case UINT32:  { uint32_t v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case UINT64:  { uint64_t v; ReadFromBuffer( buffer, offset, v ); return static_cast<double>(v); }
+  case INT16:   { int16_t  v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case INT32:   { int32_t  v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case INT64:   { int64_t  v; ReadFromBuffer( buffer, offset, v ); return static_cast<double>(v); }
+  case FLOAT32: { float    v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case FLOAT64: { double   v; ReadFromBuffer( buffer, offset, v ); return v; }
+  case TIME:    {
+    uint32_t sec, nsec;
+    ReadFromBuffer( buffer, offset, sec );
+    ReadFromBuffer( buffer, offset, nsec );
+    return static_cast<double>(sec) + 1e-9 * nsec;
+  }
+  case DURATION:{
+    int32_t sec, nsec;
+    ReadFromBuffer( buffer, offset, sec );
+    ReadFromBuffer( buffer, offset, nsec );
+    return static_cast<double>(sec) + 1e-9 * nsec;
+  }
+  default: break;
+  }
+  throw std::runtime_error( "ReadLeafAsDouble: not a numeric type" );
+}
+
+/**
+ * @brief A boolean expression over the leaves of a message, compiled once and
+ * evaluated directly on the serialized buffer:
+ *
+ *     RawPredicate predicate( schema, "error.# != 0 || drivertemperature.# > 80" );
+ *     if( predicate.evaluate( buffer ) ) { ... }
+ *
+ * Syntax:
+ *  - comparisons "path op literal", with op one of < <= > >= == !=. The literal is
+ *    a number, true/false, or a quoted string (only == and != on string fields).
+ *  - a path alone is true when the value is not zero (not empty, for strings).
+ *  - &&, ||, ! and parenthesis.
+ *  - paths use the syntax of FieldReader. "error[*]" and "error.*" are the same as
+ *    "error.#", "error[3]" is "error.3"; all the elements of an array are checked.
+ *  - "*" as a path element means "any field"; at the end of the path it selects all
+ *    the leaves below that point. For instance "*" alone is true if any field of the
+ *    message is not zero. Fields that can't be compared with the literal are ignored.
+ *
+ * A comparison is true if any of the leaves it selects satisfies it: the walk stops
+ * at the first match, && and || are short-circuited, and nothing else is decoded.
+ *
+ * The MessageSchema must outlive the RawPredicate. evaluate() reuses the buffers
+ * of its FieldReaders: a RawPredicate must not be evaluated by two threads at once.
+ * Throws std::runtime_error if the expression is not valid.
+ */
+class RawPredicate
+{
+public:
+
+  RawPredicate(const MessageSchema& schema, const std::string& expression);
+
+  /// Throws std::runtime_error if the buffer is truncated.
+  bool evaluate(const Span<uint8_t>& buffer) const
+  {
+    return evaluateNode( _root, buffer );
+  }
+
+  const std::string& expression() const { return _expression; }
+
+  /// Number of concrete leaf paths (after the expansion of "*") used by the expression.
+  size_t readersCount() const { return _readers.size(); }
+
+private:
+
+  enum NodeType { OR, AND, NOT, COMPARE };
+  enum Comparison { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL };
+
+  struct Node
+  {
+    explicit Node(NodeType node_type):
+      type(node_type), comparison(NOT_EQUAL), is_string(false),
+      number(0), first_reader(0), readers_count(0) {}
+
+    NodeType type;
+    std::vector<int> children;
+    // COMPARE only
+    Comparison comparison;
+    bool is_string;
+    double number;
+    std::string text;
+    size_t first_reader;
+    size_t readers_count;
+  };
+
+  enum TokenType { TOKEN_PATH, TOKEN_NUMBER, TOKEN_STRING, TOKEN_OPERATOR, TOKEN_END };
+
+  struct Token
+  {
+    TokenType type;
+    std::string text;
+  };
+
+  void tokenize();
+
+  const Token& peek() const { return _tokens[_position]; }
+
+  bool accept(const char* op);
+
+  int parseOr();
+  int parseAnd();
+  int parseUnary();
+  int parseComparison();
+
+  /// Concrete paths matching a path with '*' elements.
+  void expandPath(int32_t msg_index, const std::vector<std::string>& elements, size_t index,
+                  const std::string& prefix, std::vector<std::string>& output) const;
+
+  void expandLeaves(int32_t msg_index, const std::string& prefix, std::vector<std::string>& output) const;
+
+  static std::string NormalizePath(const std::string& path);
+
+  static bool Compare(double value, Comparison comparison, double reference);
+
+  bool evaluateNode(int index, const Span<uint8_t>& buffer) const;
+
+  bool evaluateComparison(const Node& node, const Span<uint8_t>& buffer) const;
+
+  void throwError(const std::string& message) const
+  {
+    throw std::runtime_error( "RawPredicate: " + message + " in expression: " + _expression );
+  }
+
+  const MessageSchema* _schema;
+  std::string _expression;
+  std::vector<Node> _nodes;
+  std::vector<FieldReader> _readers;
+  int _root;
+
+  // used only while compiling
+  std::vector<Token> _tokens;
+  size_t _position;
+};
+
+//---------------------------------------------------------------------------
+
+inline RawPredicate::RawPredicate(const MessageSchema &schema, const std::string &expression):
+  _schema(&schema),
+  _expression(expression),
+  _position(0)
+{
+  tokenize();
+  _root = parseOr();
+  if( peek().type != TOKEN_END ){
+    throwError( "unexpected [" + peek().text + "]" );
+  }
+  _tokens.clear();
+}
+
+inline void RawPredicate::tokenize()
+{
+  static const char* operators[10] = { "&&", "||", "<=", ">=", "==", "!=", "<", ">", "!", "(" };
+  const std::string& expr = _expression;
+  size_t pos = 0;
+
+  while( pos < expr.size() )
+  {
+    const char c = expr[pos];
+    if( c == ' ' || c == '\t' ){
+      pos++;
+      continue;
+    }
+    Token token;
+
+    if( c == ')' )
+    {
+      token.type = TOKEN_OPERATOR;
+      token.text = ")";
+      pos++;
+    }
+    else if( c == '"' || c == '\'' )
+    {
+      const size_t end = expr.find( c, pos + 1 );
+      if( end == std::string::npos ){
+        throwError( "unterminated string" );
+      }
+      token.type = TOKEN_STRING;
+      token.text = expr.substr( pos + 1, end - pos - 1 );
+      pos = end + 1;
+    }
+    else if( std::isdigit( static_cast<unsigned char>(c) ) || c == '-' || c == '+' )
+    {
+      const char* start = expr.c_str() + pos;
+      char* end = nullptr;
+      std::strtod( start, &end );
+      if( end == start ){
+        throwError( "invalid number" );
+      }
+      token.type = TOKEN_NUMBER;
+      token.text.assign( start, end - start );
+      pos += end - start;
+    }
+    else if( std::isalpha( static_cast<unsigned char>(c) ) || c == '_' || c == '/' || c == '*' )
+    {
+      const size_t start = pos;
+      while( pos < expr.size() )
+      {
+        const char p = expr[pos];
+        if( !std::isalnum( static_cast<unsigned char>(p) ) &&
+            std::strchr( "_/.#*[]", p ) == nullptr ){
+          break;
+        }
+        pos++;
+      }
+      token.text = expr.substr( start, pos - start );
+      token.type = TOKEN_PATH;
+      if( token.text == "true" || token.text == "false" )
+      {
+        token.type = TOKEN_NUMBER;
+        token.text = ( token.text == "true" ) ? "1" : "0";
+      }
+    }
+    else{
+      token.type = TOKEN_OPERATOR;
+      for(const char* op: operators)
+      {
+        if( expr.compare( pos, std::strlen(op), op ) == 0 )
+        {
+          token.text = op;
+          break;
+        }
+      }
+      if( token.text.empty() ){
+        throwError( std::string("unexpected character [") + c + "]" );
+      }
+      pos += token.text.size();
+    }
+    _tokens.push_back( token );
+  }
+  Token end;
+  end.type = TOKEN_END;
+  end.text = "end of expression";
+  _tokens.push_back( end );
+}
+
+inline bool RawPredicate::accept(const char *op)
+{
+  if( peek().type == TOKEN_OPERATOR && peek().text == op )
+  {
+    _position++;
+    return true;
+  }
+  return false;
+}
+
+inline int RawPredicate::parseOr()
+{
+  const int first = parseAnd();
+  if( peek().text != "||" ){
+    return first;
+  }
+  Node node( OR );
+  node.children.push_back( first );
+  while( accept("||") ){
+    node.children.push_back( parseAnd() );
+  }
+  _nodes.push_back( node );
+  return static_cast<int>(_nodes.size() - 1);
+}
+
+inline int RawPredicate::parseAnd()
+{
+  const int first = parseUnary();
+  if( peek().text != "&&" ){
+    return first;
+  }
+  Node node( AND );
+  node.children.push_back( first );
+  while( accept("&&") ){
+    node.children.push_back( parseUnary() );
+  }
+  _nodes.push_back( node );
+  return static_cast<int>(_nodes.size() - 1);
+}
+
+inline int RawPredicate::parseUnary()
+{
+  if( accept("!") )
+  {
+    Node node( NOT );
+    node.children.push_back( parseUnary() );
+    _nodes.push_back( node );
+    return static_cast<int>(_nodes.size() - 1);
+  }
+  if( accept("(") )
+  {
+    const int inner = parseOr();
+    if( !accept(")") ){
+      throwError( "expected [)]" );
+    }
+    return inner;
+  }
+  return parseComparison();
+}
+
+inline int RawPredicate::parseComparison()
+{
+  if( peek().type != TOKEN_PATH ){
+    throwError( "expected a path, found [" + peek().text + "]" );
+  }
+  const std::string path = NormalizePath( peek().text );
+  _position++;
+
+  static const char* operators[6] = { "<", "<=", ">", ">=", "==", "!=" };
+  static const Comparison comparisons[6] = { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL };
+
+  Node node( COMPARE );
+
+  bool has_operator = false;
+  for(int i=0; i<6; i++)
+  {
+    if( accept( operators[i] ) )
+    {
+      node.comparison = comparisons[i];
+      has_operator = true;
+      break;
+    }
+  }
+  if( has_operator )
+  {
+    const Token& literal = peek();
+    if( literal.type == TOKEN_NUMBER ){
+      node.number = std::strtod( literal.text.c_str(), nullptr );
+    }
+    else if( literal.type == TOKEN_STRING )
+    {
+      if( node.comparison != EQUAL && node.comparison != NOT_EQUAL ){
+        throwError( "strings can be compared only with == and !=" );
+      }
+      node.is_string = true;
+      node.text = literal.text;
+    }
+    else{
+      throwError( "expected a number or a string, found [" + literal.text + "]" );
+    }
+    _position++;
+  }
+
+  // split the path and expand the '*'
+  std::vector<std::string> elements;
+  size_t start = 0;
+  while( start <= path.size() )
+  {
+    size_t end = path.find( '/', start );
+    if( end == std::string::npos ){
+      end = path.size();
+    }
+    if( end > start ){
+      elements.push_back( path.substr( start, end - start ) );
+    }
+    start = end + 1;
+  }
+  std::vector<std::string> paths;
+  expandPath( 0, elements, 0, std::string(), paths );
+
+  const bool explicit_path = ( path.find('*') == std::string::npos );
+  node.first_reader = _readers.size();
+
+  for(const std::string& leaf_path: paths)
+  {
+    FieldReader reader( *_schema, leaf_path );
+    const bool string_leaf = ( reader.leaf().type_id == STRING );
+
+    // without an operator, strings are compared with ""
+    const bool compatible = !has_operator || ( string_leaf == node.is_string );
+    if( !compatible )
+    {
+      if( explicit_path ){
+        throwError( "the type of [" + leaf_path + "] can't be compared with the literal" );
+      }
+      continue;
+    }
+    _readers.push_back( reader );
+  }
+  node.readers_count = _readers.size() - node.first_reader;
+  if( !has_operator ){
+    node.is_string = false; // each leaf decides
+  }
+
+  _nodes.push_back( node );
+  return static_cast<int>(_nodes.size() - 1);
+}
+
+inline std::string RawPredicate::NormalizePath(const std::string &path)
+{
+  std::string output;
+  output.reserve( path.size() );
+  for(size_t i=0; i < path.size(); i++)
+  {
+    const char c = path[i];
+    if( c == '[' )
+    {
+      output += '.';
+    }
+    else if( c == ']' )
+    {
+      continue;
+    }
+    else if( c == '*' && !output.empty() && output.back() == '.' )
+    {
+      output += '#';
+    }
+    else{
+      output += c;
+    }
+  }
+  return output;
+}
+
+inline void RawPredicate::expandPath(int32_t msg_index,
+                                     const std::vector<std::string> &elements, size_t index,
+                                     const std::string &prefix,
+                                     std::vector<std::string> &output) const
+{
+  if( index == elements.size() )
+  {
+    output.push_back( prefix );
+    return;
+  }
+  if( msg_index < 0 ){
+    throwError( "the path goes through a builtin field" );
+  }
+  const SchemaMessage& msg = _schema->message( msg_index );
+  const std::string& element = elements[index];
+  const bool last = ( index + 1 == elements.size() );
+  const std::string separator = prefix.empty() ? "" : "/";
+
+  if( element == "*" )
+  {
+    for(const SchemaField& field: msg.fields)
+    {
+      const std::string path = prefix + separator + field.name + ( field.is_array ? ".#" : "" );
+      if( field.message_index < 0 )
+      {
+        if( last ){
+          output.push_back( path );
+        }
+      }
+      else if( last ){
+        expandLeaves( field.message_index, path, output );
+      }
+      else{
+        expandPath( field.message_index, elements, index + 1, path, output );
+      }
+    }
+    return;
+  }
+
+  const std::string name = element.substr( 0, element.find('.') );
+  for(const SchemaField& field: msg.fields)
+  {
+    if( field.name == name )
+    {
+      expandPath( field.message_index, elements, index + 1, prefix + separator + element, output );
+      return;
+    }
+  }
+  throwError( "field [" + name + "] not found" );
+}
+
+inline void RawPredicate::expandLeaves(int32_t msg_index, const std::string &prefix,
+                                       std::vector<std::string> &output) const
+{
+  for(const SchemaField& field: _schema->message( msg_index ).fields)
+  {
+    const std::string path = prefix + "/" + field.name + ( field.is_array ? ".#" : "" );
+    if( field.message_index < 0 ){
+      output.push_back( path );
+    }
+    else{
+      expandLeaves( field.message_index, path, output );
+    }
+  }
+}
+
+inline bool RawPredicate::Compare(double value, Comparison comparison, double reference)
+{
+  switch( comparison )
+  {
+  case LESS:          return value <  reference;
+  case LESS_EQUAL:    return value <= reference;
+  case GREATER:       return value >  reference;
+  case GREATER_EQUAL: return value >= reference;
+  case EQUAL:         return value == reference;
+  case NOT_EQUAL:     return value != reference;
+  }
+  return false;
+}
+
+inline bool RawPredicate::evaluateNode(int index, const Span<uint8_t> &buffer) const
+{
+  const Node& node = _nodes[index];
+  switch( node.type )
+  {
+  case OR:
+    for(int child: node.children)
+    {
+      if( evaluateNode( child, buffer ) ){
+        return true;
+      }
+    }
+    return false;
+
+  case AND:
+    for(int child: node.children)
+    {
+      if( !evaluateNode( child, buffer ) ){
+        return false;
+      }
+    }
+    return true;
+
+  case NOT:
+    return !evaluateNode( node.children.front(), buffer );
+
+  case COMPARE:
+    return evaluateComparison( node, buffer );
+  }
+  return false;
+}
+
+inline bool RawPredicate::evaluateComparison(const Node &node, const Span<uint8_t> &buffer) const
+{
+  std::string text;
+  auto matches = [&node, &text](const SchemaField& leaf, const Span<uint8_t>& buf,
+                                size_t offset, const std::vector<uint32_t>&) -> bool
+  {
+    if( leaf.type_id == STRING )
+    {
+      ReadLeafString( buf, offset, text );
+      if( !node.is_string ){
+        return !text.empty(); // no operator
+      }
+      return ( text == node.text ) == ( node.comparison == EQUAL );
+    }
+    return Compare( ReadLeafAsDouble( leaf.type_id, buf, offset ), node.comparison, node.number );
+  };
+
+  for(size_t i=0; i < node.readers_count; i++)
+  {
+    if( _readers[node.first_reader + i].visit( buffer, matches ) ){
+      return true;
+    }
+  }
+  return false;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_RAW_PREDICATE_HPP
@@ -0,0 +1,389 @@
+#ifndef ROS_INTROSPECTION_TEST_SAMPLE_HISTORY_HPP
+#define ROS_INTROSPECTION_TEST_SAMPLE_HISTORY_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_utils.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief The SampleHistory stores the last N samples of every numerical
+ * value of a topic, with their timestamp.
+ *
+ * Memory is allocated once (capacity * number of keys) and data is stored by
+ * column: a time-window query is a binary search on the timestamps and returns
+ * a view of the columns, without copying them.
+ *
+ * Timestamps must be non-decreasing; older samples are discarded.
+ * A key that is missing in a message gets NaN. The column of a key that is
+ * missing in all the stored samples is dropped, and its memory is reused by
+ * the next new key: the number of columns doesn't grow with keys that change
+ * over time (for instance names in arrays).
+ */
+class SampleHistory
+{
+public:
+
+  /// View of a window of samples. The ring buffer may wrap: data is in two segments.
+  struct Range
+  {
+    const double* time[2];
+    const double* value[2];
+    size_t size[2];
+
+    size_t count() const { return size[0] + size[1]; }
+
+    double timeAt(size_t i) const  { return (i < size[0]) ? time[0][i]  : time[1][i - size[0]]; }
+    double valueAt(size_t i) const { return (i < size[0]) ? value[0][i] : value[1][i - size[0]]; }
+  };
+
+  explicit SampleHistory(size_t capacity);
+
+  void push(double timestamp, const RenamedValues& values);
+
+  /// Keys are created with StringTreeLeaf::toStdString() only when the layout changes.
+  void push(double timestamp, const FlatMessage& message);
+
+  /// Number of samples currently stored.
+  size_t size() const { return _size; }
+
+  size_t capacity() const { return _capacity; }
+
+  /// Key of each column, empty if the column was dropped.
+  const std::vector<std::string>& keys() const { return _keys; }
+
+  /// Index of a column, -1 if not found. Valid until the column is dropped.
+  int findKey(const std::string& key) const;
+
+  /// Samples of a column with timestamp in [t0, t1]. O(log n).
+  Range range(size_t column, double t0, double t1) const;
+
+  /// Timestamp of the most recent sample (NaN if empty).
+  double latestTime() const;
+
+  /// Most recent value of a column. O(1).
+  double latest(size_t column) const;
+
+  /// Samples discarded because older than the latest one.
+  uint64_t outOfOrderCount() const { return _out_of_order; }
+
+  /// Remove all the samples and keys. The memory of the columns is kept and reused.
+  void clear();
+
+private:
+
+  size_t addColumn(const std::string& key);
+
+  bool beginSample(double timestamp);
+
+  /// Update the columns that are absent from the new _layout.
+  void updateAbsentColumns();
+
+  /// NaN into the absent columns, then drop the ones absent from all the samples.
+  void endSample();
+
+  size_t physical(size_t logical) const { return (_head + logical) % _capacity; }
+
+  size_t lowerBound(double t) const;
+
+  size_t _capacity;
+  size_t _head;       // physical index of the oldest sample
+  size_t _size;
+  size_t _current;    // physical index of the sample being written
+  uint64_t _out_of_order;
+  uint64_t _samples;  // samples accepted so far
+
+  std::vector<double> _time;
+  std::vector<std::vector<double>> _columns;
+  std::vector<std::string> _keys;
+  std::unordered_map<std::string, size_t> _key_index;
+
+  // for each column: is it in _layout, and the last sample containing it if not
+  std::vector<bool> _present;
+  std::vector<uint64_t> _last_seen;
+  std::vector<size_t> _absent;
+  std::vector<size_t> _free_columns;
+
+  // layout of the previous message: column of each value
+  std::vector<size_t> _layout;
+  std::vector<StringTreeLeaf> _layout_leaves;
+};
+
+//---------------------------------------------------------------------------
+
+inline SampleHistory::SampleHistory(size_t capacity):
+  _capacity( capacity > 0 ? capacity : 1 ),
+  _head(0),
+  _size(0),
+  _current(0),
+  _out_of_order(0),
+  _samples(0),
+  _time( _capacity, 0.0 )
+{
+}
+
+inline void SampleHistory::clear()
+{
+  _head = 0;
+  _size = 0;
+  _current = 0;
+  _out_of_order = 0;
+  _samples = 0;
+
+  // all the columns are dropped (NaN), as if they were absent from every sample
+  _key_index.clear();
+  _free_columns.clear();
+  for(size_t column = _columns.size(); column-- > 0; )
+  {
+    std::fill( _columns[column].begin(), _columns[column].end(),
+               std::numeric_limits<double>::quiet_NaN() );
+    _keys[column].clear();
+    _present[column] = false;
+    _last_seen[column] = 0;
+    _free_columns.push_back( column );
+  }
+  _absent.clear();
+  _layout.clear();
+  _layout_leaves.clear();
+}
+
+inline int SampleHistory::findKey(const std::string &key) const
+{
+  auto it = _key_index.find(key);
+  return (it == _key_index.end()) ? -1 : static_cast<int>(it->second);
+}
+
+inline size_t SampleHistory::addColumn(const std::string &key)
+{
+  auto it = _key_index.find(key);
+  if( it != _key_index.end() ){
+    return it->second;
+  }
+  size_t column = _keys.size();
+  if( !_free_columns.empty() )
+  {
+    // a dropped column contains only NaN
+    column = _free_columns.back();
+    _free_columns.pop_back();
+    _keys[column] = key;
+  }
+  else{
+    _keys.push_back( key );
+    _columns.push_back( std::vector<double>( _capacity, std::numeric_limits<double>::quiet_NaN() ) );
+    _present.push_back( false );
+    _last_seen.push_back( 0 );
+  }
+  _key_index.insert( std::make_pair(key, column) );
+  return column;
+}
+
+inline void SampleHistory::updateAbsentColumns()
+{
+  std::vector<bool> present( _columns.size(), false );
+  for(size_t column: _layout){
+    present[column] = true;
+  }
+  _absent.clear();
+  for(size_t column=0; column < _columns.size(); column++)
+  {
+    if( _present[column] && !present[column] ){
+      _last_seen[column] = _samples - 1;
+    }
+    if( !present[column] && !_keys[column].empty() ){
+      _absent.push_back( column );
+    }
+  }
+  _present.swap( present );
+}
+
+inline void SampleHistory::endSample()
+{
+  size_t i = 0;
+  while( i < _absent.size() )
+  {
+    const size_t column = _absent[i];
+    _columns[column][_current] = std::numeric_limits<double>::quiet_NaN();
+    if( _samples - _last_seen[column] < _size )
+    {
+      i++;
+      continue;
+    }
+    _key_index.erase( _keys[column] );
+    _keys[column].clear();
+    _free_columns.push_back( column );
+    _absent[i] = _absent.back();
+    _absent.pop_back();
+  }
+}
+
+inline bool SampleHistory::beginSample(double timestamp)
+{
+  if( _size > 0 && timestamp < latestTime() )
+  {
+    _out_of_order++;
+    return false;
+  }
+  if( _size < _capacity )
+  {
+    _current = physical( _size );
+    _size++;
+  }
+  else{
+    _current = _head;
+    _head = (_head + 1) % _capacity;
+  }
+  _time[_current] = timestamp;
+  _samples++;
+  return true;
+}
+
+inline void SampleHistory::push(double timestamp, const RenamedValues &values)
+{
+  if( !beginSample(timestamp) ){
+    return;
+  }
+  bool same_layout = ( _layout.size() == values.size() && _layout_leaves.empty() );
+  for(size_t i=0; same_layout && i < values.size(); i++)
+  {
+    same_layout = ( _keys[ _layout[i] ] == values[i].first );
+  }
+  if( !same_layout )
+  {
+    _layout_leaves.clear();
+    _layout.resize( values.size() );
+    for(size_t i=0; i < values.size(); i++){
+      _layout[i] = addColumn( values[i].first );
+    }
+    updateAbsentColumns();
+  }
+  for(size_t i=0; i < values.size(); i++)
+  {
+    _columns[ _layout[i] ][_current] = values[i].second.convert<double>();
+  }
+  endSample();
+}
+
+inline void SampleHistory::push(double timestamp, const FlatMessage &message)
+{
+  if( !beginSample(timestamp) ){
+    return;
+  }
+  const auto& values = message.value;
+  bool same_layout = ( _layout_leaves.size() == values.size() && !values.empty() );
+  for(size_t i=0; same_layout && i < values.size(); i++)
+  {
+    same_layout = IsSameLeaf( _layout_leaves[i], values[i].first );
+  }
+  if( !same_layout )
+  {
+    _layout_leaves.resize( values.size() );
+    _layout.resize( values.size() );
+    for(size_t i=0; i < values.size(); i++)
+    {
+      _layout_leaves[i] = values[i].first;
+      _layout[i] = addColumn( values[i].first.toStdString() );
+    }
+    updateAbsentColumns();
+  }
+  for(size_t i=0; i < values.size(); i++)
+  {
+    _columns[ _layout[i] ][_current] = values[i].second.convert<double>();
+  }
+  endSample();
+}
+
+inline double SampleHistory::latestTime() const
+{
+  if( _size == 0 ){
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return _time[ physical(_size - 1) ];
+}
+
+inline double SampleHistory::latest(size_t column) const
+{
+  if( _size == 0 ){
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return _columns[column][ physical(_size - 1) ];
+}
+
+inline size_t SampleHistory::lowerBound(double t) const
+{
+  size_t first = 0;
+  size_t count = _size;
+  while( count > 0 )
+  {
+    const size_t step = count / 2;
+    const size_t middle = first + step;
+    if( _time[ physical(middle) ] < t )
+    {
+      first = middle + 1;
+      count -= step + 1;
+    }
+    else{
+      count = step;
+    }
+  }
+  return first;
+}
+
+inline SampleHistory::Range SampleHistory::range(size_t column, double t0, double t1) const
+{
+  Range output;
+  output.size[0] = output.size[1] = 0;
+  output.time[0] = output.time[1] = nullptr;
+  output.value[0] = output.value[1] = nullptr;
+
+  const size_t begin = lowerBound( t0 );
+  size_t end = begin;
+  // upper bound of t1
+  {
+    size_t first = begin;
+    size_t count = _size - begin;
+    while( count > 0 )
+    {
+      const size_t step = count / 2;
+      const size_t middle = first + step;
+      if( !(t1 < _time[ physical(middle) ]) )
+      {
+        first = middle + 1;
+        count -= step + 1;
+      }
+      else{
+        count = step;
+      }
+    }
+    end = first;
+  }
+  if( end <= begin ){
+    return output;
+  }
+
+  const double* time_data  = _time.data();
+  const double* value_data = _columns[column].data();
+
+  const size_t phys_begin = physical(begin);
+  const size_t length = end - begin;
+  const size_t first_segment = std::min( length, _capacity - phys_begin );
+
+  output.time[0]  = time_data  + phys_begin;
+  output.value[0] = value_data + phys_begin;
+  output.size[0]  = first_segment;
+
+  if( first_segment < length )
+  {
+    output.time[1]  = time_data;
+    output.value[1] = value_data;
+    output.size[1]  = length - first_segment;
+  }
+  return output;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_SAMPLE_HISTORY_HPP
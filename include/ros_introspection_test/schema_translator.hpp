@@ -0,0 +1,350 @@
+#ifndef ROS_INTROSPECTION_TEST_SCHEMA_TRANSLATOR_HPP
+#define ROS_INTROSPECTION_TEST_SCHEMA_TRANSLATOR_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <map>
+
+namespace RosIntrospection{
+
+/// A difference between two definitions of the same datatype.
+struct SchemaChange
+{
+  enum Kind
+  {
+    ADDED,    ///< only in the new definition: it gets its default value.
+    REMOVED,  ///< only in the old definition: it is dropped.
+    CHANGED   ///< different type or array size: treated as REMOVED + ADDED.
+  };
+  Kind kind;
+  /// datatype and name of the field, for instance "geometry_msgs/TransformStamped/child_frame_id".
+  std::string field;
+};
+
+/**
+ * @brief Converts messages serialized with an old definition of a datatype
+ * into the layout of a newer definition of the same datatype
+ * (for instance when a field was added to MotorStatus.msg between two bags).
+ *
+ * The fields are matched by name, once, in the constructor: the result is a
+ * list of operations for each pair of (old, new) message types:
+ *
+ * - copy a range of consecutive fields (a single memcpy);
+ * - write the default value of a new field (zero, empty string or empty array);
+ * - translate the elements of a sub-message whose definition changed.
+ *
+ * Removed fields are simply not copied. Sub-messages that didn't change are copied
+ * as a whole. The output can be deserialized by a Parser where the newest definition
+ * is registered, so that old and new bags produce the same keys.
+ *
+ * Both MessageSchemas must outlive the SchemaTranslator.
+ */
+class SchemaTranslator
+{
+public:
+
+  SchemaTranslator(const MessageSchema& old_schema, const MessageSchema& new_schema);
+
+  /// True if the two definitions have the same layout: translate() is a plain copy.
+  bool isIdentity() const { return _plans.front().identity; }
+
+  const std::vector<SchemaChange>& changes() const { return _changes; }
+
+  /**
+   * @brief Convert a message serialized with the old definition.
+   * Returns the number of bytes of old_buffer that were used.
+   * Throws std::runtime_error if old_buffer is too short.
+   */
+  size_t translate(const Span<uint8_t>& old_buffer, std::vector<uint8_t>& new_buffer);
+
+private:
+
+  struct Op
+  {
+    enum Kind { COPY, DEFAULT, TRANSLATE };
+    Kind kind;
+    // COPY: range of old fields. TRANSLATE: old_first only
+    uint32_t old_first;
+    uint32_t old_last;
+    // TRANSLATE: plan of the elements
+    int32_t plan;
+    // DEFAULT: serialized default value
+    std::vector<uint8_t> bytes;
+  };
+
+  struct Plan
+  {
+    int32_t old_msg;
+    bool identity;
+    std::vector<Op> ops;
+    /// offset of each old field from the beginning of the message, -1 if not fixed.
+    std::vector<int64_t> old_offsets;
+  };
+
+  int32_t compile(int32_t old_msg, int32_t new_msg);
+
+  bool sameKind(const SchemaField& old_field, const SchemaField& new_field) const;
+
+  /// Serialized default value of a field of the new schema.
+  void defaultField(const SchemaField& field, std::vector<uint8_t>& output) const;
+
+  size_t translateMessage(int32_t plan_index, const Span<uint8_t>& buffer,
+                          size_t offset, std::vector<uint8_t>& output);
+
+  const MessageSchema* _old;
+  const MessageSchema* _new;
+
+  std::vector<Plan> _plans;
+  // key: (old message, new message)
+  std::map<std::pair<int32_t, int32_t>, int32_t> _plan_index;
+  std::vector<SchemaChange> _changes;
+
+  // positions of the old fields, used as a stack by the nested messages
+  std::vector<size_t> _positions;
+};
+
+//---------------------------------------------------------------------------
+
+inline SchemaTranslator::SchemaTranslator(const MessageSchema &old_schema,
+                                          const MessageSchema &new_schema):
+  _old(&old_schema),
+  _new(&new_schema)
+{
+  if( old_schema.messages().empty() || new_schema.messages().empty() ){
+    throw std::runtime_error("SchemaTranslator: empty schema");
+  }
+  if( old_schema.message(0).datatype != new_schema.message(0).datatype )
+  {
+    throw std::runtime_error("SchemaTranslator: different datatypes: " +
+                             old_schema.message(0).datatype + " and " +
+                             new_schema.message(0).datatype );
+  }
+  compile( 0, 0 );
+}
+
+inline bool SchemaTranslator::sameKind(const SchemaField &old_field,
+                                       const SchemaField &new_field) const
+{
+  if( old_field.type_id != new_field.type_id ||
+      old_field.is_array != new_field.is_array ||
+      old_field.array_size != new_field.array_size )
+  {
+    return false;
+  }
+  if( new_field.message_index >= 0 )
+  {
+    return _old->message( old_field.message_index ).datatype ==
+        _new->message( new_field.message_index ).datatype;
+  }
+  return true;
+}
+
+inline void SchemaTranslator::defaultField(const SchemaField &field,
+                                           std::vector<uint8_t> &output) const
+{
+  if( field.array_size < 0 )
+  {
+    output.insert( output.end(), sizeof(uint32_t), 0 ); // empty array
+    return;
+  }
+  for(int32_t i=0; i < field.array_size; i++)
+  {
+    if( field.builtin_size >= 0 )
+    {
+      output.insert( output.end(), field.builtin_size, 0 );
+    }
+    else if( field.message_index >= 0 )
+    {
+      for(const SchemaField& sub_field: _new->message( field.message_index ).fields){
+        defaultField( sub_field, output );
+      }
+    }
+    else{
+      output.insert( output.end(), sizeof(uint32_t), 0 ); // empty string
+    }
+  }
+}
+
+inline int32_t SchemaTranslator::compile(int32_t old_msg, int32_t new_msg)
+{
+  const auto key = std::make_pair( old_msg, new_msg );
+  auto it = _plan_index.find( key );
+  if( it != _plan_index.end() ){
+    return it->second;
+  }
+  // _plans may grow during the recursion: don't keep references to its elements
+  const int32_t index = static_cast<int32_t>( _plans.size() );
+  _plans.push_back( Plan() );
+  _plan_index.insert( std::make_pair( key, index ) );
+
+  const SchemaMessage& old_message = _old->message( old_msg );
+  const SchemaMessage& new_message = _new->message( new_msg );
+
+  Plan plan;
+  plan.old_msg = old_msg;
+  bool identity = ( old_message.fields.size() == new_message.fields.size() );
+  std::vector<bool> used( old_message.fields.size(), false );
+
+  for(size_t n=0; n < new_message.fields.size(); n++)
+  {
+    const SchemaField& field = new_message.fields[n];
+    uint32_t match = 0;
+    while( match < old_message.fields.size() && old_message.fields[match].name != field.name ){
+      match++;
+    }
+
+    Op op;
+    op.old_first = match;
+    op.old_last = match;
+    op.plan = -1;
+
+    if( match == old_message.fields.size() || !sameKind( old_message.fields[match], field ) )
+    {
+      if( match < old_message.fields.size() )
+      {
+        used[match] = true;
+        _changes.push_back( SchemaChange{ SchemaChange::CHANGED, new_message.datatype + "/" + field.name } );
+      }
+      else{
+        _changes.push_back( SchemaChange{ SchemaChange::ADDED, new_message.datatype + "/" + field.name } );
+      }
+      identity = false;
+      op.kind = Op::DEFAULT;
+      defaultField( field, op.bytes );
+      plan.ops.push_back( std::move(op) );
+      continue;
+    }
+
+    used[match] = true;
+    if( match != n ){
+      identity = false;
+    }
+    if( field.message_index >= 0 )
+    {
+      const int32_t sub_plan = compile( old_message.fields[match].message_index, field.message_index );
+      if( !_plans[sub_plan].identity )
+      {
+        identity = false;
+        op.kind = Op::TRANSLATE;
+        op.plan = sub_plan;
+        plan.ops.push_back( std::move(op) );
+        continue;
+      }
+    }
+
+    // consecutive fields are copied at once
+    if( !plan.ops.empty() && plan.ops.back().kind == Op::COPY &&
+        plan.ops.back().old_last + 1 == match )
+    {
+      plan.ops.back().old_last = match;
+    }
+    else{
+      op.kind = Op::COPY;
+      plan.ops.push_back( std::move(op) );
+    }
+  }
+
+  for(size_t o=0; o < old_message.fields.size(); o++)
+  {
+    if( !used[o] )
+    {
+      identity = false;
+      _changes.push_back( SchemaChange{ SchemaChange::REMOVED,
+                                        old_message.datatype + "/" + old_message.fields[o].name } );
+    }
+  }
+
+  // fields preceded only by fields of fixed size have a fixed offset
+  plan.old_offsets.resize( old_message.fields.size() + 1, -1 );
+  plan.old_offsets[0] = 0;
+  for(size_t o=0; o < old_message.fields.size(); o++)
+  {
+    const SchemaField& field = old_message.fields[o];
+    int32_t element_size = field.builtin_size;
+    if( field.message_index >= 0 ){
+      element_size = _old->message( field.message_index ).fixed_size;
+    }
+    if( element_size < 0 || field.array_size < 0 ){
+      break;
+    }
+    plan.old_offsets[o+1] = plan.old_offsets[o] + int64_t(element_size) * field.array_size;
+  }
+
+  plan.identity = identity;
+  _plans[index] = std::move(plan);
+  return index;
+}
+
+inline size_t SchemaTranslator::translateMessage(int32_t plan_index, const Span<uint8_t> &buffer,
+                                                 size_t offset, std::vector<uint8_t> &output)
+{
+  const Plan& plan = _plans[plan_index];
+  if( plan.identity )
+  {
+    const size_t end = _old->skipMessage( plan.old_msg, buffer, offset );
+    output.insert( output.end(), buffer.data() + offset, buffer.data() + end );
+    return end;
+  }
+
+  const std::vector<SchemaField>& old_fields = _old->message( plan.old_msg ).fields;
+  const size_t base = _positions.size();
+  _positions.resize( base + old_fields.size() + 1 );
+  _positions[base] = offset;
+  for(size_t i=0; i < old_fields.size(); i++)
+  {
+    const int64_t fixed_offset = plan.old_offsets[i+1];
+    _positions[base+i+1] = ( fixed_offset >= 0 ) ?
+          offset + static_cast<size_t>(fixed_offset) :
+          _old->skipField( old_fields[i], buffer, _positions[base+i] );
+  }
+  const size_t end = _positions[base + old_fields.size()];
+  if( end > buffer.size() ){
+    ThrowBufferOverrun();
+  }
+
+  for(const Op& op: plan.ops)
+  {
+    switch( op.kind )
+    {
+    case Op::COPY:
+    {
+      output.insert( output.end(), buffer.data() + _positions[base + op.old_first],
+                     buffer.data() + _positions[base + op.old_last + 1] );
+    } break;
+
+    case Op::DEFAULT:
+    {
+      output.insert( output.end(), op.bytes.begin(), op.bytes.end() );
+    } break;
+
+    case Op::TRANSLATE:
+    {
+      size_t position = _positions[base + op.old_first];
+      const size_t prefix_start = position;
+      const uint32_t length = _old->readArrayLength( old_fields[op.old_first], buffer, position );
+      // the length prefix of dynamic arrays, if any
+      output.insert( output.end(), buffer.data() + prefix_start, buffer.data() + position );
+      for(uint32_t i=0; i < length; i++)
+      {
+        position = translateMessage( op.plan, buffer, position, output );
+      }
+    } break;
+    }
+  }
+
+  _positions.resize( base );
+  return end;
+}
+
+inline size_t SchemaTranslator::translate(const Span<uint8_t> &old_buffer,
+                                          std::vector<uint8_t> &new_buffer)
+{
+  new_buffer.clear();
+  new_buffer.reserve( old_buffer.size() );
+  // left dirty if the previous call threw
+  _positions.clear();
+  return translateMessage( 0, old_buffer, 0, new_buffer );
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_SCHEMA_TRANSLATOR_HPP
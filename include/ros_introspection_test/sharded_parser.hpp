@@ -0,0 +1,609 @@
+#ifndef ROS_INTROSPECTION_TEST_SHARDED_PARSER_HPP
+#define ROS_INTROSPECTION_TEST_SHARDED_PARSER_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/key_index.hpp>
+#include <ros_introspection_test/topic_scheduler.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Consistent hashing of keys (topic names) to shards.
+ *
+ * Each shard is placed on a ring at virtual_nodes pseudo-random positions;
+ * a key belongs to the first shard found after its own position.
+ * When a shard is added, only the keys moving to the new shard change owner
+ * (about 1/num_shards of them).
+ */
+class ConsistentHashRing
+{
+public:
+
+  explicit ConsistentHashRing(size_t num_shards, size_t virtual_nodes = 64);
+
+  size_t shardOf(const std::string& key) const;
+
+  size_t shardsCount() const { return _num_shards; }
+
+private:
+
+  /// FNV-1a doesn't mix the last bytes of short keys enough: finalize it (splitmix64).
+  static uint64_t Mix(uint64_t hash);
+
+  size_t _num_shards;
+  // sorted by position
+  std::vector<std::pair<uint64_t, uint32_t>> _points;
+};
+
+/// Output of the ShardedParser, valid only during the handler.
+struct ShardedResult
+{
+  /// position of the message in the sequence of push().
+  uint64_t sequence;
+  size_t shard;
+  const std::string* topic;
+  const FlatMessage* flat;
+  /// Parser::applyNameTransform() of flat.
+  const RenamedValues* renamed;
+  /// nullptr, or the error thrown by the Parser (flat and renamed are not valid then).
+  const std::string* error;
+};
+
+/**
+ * @brief Deserializes the messages of many topics in parallel, with one
+ * Parser per thread ("shard").
+ *
+ * - Topics are assigned to shards with a ConsistentHashRing. A topic is always
+ *   processed by the same shard, and each Parser knows only its own topics.
+ * - Each worker thread creates its Parser, registers its topics and allocates its
+ *   output containers (FlatMessage and RenamedValues) itself: with the default
+ *   "first touch" policy of Linux, this memory is local to the NUMA node where the
+ *   thread runs. With pin_threads, each worker is bound to a different CPU, before
+ *   allocating anything.
+ * - push() copies the message into a buffer of the shard. When the buffer must
+ *   grow, push() enlarges it, and the worker replaces it with a buffer of the same
+ *   size written by itself once the message is processed: the buffers too end up
+ *   local to the worker.
+ * - A merge thread calls the handler in the same order of push(), no matter
+ *   which shard finished first.
+ *
+ * At most queue_capacity messages per shard are in flight: when a shard is full,
+ * push() waits (backpressure).
+ *
+ * push() can be called by many threads at once: the messages are passed to the
+ * handler in the order in which push() reserved their slot (a short critical
+ * section; the copy of the buffer is made outside of it). flush(), start(), stop()
+ * and the registration methods must be called by a single thread.
+ */
+class ShardedParser
+{
+public:
+
+  typedef std::function<void(const ShardedResult&)> Handler;
+
+  ShardedParser(size_t num_shards,
+                bool pin_threads = false,
+                size_t queue_capacity = 64,
+                uint32_t max_array_size = 100);
+
+  ~ShardedParser();
+
+  ShardedParser(const ShardedParser&) = delete;
+  ShardedParser& operator=(const ShardedParser&) = delete;
+
+  /// Not thread-safe: register all the topics before calling start().
+  void registerMessageDefinition(const std::string& topic_name,
+                                 const ROSType& main_type,
+                                 const std::string& definition);
+
+  /// The rules are registered in every shard.
+  void registerRenamingRules(const ROSType& type, const std::vector<SubstitutionRule>& rules);
+
+  size_t shardOf(const std::string& topic_name) const { return _ring.shardOf( topic_name ); }
+
+  size_t shardsCount() const { return _shards.size(); }
+
+  /**
+   * @brief Start the worker threads and wait until they are ready.
+   * Rethrows the exception thrown by a Parser during the registration, if any.
+   */
+  void start(const Handler& handler);
+
+  /// Stop the threads. The messages not delivered to the handler yet are discarded.
+  void stop();
+
+  /**
+   * @brief The buffer is copied: it can be reused as soon as push() returns.
+   * Thread-safe. Throws std::runtime_error if the topic is not registered or if not started.
+   */
+  void push(const std::string& topic_name, const Span<uint8_t>& buffer);
+
+  /**
+   * @brief Wait until all the messages pushed so far have been passed to the handler.
+   * Rethrows the exception thrown by the handler, if any.
+   */
+  void flush();
+
+  /// Messages deserialized by the shard.
+  uint64_t processedCount(size_t shard) const { return _shards[shard]->processed; }
+
+  /// False if pin_threads was not requested, or if the CPU affinity could not be set.
+  bool isPinned(size_t shard) const { return _shards[shard]->pinned; }
+
+private:
+
+  struct TopicDefinition
+  {
+    std::string topic;
+    ROSType type;
+    std::string definition;
+  };
+
+  struct Slot
+  {
+    Slot(): size(0), grown(false), ready(false) {}
+
+    uint32_t topic;
+    uint64_t sequence;
+    // buffer.size() is the capacity, size the length of the message
+    std::vector<uint8_t> buffer;
+    size_t size;
+    // buffer enlarged by push(): the memory was touched by the producer
+    bool grown;
+    // set by push() once the buffer is copied
+    std::atomic<bool> ready;
+    FlatMessage flat;
+    RenamedValues renamed;
+    std::string error;
+  };
+
+  struct Shard
+  {
+    explicit Shard(size_t capacity):
+      free_slots(capacity), pending(capacity), done(capacity),
+      processed(0), pinned(false) {}
+
+    std::vector<TopicDefinition> definitions;
+    // everything below is allocated by the worker thread
+    std::unique_ptr<Parser> parser;
+    std::vector<std::unique_ptr<Slot>> slots;
+
+    BoundedQueue<size_t> free_slots;
+    BoundedQueue<size_t> pending;
+    BoundedQueue<size_t> done;
+
+    std::atomic<uint64_t> processed;
+    bool pinned;
+    std::thread thread;
+  };
+
+  struct Route
+  {
+    uint32_t shard;
+    uint32_t topic;
+  };
+
+  void workerLoop(size_t shard_index);
+
+  void initShard(size_t shard_index);
+
+  void mergeLoop();
+
+  /// yield a few times, then sleep.
+  static void Wait(unsigned& attempts);
+
+  ConsistentHashRing _ring;
+  bool _pin_threads;
+  size_t _queue_capacity;
+  uint32_t _max_array_size;
+
+  std::vector<std::unique_ptr<Shard>> _shards;
+  std::unordered_map<std::string, Route> _routes;
+  std::vector<std::pair<ROSType, std::vector<SubstitutionRule>>> _rules;
+  // CPUs this process is allowed to run on
+  std::vector<int> _cpus;
+
+  Handler _handler;
+  // shard of each message in flight, in the order of push()
+  BoundedQueue<uint32_t> _order;
+  // reservation of the slot, sequence and _order, in push()
+  std::mutex _push_mutex;
+
+  std::atomic<bool> _running;
+  std::atomic<size_t> _ready_count;
+  std::atomic<uint64_t> _pushed;
+  std::atomic<uint64_t> _merged;
+
+  std::mutex _error_mutex;
+  std::exception_ptr _error;
+
+  std::thread _merge_thread;
+};
+
+//---------------------------------------------------------------------------
+
+inline uint64_t ConsistentHashRing::Mix(uint64_t hash)
+{
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+inline ConsistentHashRing::ConsistentHashRing(size_t num_shards, size_t virtual_nodes):
+  _num_shards(num_shards)
+{
+  if( num_shards == 0 || virtual_nodes == 0 ){
+    throw std::runtime_error("ConsistentHashRing: at least one shard and one virtual node are needed");
+  }
+  _points.reserve( num_shards * virtual_nodes );
+  for(size_t shard=0; shard < num_shards; shard++)
+  {
+    for(size_t node=0; node < virtual_nodes; node++)
+    {
+      // the position of a shard doesn't depend on num_shards
+      const std::string name = std::to_string(shard) + "#" + std::to_string(node);
+      _points.push_back( std::make_pair( Mix( HashKey( name.data(), name.size() ) ),
+                                         static_cast<uint32_t>(shard) ) );
+    }
+  }
+  std::sort( _points.begin(), _points.end() );
+}
+
+inline size_t ConsistentHashRing::shardOf(const std::string &key) const
+{
+  const uint64_t position = Mix( HashKey( key.data(), key.size() ) );
+  auto it = std::lower_bound( _points.begin(), _points.end(),
+                              std::make_pair( position, uint32_t(0) ) );
+  if( it == _points.end() ){
+    it = _points.begin(); // it is a ring
+  }
+  return it->second;
+}
+
+//---------------------------------------------------------------------------
+
+inline ShardedParser::ShardedParser(size_t num_shards, bool pin_threads,
+                                    size_t queue_capacity, uint32_t max_array_size):
+  _ring( num_shards ),
+  _pin_threads(pin_threads),
+  _queue_capacity( queue_capacity > 0 ? queue_capacity : 1 ),
+  _max_array_size(max_array_size),
+  _order( num_shards * _queue_capacity ),
+  _running(false),
+  _ready_count(0),
+  _pushed(0),
+  _merged(0)
+{
+  for(size_t i=0; i < num_shards; i++){
+    _shards.emplace_back( new Shard( _queue_capacity ) );
+  }
+
+  cpu_set_t allowed;
+  CPU_ZERO( &allowed );
+  if( pin_threads && sched_getaffinity( 0, sizeof(allowed), &allowed ) == 0 )
+  {
+    for(int cpu=0; cpu < CPU_SETSIZE; cpu++)
+    {
+      if( CPU_ISSET( cpu, &allowed ) ){
+        _cpus.push_back( cpu );
+      }
+    }
+  }
+}
+
+inline ShardedParser::~ShardedParser()
+{
+  stop();
+}
+
+inline void ShardedParser::registerMessageDefinition(const std::string &topic_name,
+                                                     const ROSType &main_type,
+                                                     const std::string &definition)
+{
+  if( _running ){
+    throw std::runtime_error("ShardedParser: topics must be registered before start()");
+  }
+  if( _routes.count( topic_name ) ){
+    throw std::runtime_error("ShardedParser: topic already registered: " + topic_name );
+  }
+  Route route;
+  route.shard = static_cast<uint32_t>( shardOf( topic_name ) );
+  Shard& shard = *_shards[route.shard];
+  route.topic = static_cast<uint32_t>( shard.definitions.size() );
+  shard.definitions.push_back( TopicDefinition{ topic_name, main_type, definition } );
+  _routes.insert( std::make_pair( topic_name, route ) );
+}
+
+inline void ShardedParser::registerRenamingRules(const ROSType &type,
+                                                 const std::vector<SubstitutionRule> &rules)
+{
+  if( _running ){
+    throw std::runtime_error("ShardedParser: rules must be registered before start()");
+  }
+  _rules.push_back( std::make_pair( type, rules ) );
+}
+
+inline void ShardedParser::Wait(unsigned &attempts)
+{
+  if( attempts < 64 ){
+    std::this_thread::yield();
+  }
+  else{
+    std::this_thread::sleep_for( std::chrono::microseconds(50) );
+  }
+  attempts++;
+}
+
+inline void ShardedParser::start(const Handler &handler)
+{
+  if( _running.exchange(true) ){
+    return;
+  }
+  _handler = handler;
+  _ready_count = 0;
+  _error = nullptr;
+  for(size_t i=0; i < _shards.size(); i++)
+  {
+    _shards[i]->thread = std::thread( &ShardedParser::workerLoop, this, i );
+  }
+
+  unsigned attempts = 0;
+  while( _ready_count < _shards.size() ){
+    Wait( attempts );
+  }
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock( _error_mutex );
+    std::swap( error, _error );
+  }
+  if( error )
+  {
+    stop();
+    std::rethrow_exception( error );
+  }
+  _merge_thread = std::thread( &ShardedParser::mergeLoop, this );
+}
+
+inline void ShardedParser::stop()
+{
+  if( !_running.exchange(false) ){
+    return;
+  }
+  for(auto& shard: _shards)
+  {
+    if( shard->thread.joinable() ){
+      shard->thread.join();
+    }
+  }
+  if( _merge_thread.joinable() ){
+    _merge_thread.join();
+  }
+
+  // back to the state before start()
+  uint32_t shard_index;
+  while( _order.tryPop( shard_index ) ) {}
+  for(auto& shard: _shards)
+  {
+    size_t index;
+    while( shard->free_slots.tryPop( index ) ) {}
+    while( shard->pending.tryPop( index ) ) {}
+    while( shard->done.tryPop( index ) ) {}
+    shard->slots.clear();
+    shard->parser.reset();
+  }
+  _pushed = 0;
+  _merged = 0;
+}
+
+inline void ShardedParser::initShard(size_t shard_index)
+{
+  Shard& shard = *_shards[shard_index];
+
+  // pin first: the memory allocated below should be local to this CPU
+  if( _pin_threads && !_cpus.empty() )
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( _cpus[ shard_index % _cpus.size() ], &cpu_set );
+    shard.pinned = ( pthread_setaffinity_np( pthread_self(), sizeof(cpu_set), &cpu_set ) == 0 );
+  }
+
+  shard.parser.reset( new Parser );
+  for(const TopicDefinition& def: shard.definitions)
+  {
+    shard.parser->registerMessageDefinition( def.topic, def.type, def.definition );
+  }
+  for(const auto& rule: _rules)
+  {
+    shard.parser->registerRenamingRules( rule.first, rule.second );
+  }
+
+  for(size_t i=0; i < _queue_capacity; i++)
+  {
+    shard.slots.emplace_back( new Slot );
+    shard.free_slots.tryPush( i );
+  }
+}
+
+inline void ShardedParser::workerLoop(size_t shard_index)
+{
+  Shard& shard = *_shards[shard_index];
+  try{
+    initShard( shard_index );
+  }
+  catch( ... )
+  {
+    std::lock_guard<std::mutex> lock( _error_mutex );
+    if( !_error ){
+      _error = std::current_exception();
+    }
+  }
+  _ready_count++;
+
+  unsigned attempts = 0;
+  while( _running )
+  {
+    size_t index;
+    if( !shard.pending.tryPop( index ) )
+    {
+      Wait( attempts );
+      continue;
+    }
+    attempts = 0;
+
+    // the slot is published before push() copies the buffer into it
+    Slot& slot = *shard.slots[index];
+    while( !slot.ready.load( std::memory_order_acquire ) )
+    {
+      if( !_running ){
+        return;
+      }
+      Wait( attempts );
+    }
+    attempts = 0;
+    slot.ready.store( false, std::memory_order_relaxed );
+
+    const std::string& topic = shard.definitions[slot.topic].topic;
+    try{
+      shard.parser->deserializeIntoFlatContainer( topic, Span<uint8_t>( slot.buffer.data(), slot.size ),
+                                                  &slot.flat, _max_array_size );
+      shard.parser->applyNameTransform( topic, slot.flat, &slot.renamed );
+      slot.error.clear();
+    }
+    catch( std::exception& err )
+    {
+      slot.error = err.what();
+      if( slot.error.empty() ){
+        slot.error = "unknown error";
+      }
+    }
+    if( slot.grown )
+    {
+      std::vector<uint8_t>( slot.buffer.size() ).swap( slot.buffer );
+      slot.grown = false;
+    }
+    shard.processed++;
+    shard.done.tryPush( index );
+  }
+}
+
+inline void ShardedParser::mergeLoop()
+{
+  unsigned attempts = 0;
+  while( _running )
+  {
+    uint32_t shard_index;
+    if( !_order.tryPop( shard_index ) )
+    {
+      Wait( attempts );
+      continue;
+    }
+    attempts = 0;
+
+    // each shard completes its messages in order: the next one is at the front
+    Shard& shard = *_shards[shard_index];
+    size_t index;
+    while( !shard.done.tryPop( index ) )
+    {
+      if( !_running ){
+        return;
+      }
+      Wait( attempts );
+    }
+    attempts = 0;
+
+    const Slot& slot = *shard.slots[index];
+    ShardedResult result;
+    result.sequence = slot.sequence;
+    result.shard    = shard_index;
+    result.topic    = &shard.definitions[slot.topic].topic;
+    result.flat     = &slot.flat;
+    result.renamed  = &slot.renamed;
+    result.error    = slot.error.empty() ? nullptr : &slot.error;
+    try{
+      _handler( result );
+    }
+    catch( ... )
+    {
+      std::lock_guard<std::mutex> lock( _error_mutex );
+      if( !_error ){
+        _error = std::current_exception();
+      }
+    }
+    shard.free_slots.tryPush( index );
+    _merged.fetch_add( 1, std::memory_order_release );
+  }
+}
+
+inline void ShardedParser::push(const std::string &topic_name, const Span<uint8_t> &buffer)
+{
+  if( !_running ){
+    throw std::runtime_error("ShardedParser: push() before start()");
+  }
+  auto it = _routes.find( topic_name );
+  if( it == _routes.end() ){
+    throw std::runtime_error("ShardedParser: topic not registered: " + topic_name );
+  }
+  const Route& route = it->second;
+  Shard& shard = *_shards[route.shard];
+
+  size_t index;
+  {
+    // the order of _order and of the pending queue of the shard must be the same
+    std::lock_guard<std::mutex> lock( _push_mutex );
+    unsigned attempts = 0;
+    while( !shard.free_slots.tryPop( index ) ){
+      Wait( attempts );
+    }
+    Slot& slot = *shard.slots[index];
+    slot.topic = route.topic;
+    slot.sequence = _pushed++;
+
+    // never full: there are at most num_shards * queue_capacity messages in flight
+    uint32_t shard_index = route.shard;
+    _order.tryPush( shard_index );
+    shard.pending.tryPush( index );
+  }
+
+  Slot& slot = *shard.slots[index];
+  if( slot.buffer.size() < buffer.size() )
+  {
+    slot.buffer.resize( buffer.size() );
+    slot.grown = true;
+  }
+  if( buffer.size() > 0 ){
+    std::memcpy( slot.buffer.data(), buffer.data(), buffer.size() );
+  }
+  slot.size = buffer.size();
+  slot.ready.store( true, std::memory_order_release );
+}
+
+inline void ShardedParser::flush()
+{
+  unsigned attempts = 0;
+  while( _running && _merged.load( std::memory_order_acquire ) < _pushed.load() ){
+    Wait( attempts );
+  }
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock( _error_mutex );
+    std::swap( error, _error );
+  }
+  if( error ){
+    std::rethrow_exception( error );
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_SHARDED_PARSER_HPP
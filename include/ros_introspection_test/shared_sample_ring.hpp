@@ -0,0 +1,468 @@
+#ifndef ROS_INTROSPECTION_TEST_SHARED_SAMPLE_RING_HPP
+#define ROS_INTROSPECTION_TEST_SHARED_SAMPLE_RING_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_utils.hpp>
+#include <atomic>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_INT_LOCK_FREE != 2
+#error "SharedSampleRing requires lock-free atomics, to share them between processes"
+#endif
+
+namespace RosIntrospection{
+
+/*
+ * Layout of the shared memory:
+ *
+ *   RingHeader
+ *   uint32_t key_offsets[max_columns]
+ *   char     keys[max_key_bytes]        (null terminated strings)
+ *   RingSlot slots[capacity]            (each followed by max_columns doubles)
+ *
+ * The keys are the "schema": they are only appended, and column i of every
+ * sample is the value of keys[i]. A single writer publishes the samples into the
+ * slots, round robin; each slot is protected by a sequence lock.
+ */
+struct RingHeader
+{
+  /// Written last, when the ring is initialized.
+  std::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t max_columns;
+  uint32_t max_key_bytes;
+  uint64_t slot_size;
+
+  std::atomic<uint32_t> column_count;
+  std::atomic<uint32_t> key_bytes;
+  /// Number of samples published so far.
+  std::atomic<uint64_t> write_index;
+};
+
+struct RingSlot
+{
+  /// Odd while the sample N is written (2N+1), 2N+2 once it is complete.
+  std::atomic<uint64_t> sequence;
+  double time;
+  uint32_t column_count;
+  uint32_t padding;
+  // followed by max_columns doubles
+};
+
+const uint64_t kRingMagic = 0x524f534952494e47ULL; // "ROSIRING"
+const uint32_t kRingVersion = 1;
+
+inline size_t RingKeysOffset()
+{
+  return sizeof(RingHeader);
+}
+
+inline size_t RingSlotsOffset(uint32_t max_columns, uint32_t max_key_bytes)
+{
+  const size_t end_of_keys = sizeof(RingHeader) + max_columns * sizeof(uint32_t) + max_key_bytes;
+  return (end_of_keys + 63) & ~size_t(63);
+}
+
+inline size_t RingSlotSize(uint32_t max_columns)
+{
+  const size_t size = sizeof(RingSlot) + max_columns * sizeof(double);
+  return (size + 63) & ~size_t(63);
+}
+
+/// A sample read from the ring. values[i] is the value of SharedSampleReader::keys()[i], NaN if missing.
+struct SharedSample
+{
+  uint64_t index;
+  double time;
+  std::vector<double> values;
+};
+
+/**
+ * @brief Publishes the decoded messages of one topic into a ring buffer in
+ * shared memory (POSIX shm_open), so that the message is deserialized by a single
+ * process and read by many (a logger, a plotter, a safety monitor...), without
+ * a ROS master.
+ *
+ * The writer never waits for the readers: a reader that is too slow loses the
+ * oldest samples (see SharedSampleReader::lostCount()).
+ *
+ * Only one writer per name. The shared memory is removed when the writer is
+ * destroyed; readers that mapped it can still read the samples already published.
+ */
+class SharedSampleWriter
+{
+public:
+
+  /**
+   * @brief name must start with '/', for instance "/ros_introspection_imu".
+   * Throws std::runtime_error if the shared memory can't be created.
+   */
+  explicit SharedSampleWriter(const std::string& name,
+                              uint32_t capacity = 256,
+                              uint32_t max_columns = 1024,
+                              uint32_t max_key_bytes = 64*1024);
+
+  ~SharedSampleWriter();
+
+  SharedSampleWriter(const SharedSampleWriter&) = delete;
+  SharedSampleWriter& operator=(const SharedSampleWriter&) = delete;
+
+  /// Publish the values of a message deserialized by the Parser.
+  void publish(double time, const FlatMessage& message);
+
+  /// Number of samples published.
+  uint64_t publishedCount() const { return _next_index; }
+
+  /// Leaves that were discarded because max_columns or max_key_bytes was reached.
+  uint64_t droppedKeys() const { return _dropped_keys; }
+
+private:
+
+  /// Column of the key, added to the shared table if new. -1 if the table is full.
+  int32_t addColumn(const std::string& key);
+
+  RingSlot* slot(uint64_t index)
+  {
+    return reinterpret_cast<RingSlot*>( _memory + _slots_offset + (index % _header->capacity) * _header->slot_size );
+  }
+
+  std::string _name;
+  int _fd;
+  uint8_t* _memory;
+  size_t _size;
+  RingHeader* _header;
+  size_t _slots_offset;
+
+  uint64_t _next_index;
+  uint64_t _dropped_keys;
+
+  std::unordered_map<std::string, int32_t> _columns;
+  std::vector<StringTreeLeaf> _layout_leaves;
+  std::vector<int32_t> _layout;
+};
+
+/**
+ * @brief Maps read-only the ring of a SharedSampleWriter, possibly in another process.
+ * Never blocks the writer: a slot overwritten while it was read is detected and
+ * counted as lost.
+ */
+class SharedSampleReader
+{
+public:
+
+  /// Throws std::runtime_error if the shared memory doesn't exist or is not a ring.
+  explicit SharedSampleReader(const std::string& name);
+
+  ~SharedSampleReader();
+
+  SharedSampleReader(const SharedSampleReader&) = delete;
+  SharedSampleReader& operator=(const SharedSampleReader&) = delete;
+
+  /**
+   * @brief Read the oldest sample not read yet. Returns false if there is none.
+   * If the reader is more than capacity samples behind the writer, the older
+   * ones are skipped.
+   */
+  bool next(SharedSample& sample);
+
+  /// Skip everything published so far: next() will return only new samples.
+  void seekToEnd();
+
+  /// Name of each column, updated by next().
+  const std::vector<std::string>& keys() const { return _keys; }
+
+  /// Samples overwritten by the writer before they could be read.
+  uint64_t lostCount() const { return _lost; }
+
+private:
+
+  enum ReadResult { READ_OK, READ_OVERWRITTEN };
+
+  ReadResult readSlot(uint64_t index, SharedSample& sample);
+
+  void updateKeys(uint32_t count);
+
+  const RingSlot* slot(uint64_t index) const
+  {
+    return reinterpret_cast<const RingSlot*>( _memory + _slots_offset + (index % _capacity) * _slot_size );
+  }
+
+  int _fd;
+  const uint8_t* _memory;
+  size_t _size;
+  const RingHeader* _header;
+  size_t _slots_offset;
+  uint32_t _capacity;
+  uint64_t _slot_size;
+
+  uint64_t _next_index;
+  uint64_t _lost;
+  std::vector<std::string> _keys;
+};
+
+//---------------------------------------------------------------------------
+
+inline void ThrowSystemError(const std::string& what, int error_number)
+{
+  throw std::runtime_error( what + ": " + std::strerror(error_number) );
+}
+
+inline SharedSampleWriter::SharedSampleWriter(const std::string &name, uint32_t capacity,
+                                              uint32_t max_columns, uint32_t max_key_bytes):
+  _name(name),
+  _fd(-1),
+  _memory(nullptr),
+  _next_index(0),
+  _dropped_keys(0)
+{
+  if( capacity == 0 || max_columns == 0 ){
+    throw std::runtime_error("SharedSampleWriter: capacity and max_columns must be greater than zero");
+  }
+  _slots_offset = RingSlotsOffset( max_columns, max_key_bytes );
+  const size_t slot_size = RingSlotSize( max_columns );
+  _size = _slots_offset + slot_size * capacity;
+
+  // start from scratch, even if a previous writer crashed
+  shm_unlink( name.c_str() );
+  _fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+  if( _fd < 0 ){
+    ThrowSystemError( "SharedSampleWriter: can't create " + name, errno );
+  }
+  if( ftruncate( _fd, static_cast<off_t>(_size) ) != 0 )
+  {
+    const int error_number = errno;
+    close( _fd );
+    shm_unlink( name.c_str() );
+    ThrowSystemError( "SharedSampleWriter: can't resize " + name, error_number );
+  }
+  void* memory = mmap( nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0 );
+  if( memory == MAP_FAILED )
+  {
+    const int error_number = errno;
+    close( _fd );
+    shm_unlink( name.c_str() );
+    ThrowSystemError( "SharedSampleWriter: can't map " + name, error_number );
+  }
+  _memory = static_cast<uint8_t*>( memory );
+
+  // ftruncate filled the memory with zeros
+  _header = new (_memory) RingHeader;
+  _header->version = kRingVersion;
+  _header->capacity = capacity;
+  _header->max_columns = max_columns;
+  _header->max_key_bytes = max_key_bytes;
+  _header->slot_size = slot_size;
+  _header->column_count.store( 0, std::memory_order_relaxed );
+  _header->key_bytes.store( 0, std::memory_order_relaxed );
+  _header->write_index.store( 0, std::memory_order_relaxed );
+  for(uint32_t i=0; i < capacity; i++)
+  {
+    new (slot(i)) RingSlot;
+    slot(i)->sequence.store( 0, std::memory_order_relaxed );
+  }
+  _header->magic.store( kRingMagic, std::memory_order_release );
+}
+
+inline SharedSampleWriter::~SharedSampleWriter()
+{
+  munmap( _memory, _size );
+  close( _fd );
+  shm_unlink( _name.c_str() );
+}
+
+inline int32_t SharedSampleWriter::addColumn(const std::string &key)
+{
+  auto it = _columns.find( key );
+  if( it != _columns.end() ){
+    return it->second;
+  }
+  const uint32_t count = _header->column_count.load( std::memory_order_relaxed );
+  const uint32_t offset = _header->key_bytes.load( std::memory_order_relaxed );
+  if( count >= _header->max_columns || offset + key.size() + 1 > _header->max_key_bytes )
+  {
+    return -1;
+  }
+  uint32_t* key_offsets = reinterpret_cast<uint32_t*>( _memory + RingKeysOffset() );
+  char* keys = reinterpret_cast<char*>( key_offsets + _header->max_columns );
+
+  std::memcpy( keys + offset, key.c_str(), key.size() + 1 );
+  key_offsets[count] = offset;
+  _header->key_bytes.store( offset + key.size() + 1, std::memory_order_relaxed );
+  // the key is visible before the column is
+  _header->column_count.store( count + 1, std::memory_order_release );
+
+  _columns.insert( std::make_pair( key, static_cast<int32_t>(count) ) );
+  return static_cast<int32_t>(count);
+}
+
+inline void SharedSampleWriter::publish(double time, const FlatMessage &message)
+{
+  const auto& values = message.value;
+
+  bool same_layout = ( _layout_leaves.size() == values.size() );
+  for(size_t i=0; same_layout && i < values.size(); i++)
+  {
+    same_layout = IsSameLeaf( _layout_leaves[i], values[i].first );
+  }
+  if( !same_layout )
+  {
+    _layout_leaves.resize( values.size() );
+    _layout.resize( values.size() );
+    for(size_t i=0; i < values.size(); i++)
+    {
+      _layout_leaves[i] = values[i].first;
+      _layout[i] = addColumn( values[i].first.toStdString() );
+      _dropped_keys += ( _layout[i] < 0 );
+    }
+  }
+
+  const uint64_t index = _next_index++;
+  RingSlot* ring_slot = slot( index );
+  double* columns = reinterpret_cast<double*>( ring_slot + 1 );
+  const uint32_t column_count = _header->column_count.load( std::memory_order_relaxed );
+
+  ring_slot->sequence.store( 2*index + 1, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+
+  ring_slot->time = time;
+  ring_slot->column_count = column_count;
+  std::fill( columns, columns + column_count, std::numeric_limits<double>::quiet_NaN() );
+  for(size_t i=0; i < values.size(); i++)
+  {
+    if( _layout[i] >= 0 ){
+      columns[ _layout[i] ] = values[i].second.convert<double>();
+    }
+  }
+
+  ring_slot->sequence.store( 2*index + 2, std::memory_order_release );
+  _header->write_index.store( index + 1, std::memory_order_release );
+}
+
+inline SharedSampleReader::SharedSampleReader(const std::string &name):
+  _memory(nullptr),
+  _next_index(0),
+  _lost(0)
+{
+  _fd = shm_open( name.c_str(), O_RDONLY, 0 );
+  if( _fd < 0 ){
+    ThrowSystemError( "SharedSampleReader: can't open " + name, errno );
+  }
+  struct stat info;
+  if( fstat( _fd, &info ) != 0 || static_cast<size_t>(info.st_size) < sizeof(RingHeader) )
+  {
+    close( _fd );
+    throw std::runtime_error( "SharedSampleReader: not a sample ring: " + name );
+  }
+  _size = static_cast<size_t>( info.st_size );
+  void* memory = mmap( nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0 );
+  if( memory == MAP_FAILED )
+  {
+    const int error_number = errno;
+    close( _fd );
+    ThrowSystemError( "SharedSampleReader: can't map " + name, error_number );
+  }
+  _memory = static_cast<const uint8_t*>( memory );
+  _header = reinterpret_cast<const RingHeader*>( _memory );
+
+  const uint64_t magic = _header->magic.load( std::memory_order_acquire );
+
+  _capacity  = _header->capacity;
+  _slot_size = _header->slot_size;
+  _slots_offset = RingSlotsOffset( _header->max_columns, _header->max_key_bytes );
+
+  if( magic != kRingMagic || _header->version != kRingVersion || _capacity == 0 ||
+      _slots_offset + _slot_size * _capacity > _size )
+  {
+    munmap( memory, _size );
+    close( _fd );
+    throw std::runtime_error( "SharedSampleReader: not a sample ring, or not initialized yet: " + name );
+  }
+}
+
+inline SharedSampleReader::~SharedSampleReader()
+{
+  munmap( const_cast<uint8_t*>(_memory), _size );
+  close( _fd );
+}
+
+inline void SharedSampleReader::seekToEnd()
+{
+  _next_index = _header->write_index.load( std::memory_order_acquire );
+}
+
+inline void SharedSampleReader::updateKeys(uint32_t count)
+{
+  const uint32_t* key_offsets = reinterpret_cast<const uint32_t*>( _memory + RingKeysOffset() );
+  const char* keys = reinterpret_cast<const char*>( key_offsets + _header->max_columns );
+  for(uint32_t i = _keys.size(); i < count; i++)
+  {
+    _keys.push_back( std::string( keys + key_offsets[i] ) );
+  }
+}
+
+inline SharedSampleReader::ReadResult SharedSampleReader::readSlot(uint64_t index, SharedSample &sample)
+{
+  const RingSlot* ring_slot = slot( index );
+  const uint64_t expected = 2*index + 2;
+
+  const uint64_t before = ring_slot->sequence.load( std::memory_order_acquire );
+  if( before != expected ){
+    // already reused for a newer sample (or being written)
+    return READ_OVERWRITTEN;
+  }
+  const uint32_t column_count = std::min( ring_slot->column_count, _header->max_columns );
+  const double* columns = reinterpret_cast<const double*>( ring_slot + 1 );
+
+  sample.index = index;
+  sample.time = ring_slot->time;
+  sample.values.resize( column_count );
+  std::memcpy( sample.values.data(), columns, column_count * sizeof(double) );
+
+  std::atomic_thread_fence( std::memory_order_acquire );
+  const uint64_t after = ring_slot->sequence.load( std::memory_order_relaxed );
+  if( after != expected ){
+    return READ_OVERWRITTEN;
+  }
+  if( column_count > _keys.size() ){
+    // published before the sample: the acquire above makes them visible
+    updateKeys( std::min( _header->column_count.load( std::memory_order_acquire ),
+                          _header->max_columns ) );
+  }
+  return READ_OK;
+}
+
+inline bool SharedSampleReader::next(SharedSample &sample)
+{
+  while( true )
+  {
+    const uint64_t write_index = _header->write_index.load( std::memory_order_acquire );
+    if( _next_index >= write_index ){
+      return false;
+    }
+    if( write_index - _next_index > _capacity )
+    {
+      _lost += write_index - _capacity - _next_index;
+      _next_index = write_index - _capacity;
+    }
+    const uint64_t index = _next_index++;
+    if( readSlot( index, sample ) == READ_OK ){
+      return true;
+    }
+    _lost++;
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_SHARED_SAMPLE_RING_HPP
@@ -0,0 +1,399 @@
+#ifndef ROS_INTROSPECTION_TEST_SHARED_SCHEMA_PARSER_HPP
+#define ROS_INTROSPECTION_TEST_SHARED_SCHEMA_PARSER_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_utils.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/// Memory used by a type registered in a SharedSchemaParser.
+struct TypeMemory
+{
+  std::string identifier;
+  std::string datatype;
+  size_t topics;
+  /// ROSMessage and ROSField of all the types used by this one.
+  size_t messages_bytes;
+  size_t string_tree_nodes;
+  size_t string_tree_bytes;
+  size_t message_tree_nodes;
+  size_t message_tree_bytes;
+
+  size_t totalBytes() const
+  {
+    return messages_bytes + string_tree_bytes + message_tree_bytes;
+  }
+};
+
+/// Memory used by a topic registered in a SharedSchemaParser.
+struct TopicMemory
+{
+  std::string topic;
+  std::string type_identifier;
+  /// memory owned by this topic only.
+  size_t own_bytes;
+  /// memory of the type, divided by the number of topics using it.
+  size_t shared_bytes;
+};
+
+/**
+ * @brief Wrapper of the Parser that registers each type (datatype and MD5 sum)
+ * only once, no matter how many topics use it.
+ *
+ * The schema (ROSMessage list, StringTree and MessageTree) is stored in the
+ * Parser using an identifier of the type, and every topic of that type
+ * references the same immutable entry.
+ *
+ * Note that the root of the StringTree is the identifier of the type:
+ * use applyNameTransform() of this class, that writes keys starting with the
+ * name of the topic, or leafToString().
+ *
+ * The keys of each topic are cached and rebuilt only when the layout of the
+ * message changes. Renaming rules must be registered with registerRenamingRules()
+ * of this class, not with parser().
+ */
+class SharedSchemaParser
+{
+public:
+
+  /**
+   * @brief Register a topic. Returns true if its type was not known yet.
+   * A topic that is registered again with a different type references the new one.
+   */
+  bool registerMessageDefinition(const std::string& topic_name,
+                                 const ROSType& main_type,
+                                 const std::string& definition,
+                                 const std::string& md5sum);
+
+  void registerRenamingRules(const ROSType& type, const std::vector<SubstitutionRule>& rules)
+  {
+    _parser.registerRenamingRules( type, rules );
+    _has_rules = _has_rules || !rules.empty();
+  }
+
+  /// Identifier of the type used by the topic. Throws std::runtime_error if not registered.
+  const std::string& typeIdentifier(const std::string& topic_name) const;
+
+  const ROSMessageInfo* getMessageInfo(const std::string& topic_name) const
+  {
+    return _parser.getMessageInfo( typeIdentifier(topic_name) );
+  }
+
+  bool deserializeIntoFlatContainer(const std::string& topic_name,
+                                    Span<uint8_t> buffer,
+                                    FlatMessage* flat_container_output,
+                                    const uint32_t max_array_size) const
+  {
+    return _parser.deserializeIntoFlatContainer( typeIdentifier(topic_name), buffer,
+                                                 flat_container_output, max_array_size );
+  }
+
+  /**
+   * @brief Same as Parser::applyNameTransform, but the keys start with the name of the topic.
+   *
+   * Without renaming rules, the keys already stored in renamed_value are kept when
+   * it is the output of the previous call, for the same topic and layout: it must
+   * not be modified in between.
+   */
+  void applyNameTransform(const std::string& topic_name,
+                          const FlatMessage& container,
+                          RenamedValues* renamed_value);
+
+  /// Key of the leaf, starting with the name of the topic.
+  void leafToString(const std::string& topic_name, const StringTreeLeaf& leaf,
+                    std::string& output) const;
+
+  size_t topicsCount() const { return _topics.size(); }
+
+  size_t typesCount() const { return _types.size(); }
+
+  std::vector<TypeMemory> typesMemory() const;
+
+  std::vector<TopicMemory> topicsMemory() const;
+
+  Parser& parser() { return _parser; }
+
+  SharedSchemaParser(): _has_rules(false), _last_topic(nullptr), _last_output(nullptr) {}
+
+private:
+
+  struct TopicEntry
+  {
+    std::string identifier;
+    /// layout of the values of the last message (without renaming rules)
+    std::vector<StringTreeLeaf> leaves;
+    /// keys written by the Parser for the last message (with renaming rules)
+    std::vector<std::string> type_keys;
+    /// keys starting with the name of the topic
+    std::vector<std::string> keys;
+  };
+
+  const TopicEntry& topicEntry(const std::string& topic_name) const;
+
+  TopicEntry& topicEntry(const std::string& topic_name)
+  {
+    return const_cast<TopicEntry&>( static_cast<const SharedSchemaParser*>(this)->topicEntry(topic_name) );
+  }
+
+  static void ReplacePrefix(std::string& key, const std::string& prefix,
+                            const std::string& new_prefix);
+
+  TypeMemory computeMemory(const std::string& identifier) const;
+
+  Parser _parser;
+  // key: type identifier, value: number of topics
+  std::unordered_map<std::string, size_t> _types;
+  std::unordered_map<std::string, TopicEntry> _topics;
+  bool _has_rules;
+  // output of the last applyNameTransform()
+  const TopicEntry* _last_topic;
+  const RenamedValues* _last_output;
+};
+
+//---------------------------------------------------------------------------
+
+inline bool SharedSchemaParser::registerMessageDefinition(const std::string &topic_name,
+                                                          const ROSType &main_type,
+                                                          const std::string &definition,
+                                                          const std::string &md5sum)
+{
+  const std::string identifier = main_type.baseName() + "#" + md5sum;
+
+  auto topic_it = _topics.find( topic_name );
+  if( topic_it != _topics.end() )
+  {
+    if( topic_it->second.identifier == identifier ){
+      return false;
+    }
+    _types[ topic_it->second.identifier ]--;
+  }
+
+  auto type_it = _types.find( identifier );
+  const bool new_type = ( type_it == _types.end() );
+  if( new_type )
+  {
+    _parser.registerMessageDefinition( identifier, main_type, definition );
+    type_it = _types.insert( std::make_pair(identifier, 0) ).first;
+  }
+  type_it->second++;
+
+  // the cached keys refer to the previous type
+  TopicEntry& entry = _topics[topic_name];
+  entry = TopicEntry();
+  entry.identifier = identifier;
+  _last_topic = nullptr;
+  return new_type;
+}
+
+inline const SharedSchemaParser::TopicEntry&
+SharedSchemaParser::topicEntry(const std::string &topic_name) const
+{
+  auto it = _topics.find( topic_name );
+  if( it == _topics.end() )
+  {
+    throw std::runtime_error( "SharedSchemaParser: topic not registered: " + topic_name );
+  }
+  return it->second;
+}
+
+inline const std::string &SharedSchemaParser::typeIdentifier(const std::string &topic_name) const
+{
+  return topicEntry( topic_name ).identifier;
+}
+
+inline void SharedSchemaParser::ReplacePrefix(std::string &key,
+                                              const std::string &prefix,
+                                              const std::string &new_prefix)
+{
+  if( key.compare( 0, prefix.size(), prefix ) == 0 )
+  {
+    key.replace( 0, prefix.size(), new_prefix );
+  }
+}
+
+inline void SharedSchemaParser::applyNameTransform(const std::string &topic_name,
+                                                   const FlatMessage &container,
+                                                   RenamedValues *renamed_value)
+{
+  TopicEntry& entry = topicEntry( topic_name );
+  const std::string& identifier = entry.identifier;
+
+  if( _has_rules )
+  {
+    // the keys depend on the names too: compare them with the ones of the Parser
+    _parser.applyNameTransform( identifier, container, renamed_value );
+    entry.type_keys.resize( renamed_value->size() );
+    entry.keys.resize( renamed_value->size() );
+    for(size_t i=0; i < renamed_value->size(); i++)
+    {
+      std::string& key = (*renamed_value)[i].first;
+      if( key != entry.type_keys[i] )
+      {
+        entry.type_keys[i] = key;
+        ReplacePrefix( key, identifier, topic_name );
+        entry.keys[i] = key;
+      }
+      else{
+        key = entry.keys[i];
+      }
+    }
+    _last_topic = nullptr;
+    return;
+  }
+
+  // the keys depend only on the leaves
+  const auto& values = container.value;
+  bool same_layout = ( entry.leaves.size() == values.size() && !values.empty() );
+  for(size_t i=0; same_layout && i < values.size(); i++)
+  {
+    same_layout = IsSameLeaf( entry.leaves[i], values[i].first );
+  }
+  if( !same_layout )
+  {
+    entry.leaves.resize( values.size() );
+    entry.keys.resize( values.size() );
+    for(size_t i=0; i < values.size(); i++)
+    {
+      entry.leaves[i] = values[i].first;
+      entry.keys[i] = values[i].first.toStdString();
+      ReplacePrefix( entry.keys[i], identifier, topic_name );
+    }
+  }
+
+  const bool keys_written = same_layout && _last_topic == &entry &&
+      _last_output == renamed_value && renamed_value->size() == values.size();
+  renamed_value->resize( values.size() );
+  for(size_t i=0; i < values.size(); i++)
+  {
+    if( !keys_written ){
+      (*renamed_value)[i].first = entry.keys[i];
+    }
+    (*renamed_value)[i].second = values[i].second;
+  }
+  _last_topic = &entry;
+  _last_output = renamed_value;
+}
+
+inline void SharedSchemaParser::leafToString(const std::string &topic_name,
+                                             const StringTreeLeaf &leaf,
+                                             std::string &output) const
+{
+  output = leaf.toStdString();
+  ReplacePrefix( output, typeIdentifier( topic_name ), topic_name );
+}
+
+template <typename Node> inline
+void CountTreeNodes(const Node* node, size_t& count)
+{
+  count++;
+  for(const Node& child: node->children())
+  {
+    CountTreeNodes( &child, count );
+  }
+}
+
+inline void StringTreeBytes(const StringTreeNode* node, size_t& bytes)
+{
+  bytes += sizeof(StringTreeNode) + node->value().capacity();
+  for(const StringTreeNode& child: node->children())
+  {
+    StringTreeBytes( &child, bytes );
+  }
+}
+
+inline TypeMemory SharedSchemaParser::computeMemory(const std::string &identifier) const
+{
+  TypeMemory memory;
+  memory.identifier = identifier;
+  memory.topics = 0;
+  auto type_it = _types.find( identifier );
+  if( type_it != _types.end() ){
+    memory.topics = type_it->second;
+  }
+  memory.messages_bytes = 0;
+  memory.string_tree_nodes = 0;
+  memory.string_tree_bytes = 0;
+  memory.message_tree_nodes = 0;
+  memory.message_tree_bytes = 0;
+
+  const ROSMessageInfo* info = _parser.getMessageInfo( identifier );
+  if( !info ){
+    return memory;
+  }
+  memory.datatype = info->type_list.empty() ? std::string() :
+                                              info->type_list.front().type().baseName();
+
+  for(const ROSMessage& msg: info->type_list)
+  {
+    memory.messages_bytes += sizeof(ROSMessage) + msg.type().baseName().size();
+    for(const ROSField& field: msg.fields())
+    {
+      memory.messages_bytes += sizeof(ROSField) + field.name().size() +
+          field.type().baseName().size() + field.value().size();
+    }
+  }
+
+  if( info->string_tree.croot() )
+  {
+    CountTreeNodes( info->string_tree.croot(), memory.string_tree_nodes );
+    StringTreeBytes( info->string_tree.croot(), memory.string_tree_bytes );
+  }
+  if( info->message_tree.croot() )
+  {
+    CountTreeNodes( info->message_tree.croot(), memory.message_tree_nodes );
+    memory.message_tree_bytes = memory.message_tree_nodes * sizeof(MessageTreeNode);
+  }
+  return memory;
+}
+
+inline std::vector<TypeMemory> SharedSchemaParser::typesMemory() const
+{
+  std::vector<TypeMemory> output;
+  output.reserve( _types.size() );
+  for(const auto& it: _types)
+  {
+    // types without topics are still stored in the Parser
+    output.push_back( computeMemory( it.first ) );
+  }
+  return output;
+}
+
+inline std::vector<TopicMemory> SharedSchemaParser::topicsMemory() const
+{
+  std::unordered_map<std::string, size_t> type_bytes;
+  for(const TypeMemory& type: typesMemory())
+  {
+    type_bytes[type.identifier] = type.totalBytes() / std::max<size_t>( type.topics, 1 );
+  }
+
+  std::vector<TopicMemory> output;
+  output.reserve( _topics.size() );
+  for(const auto& it: _topics)
+  {
+    TopicMemory memory;
+    const TopicEntry& entry = it.second;
+    memory.topic = it.first;
+    memory.type_identifier = entry.identifier;
+    // the entry of the map: key, value and node
+    memory.own_bytes = it.first.capacity() + entry.identifier.capacity() +
+        sizeof(std::pair<const std::string, TopicEntry>) + sizeof(void*);
+    // the cached keys
+    memory.own_bytes += entry.leaves.capacity() * sizeof(StringTreeLeaf);
+    for(const std::string& key: entry.type_keys){
+      memory.own_bytes += sizeof(std::string) + key.capacity();
+    }
+    for(const std::string& key: entry.keys){
+      memory.own_bytes += sizeof(std::string) + key.capacity();
+    }
+    memory.shared_bytes = type_bytes[entry.identifier];
+    output.push_back( memory );
+  }
+  return output;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_SHARED_SCHEMA_PARSER_HPP
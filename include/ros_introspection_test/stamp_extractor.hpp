@@ -0,0 +1,218 @@
+#ifndef ROS_INTROSPECTION_TEST_STAMP_EXTRACTOR_HPP
+#define ROS_INTROSPECTION_TEST_STAMP_EXTRACTOR_HPP
+
+#include <ros_introspection_test/message_schema.hpp>
+#include <memory>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Finds the header.stamp of a message type, i.e. the field "stamp" of the
+ * first std_msgs/Header (not in an array) of the main type, or of the main type
+ * itself if it is a std_msgs/Header.
+ *
+ * The position is computed once. When all the fields before the stamp have a fixed
+ * size (the usual case: the header is the first field), extract() is a single read
+ * at a fixed offset; otherwise only the variable-length fields before it are skipped.
+ *
+ * The MessageSchema must outlive the StampLocator.
+ */
+class StampLocator
+{
+public:
+
+  StampLocator(): _schema(nullptr), _found(false), _bytes(0) {}
+
+  explicit StampLocator(const MessageSchema& schema);
+
+  bool hasStamp() const { return _found; }
+
+  /// Offset of the stamp in any message of this type, -1 if it is not fixed (or no stamp).
+  int64_t fixedOffset() const
+  {
+    return ( _found && _walk.empty() ) ? static_cast<int64_t>(_bytes) : -1;
+  }
+
+  /**
+   * @brief Read the stamp. Returns false if the type has no header stamp.
+   * Throws std::runtime_error if the buffer is too short.
+   */
+  bool extract(const Span<uint8_t>& buffer, ros::Time& stamp) const;
+
+private:
+
+  // fields before the stamp: add bytes, then skip the field
+  struct Step
+  {
+    size_t bytes;
+    const SchemaField* field;
+  };
+
+  /// Add the fields of the message that precede field_index to the walk.
+  void addFields(int32_t msg_index, size_t field_index);
+
+  const MessageSchema* _schema;
+  bool _found;
+  std::vector<Step> _walk;
+  // after the walk
+  size_t _bytes;
+};
+
+/**
+ * @brief Header stamps of many topics, extracted directly from the serialized messages,
+ * without deserializing them (see StampLocator).
+ */
+class StampExtractor
+{
+public:
+
+  /**
+   * @brief Compute the position of the stamp of a topic registered in the parser.
+   * Returns true if its type has a header stamp. Throws std::runtime_error if the
+   * topic is not registered in the parser.
+   */
+  bool registerTopic(const Parser& parser, const std::string& topic_name);
+
+  /// Null if the topic was never registered.
+  const StampLocator* locator(const std::string& topic_name) const;
+
+  /**
+   * @brief Returns false if the topic is not registered or its type has no header stamp.
+   * Throws std::runtime_error if the buffer is too short.
+   */
+  bool extractStamp(const std::string& topic_name, const Span<uint8_t>& buffer,
+                    ros::Time& stamp) const
+  {
+    const StampLocator* topic_locator = locator( topic_name );
+    return topic_locator && topic_locator->extract( buffer, stamp );
+  }
+
+private:
+
+  struct TopicState
+  {
+    std::unique_ptr<MessageSchema> schema;
+    StampLocator locator;
+  };
+
+  std::unordered_map<std::string, TopicState> _topics;
+};
+
+//---------------------------------------------------------------------------
+
+inline StampLocator::StampLocator(const MessageSchema &schema):
+  _schema(&schema),
+  _found(false),
+  _bytes(0)
+{
+  if( schema.messages().empty() ){
+    throw std::runtime_error("StampLocator: empty schema");
+  }
+  static const std::string header_type("std_msgs/Header");
+
+  int32_t header_index = -1;
+  if( schema.message(0).datatype == header_type )
+  {
+    header_index = 0;
+  }
+  else{
+    const std::vector<SchemaField>& fields = schema.message(0).fields;
+    for(size_t i=0; i < fields.size(); i++)
+    {
+      if( !fields[i].is_array && fields[i].message_index >= 0 &&
+          schema.message( fields[i].message_index ).datatype == header_type )
+      {
+        addFields( 0, i );
+        header_index = fields[i].message_index;
+        break;
+      }
+    }
+  }
+  if( header_index < 0 ){
+    return;
+  }
+
+  const std::vector<SchemaField>& header_fields = schema.message( header_index ).fields;
+  for(size_t i=0; i < header_fields.size(); i++)
+  {
+    if( header_fields[i].name == "stamp" && header_fields[i].type_id == TIME &&
+        !header_fields[i].is_array )
+    {
+      addFields( header_index, i );
+      _found = true;
+      return;
+    }
+  }
+  // a Header without stamp: not usable
+  _walk.clear();
+  _bytes = 0;
+}
+
+inline void StampLocator::addFields(int32_t msg_index, size_t field_index)
+{
+  const std::vector<SchemaField>& fields = _schema->message( msg_index ).fields;
+  for(size_t i=0; i < field_index; i++)
+  {
+    const SchemaField& field = fields[i];
+    int32_t element_size = field.builtin_size;
+    if( field.message_index >= 0 ){
+      element_size = _schema->message( field.message_index ).fixed_size;
+    }
+    if( element_size >= 0 && field.array_size >= 0 )
+    {
+      _bytes += static_cast<size_t>(element_size) * field.array_size;
+    }
+    else{
+      _walk.push_back( Step{ _bytes, &field } );
+      _bytes = 0;
+    }
+  }
+}
+
+inline bool StampLocator::extract(const Span<uint8_t> &buffer, ros::Time &stamp) const
+{
+  if( !_found ){
+    return false;
+  }
+  size_t offset = 0;
+  for(const Step& step: _walk)
+  {
+    offset = _schema->skipField( *step.field, buffer, offset + step.bytes );
+  }
+  offset += _bytes;
+  if( offset > buffer.size() || buffer.size() - offset < 2*sizeof(uint32_t) ){
+    ThrowBufferOverrun();
+  }
+  uint32_t sec, nsec;
+  std::memcpy( &sec,  buffer.data() + offset, sizeof(uint32_t) );
+  std::memcpy( &nsec, buffer.data() + offset + sizeof(uint32_t), sizeof(uint32_t) );
+  stamp = ros::Time( sec, nsec );
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+inline bool StampExtractor::registerTopic(const Parser &parser, const std::string &topic_name)
+{
+  const ROSMessageInfo* info = parser.getMessageInfo( topic_name );
+  if( !info ){
+    throw std::runtime_error("StampExtractor: topic not registered in the Parser: " + topic_name );
+  }
+  TopicState& state = _topics[topic_name];
+  // the previous locator points to the previous schema
+  state.locator = StampLocator();
+  state.schema.reset( new MessageSchema( *info ) );
+  state.locator = StampLocator( *state.schema );
+  return state.locator.hasStamp();
+}
+
+inline const StampLocator *StampExtractor::locator(const std::string &topic_name) const
+{
+  auto it = _topics.find( topic_name );
+  return ( it == _topics.end() ) ? nullptr : &it->second.locator;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_STAMP_EXTRACTOR_HPP
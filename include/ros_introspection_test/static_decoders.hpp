@@ -0,0 +1,148 @@
+#ifndef ROS_INTROSPECTION_TEST_STATIC_DECODERS_HPP
+#define ROS_INTROSPECTION_TEST_STATIC_DECODERS_HPP
+
+#include <ros_introspection_test/flat_decoder.hpp>
+#include <ros/message_traits.h>
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+#include <nav_msgs/Odometry.h>
+#include <tf2_msgs/TFMessage.h>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Specialized decoder of a message type known at compile time.
+ *
+ * A specialization must provide a static function
+ *
+ *     static void decode(FlatDecoder& decoder);
+ *
+ * that visits the fields in the same order as the serialization.
+ * Register it with AddStaticDecoder<Msg>(registry).
+ */
+template <typename Msg> struct StaticDecoder;
+
+/// The registry is keyed by ros::message_traits::MD5Sum<Msg>.
+template <typename Msg> inline
+void AddStaticDecoder(FlatDecoderRegistry& registry)
+{
+  registry.add( ros::message_traits::MD5Sum<Msg>::value(), &StaticDecoder<Msg>::decode );
+}
+
+/// Decoders of JointState, Imu, Odometry and TFMessage.
+inline void AddDefaultStaticDecoders(FlatDecoderRegistry& registry)
+{
+  AddStaticDecoder<sensor_msgs::JointState>( registry );
+  AddStaticDecoder<sensor_msgs::Imu>( registry );
+  AddStaticDecoder<nav_msgs::Odometry>( registry );
+  AddStaticDecoder<tf2_msgs::TFMessage>( registry );
+}
+
+//---------------------------------------------------------------------------
+
+namespace StaticDecoders{
+
+inline void header(FlatDecoder& d)
+{
+  d.value<uint32_t>();  // seq
+  d.time();             // stamp
+  d.string();           // frame_id
+}
+
+inline void vector3(FlatDecoder& d)
+{
+  d.value<double>();
+  d.value<double>();
+  d.value<double>();
+}
+
+inline void quaternion(FlatDecoder& d)
+{
+  d.value<double>();
+  d.value<double>();
+  d.value<double>();
+  d.value<double>();
+}
+
+inline void pose(FlatDecoder& d)
+{
+  vector3( d );     // position
+  quaternion( d );  // orientation
+}
+
+inline void twist(FlatDecoder& d)
+{
+  vector3( d );     // linear
+  vector3( d );     // angular
+}
+
+inline void doubleArray(FlatDecoder& d)
+{
+  const uint32_t size = d.arrayLength();
+  for(uint32_t i=0; i<size; i++){
+    d.value<double>();
+  }
+}
+
+} // end namespace StaticDecoders
+
+template <> struct StaticDecoder<sensor_msgs::JointState>
+{
+  static void decode(FlatDecoder& d)
+  {
+    StaticDecoders::header( d );
+    const uint32_t names = d.arrayLength();
+    for(uint32_t i=0; i<names; i++){
+      d.string();
+    }
+    StaticDecoders::doubleArray( d );  // position
+    StaticDecoders::doubleArray( d );  // velocity
+    StaticDecoders::doubleArray( d );  // effort
+  }
+};
+
+template <> struct StaticDecoder<sensor_msgs::Imu>
+{
+  static void decode(FlatDecoder& d)
+  {
+    StaticDecoders::header( d );
+    StaticDecoders::quaternion( d );   // orientation
+    d.values<double>( 9 );             // orientation_covariance
+    StaticDecoders::vector3( d );      // angular_velocity
+    d.values<double>( 9 );             // angular_velocity_covariance
+    StaticDecoders::vector3( d );      // linear_acceleration
+    d.values<double>( 9 );             // linear_acceleration_covariance
+  }
+};
+
+template <> struct StaticDecoder<nav_msgs::Odometry>
+{
+  static void decode(FlatDecoder& d)
+  {
+    StaticDecoders::header( d );
+    d.string();                        // child_frame_id
+    StaticDecoders::pose( d );         // pose/pose
+    d.values<double>( 36 );            // pose/covariance
+    StaticDecoders::twist( d );        // twist/twist
+    d.values<double>( 36 );            // twist/covariance
+  }
+};
+
+template <> struct StaticDecoder<tf2_msgs::TFMessage>
+{
+  static void decode(FlatDecoder& d)
+  {
+    const uint32_t transforms = d.arrayLength();
+    for(uint32_t i=0; i<transforms && d.ok(); i++)
+    {
+      StaticDecoders::header( d );
+      d.string();                      // child_frame_id
+      StaticDecoders::vector3( d );    // transform/translation
+      StaticDecoders::quaternion( d ); // transform/rotation
+    }
+  }
+};
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_STATIC_DECODERS_HPP
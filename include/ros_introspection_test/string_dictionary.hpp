@@ -0,0 +1,182 @@
+#ifndef ROS_INTROSPECTION_TEST_STRING_DICTIONARY_HPP
+#define ROS_INTROSPECTION_TEST_STRING_DICTIONARY_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_utils.hpp>
+#include <cstring>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Assigns a small integer code to each distinct string: 0, 1, 2...
+ * Looking up a string that is already known doesn't allocate memory.
+ */
+class StringDictionary
+{
+public:
+
+  StringDictionary() {}
+
+  /// Code of the string, added to the dictionary if it is new.
+  uint32_t encode(const std::string& str);
+
+  const std::string& decode(uint32_t code) const { return *_strings[code]; }
+
+  size_t size() const { return _strings.size(); }
+
+  void clear()
+  {
+    _strings.clear();
+    _codes.clear();
+  }
+
+private:
+
+  std::unordered_map<std::string, uint32_t> _codes;
+  // points to the keys of _codes, that never move
+  std::vector<const std::string*> _strings;
+};
+
+/**
+ * @brief Dictionary encoding of FlatMessage::name, for a single topic.
+ *
+ * update() converts the strings of each message into codes. When a string is
+ * equal to the one at the same position in the previous message (the usual case
+ * for JointState::name or header.frame_id), it is recognized with a memcmp,
+ * without hashing it.
+ *
+ * namesUnchanged() tells in O(1) whether the last message has exactly the same names
+ * (same leaves and same strings) as the previous one. The LinearRenamer uses it to
+ * skip the renaming of the keys.
+ *
+ * The dictionary is cleared when it grows beyond max_dictionary_size,
+ * to bound the memory used by topics where the strings never repeat.
+ */
+class NameEncoder
+{
+public:
+
+  explicit NameEncoder(size_t max_dictionary_size = 65536);
+
+  /// Encode the names of a new message. Returns namesUnchanged().
+  bool update(const FlatMessage& container);
+
+  bool namesUnchanged() const { return _unchanged; }
+
+  /// Incremented every time the names change.
+  uint64_t generation() const { return _generation; }
+
+  /// One code for each element of FlatMessage::name.
+  const std::vector<uint32_t>& codes() const { return _codes; }
+
+  const StringDictionary& dictionary() const { return _dictionary; }
+
+private:
+
+  bool encodeAll(const FlatMessage& container);
+
+  StringDictionary _dictionary;
+  size_t _max_dictionary_size;
+
+  std::vector<StringTreeLeaf> _leaves;
+  std::vector<uint32_t> _codes;
+  std::vector<uint32_t> _previous_codes;
+
+  bool _unchanged;
+  bool _first;
+  uint64_t _generation;
+};
+
+//---------------------------------------------------------------------------
+
+inline uint32_t StringDictionary::encode(const std::string &str)
+{
+  auto it = _codes.find( str );
+  if( it != _codes.end() ){
+    return it->second;
+  }
+  const uint32_t code = static_cast<uint32_t>( _strings.size() );
+  it = _codes.insert( std::make_pair( str, code ) ).first;
+  _strings.push_back( &it->first );
+  return code;
+}
+
+inline NameEncoder::NameEncoder(size_t max_dictionary_size):
+  _max_dictionary_size(max_dictionary_size),
+  _unchanged(false),
+  _first(true),
+  _generation(0)
+{}
+
+inline bool NameEncoder::encodeAll(const FlatMessage &container)
+{
+  const auto& names = container.name;
+  const size_t previous_size = _leaves.size();
+  bool same_layout = ( names.size() == previous_size );
+
+  _codes.resize( names.size() );
+
+  for(size_t i=0; i < names.size(); i++)
+  {
+    const StringTreeLeaf& leaf = names[i].first;
+    const std::string& str = names[i].second;
+
+    if( i < previous_size && IsSameLeaf( _leaves[i], leaf ) )
+    {
+      const std::string& previous = _dictionary.decode( _previous_codes[i] );
+      if( previous.size() == str.size() &&
+          std::memcmp( previous.data(), str.data(), str.size() ) == 0 )
+      {
+        _codes[i] = _previous_codes[i];
+        continue;
+      }
+    }
+    else{
+      same_layout = false;
+      if( i < previous_size ){
+        _leaves[i] = leaf;
+      }
+      else{
+        _leaves.push_back( leaf );
+      }
+    }
+    _codes[i] = _dictionary.encode( str );
+  }
+  _leaves.resize( names.size() );
+
+  if( !same_layout ){
+    return false;
+  }
+  return _codes.empty() ||
+      std::memcmp( _codes.data(), _previous_codes.data(), _codes.size() * sizeof(uint32_t) ) == 0;
+}
+
+inline bool NameEncoder::update(const FlatMessage &container)
+{
+  _previous_codes.swap( _codes );
+  _previous_codes.resize( _leaves.size() );
+
+  bool unchanged = encodeAll( container );
+
+  if( _dictionary.size() > _max_dictionary_size )
+  {
+    // the codes of the previous message are not valid anymore
+    _dictionary.clear();
+    _leaves.clear();
+    _previous_codes.clear();
+    encodeAll( container );
+    unchanged = false;
+  }
+
+  _unchanged = unchanged && !_first;
+  _first = false;
+  if( !_unchanged ){
+    _generation++;
+  }
+  return _unchanged;
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_STRING_DICTIONARY_HPP
@@ -0,0 +1,404 @@
+#ifndef ROS_INTROSPECTION_TEST_TIME_SYNC_JOIN_HPP
+#define ROS_INTROSPECTION_TEST_TIME_SYNC_JOIN_HPP
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace RosIntrospection{
+
+/// Rows produced by the TimeSyncJoin, stored by column.
+struct JoinTable
+{
+  /// timestamp of each row (the one of the reference topic), in seconds.
+  std::vector<double> time;
+  std::vector<std::string> keys;
+  /// one column per key, with the same size as time. NaN when a value is missing.
+  std::vector<std::vector<double>> columns;
+
+  size_t rows() const { return time.size(); }
+};
+
+/**
+ * @brief Joins the messages of several topics by timestamp.
+ *
+ * The first topic added is the reference: each of its messages becomes a row,
+ * that contains its values and the values of the other topics at the same time,
+ * either from the nearest message or interpolated between the messages before and after.
+ * Messages farther than tolerance seconds are not used (their columns are NaN).
+ *
+ * Messages can arrive out of order: they are kept sorted by timestamp in a buffer
+ * per topic. The watermark is the most recent timestamp received minus max_lateness,
+ * and messages that arrive later than the watermark are dropped.
+ * A row at time t is emitted when it can't change anymore: t is older than the
+ * watermark and every other topic has a message between t and the watermark, or t is
+ * farther than tolerance from the watermark. The messages that are not needed anymore
+ * are discarded. Therefore the memory used depends on max_lateness and tolerance (or on
+ * the gaps of the other topics, if tolerance is infinite), not on the length of the bag.
+ */
+class TimeSyncJoin
+{
+public:
+
+  enum Alignment
+  {
+    NEAREST,      ///< values of the message closest in time.
+    INTERPOLATE   ///< linear interpolation, if the two surrounding messages have the same keys.
+  };
+
+  TimeSyncJoin(Alignment alignment, double max_lateness,
+               double tolerance = std::numeric_limits<double>::infinity());
+
+  /// Returns the index of the topic. The first one is the reference.
+  size_t addTopic(const std::string& name);
+
+  /**
+   * @brief Add a message, with its timestamp in seconds.
+   * Returns false if it arrived after the watermark and was dropped.
+   */
+  bool push(size_t topic, double stamp, const RenamedValues& values);
+
+  /**
+   * @brief Same as above, using the value of the key that ends with "/header/stamp".
+   * Throws std::runtime_error if there is no such key.
+   */
+  bool push(size_t topic, const RenamedValues& values);
+
+  /// Emit the rows still pending, regardless of the watermark (end of the data).
+  void flush();
+
+  const JoinTable& output() const { return _table; }
+
+  /// Remove the rows of output(), once they are consumed. The keys are kept.
+  void clearOutput();
+
+  /// Index of a column of output(), -1 if not found.
+  int findKey(const std::string& key) const;
+
+  double watermark() const { return _watermark; }
+
+  /// Messages dropped because older than the watermark.
+  uint64_t lateCount() const { return _late; }
+
+  /// Messages currently stored, waiting for the watermark.
+  size_t bufferedCount() const;
+
+private:
+
+  struct Sample
+  {
+    double stamp;
+    size_t layout;
+    std::vector<double> values;
+  };
+
+  struct Topic
+  {
+    std::string name;
+    std::deque<Sample> samples;
+    // column of each value, for each set of keys received
+    std::vector<std::vector<size_t>> layouts;
+    // position of the header/stamp in the last message
+    size_t stamp_index;
+  };
+
+  size_t findLayout(Topic& topic, const RenamedValues& values);
+
+  size_t addColumn(const std::string& key);
+
+  /// True if no message that can still arrive would change the row at time t.
+  bool rowReady(double t) const;
+
+  void emitRows(bool flush);
+
+  void emitRow(const Sample& reference);
+
+  void writeValues(const Topic& topic, const Sample& sample);
+
+  Alignment _alignment;
+  double _max_lateness;
+  double _tolerance;
+
+  std::vector<Topic> _topics;
+  JoinTable _table;
+  std::unordered_map<std::string, size_t> _key_index;
+
+  double _max_stamp;
+  double _watermark;
+  uint64_t _late;
+};
+
+//---------------------------------------------------------------------------
+
+inline TimeSyncJoin::TimeSyncJoin(Alignment alignment, double max_lateness, double tolerance):
+  _alignment(alignment),
+  _max_lateness(max_lateness),
+  _tolerance(tolerance),
+  _max_stamp( -std::numeric_limits<double>::infinity() ),
+  _watermark( -std::numeric_limits<double>::infinity() ),
+  _late(0)
+{
+  if( !(max_lateness >= 0) || !(tolerance >= 0) ){
+    throw std::runtime_error("TimeSyncJoin: max_lateness and tolerance must be positive");
+  }
+}
+
+inline size_t TimeSyncJoin::addTopic(const std::string &name)
+{
+  Topic topic;
+  topic.name = name;
+  topic.stamp_index = 0;
+  _topics.push_back( std::move(topic) );
+  return _topics.size() - 1;
+}
+
+inline size_t TimeSyncJoin::bufferedCount() const
+{
+  size_t count = 0;
+  for(const Topic& topic: _topics){
+    count += topic.samples.size();
+  }
+  return count;
+}
+
+inline int TimeSyncJoin::findKey(const std::string &key) const
+{
+  auto it = _key_index.find(key);
+  return (it == _key_index.end()) ? -1 : static_cast<int>(it->second);
+}
+
+inline size_t TimeSyncJoin::addColumn(const std::string &key)
+{
+  auto it = _key_index.find(key);
+  if( it != _key_index.end() ){
+    return it->second;
+  }
+  const size_t column = _table.keys.size();
+  _table.keys.push_back( key );
+  _key_index.insert( std::make_pair(key, column) );
+  // the rows already emitted don't have this key
+  _table.columns.push_back( std::vector<double>( _table.rows(),
+                                                 std::numeric_limits<double>::quiet_NaN() ) );
+  return column;
+}
+
+inline size_t TimeSyncJoin::findLayout(Topic &topic, const RenamedValues &values)
+{
+  // usually the keys are the same of the previous message: start from the last layout
+  for(size_t l = topic.layouts.size(); l-- > 0; )
+  {
+    const std::vector<size_t>& layout = topic.layouts[l];
+    bool same_layout = ( layout.size() == values.size() );
+    for(size_t i=0; same_layout && i < values.size(); i++)
+    {
+      same_layout = ( _table.keys[ layout[i] ] == values[i].first );
+    }
+    if( same_layout ){
+      return l;
+    }
+  }
+  std::vector<size_t> layout( values.size() );
+  for(size_t i=0; i < values.size(); i++){
+    layout[i] = addColumn( values[i].first );
+  }
+  topic.layouts.push_back( std::move(layout) );
+  return topic.layouts.size() - 1;
+}
+
+inline bool TimeSyncJoin::push(size_t topic_index, double stamp, const RenamedValues &values)
+{
+  if( stamp < _watermark )
+  {
+    _late++;
+    return false;
+  }
+  Topic& topic = _topics.at( topic_index );
+
+  Sample sample;
+  sample.stamp = stamp;
+  sample.layout = findLayout( topic, values );
+  sample.values.resize( values.size() );
+  for(size_t i=0; i < values.size(); i++){
+    sample.values[i] = values[i].second.convert<double>();
+  }
+
+  // sorted by timestamp: out of order messages are usually close to the end
+  auto position = topic.samples.end();
+  while( position != topic.samples.begin() && std::prev(position)->stamp > stamp ){
+    --position;
+  }
+  topic.samples.insert( position, std::move(sample) );
+
+  if( stamp > _max_stamp )
+  {
+    _max_stamp = stamp;
+    const double watermark = _max_stamp - _max_lateness;
+    if( watermark > _watermark )
+    {
+      _watermark = watermark;
+      emitRows( false );
+    }
+  }
+  return true;
+}
+
+inline bool TimeSyncJoin::push(size_t topic_index, const RenamedValues &values)
+{
+  static const std::string suffix("/header/stamp");
+  Topic& topic = _topics.at( topic_index );
+
+  auto IsStamp = [&values](size_t index) -> bool
+  {
+    const std::string& key = values[index].first;
+    return key.size() >= suffix.size() &&
+        key.compare( key.size() - suffix.size(), suffix.size(), suffix ) == 0;
+  };
+
+  // the stamp is usually at the same position of the previous message
+  if( topic.stamp_index >= values.size() || !IsStamp( topic.stamp_index ) )
+  {
+    size_t index = 0;
+    while( index < values.size() && !IsStamp( index ) ){
+      index++;
+    }
+    if( index == values.size() ){
+      throw std::runtime_error("TimeSyncJoin: no header/stamp in a message of " + topic.name );
+    }
+    topic.stamp_index = index;
+  }
+  return push( topic_index, values[topic.stamp_index].second.convert<double>(), values );
+}
+
+inline void TimeSyncJoin::flush()
+{
+  emitRows( true );
+  // rows are emitted in order: messages older than the last one are now late
+  _watermark = std::max( _watermark, _max_stamp );
+}
+
+inline void TimeSyncJoin::clearOutput()
+{
+  _table.time.clear();
+  for(std::vector<double>& column: _table.columns){
+    column.clear();
+  }
+}
+
+inline bool TimeSyncJoin::rowReady(double t) const
+{
+  if( t > _watermark ){
+    return false;
+  }
+  // messages received from now on are newer than the watermark
+  if( t + _tolerance < _watermark ){
+    return true;
+  }
+  for(size_t topic_index=1; topic_index < _topics.size(); topic_index++)
+  {
+    const std::deque<Sample>& samples = _topics[topic_index].samples;
+    auto after = std::lower_bound( samples.begin(), samples.end(), t,
+                                   [](const Sample& sample, double stamp)
+    {
+      return sample.stamp < stamp;
+    });
+    if( after == samples.end() || after->stamp > _watermark ){
+      return false;
+    }
+  }
+  return true;
+}
+
+inline void TimeSyncJoin::emitRows(bool flush)
+{
+  if( _topics.empty() ){
+    return;
+  }
+  std::deque<Sample>& reference = _topics.front().samples;
+  while( !reference.empty() && ( flush || rowReady( reference.front().stamp ) ) )
+  {
+    emitRow( reference.front() );
+    reference.pop_front();
+  }
+
+  // the next rows are not older than limit: of the messages before it,
+  // only the last one can still be used
+  double limit = flush ? std::numeric_limits<double>::infinity() : _watermark;
+  if( !reference.empty() ){
+    limit = std::min( limit, reference.front().stamp );
+  }
+  for(size_t t=1; t < _topics.size(); t++)
+  {
+    std::deque<Sample>& samples = _topics[t].samples;
+    while( samples.size() >= 2 && samples[1].stamp <= limit ){
+      samples.pop_front();
+    }
+  }
+}
+
+inline void TimeSyncJoin::writeValues(const Topic &topic, const Sample &sample)
+{
+  const std::vector<size_t>& layout = topic.layouts[ sample.layout ];
+  for(size_t i=0; i < layout.size(); i++)
+  {
+    _table.columns[ layout[i] ].back() = sample.values[i];
+  }
+}
+
+inline void TimeSyncJoin::emitRow(const Sample &reference)
+{
+  const double t = reference.stamp;
+  _table.time.push_back( t );
+  for(std::vector<double>& column: _table.columns){
+    column.push_back( std::numeric_limits<double>::quiet_NaN() );
+  }
+  writeValues( _topics.front(), reference );
+
+  for(size_t topic_index=1; topic_index < _topics.size(); topic_index++)
+  {
+    const Topic& topic = _topics[topic_index];
+    const std::deque<Sample>& samples = topic.samples;
+
+    auto after_it = std::lower_bound( samples.begin(), samples.end(), t,
+                                      [](const Sample& sample, double stamp)
+    {
+      return sample.stamp < stamp;
+    });
+    const Sample* after  = ( after_it != samples.end() ) ? &(*after_it) : nullptr;
+    const Sample* before = ( after_it != samples.begin() ) ? &(*std::prev(after_it)) : nullptr;
+
+    if( after && after->stamp - t > _tolerance ){
+      after = nullptr;
+    }
+    if( before && t - before->stamp > _tolerance ){
+      before = nullptr;
+    }
+
+    if( _alignment == INTERPOLATE && before && after &&
+        before->layout == after->layout && after->stamp > before->stamp )
+    {
+      const double ratio = (t - before->stamp) / (after->stamp - before->stamp);
+      const std::vector<size_t>& layout = topic.layouts[ after->layout ];
+      for(size_t i=0; i < layout.size(); i++)
+      {
+        const double value = before->values[i] + (after->values[i] - before->values[i]) * ratio;
+        _table.columns[ layout[i] ].back() = value;
+      }
+    }
+    else if( before || after )
+    {
+      const Sample* nearest = before;
+      if( !before || ( after && after->stamp - t < t - before->stamp ) ){
+        nearest = after;
+      }
+      writeValues( topic, *nearest );
+    }
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_TIME_SYNC_JOIN_HPP
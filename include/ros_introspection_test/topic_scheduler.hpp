@@ -0,0 +1,502 @@
+#ifndef ROS_INTROSPECTION_TEST_TOPIC_SCHEDULER_HPP
+#define ROS_INTROSPECTION_TEST_TOPIC_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RosIntrospection{
+
+/**
+ * @brief Lock-free, bounded, multi-producer multi-consumer queue
+ * (D. Vyukov's algorithm). The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(size_t capacity);
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /// On success, value is moved into the queue. On failure (full) it is left untouched.
+  bool tryPush(T& value);
+
+  bool tryPop(T& value);
+
+  /// Approximate, when other threads are pushing or popping.
+  bool empty() const;
+
+  size_t capacity() const { return _mask + 1; }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> _cells;
+  size_t _mask;
+  // padding: producers and consumers should not share the same cache line
+  char _pad0[64];
+  std::atomic<size_t> _enqueue_pos;
+  char _pad1[64];
+  std::atomic<size_t> _dequeue_pos;
+};
+
+/**
+ * @brief The TopicScheduler decouples the reception of messages (push) from
+ * their processing, that is done by a pool of worker threads.
+ *
+ * - Each topic has its own lock-free bounded queue and overflow policy.
+ * - A topic is processed by a single worker at a time, therefore the
+ *   order of the messages of a topic is preserved.
+ * - Topics with pending messages are distributed in the per-worker ready lists;
+ *   idle workers steal from the others. A worker processes at most
+ *   "batch_size" messages of a topic before moving to the next one, so that
+ *   a high-rate topic can't starve the others.
+ */
+template <typename Item>
+class TopicScheduler
+{
+public:
+
+  enum OverflowPolicy
+  {
+    DROP_NEWEST,  ///< the message being pushed is discarded.
+    DROP_OLDEST,  ///< the oldest message in the queue is discarded.
+    BLOCK         ///< push() waits until there is space (backpressure on the producer).
+  };
+
+  typedef size_t TopicHandle;
+  typedef std::function<void(TopicHandle, Item&)> Handler;
+
+  struct TopicStats
+  {
+    uint64_t enqueued;
+    uint64_t dropped;
+    uint64_t processed;
+  };
+
+  TopicScheduler(size_t num_threads, const Handler& handler, size_t batch_size = 16);
+
+  ~TopicScheduler();
+
+  /// Not thread-safe: add all the topics before calling start().
+  TopicHandle addTopic(size_t queue_capacity, OverflowPolicy policy);
+
+  void start();
+
+  /// Stop the workers. The messages still in the queues are not processed.
+  void stop();
+
+  /// Returns false if the item was dropped.
+  bool push(TopicHandle topic, Item item);
+
+  TopicStats stats(TopicHandle topic) const;
+
+  /// Block until all the queues are empty and no topic is being processed.
+  /// Returns immediately if the scheduler is not running: after stop(), or
+  /// before start(), the items left in the queues are never processed.
+  void waitIdle() const;
+
+  size_t topicsCount() const { return _topics.size(); }
+
+private:
+
+  struct Topic
+  {
+    Topic(size_t capacity, OverflowPolicy overflow_policy):
+      queue(capacity), policy(overflow_policy),
+      scheduled(false), enqueued(0), dropped(0), processed(0) {}
+
+    BoundedQueue<Item> queue;
+    OverflowPolicy policy;
+    std::atomic<bool> scheduled;
+    std::atomic<uint64_t> enqueued;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> processed;
+  };
+
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<TopicHandle> ready;
+    std::thread thread;
+  };
+
+  void schedule(TopicHandle topic);
+
+  bool popReady(size_t worker_index, TopicHandle& topic);
+
+  void run(TopicHandle topic);
+
+  void workerLoop(size_t worker_index);
+
+  struct WorkerIdentity
+  {
+    const TopicScheduler* scheduler;
+    int index;
+  };
+
+  /// identifies the worker threads, to let them keep the topics they reschedule.
+  static WorkerIdentity& currentWorker();
+
+  Handler _handler;
+  size_t _batch_size;
+  size_t _num_threads;
+
+  std::vector<std::unique_ptr<Topic>> _topics;
+  std::vector<std::unique_ptr<Worker>> _workers;
+
+  std::atomic<bool> _running;
+  // number of topics in the ready lists, updated together with the list,
+  // under the mutex of its Worker
+  std::atomic<size_t> _ready_count;
+  std::atomic<size_t> _next_worker;
+  std::atomic<size_t> _busy_count;
+
+  std::mutex _idle_mutex;
+  std::condition_variable _idle_cv;
+};
+
+//---------------------------------------------------------------------------
+
+template <typename T> inline
+BoundedQueue<T>::BoundedQueue(size_t capacity)
+{
+  size_t size = 2;
+  while( size < capacity ){
+    size *= 2;
+  }
+  _mask = size - 1;
+  _cells.reset( new Cell[size] );
+  for(size_t i=0; i<size; i++){
+    _cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  _enqueue_pos.store(0, std::memory_order_relaxed);
+  _dequeue_pos.store(0, std::memory_order_relaxed);
+}
+
+template <typename T> inline
+bool BoundedQueue<T>::tryPush(T& value)
+{
+  Cell* cell;
+  size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+  while( true )
+  {
+    cell = &_cells[pos & _mask];
+    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if( diff == 0 )
+    {
+      if( _enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ){
+        break;
+      }
+    }
+    else if( diff < 0 ){
+      return false; // full
+    }
+    else{
+      pos = _enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = std::move(value);
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T> inline
+bool BoundedQueue<T>::tryPop(T& value)
+{
+  Cell* cell;
+  size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+  while( true )
+  {
+    cell = &_cells[pos & _mask];
+    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+    if( diff == 0 )
+    {
+      if( _dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ){
+        break;
+      }
+    }
+    else if( diff < 0 ){
+      return false; // empty
+    }
+    else{
+      pos = _dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  value = std::move(cell->data);
+  cell->data = T(); // release resources (shared_ptr) as soon as possible
+  cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T> inline
+bool BoundedQueue<T>::empty() const
+{
+  return _enqueue_pos.load(std::memory_order_acquire) ==
+      _dequeue_pos.load(std::memory_order_acquire);
+}
+
+//---------------------------------------------------------------------------
+
+template <typename Item> inline
+TopicScheduler<Item>::TopicScheduler(size_t num_threads, const Handler& handler, size_t batch_size):
+  _handler(handler),
+  _batch_size( batch_size > 0 ? batch_size : 1 ),
+  _num_threads( num_threads > 0 ? num_threads : 1 ),
+  _running(false),
+  _ready_count(0),
+  _next_worker(0),
+  _busy_count(0)
+{
+  for(size_t i=0; i<_num_threads; i++){
+    _workers.push_back( std::unique_ptr<Worker>( new Worker ) );
+  }
+}
+
+template <typename Item> inline
+TopicScheduler<Item>::~TopicScheduler()
+{
+  stop();
+}
+
+template <typename Item> inline
+typename TopicScheduler<Item>::TopicHandle
+TopicScheduler<Item>::addTopic(size_t queue_capacity, OverflowPolicy policy)
+{
+  _topics.push_back( std::unique_ptr<Topic>( new Topic(queue_capacity, policy) ) );
+  return _topics.size() - 1;
+}
+
+template <typename Item> inline
+void TopicScheduler<Item>::start()
+{
+  if( _running.exchange(true) ){
+    return;
+  }
+  for(size_t i=0; i<_workers.size(); i++)
+  {
+    _workers[i]->thread = std::thread( &TopicScheduler::workerLoop, this, i );
+  }
+}
+
+template <typename Item> inline
+void TopicScheduler<Item>::stop()
+{
+  if( !_running.exchange(false) ){
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_idle_mutex);
+  }
+  _idle_cv.notify_all();
+  for(auto& worker: _workers)
+  {
+    if( worker->thread.joinable() ){
+      worker->thread.join();
+    }
+  }
+}
+
+template <typename Item> inline
+typename TopicScheduler<Item>::WorkerIdentity& TopicScheduler<Item>::currentWorker()
+{
+  static thread_local WorkerIdentity identity = { nullptr, -1 };
+  return identity;
+}
+
+template <typename Item> inline
+bool TopicScheduler<Item>::push(TopicHandle topic_handle, Item item)
+{
+  Topic& topic = *_topics[topic_handle];
+
+  if( !topic.queue.tryPush(item) )
+  {
+    switch( topic.policy )
+    {
+    case DROP_NEWEST:
+    {
+      topic.dropped++;
+      return false;
+    }
+    case DROP_OLDEST:
+    {
+      Item oldest;
+      do{
+        if( topic.queue.tryPop(oldest) ){
+          topic.dropped++;
+        }
+      } while( !topic.queue.tryPush(item) );
+    } break;
+
+    case BLOCK:
+    {
+      while( !topic.queue.tryPush(item) )
+      {
+        if( !_running ){
+          topic.dropped++;
+          return false;
+        }
+        std::this_thread::yield();
+      }
+    } break;
+    }
+  }
+  topic.enqueued++;
+
+  // pairs with the fence in run(): either the worker sees this item,
+  // or we see scheduled == false
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  schedule( topic_handle );
+  return true;
+}
+
+template <typename Item> inline
+void TopicScheduler<Item>::schedule(TopicHandle topic_handle)
+{
+  Topic& topic = *_topics[topic_handle];
+  if( topic.scheduled.exchange(true) ){
+    return; // already in a ready list or being processed
+  }
+
+  // workers keep their own topics, the other threads use round-robin
+  const WorkerIdentity& identity = currentWorker();
+  int worker_index = (identity.scheduler == this) ? identity.index : -1;
+  if( worker_index < 0 ){
+    worker_index = static_cast<int>( _next_worker++ % _workers.size() );
+  }
+
+  Worker& worker = *_workers[worker_index];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.ready.push_back( topic_handle );
+    _ready_count++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_idle_mutex);
+  }
+  _idle_cv.notify_one();
+}
+
+template <typename Item> inline
+bool TopicScheduler<Item>::popReady(size_t worker_index, TopicHandle& topic_handle)
+{
+  // own list first (oldest first, to be fair among topics)...
+  {
+    Worker& worker = *_workers[worker_index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if( !worker.ready.empty() )
+    {
+      topic_handle = worker.ready.front();
+      worker.ready.pop_front();
+      _ready_count--;
+      return true;
+    }
+  }
+  // ...then steal from the others
+  for(size_t i=1; i<_workers.size(); i++)
+  {
+    Worker& victim = *_workers[ (worker_index + i) % _workers.size() ];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if( !victim.ready.empty() )
+    {
+      topic_handle = victim.ready.back();
+      victim.ready.pop_back();
+      _ready_count--;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Item> inline
+void TopicScheduler<Item>::run(TopicHandle topic_handle)
+{
+  Topic& topic = *_topics[topic_handle];
+  Item item;
+  size_t count = 0;
+  while( count < _batch_size && topic.queue.tryPop(item) )
+  {
+    _handler( topic_handle, item );
+    item = Item();
+    topic.processed++;
+    count++;
+  }
+
+  topic.scheduled.store(false);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if( !topic.queue.empty() ){
+    schedule( topic_handle );
+  }
+}
+
+template <typename Item> inline
+void TopicScheduler<Item>::workerLoop(size_t worker_index)
+{
+  currentWorker().scheduler = this;
+  currentWorker().index = static_cast<int>(worker_index);
+
+  while( _running )
+  {
+    TopicHandle topic_handle;
+    if( popReady(worker_index, topic_handle) )
+    {
+      _busy_count++;
+      run( topic_handle );
+      _busy_count--;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_idle_mutex);
+    _idle_cv.wait_for( lock, std::chrono::milliseconds(50), [this]()
+    {
+      return !_running || _ready_count > 0;
+    });
+  }
+}
+
+template <typename Item> inline
+typename TopicScheduler<Item>::TopicStats TopicScheduler<Item>::stats(TopicHandle topic_handle) const
+{
+  const Topic& topic = *_topics[topic_handle];
+  TopicStats stats;
+  stats.enqueued  = topic.enqueued;
+  stats.dropped   = topic.dropped;
+  stats.processed = topic.processed;
+  return stats;
+}
+
+template <typename Item> inline
+void TopicScheduler<Item>::waitIdle() const
+{
+  while( _running )
+  {
+    bool idle = (_ready_count == 0 && _busy_count == 0);
+    for(size_t i=0; idle && i<_topics.size(); i++)
+    {
+      idle = _topics[i]->queue.empty() && !_topics[i]->scheduled;
+    }
+    if( idle ){
+      return;
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+  }
+}
+
+} // end namespace
+
+#endif // ROS_INTROSPECTION_TEST_TOPIC_SCHEDULER_HPP
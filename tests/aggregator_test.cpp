@@ -0,0 +1,122 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/leaf_aggregator.hpp>
+#include <sensor_msgs/JointState.h>
+#include <algorithm>
+#include <limits>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(LeafAggregator, JointState)
+{
+  RosIntrospection::Parser parser;
+  parser.registerMessageDefinition("JointState",
+                                   ROSType(DataType<sensor_msgs::JointState>::value()),
+                                   Definition<sensor_msgs::JointState>::value());
+  FlatMessage flat_container;
+  LeafAggregator aggregator;
+
+  std::vector<double> efforts;
+  std::vector<uint8_t> buffer;
+
+  for (int i=0; i<1000; i++)
+  {
+    sensor_msgs::JointState joint_state;
+    joint_state.name.push_back("joint");
+    joint_state.position.push_back( i );
+    joint_state.velocity.push_back( -0.5 * i );
+    // a deterministic, non monotonic sequence
+    joint_state.effort.push_back( (i * 37) % 101 + 0.5 );
+    efforts.push_back( joint_state.effort.back() );
+
+    buffer = Serialize( joint_state );
+
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    aggregator.update( flat_container );
+  }
+
+  EXPECT_EQ( aggregator.messagesCount(), 1000 );
+
+  const int position = aggregator.findKey("JointState/position.0");
+  const int velocity = aggregator.findKey("JointState/velocity.0");
+  const int effort   = aggregator.findKey("JointState/effort.0");
+  ASSERT_GE( position, 0 );
+  ASSERT_GE( velocity, 0 );
+  ASSERT_GE( effort, 0 );
+  EXPECT_EQ( aggregator.findKey("JointState/position.1"), -1 );
+
+  EXPECT_EQ( aggregator.count(position), 1000 );
+  EXPECT_EQ( aggregator.min(position), 0 );
+  EXPECT_EQ( aggregator.max(position), 999 );
+  EXPECT_DOUBLE_EQ( aggregator.mean(position), 499.5 );
+  // variance of 0..n-1 is n(n+1)/12
+  EXPECT_NEAR( aggregator.variance(position), 1000.0 * 1001.0 / 12.0, 1e-6 );
+
+  EXPECT_EQ( aggregator.min(velocity), -499.5 );
+  EXPECT_NEAR( aggregator.quantile(velocity, 0.5), -250, 250 * 0.02 );
+
+  std::sort( efforts.begin(), efforts.end() );
+  for (double q: {0.1, 0.5, 0.9})
+  {
+    const double exact = efforts[ static_cast<size_t>( q * 999 ) ];
+    EXPECT_NEAR( aggregator.quantile(effort, q), exact, exact * 0.02 );
+  }
+
+  // a new time window
+  aggregator.reset();
+  EXPECT_EQ( aggregator.count(position), 0 );
+  EXPECT_TRUE( std::isnan( aggregator.mean(position) ) );
+  EXPECT_EQ( aggregator.size(), 3 );
+
+  // NaN and infinite values are not counted
+  const double values[] = { std::numeric_limits<double>::infinity(), 5.0,
+                            -std::numeric_limits<double>::infinity(),
+                            std::numeric_limits<double>::quiet_NaN(), 7.0 };
+  for (double value: values)
+  {
+    sensor_msgs::JointState joint_state;
+    joint_state.name.push_back("joint");
+    joint_state.position.push_back( value );
+    joint_state.velocity.push_back( value );
+    joint_state.effort.push_back( value );
+    buffer = Serialize( joint_state );
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    aggregator.update( flat_container );
+  }
+  EXPECT_EQ( aggregator.count(position), 2 );
+  EXPECT_EQ( aggregator.min(position), 5 );
+  EXPECT_EQ( aggregator.max(position), 7 );
+  EXPECT_DOUBLE_EQ( aggregator.mean(position), 6 );
+  EXPECT_DOUBLE_EQ( aggregator.variance(position), 2 );
+  EXPECT_GE( aggregator.quantile(position, 1.0), 5 );
+  EXPECT_LE( aggregator.quantile(position, 1.0), 7 * 1.02 );
+}
+
+TEST(LeafAggregator, QuantileSketch)
+{
+  QuantileSketch sketch( 0.01, 64 );
+  EXPECT_TRUE( std::isnan( sketch.quantile(0.5) ) );
+
+  for (int i=-500; i<=1000; i++)
+  {
+    sketch.add( i );
+  }
+  EXPECT_EQ( sketch.count(), 1501 );
+  EXPECT_EQ( sketch.quantile(500.0 / 1500.0), 0.0 );
+
+  // not counted
+  sketch.add( std::numeric_limits<double>::quiet_NaN() );
+  sketch.add( std::numeric_limits<double>::infinity() );
+  sketch.add( -std::numeric_limits<double>::infinity() );
+  EXPECT_EQ( sketch.count(), 1501 );
+
+  // with only 64 buckets, the large values keep their accuracy
+  EXPECT_NEAR( sketch.quantile(0.9), 850, 17 );
+  EXPECT_NEAR( sketch.quantile(1.0), 1000, 20 );
+  EXPECT_NEAR( sketch.quantile(0.99), 985, 20 );
+  EXPECT_NEAR( sketch.quantile(0.0), -500, 10 );
+}
@@ -5,10 +5,16 @@
 #include <boost/utility/string_ref.hpp>
 #include <geometry_msgs/Pose.h>
 #include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+#include <tf2_msgs/TFMessage.h>
 #include <sstream>
 #include <iostream>
 #include <chrono>
+#include <thread>
 #include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/linear_renamer.hpp>
+#include <ros_introspection_test/sharded_parser.hpp>
+#include "test_helpers.hpp"
 
 
 #include <benchmark/benchmark.h>
@@ -18,25 +24,6 @@ using namespace ros::message_traits;
 using namespace RosIntrospection;
 
 
-static std::vector<SubstitutionRule> Rules()
-{
-  std::vector<SubstitutionRule> rules;
-
-
-    rules.push_back( SubstitutionRule( "transforms.#.transform",
-                                       "transforms.#.header.frame_id",
-                                       "transforms.#" ));
-
-    rules.push_back( SubstitutionRule( "transforms.#.header",
-                                       "transforms.#.header.frame_id",
-                                       "transforms.#.header" ));
-
-  rules.push_back( SubstitutionRule( "position.#", "name.#", "@.position" ));
-  rules.push_back( SubstitutionRule( "velocity.#", "name.#", "@.velocity" ));
-  rules.push_back( SubstitutionRule( "effort.#",   "name.#", "@.effort"   ));
-  return rules;
-}
-
 
 static void BM_Joints(benchmark::State& state)
 {
@@ -49,7 +36,7 @@ static void BM_Joints(benchmark::State& state)
         main_type,
         Definition<sensor_msgs::JointState>::value());
 
-  parser.registerRenamingRules( main_type, Rules() );
+  parser.registerRenamingRules( main_type, RenamingRules() );
 
   sensor_msgs::JointState js_msg;
 
@@ -88,5 +75,142 @@ static void BM_Joints(benchmark::State& state)
 
 BENCHMARK(BM_Joints);
 
+static void BM_TF_Parser(benchmark::State& state)
+{
+  RosIntrospection::Parser parser;
+  ROSType main_type(DataType<tf2_msgs::TFMessage>::value());
+
+  parser.registerMessageDefinition("tf", main_type,
+                                   Definition<tf2_msgs::TFMessage>::value());
+  parser.registerRenamingRules( main_type, RenamingRules() );
+
+  std::vector<uint8_t> buffer = SerializedTF( state.range(0) );
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+
+  while (state.KeepRunning())
+  {
+    parser.deserializeIntoFlatContainer("tf",  Span<uint8_t>(buffer),  &flat_container, 1000);
+    parser.applyNameTransform("tf", flat_container, &renamed_values );
+  }
+}
+
+static void BM_TF_LinearRenamer(benchmark::State& state)
+{
+  RosIntrospection::Parser parser;
+  parser.registerMessageDefinition("tf", ROSType(DataType<tf2_msgs::TFMessage>::value()),
+                                   Definition<tf2_msgs::TFMessage>::value());
+  // same rules as BM_TF_Parser
+  LinearRenamer renamer;
+  for (const auto& rule: RENAMING_RULES)
+  {
+    renamer.addRule( rule[0], rule[1], rule[2] );
+  }
+
+  std::vector<uint8_t> buffer = SerializedTF( state.range(0) );
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+
+  while (state.KeepRunning())
+  {
+    parser.deserializeIntoFlatContainer("tf",  Span<uint8_t>(buffer),  &flat_container, 1000);
+    renamer.apply( flat_container, &renamed_values );
+  }
+}
+
+// 64 topics: JointState, TFMessage and Imu. range(0) is the number of shards,
+// range(1) the number of threads calling push(). Each iteration pushes a batch
+// of messages and waits until all of them reached the handler.
+static void BM_ShardedParser(benchmark::State& state)
+{
+  const size_t num_topics = 64;
+  const size_t rounds = 16;
+  const size_t num_producers = state.range(1);
+  ShardedParser sharded( state.range(0), true );
+
+  const ROSType joint_type( DataType<sensor_msgs::JointState>::value() );
+  const ROSType tf_type( DataType<tf2_msgs::TFMessage>::value() );
+  const ROSType imu_type( DataType<sensor_msgs::Imu>::value() );
+
+  sensor_msgs::JointState js_msg;
+  for (int i=0; i<6; i++)
+  {
+    js_msg.name.push_back( std::string("joint_").append( std::to_string(i) ) );
+    js_msg.position.push_back( i );
+    js_msg.velocity.push_back( i );
+    js_msg.effort.push_back( i );
+  }
+  std::vector<uint8_t> js_buffer = Serialize( js_msg );
+  std::vector<uint8_t> imu_buffer = Serialize( sensor_msgs::Imu() );
+
+  std::vector<uint8_t> tf_buffer = SerializedTF( 10 );
+
+  std::vector<std::string> topics;
+  std::vector<std::vector<uint8_t>*> buffers;
+  for (size_t i=0; i<num_topics; i++)
+  {
+    topics.push_back( std::string("/topic_").append( std::to_string(i) ) );
+    switch( i % 3 )
+    {
+    case 0:
+      sharded.registerMessageDefinition( topics.back(), joint_type,
+                                         Definition<sensor_msgs::JointState>::value() );
+      buffers.push_back( &js_buffer );
+      break;
+    case 1:
+      sharded.registerMessageDefinition( topics.back(), tf_type,
+                                         Definition<tf2_msgs::TFMessage>::value() );
+      buffers.push_back( &tf_buffer );
+      break;
+    default:
+      sharded.registerMessageDefinition( topics.back(), imu_type,
+                                         Definition<sensor_msgs::Imu>::value() );
+      buffers.push_back( &imu_buffer );
+    }
+  }
+  sharded.registerRenamingRules( joint_type, RenamingRules() );
+  sharded.registerRenamingRules( tf_type, RenamingRules() );
+
+  size_t values = 0;
+  sharded.start( [&values](const ShardedResult& result)
+  {
+    values += result.renamed->size();
+  });
+
+  while (state.KeepRunning())
+  {
+    std::vector<std::thread> producers;
+    for (size_t p=0; p<num_producers; p++)
+    {
+      // each producer pushes the messages of its own topics
+      producers.push_back( std::thread( [&, p]()
+      {
+        for (size_t r=0; r<rounds; r++)
+        {
+          for (size_t i=p; i<num_topics; i += num_producers)
+          {
+            sharded.push( topics[i], Span<uint8_t>( *buffers[i] ) );
+          }
+        }
+      }));
+    }
+    for (std::thread& producer: producers)
+    {
+      producer.join();
+    }
+    sharded.flush();
+  }
+  sharded.stop();
+
+  state.SetItemsProcessed( state.iterations() * num_topics * rounds );
+  benchmark::DoNotOptimize( values );
+}
+
+BENCHMARK(BM_TF_Parser)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Arg(300)->Arg(500);
+BENCHMARK(BM_TF_LinearRenamer)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Arg(300)->Arg(500);
+BENCHMARK(BM_ShardedParser)->RangeMultiplier(2)->Ranges({{1, 64}, {1, 8}})->UseRealTime();
+
 BENCHMARK_MAIN();
 
@@ -0,0 +1,95 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/message_corpus.hpp>
+#include <fstream>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(MessageCorpus, SaveAndLoad)
+{
+  TemporaryDirectory directory;
+  const std::string filename = directory.path( "test.corpus" );
+
+  MessageCorpus corpus;
+  CorpusTopic joints;
+  joints.name       = "/joint_states";
+  joints.datatype   = DataType<sensor_msgs::JointState>::value();
+  joints.md5sum     = MD5Sum<sensor_msgs::JointState>::value();
+  joints.definition = Definition<sensor_msgs::JointState>::value();
+  CorpusTopic empty;
+  empty.name = "/empty";
+
+  EXPECT_EQ( corpus.addTopic( joints ), 0 );
+  EXPECT_EQ( corpus.addTopic( empty ), 1 );
+  EXPECT_EQ( corpus.addTopic( joints ), 0 );
+  EXPECT_THROW( corpus.addMessage( 2, ros::Time(1), Span<uint8_t>() ), std::runtime_error );
+
+  std::vector<std::vector<uint8_t>> buffers;
+  for (int i=0; i<50; i++)
+  {
+    sensor_msgs::JointState joint_state;
+    joint_state.header.seq = i;
+    joint_state.name.resize( i, "joint" );
+    joint_state.position.resize( i, i );
+    std::vector<uint8_t> buffer = Serialize( joint_state );
+
+    corpus.addMessage( 0, ros::Time(1000, i), Span<uint8_t>(buffer) );
+    buffers.push_back( buffer );
+    if( i % 10 == 0 )
+    {
+      corpus.addMessage( 1, ros::Time(1000, i), Span<uint8_t>() );
+      buffers.push_back( std::vector<uint8_t>() );
+    }
+  }
+  corpus.save( filename );
+
+  MessageCorpus loaded;
+  loaded.load( filename );
+  ASSERT_EQ( loaded.topics().size(), 2 );
+  EXPECT_EQ( loaded.topics()[0].name,       joints.name );
+  EXPECT_EQ( loaded.topics()[0].datatype,   joints.datatype );
+  EXPECT_EQ( loaded.topics()[0].md5sum,     joints.md5sum );
+  EXPECT_EQ( loaded.topics()[0].definition, joints.definition );
+  EXPECT_EQ( loaded.topics()[1].name,       empty.name );
+  EXPECT_EQ( loaded.totalBytes(), corpus.totalBytes() );
+
+  ASSERT_EQ( loaded.messagesCount(), buffers.size() );
+  for (size_t i=0; i < loaded.messagesCount(); i++)
+  {
+    EXPECT_EQ( loaded.message(i).topic, corpus.message(i).topic );
+    EXPECT_EQ( loaded.message(i).time,  corpus.message(i).time );
+    Span<uint8_t> buffer = loaded.buffer(i);
+    ASSERT_EQ( buffer.size(), buffers[i].size() );
+    EXPECT_TRUE( std::equal( buffer.begin(), buffer.end(), buffers[i].begin() ) );
+  }
+
+  // the messages can be deserialized
+  Parser parser;
+  const CorpusTopic& topic = loaded.topics()[0];
+  parser.registerMessageDefinition( topic.name, ROSType(topic.datatype), topic.definition );
+  FlatMessage flat_container;
+  parser.deserializeIntoFlatContainer( topic.name, loaded.buffer( loaded.messagesCount() - 1 ),
+                                       &flat_container, 100 );
+  EXPECT_EQ( flat_container.name.size(), 49 );
+
+  // truncated and invalid files
+  {
+    std::ifstream file( filename.c_str(), std::ios::binary );
+    std::vector<char> content( (std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>() );
+    std::ofstream truncated( filename.c_str(), std::ios::binary );
+    truncated.write( content.data(), content.size() - 10 );
+  }
+  EXPECT_THROW( loaded.load( filename ), std::runtime_error );
+  {
+    std::ofstream invalid( filename.c_str(), std::ios::binary );
+    invalid << "not a corpus";
+  }
+  EXPECT_THROW( loaded.load( filename ), std::runtime_error );
+  EXPECT_THROW( loaded.load( directory.path( "not_existing.corpus" ) ), std::runtime_error );
+}
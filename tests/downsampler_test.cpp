@@ -0,0 +1,128 @@
+#include "config.h"
+#include <gtest/gtest.h>
+
+#include <ros_introspection_test/downsampler.hpp>
+#include <memory>
+#include <vector>
+
+using namespace RosIntrospection;
+
+typedef std::shared_ptr<const int> Message;
+
+// 1 kHz stream, ids from 0 to count-1
+static std::vector<int> Stream(Downsampler<Message>& downsampler, int count,
+                               double (*value)(int) = nullptr)
+{
+  std::vector<int> output;
+  Message ready[2];
+  for (int i=0; i<count; i++)
+  {
+    Message msg = std::make_shared<const int>(i);
+    const double time = 100.0 + i * 0.001;
+    const size_t n = value ? downsampler.push( time, msg, value(i), ready ) :
+                             downsampler.push( time, msg, ready );
+    for (size_t k=0; k<n; k++)
+    {
+      output.push_back( *ready[k] );
+    }
+  }
+  const size_t n = downsampler.flush( ready );
+  for (size_t k=0; k<n; k++)
+  {
+    output.push_back( *ready[k] );
+  }
+  return output;
+}
+
+TEST(Downsampler, EveryNth)
+{
+  Downsampler<Message> downsampler( DownsamplePolicy::EveryNth(10) );
+  std::vector<int> output = Stream( downsampler, 95 );
+  ASSERT_EQ( output.size(), 10 );
+  for (size_t i=0; i<output.size(); i++)
+  {
+    EXPECT_EQ( output[i], 10*i );
+  }
+  EXPECT_EQ( downsampler.receivedCount(), 95 );
+  EXPECT_EQ( downsampler.forwardedCount(), 10 );
+
+  Downsampler<Message> keep_all;
+  EXPECT_EQ( Stream( keep_all, 20 ).size(), 20 );
+
+  EXPECT_THROW( Downsampler<Message>( DownsamplePolicy::EveryNth(0) ), std::runtime_error );
+  EXPECT_THROW( Downsampler<Message>( DownsamplePolicy::LatestPerInterval(0) ), std::runtime_error );
+  EXPECT_THROW( Downsampler<Message>( DownsamplePolicy::MinMaxPerInterval(0.1, "") ), std::runtime_error );
+}
+
+TEST(Downsampler, LatestPerInterval)
+{
+  // 1 second at 1 kHz, downsampled to 50 Hz
+  Downsampler<Message> downsampler( DownsamplePolicy::LatestPerInterval(0.02) );
+  std::vector<int> output = Stream( downsampler, 1000 );
+
+  ASSERT_EQ( output.size(), 50 );
+  for (size_t i=1; i<output.size(); i++)
+  {
+    EXPECT_GT( output[i], output[i-1] );
+    // the last message of each interval
+    EXPECT_NEAR( output[i] - output[i-1], 20, 1 );
+  }
+  EXPECT_EQ( output.back(), 999 );
+}
+
+TEST(Downsampler, FlushEnded)
+{
+  Downsampler<Message> downsampler( DownsamplePolicy::LatestPerInterval(0.1) );
+  Message ready[2];
+  EXPECT_EQ( downsampler.flushEnded( 100.0, ready ), 0 );
+
+  // the topic stops publishing after two messages
+  EXPECT_EQ( downsampler.push( 100.01, std::make_shared<const int>(1), ready ), 0 );
+  EXPECT_EQ( downsampler.push( 100.02, std::make_shared<const int>(2), ready ), 0 );
+
+  // the interval is not over yet
+  EXPECT_EQ( downsampler.flushEnded( 100.09, ready ), 0 );
+  ASSERT_EQ( downsampler.flushEnded( 100.15, ready ), 1 );
+  EXPECT_EQ( *ready[0], 2 );
+  EXPECT_EQ( downsampler.flushEnded( 100.25, ready ), 0 );
+
+  // the following messages are not affected
+  EXPECT_EQ( downsampler.push( 100.31, std::make_shared<const int>(3), ready ), 0 );
+  ASSERT_EQ( downsampler.push( 100.41, std::make_shared<const int>(4), ready ), 1 );
+  EXPECT_EQ( *ready[0], 3 );
+  EXPECT_EQ( downsampler.forwardedCount(), 2 );
+}
+
+static double Triangle(int i)
+{
+  // peaks at 7 and valleys at 17, every 20 messages
+  const int phase = i % 20;
+  if( phase == 3 ) {
+    return std::nan("");
+  }
+  return (phase <= 7) ? phase : ( (phase <= 17) ? 14 - phase : phase - 20 );
+}
+
+TEST(Downsampler, MinMaxPerInterval)
+{
+  Downsampler<Message> downsampler( DownsamplePolicy::MinMaxPerInterval(0.02, "position.0") );
+  EXPECT_TRUE( downsampler.needsValue() );
+
+  std::vector<int> output = Stream( downsampler, 1000, Triangle );
+
+  // the peaks are preserved, in time order
+  ASSERT_EQ( output.size(), 100 );
+  for (size_t i=1; i<output.size(); i++)
+  {
+    EXPECT_GT( output[i], output[i-1] );
+  }
+  int peaks = 0;
+  int valleys = 0;
+  for (int id: output)
+  {
+    peaks   += ( Triangle(id) == 7 );
+    valleys += ( Triangle(id) == -3 );
+  }
+  EXPECT_EQ( peaks, 50 );
+  EXPECT_EQ( valleys, 50 );
+}
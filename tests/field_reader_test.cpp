@@ -0,0 +1,199 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+#include <tf2_msgs/TFMessage.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/field_reader.hpp>
+#include <ros_introspection_test/bag_query.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+// collects "key=value" for each visited element
+struct KeyValueCollector
+{
+  const FieldReader* reader;
+  size_t stop_after;
+  std::vector<std::string> output;
+
+  bool operator()(const SchemaField& leaf, const Span<uint8_t>& buffer,
+                  size_t offset, const std::vector<uint32_t>& indices)
+  {
+    std::string key;
+    reader->key( indices, key );
+    std::string value;
+    if( leaf.type_id == STRING ){
+      ReadLeafString( buffer, offset, value );
+    }
+    else{
+      value = std::to_string( ReadLeafValue( leaf, buffer, offset ).convert<double>() );
+    }
+    output.push_back( key + "=" + value );
+    return output.size() == stop_after;
+  }
+};
+
+static std::vector<std::string> ReadAll(const FieldReader& reader, const std::vector<uint8_t>& buffer,
+                                        size_t stop_after = 0)
+{
+  KeyValueCollector collector;
+  collector.reader = &reader;
+  collector.stop_after = stop_after;
+  reader.visit( Span<uint8_t>(buffer), collector );
+  return collector.output;
+}
+
+TEST(FieldReader, JointState)
+{
+  Parser parser;
+  parser.registerMessageDefinition( "joint_state",
+                                    ROSType(DataType<sensor_msgs::JointState>::value()),
+                                    Definition<sensor_msgs::JointState>::value() );
+  MessageSchema schema( *parser.getMessageInfo("joint_state") );
+
+  sensor_msgs::JointState joint_state;
+  joint_state.header.frame_id = "base";
+  for (int i=0; i<4; i++)
+  {
+    joint_state.name.push_back( std::string("joint_") + std::to_string(i) );
+    joint_state.position.push_back( 10 + i );
+    joint_state.velocity.push_back( 20 + i );
+    joint_state.effort.push_back( 30 + i );
+  }
+  const std::vector<uint8_t> buffer = Serialize( joint_state );
+
+  FieldReader velocity( schema, "velocity.#" );
+  EXPECT_EQ( velocity.wildcards(), 1 );
+  std::vector<std::string> values = ReadAll( velocity, buffer );
+  ASSERT_EQ( values.size(), 4 );
+  EXPECT_EQ( values[1], "velocity.1=" + std::to_string(21.0) );
+
+  values = ReadAll( FieldReader( schema, "effort.2" ), buffer );
+  ASSERT_EQ( values.size(), 1 );
+  EXPECT_EQ( values[0], "effort.2=" + std::to_string(32.0) );
+
+  values = ReadAll( FieldReader( schema, "name.#" ), buffer );
+  ASSERT_EQ( values.size(), 4 );
+  EXPECT_EQ( values[3], "name.3=joint_3" );
+
+  values = ReadAll( FieldReader( schema, "header/frame_id" ), buffer );
+  ASSERT_EQ( values.size(), 1 );
+  EXPECT_EQ( values[0], "header/frame_id=base" );
+
+  // out of range
+  EXPECT_TRUE( ReadAll( FieldReader( schema, "position.9" ), buffer ).empty() );
+
+  // not a leaf
+  EXPECT_THROW( FieldReader( schema, "header" ), std::runtime_error );
+}
+
+TEST(FieldReader, TFMessage)
+{
+  Parser parser;
+  parser.registerMessageDefinition( "tf",
+                                    ROSType(DataType<tf2_msgs::TFMessage>::value()),
+                                    Definition<tf2_msgs::TFMessage>::value() );
+  MessageSchema schema( *parser.getMessageInfo("tf") );
+
+  tf2_msgs::TFMessage tf_msg;
+  tf_msg.transforms.resize( 5 );
+  for (int i=0; i<5; i++)
+  {
+    tf_msg.transforms[i].header.frame_id = "frame_" + std::to_string(i);
+    tf_msg.transforms[i].child_frame_id  = "child_" + std::to_string(i);
+    tf_msg.transforms[i].transform.translation.y = i;
+  }
+  std::vector<uint8_t> buffer = Serialize( tf_msg );
+
+  FieldReader translation( schema, "transforms.#/transform/translation/y" );
+
+  // interrupted by the visitor
+  std::vector<std::string> values = ReadAll( translation, buffer, 3 );
+  ASSERT_EQ( values.size(), 3 );
+  EXPECT_EQ( values[2], "transforms.2/transform/translation/y=" + std::to_string(2.0) );
+
+  values = ReadAll( FieldReader( schema, "transforms.4/child_frame_id" ), buffer );
+  ASSERT_EQ( values.size(), 1 );
+  EXPECT_EQ( values[0], "transforms.4/child_frame_id=child_4" );
+
+  // truncated buffer
+  buffer.resize( buffer.size() - 100 );
+  EXPECT_THROW( ReadAll( translation, buffer ), std::runtime_error );
+
+  // the reader is reused after an interrupted or a failed visit
+  buffer = Serialize( tf_msg );
+  values = ReadAll( translation, buffer );
+  ASSERT_EQ( values.size(), 5 );
+  EXPECT_EQ( values[4], "transforms.4/transform/translation/y=" + std::to_string(4.0) );
+
+  // indices owned by the caller
+  std::vector<uint32_t> indices( 3, 7 );
+  KeyValueCollector collector;
+  collector.reader = &translation;
+  collector.stop_after = 0;
+  translation.visit( Span<uint8_t>(buffer), collector, indices );
+  EXPECT_EQ( collector.output, values );
+}
+
+TEST(BagQuery, GlobMatch)
+{
+  EXPECT_TRUE( GlobMatch( "/imu*", "/imu" ) );
+  EXPECT_TRUE( GlobMatch( "/imu*", "/imu/data" ) );
+  EXPECT_TRUE( GlobMatch( "/robot/*/joint_states", "/robot/arm/joint_states" ) );
+  EXPECT_TRUE( GlobMatch( "/cam?", "/cam1" ) );
+  EXPECT_FALSE( GlobMatch( "/cam?", "/cam12" ) );
+  EXPECT_FALSE( GlobMatch( "/imu", "/imu/data" ) );
+}
+
+TEST(BagQuery, TopicTimeAndCondition)
+{
+  TemporaryDirectory directory;
+  const std::string filename = directory.path( "bag_query_test.bag" );
+  {
+    rosbag::Bag bag( filename, rosbag::bagmode::Write );
+    for (int i=0; i<100; i++)
+    {
+      const ros::Time time( 1000 + i / 10, (i % 10) * 100000000 );
+      sensor_msgs::Imu imu;
+      imu.linear_acceleration.z = (i % 10 == 0) ? 20 : 9.8;
+      bag.write( "/imu", time, imu );
+
+      sensor_msgs::JointState joint_state;
+      joint_state.position.push_back( i );
+      bag.write( "/joint_states", time, joint_state );
+    }
+    bag.close();
+  }
+
+  rosbag::Bag bag( filename, rosbag::bagmode::Read );
+  BagQuery query( bag );
+  query.topics("/im*")
+       .relativeTimeRange( 1.0, 5.0 )
+       .select("/imu/linear_acceleration/z")
+       .where("imu/linear_acceleration/z > 15");
+
+  std::vector<double> times;
+  size_t records = query.run( [&](const QueryRecord& record)
+  {
+    EXPECT_EQ( *record.topic, "/imu" );
+    ASSERT_EQ( record.values->size(), 1 );
+    EXPECT_EQ( record.values->at(0).first, "/imu/linear_acceleration/z" );
+    EXPECT_EQ( record.values->at(0).second.convert<double>(), 20 );
+    times.push_back( (record.time - ros::Time(1000)).toSec() );
+  });
+
+  // messages 10, 20, 30, 40 and 50
+  EXPECT_EQ( records, 5 );
+  ASSERT_EQ( times.size(), 5 );
+  EXPECT_NEAR( times.front(), 1.0, 0.001 );
+  EXPECT_NEAR( times.back(),  5.0, 0.001 );
+  EXPECT_EQ( query.messagesRead(), 41 );
+
+  BagQuery invalid_query( bag );
+  invalid_query.topics("/imu").select("/joint_states/position.0");
+  EXPECT_THROW( invalid_query.run( [](const QueryRecord&){} ), std::runtime_error );
+  EXPECT_THROW( invalid_query.where("position.0 ~ 3"), std::runtime_error );
+}
@@ -0,0 +1,83 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <ros_introspection_test/FrankaError.h>
+#include <sensor_msgs/NavSatStatus.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/flag_bitset.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(FlagBitset, FrankaError)
+{
+  using ros_introspection_test::FrankaError;
+  Parser parser;
+  parser.registerMessageDefinition( "error", ROSType(DataType<FrankaError>::value()),
+                                    Definition<FrankaError>::value() );
+  const MessageSchema schema( *parser.getMessageInfo("error") );
+  const FlagLayout layout( schema );
+
+  ASSERT_EQ( layout.size(), 36 );
+  EXPECT_EQ( layout.names()[0], "joint_position_limits_violation" );
+  EXPECT_EQ( layout.names()[7], "cartesian_reflex" );
+
+  FrankaError error{};
+  std::vector<uint8_t> buffer = Serialize( error );
+  FlagBitset flags;
+  EXPECT_FALSE( layout.pack( Span<uint8_t>(buffer), &flags ) );
+  EXPECT_EQ( flags.size(), 36 );
+  EXPECT_EQ( flags.count(), 0 );
+
+  error.cartesian_reflex = true;
+  error.force_control_safety_violation = true;
+  buffer = Serialize( error );
+  EXPECT_TRUE( layout.pack( Span<uint8_t>(buffer), &flags ) );
+  EXPECT_EQ( flags.count(), 2 );
+
+  std::vector<std::string> set_flags;
+  flags.forEachSet( [&](size_t index){ set_flags.push_back( layout.names()[index] ); } );
+  ASSERT_EQ( set_flags.size(), 2 );
+  EXPECT_EQ( set_flags[0], "force_control_safety_violation" );
+  EXPECT_EQ( set_flags[1], "cartesian_reflex" );
+
+  // every flag, one at a time: crosses the 8 bytes blocks of pack()
+  for (size_t i=0; i<buffer.size(); i++)
+  {
+    std::vector<uint8_t> single( buffer.size(), 0 );
+    single[i] = 1;
+    ASSERT_TRUE( layout.pack( Span<uint8_t>(single), &flags ) );
+    EXPECT_EQ( flags.count(), 1 );
+    EXPECT_TRUE( flags.test(i) );
+  }
+
+  std::vector<uint8_t> truncated( buffer.begin(), buffer.end() - 1 );
+  EXPECT_THROW( layout.pack( Span<uint8_t>(truncated), &flags ), std::runtime_error );
+}
+
+TEST(FlagBitset, MixedFields)
+{
+  // int8 status, uint16 service
+  Parser parser;
+  parser.registerMessageDefinition( "status", ROSType(DataType<sensor_msgs::NavSatStatus>::value()),
+                                    Definition<sensor_msgs::NavSatStatus>::value() );
+  const MessageSchema schema( *parser.getMessageInfo("status") );
+  const FlagLayout layout( schema );
+  ASSERT_EQ( layout.size(), 1 );
+  EXPECT_EQ( layout.names()[0], "status" );
+
+  sensor_msgs::NavSatStatus status;
+  status.status = sensor_msgs::NavSatStatus::STATUS_NO_FIX;
+  status.service = sensor_msgs::NavSatStatus::SERVICE_GPS;
+  std::vector<uint8_t> buffer = Serialize( status );
+
+  // any value different from zero is set, including negative ones
+  FlagBitset flags;
+  EXPECT_TRUE( layout.pack( Span<uint8_t>(buffer), &flags ) );
+  EXPECT_TRUE( flags.test(0) );
+
+  status.status = sensor_msgs::NavSatStatus::STATUS_FIX;
+  buffer = Serialize( status );
+  EXPECT_FALSE( layout.pack( Span<uint8_t>(buffer), &flags ) );
+}
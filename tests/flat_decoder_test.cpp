@@ -0,0 +1,328 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/static_decoders.hpp>
+#include <ros_introspection_test/decoder_codegen.hpp>
+#include <ros_introspection_test/decoder_plugin.hpp>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/Imu.h>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+static void ExpectSameFlatMessage(const FlatMessage& a, const FlatMessage& b)
+{
+  ASSERT_EQ( a.value.size(), b.value.size() );
+  ASSERT_EQ( a.name.size(), b.name.size() );
+  for(size_t i=0; i<a.value.size(); i++)
+  {
+    EXPECT_EQ( a.value[i].first.toStdString(), b.value[i].first.toStdString() );
+    EXPECT_EQ( a.value[i].second.getTypeID(), b.value[i].second.getTypeID() );
+    EXPECT_EQ( a.value[i].second.convert<double>(), b.value[i].second.convert<double>() );
+  }
+  for(size_t i=0; i<a.name.size(); i++)
+  {
+    EXPECT_EQ( a.name[i].first.toStdString(), b.name[i].first.toStdString() );
+    EXPECT_EQ( a.name[i].second, b.name[i].second );
+  }
+}
+
+static sensor_msgs::JointState CreateJointState(int size, int seq)
+{
+  sensor_msgs::JointState joint_state;
+  joint_state.header.seq = seq;
+  joint_state.header.stamp.sec  = 1234 + seq;
+  joint_state.header.stamp.nsec = 567*1000*1000;
+  joint_state.header.frame_id = "frame_" + std::to_string(seq);
+  for (int i=0; i<size; i++)
+  {
+    joint_state.name.push_back( "joint_" + std::to_string(i+seq) );
+    joint_state.position.push_back( 10+i+seq );
+    joint_state.velocity.push_back( 30+i+seq );
+    joint_state.effort.push_back( 50+i+seq );
+  }
+  return joint_state;
+}
+
+TEST(FlatDecoder, JointStateSameAsParser)
+{
+  FlatDecoderRegistry registry;
+  AddDefaultStaticDecoders(registry);
+  EXPECT_EQ( registry.size(), 4 );
+
+  SpecializedParser specialized(registry);
+  Parser parser;
+
+  const ROSType type( DataType<sensor_msgs::JointState>::value() );
+  const std::string definition = Definition<sensor_msgs::JointState>::value();
+
+  specialized.registerMessageDefinition("JointState", type, definition,
+                                        MD5Sum<sensor_msgs::JointState>::value() );
+  parser.registerMessageDefinition("JointState", type, definition);
+
+  FlatMessage flat_specialized;
+  FlatMessage flat_reference;
+
+  const int sizes[7] = {3, 3, 3, 5, 5, 5, 2};
+  for (int seq=0; seq<7; seq++)
+  {
+    std::vector<uint8_t> buffer = Serialize( CreateJointState( sizes[seq], seq ) );
+
+    specialized.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_specialized, 100);
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_reference, 100);
+    ExpectSameFlatMessage( flat_specialized, flat_reference );
+  }
+  EXPECT_TRUE( specialized.isSpecialized("JointState") );
+  // the first two messages of each new shape go through the Parser
+  EXPECT_EQ( specialized.specializedCount("JointState"), 3 );
+
+  // a new container for each message never has the keys: same output, no fast path
+  for (int seq=0; seq<3; seq++)
+  {
+    std::vector<uint8_t> buffer = Serialize( CreateJointState( 2, seq ) );
+    FlatMessage flat_temporary;
+    specialized.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_temporary, 100);
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_reference, 100);
+    ExpectSameFlatMessage( flat_temporary, flat_reference );
+  }
+  EXPECT_EQ( specialized.specializedCount("JointState"), 3 );
+}
+
+TEST(FlatDecoder, TFMessageAndOdometry)
+{
+  FlatDecoderRegistry registry;
+  AddDefaultStaticDecoders(registry);
+  SpecializedParser specialized(registry);
+  Parser parser;
+
+  const ROSType tf_type( DataType<tf2_msgs::TFMessage>::value() );
+  const ROSType odom_type( DataType<nav_msgs::Odometry>::value() );
+
+  specialized.registerMessageDefinition("tf", tf_type, Definition<tf2_msgs::TFMessage>::value(),
+                                        MD5Sum<tf2_msgs::TFMessage>::value() );
+  specialized.registerMessageDefinition("odom", odom_type, Definition<nav_msgs::Odometry>::value(),
+                                        MD5Sum<nav_msgs::Odometry>::value() );
+  parser.registerMessageDefinition("tf", tf_type, Definition<tf2_msgs::TFMessage>::value() );
+  parser.registerMessageDefinition("odom", odom_type, Definition<nav_msgs::Odometry>::value() );
+
+  FlatMessage tf_specialized, tf_reference;
+  FlatMessage odom_specialized, odom_reference;
+
+  for (int seq=0; seq<3; seq++)
+  {
+    tf2_msgs::TFMessage tf_msg;
+    for (int i=0; i<4; i++)
+    {
+      geometry_msgs::TransformStamped transform;
+      transform.header.seq = seq;
+      transform.header.frame_id = "world";
+      transform.child_frame_id = "link_" + std::to_string(i);
+      transform.transform.translation.x = i + seq;
+      transform.transform.rotation.w = 1.0;
+      tf_msg.transforms.push_back( transform );
+    }
+    nav_msgs::Odometry odom;
+    odom.header.seq = seq;
+    odom.child_frame_id = "base_link";
+    odom.pose.pose.position.x = seq;
+    odom.pose.covariance[35] = 0.5 * seq;
+    odom.twist.twist.angular.z = -seq;
+
+    std::vector<uint8_t> tf_buffer   = Serialize( tf_msg );
+    std::vector<uint8_t> odom_buffer = Serialize( odom );
+
+    specialized.deserializeIntoFlatContainer("tf", Span<uint8_t>(tf_buffer), &tf_specialized, 100);
+    parser.deserializeIntoFlatContainer("tf", Span<uint8_t>(tf_buffer), &tf_reference, 100);
+    ExpectSameFlatMessage( tf_specialized, tf_reference );
+
+    specialized.deserializeIntoFlatContainer("odom", Span<uint8_t>(odom_buffer), &odom_specialized, 100);
+    parser.deserializeIntoFlatContainer("odom", Span<uint8_t>(odom_buffer), &odom_reference, 100);
+    ExpectSameFlatMessage( odom_specialized, odom_reference );
+  }
+  EXPECT_EQ( specialized.specializedCount("tf"), 2 );
+  EXPECT_EQ( specialized.specializedCount("odom"), 2 );
+}
+
+TEST(FlatDecoder, SharedOutputAndNaN)
+{
+  FlatDecoderRegistry registry;
+  AddDefaultStaticDecoders(registry);
+  SpecializedParser specialized(registry);
+  Parser parser;
+
+  const ROSType imu_type( DataType<sensor_msgs::Imu>::value() );
+  for (const char* topic: {"imu_a", "imu_b"})
+  {
+    specialized.registerMessageDefinition(topic, imu_type, Definition<sensor_msgs::Imu>::value(),
+                                          MD5Sum<sensor_msgs::Imu>::value() );
+    parser.registerMessageDefinition(topic, imu_type, Definition<sensor_msgs::Imu>::value() );
+  }
+
+  // same number of values, different keys: the keys of the other topic must not be reused
+  FlatMessage shared, reference;
+  for (int seq=0; seq<6; seq++)
+  {
+    const char* topic = (seq % 2 == 0) ? "imu_a" : "imu_b";
+    sensor_msgs::Imu imu;
+    imu.header.seq = seq;
+    imu.linear_acceleration.z = seq;
+    std::vector<uint8_t> buffer = Serialize( imu );
+
+    specialized.deserializeIntoFlatContainer(topic, Span<uint8_t>(buffer), &shared, 100);
+    parser.deserializeIntoFlatContainer(topic, Span<uint8_t>(buffer), &reference, 100);
+    ExpectSameFlatMessage( shared, reference );
+  }
+  EXPECT_EQ( specialized.specializedCount("imu_a"), 0 );
+  EXPECT_EQ( specialized.specializedCount("imu_b"), 0 );
+
+  // a NaN doesn't disable the decoder
+  const ROSType joints_type( DataType<sensor_msgs::JointState>::value() );
+  specialized.registerMessageDefinition("JointState", joints_type,
+                                        Definition<sensor_msgs::JointState>::value(),
+                                        MD5Sum<sensor_msgs::JointState>::value() );
+  FlatMessage flat;
+  for (int seq=0; seq<3; seq++)
+  {
+    sensor_msgs::JointState joint_state = CreateJointState( 3, seq );
+    joint_state.effort[1] = std::numeric_limits<double>::quiet_NaN();
+    std::vector<uint8_t> buffer = Serialize( joint_state );
+    specialized.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat, 100);
+  }
+  EXPECT_TRUE( specialized.isSpecialized("JointState") );
+  EXPECT_EQ( specialized.specializedCount("JointState"), 2 );
+}
+
+TEST(FlatDecoder, FallbackWithoutDecoder)
+{
+  FlatDecoderRegistry registry;
+  SpecializedParser specialized(registry);
+
+  specialized.registerMessageDefinition("JointState",
+                                        ROSType(DataType<sensor_msgs::JointState>::value()),
+                                        Definition<sensor_msgs::JointState>::value(),
+                                        MD5Sum<sensor_msgs::JointState>::value() );
+  FlatMessage flat;
+  for (int seq=0; seq<3; seq++)
+  {
+    std::vector<uint8_t> buffer = Serialize( CreateJointState( 3, seq ) );
+    specialized.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat, 100);
+  }
+  EXPECT_FALSE( specialized.isSpecialized("JointState") );
+  EXPECT_EQ( specialized.specializedCount("JointState"), 0 );
+  EXPECT_EQ( flat.name.size(), 4 );
+  EXPECT_EQ( flat.value.size(), 2 + 3*3 );
+
+  // arrays larger than max_array_size are discarded by the Parser: not specialized
+  registry.add( MD5Sum<sensor_msgs::JointState>::value(),
+                &StaticDecoder<sensor_msgs::JointState>::decode );
+  SpecializedParser small_arrays(registry);
+  small_arrays.registerMessageDefinition("JointState",
+                                         ROSType(DataType<sensor_msgs::JointState>::value()),
+                                         Definition<sensor_msgs::JointState>::value(),
+                                         MD5Sum<sensor_msgs::JointState>::value() );
+  for (int seq=0; seq<3; seq++)
+  {
+    std::vector<uint8_t> buffer = Serialize( CreateJointState( 10, seq ) );
+    small_arrays.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat, 5);
+  }
+  EXPECT_EQ( small_arrays.specializedCount("JointState"), 0 );
+}
+
+TEST(FlatDecoder, GeneratedSource)
+{
+  Parser parser;
+  parser.registerMessageDefinition("imu",
+                                   ROSType(DataType<sensor_msgs::Imu>::value()),
+                                   Definition<sensor_msgs::Imu>::value() );
+
+  DecoderGenerator generator;
+  generator.addType( MD5Sum<sensor_msgs::Imu>::value(), MessageSchema( *parser.getMessageInfo("imu") ) );
+  generator.addType( MD5Sum<sensor_msgs::Imu>::value(), MessageSchema( *parser.getMessageInfo("imu") ) );
+  EXPECT_EQ( generator.typesCount(), 1 );
+
+  const std::string source = generator.source();
+  EXPECT_NE( source.find( MD5Sum<sensor_msgs::Imu>::value() ), std::string::npos );
+  EXPECT_NE( source.find( "d.values<double>(9); // orientation_covariance" ), std::string::npos );
+  EXPECT_NE( source.find( "d.time(); // stamp" ), std::string::npos );
+  EXPECT_NE( source.find( ROS_INTROSPECTION_TEST_DECODER_PLUGIN_SYMBOL ), std::string::npos );
+}
+
+// compiler and include directories of the plugins, defined by CMake
+#ifdef DECODER_PLUGIN_COMPILER
+
+TEST(FlatDecoder, GeneratedPlugin)
+{
+  TemporaryDirectory directory;
+  const std::string source_file = directory.path( "decoders.cpp" );
+  const std::string plugin_file = directory.path( "decoders.so" );
+
+  const ROSType imu_type( DataType<sensor_msgs::Imu>::value() );
+  const ROSType joints_type( DataType<sensor_msgs::JointState>::value() );
+
+  Parser parser;
+  parser.registerMessageDefinition("imu", imu_type, Definition<sensor_msgs::Imu>::value() );
+  parser.registerMessageDefinition("JointState", joints_type, Definition<sensor_msgs::JointState>::value() );
+
+  DecoderGenerator generator;
+  generator.addType( MD5Sum<sensor_msgs::Imu>::value(), MessageSchema( *parser.getMessageInfo("imu") ) );
+  generator.addType( MD5Sum<sensor_msgs::JointState>::value(),
+                     MessageSchema( *parser.getMessageInfo("JointState") ) );
+  {
+    std::ofstream source( source_file.c_str() );
+    source << generator.source();
+  }
+  const std::string command = std::string( DECODER_PLUGIN_COMPILER ) +
+      " -std=c++11 -shared -fPIC " + DECODER_PLUGIN_FLAGS +
+      " '" + source_file + "' -o '" + plugin_file + "'";
+  ASSERT_EQ( system( command.c_str() ), 0 ) << command;
+
+  DecoderPlugin plugin( plugin_file );
+  FlatDecoderRegistry registry;
+  EXPECT_EQ( plugin.registerInto( registry ), 2 );
+
+  SpecializedParser specialized(registry);
+  specialized.registerMessageDefinition("imu", imu_type, Definition<sensor_msgs::Imu>::value(),
+                                        MD5Sum<sensor_msgs::Imu>::value() );
+  specialized.registerMessageDefinition("JointState", joints_type,
+                                        Definition<sensor_msgs::JointState>::value(),
+                                        MD5Sum<sensor_msgs::JointState>::value() );
+
+  FlatMessage imu_specialized, imu_reference;
+  FlatMessage joints_specialized, joints_reference;
+  for (int seq=0; seq<4; seq++)
+  {
+    sensor_msgs::Imu imu;
+    imu.header.seq = seq;
+    imu.header.stamp.sec = 1000 + seq;
+    imu.header.frame_id = "imu_link";
+    imu.orientation.w = 1.0;
+    imu.angular_velocity.x = 0.1 * seq;
+    imu.linear_acceleration.z = 9.81;
+    imu.orientation_covariance[4] = seq;
+    std::vector<uint8_t> imu_buffer = Serialize( imu );
+
+    specialized.deserializeIntoFlatContainer("imu", Span<uint8_t>(imu_buffer), &imu_specialized, 100);
+    parser.deserializeIntoFlatContainer("imu", Span<uint8_t>(imu_buffer), &imu_reference, 100);
+    ExpectSameFlatMessage( imu_specialized, imu_reference );
+
+    std::vector<uint8_t> joints_buffer = Serialize( CreateJointState( 3, seq ) );
+    specialized.deserializeIntoFlatContainer("JointState", Span<uint8_t>(joints_buffer),
+                                             &joints_specialized, 100);
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(joints_buffer), &joints_reference, 100);
+    ExpectSameFlatMessage( joints_specialized, joints_reference );
+  }
+  // the first message of each topic goes through the Parser
+  EXPECT_TRUE( specialized.isSpecialized("imu") );
+  EXPECT_TRUE( specialized.isSpecialized("JointState") );
+  EXPECT_EQ( specialized.specializedCount("imu"), 3 );
+  EXPECT_EQ( specialized.specializedCount("JointState"), 3 );
+}
+
+#endif
@@ -0,0 +1,97 @@
+// libFuzzer harness for the BufferValidator and the walkers of MessageSchema.
+// The first byte of the input selects the message type, the rest is the serialized message.
+//
+// Build with -DENABLE_FUZZING=ON (clang only), then:
+//   ./fuzz_deserializer -max_len=4096 corpus_dir
+
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/Image.h>
+#include <nav_msgs/Odometry.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <tf2_msgs/TFMessage.h>
+#include <ros_introspection_test/FrankaError.h>
+#include <ros_introspection_test/MotorStatus.h>
+#include <ros_introspection_test/Issue35.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/buffer_validator.hpp>
+#include <cstdlib>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+namespace {
+
+struct Target
+{
+  std::string name;
+  std::unique_ptr<MessageSchema> schema;
+  std::unique_ptr<BufferValidator> validator;
+};
+
+class Targets
+{
+public:
+  Targets()
+  {
+    add<sensor_msgs::JointState>("JointState");
+    add<sensor_msgs::Imu>("Imu");
+    add<sensor_msgs::Image>("Image");
+    add<nav_msgs::Odometry>("Odometry");
+    add<geometry_msgs::PoseStamped>("PoseStamped");
+    add<tf2_msgs::TFMessage>("TFMessage");
+    add<ros_introspection_test::FrankaError>("FrankaError");
+    add<ros_introspection_test::MotorStatus>("MotorStatus");
+    add<ros_introspection_test::Issue35>("Issue35");
+  }
+
+  Parser parser;
+  std::vector<Target> targets;
+
+private:
+  template <typename Message> void add(const std::string& name)
+  {
+    parser.registerMessageDefinition( name, ROSType(DataType<Message>::value()),
+                                      Definition<Message>::value() );
+    Target target;
+    target.name = name;
+    target.schema.reset( new MessageSchema( *parser.getMessageInfo(name) ) );
+    target.validator.reset( new BufferValidator( *target.schema ) );
+    targets.push_back( std::move(target) );
+  }
+};
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  static Targets fuzz;
+  static FlatMessage flat_container;
+
+  if( size < 1 ){
+    return 0;
+  }
+  const Target& target = fuzz.targets[ data[0] % fuzz.targets.size() ];
+
+  // copy: the sanitizer detects any read past the end of the message
+  std::vector<uint8_t> buffer( data + 1, data + size );
+  const Span<uint8_t> span( buffer );
+
+  if( !target.validator->validate( span ) )
+  {
+    // the checked walk must not accept it either
+    try{
+      if( target.schema->skipMessage( 0, span, 0 ) == buffer.size() ){
+        abort();
+      }
+    }
+    catch( std::runtime_error& ) {}
+    return 0;
+  }
+
+  if( target.schema->skipMessage<false>( 0, span, 0 ) != buffer.size() ){
+    abort();
+  }
+  fuzz.parser.deserializeIntoFlatContainer( target.name, span, &flat_container, 1024 );
+  return 0;
+}
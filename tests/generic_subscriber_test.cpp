@@ -0,0 +1,159 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/generic_subscriber.hpp>
+#include <atomic>
+#include <thread>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+template <typename Message>
+static topic_tools::ShapeShifter::ConstPtr ToShapeShifter(std::vector<uint8_t> buffer)
+{
+  boost::shared_ptr<topic_tools::ShapeShifter> shape_shifter( new topic_tools::ShapeShifter );
+  shape_shifter->morph( MD5Sum<Message>::value(), DataType<Message>::value(),
+                        Definition<Message>::value(), "" );
+  ros::serialization::IStream stream( buffer.data(), buffer.size() );
+  shape_shifter->read( stream );
+  return shape_shifter;
+}
+
+static std::vector<SubstitutionRule> JointStateRules()
+{
+  std::vector<SubstitutionRule> rules;
+  rules.push_back( SubstitutionRule( "position.#", "name.#", "@.position" ));
+  rules.push_back( SubstitutionRule( "velocity.#", "name.#", "@.velocity" ));
+  rules.push_back( SubstitutionRule( "effort.#",   "name.#", "@.effort"   ));
+  return rules;
+}
+
+TEST(GenericSubscriber, TopicsInParallel)
+{
+  const ROSType joint_state_type( DataType<sensor_msgs::JointState>::value() );
+  const char* topic_names[2] = { "joints_a", "joints_b" };
+  const int NUM_MSGS = 200;
+
+  // expected output, computed by a single Parser
+  Parser parser;
+  Register<sensor_msgs::JointState>( parser, topic_names[0] );
+  Register<sensor_msgs::JointState>( parser, topic_names[1] );
+  parser.registerRenamingRules( joint_state_type, JointStateRules() );
+
+  std::vector<topic_tools::ShapeShifter::ConstPtr> messages[2];
+  std::vector<RenamedValues> expected[2];
+  for (int t=0; t<2; t++)
+  {
+    for (int i=0; i<NUM_MSGS; i++)
+    {
+      // different sizes for each topic and message
+      std::vector<uint8_t> buffer = SerializedJointState( 1 + (i + t) % 4, i );
+      FlatMessage flat_container;
+      RenamedValues renamed_values;
+      parser.deserializeIntoFlatContainer( topic_names[t], Span<uint8_t>(buffer), &flat_container, 100 );
+      parser.applyNameTransform( topic_names[t], flat_container, &renamed_values );
+      expected[t].push_back( renamed_values );
+      messages[t].push_back( ToShapeShifter<sensor_msgs::JointState>( buffer ) );
+    }
+  }
+
+  GenericSubscriber subscriber;
+  subscriber.registerRenamingRules( joint_state_type, JointStateRules() );
+  EXPECT_THROW( subscriber.subscribe( "no_node_handle", 1, GenericSubscriber::Callback() ),
+                std::runtime_error );
+
+  std::atomic<int> received[2];
+  std::atomic<int> mismatches( 0 );
+  GenericSubscriber::TopicHandle handles[2];
+  for (int t=0; t<2; t++)
+  {
+    received[t] = 0;
+    handles[t] = subscriber.addTopic( topic_names[t],
+                                      [&, t](const GenericSubscriber::Topic& topic)
+    {
+      const RenamedValues& reference = expected[t][ received[t]++ ];
+      bool equal = ( topic.name == topic_names[t] && topic.renamed_values.size() == reference.size() );
+      for (size_t i=0; equal && i < reference.size(); i++)
+      {
+        equal = ( topic.renamed_values[i].first == reference[i].first &&
+                  topic.renamed_values[i].second.convert<double>() == reference[i].second.convert<double>() );
+      }
+      if( !equal ){
+        mismatches++;
+      }
+    });
+  }
+  EXPECT_EQ( subscriber.topicsCount(), 2 );
+
+  std::vector<std::thread> threads;
+  for (int t=0; t<2; t++)
+  {
+    threads.push_back( std::thread( [&, t]()
+    {
+      for (const auto& msg: messages[t]){
+        subscriber.receiveMessage( handles[t], msg );
+      }
+    }));
+  }
+  for (std::thread& thread: threads){
+    thread.join();
+  }
+
+  EXPECT_EQ( received[0], NUM_MSGS );
+  EXPECT_EQ( received[1], NUM_MSGS );
+  EXPECT_EQ( mismatches, 0 );
+  EXPECT_EQ( subscriber.droppedCount( handles[0] ), 0 );
+}
+
+TEST(GenericSubscriber, DownsamplingField)
+{
+  // the intervals of the Downsampler use ros::Time::now()
+  ros::Time::init();
+
+  std::vector<const topic_tools::ShapeShifter*> processed;
+  GenericSubscriber subscriber;
+  const GenericSubscriber::TopicHandle handle = subscriber.addTopic( "joints",
+                                                                     [&](const GenericSubscriber::Topic& topic)
+  {
+    processed.push_back( topic.message.get() );
+  });
+
+  std::vector<topic_tools::ShapeShifter::ConstPtr> messages;
+  const double offsets[] = { 5, 1, 9, 3 };
+  for (double offset: offsets){
+    messages.push_back( ToShapeShifter<sensor_msgs::JointState>( SerializedJointState( 3, offset ) ) );
+  }
+
+  // the type of the topic is not known yet: the string field is rejected by the first message
+  subscriber.setDownsampling( handle, DownsamplePolicy::MinMaxPerInterval( 10.0, "header/frame_id" ) );
+  for (const auto& msg: messages){
+    subscriber.receiveMessage( handle, msg );
+  }
+  EXPECT_EQ( subscriber.downsampling( handle ).type, DownsamplePolicy::LATEST_PER_INTERVAL );
+  EXPECT_EQ( subscriber.downsampling( handle ).period, 10.0 );
+  subscriber.flushDownsampling();
+  EXPECT_EQ( processed.size() + subscriber.droppedCount( handle ), messages.size() );
+  ASSERT_FALSE( processed.empty() );
+  EXPECT_EQ( processed.back(), messages.back().get() );
+
+  // now it is known
+  EXPECT_THROW( subscriber.setDownsampling( handle, DownsamplePolicy::MinMaxPerInterval( 10.0, "header/frame_id" ) ),
+                std::runtime_error );
+  EXPECT_THROW( subscriber.setDownsampling( handle, DownsamplePolicy::MinMaxPerInterval( 10.0, "not_a_field" ) ),
+                std::runtime_error );
+  EXPECT_EQ( subscriber.downsampling( handle ).type, DownsamplePolicy::LATEST_PER_INTERVAL );
+
+  subscriber.setDownsampling( handle, DownsamplePolicy::MinMaxPerInterval( 10.0, "position.0" ) );
+  processed.clear();
+  for (const auto& msg: messages){
+    subscriber.receiveMessage( handle, msg );
+  }
+  subscriber.flushDownsampling();
+  // minimum and maximum of position[0], in the order of arrival
+  ASSERT_EQ( processed.size(), 2 );
+  EXPECT_EQ( processed[0], messages[1].get() );
+  EXPECT_EQ( processed[1], messages[2].get() );
+}
@@ -0,0 +1,191 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/sample_history.hpp>
+#include <sensor_msgs/JointState.h>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+static RenamedValues Sample(double a, double b)
+{
+  RenamedValues values;
+  values.push_back( std::make_pair( std::string("topic/a"), Variant(a) ) );
+  values.push_back( std::make_pair( std::string("topic/b"), Variant(b) ) );
+  return values;
+}
+
+TEST(SampleHistory, RingAndTimeWindow)
+{
+  SampleHistory history(5);
+
+  for (int i=0; i<8; i++)
+  {
+    history.push( double(i), Sample(i*10, i*100) );
+  }
+
+  // only the last 5 samples (t = 3..7) are kept
+  EXPECT_EQ( history.size(), 5 );
+  EXPECT_EQ( history.keys().size(), 2 );
+  EXPECT_EQ( history.latestTime(), 7.0 );
+
+  const int a = history.findKey("topic/a");
+  const int b = history.findKey("topic/b");
+  ASSERT_GE( a, 0 );
+  ASSERT_GE( b, 0 );
+  EXPECT_EQ( history.findKey("topic/c"), -1 );
+  EXPECT_EQ( history.latest(a), 70 );
+  EXPECT_EQ( history.latest(b), 700 );
+
+  // the window wraps around the end of the ring
+  SampleHistory::Range range = history.range( b, 3.5, 6.0 );
+  ASSERT_EQ( range.count(), 3 );
+  for (size_t i=0; i<range.count(); i++)
+  {
+    EXPECT_EQ( range.timeAt(i), 4.0 + i );
+    EXPECT_EQ( range.valueAt(i), 400.0 + 100*i );
+  }
+
+  EXPECT_EQ( history.range( a, 0.0, 2.9 ).count(), 0 );
+  EXPECT_EQ( history.range( a, 0.0, 100.0 ).count(), 5 );
+  EXPECT_EQ( history.range( a, 7.0, 7.0 ).count(), 1 );
+
+  // older samples are discarded
+  history.push( 1.0, Sample(0, 0) );
+  EXPECT_EQ( history.outOfOrderCount(), 1 );
+  EXPECT_EQ( history.latest(a), 70 );
+
+  // a new key adds a column; missing keys are NaN
+  RenamedValues other;
+  other.push_back( std::make_pair( std::string("topic/c"), Variant(42.0) ) );
+  history.push( 8.0, other );
+  EXPECT_EQ( history.keys().size(), 3 );
+  EXPECT_EQ( history.latest( history.findKey("topic/c") ), 42 );
+  EXPECT_TRUE( std::isnan( history.latest(a) ) );
+}
+
+TEST(SampleHistory, ChangingKeys)
+{
+  SampleHistory history(3);
+
+  // "topic/a" is always present, "topic/name_i" only in the sample i
+  for (int i=0; i<10; i++)
+  {
+    RenamedValues values;
+    values.push_back( std::make_pair( std::string("topic/a"), Variant( double(i) ) ) );
+    values.push_back( std::make_pair( "topic/name_" + std::to_string(i), Variant( double(i*10) ) ) );
+    history.push( double(i), values );
+  }
+
+  // the columns of the keys missing from the last 3 samples were reused
+  EXPECT_LE( history.keys().size(), 5 );
+  EXPECT_EQ( history.findKey("topic/name_0"), -1 );
+  EXPECT_EQ( history.findKey("topic/name_6"), -1 );
+
+  const int a = history.findKey("topic/a");
+  ASSERT_GE( a, 0 );
+  EXPECT_EQ( history.range( a, 0.0, 100.0 ).count(), 3 );
+  EXPECT_EQ( history.latest(a), 9 );
+
+  // each key has a value only in its own sample
+  for (int i=7; i<10; i++)
+  {
+    const int column = history.findKey( "topic/name_" + std::to_string(i) );
+    ASSERT_GE( column, 0 );
+    SampleHistory::Range range = history.range( column, 0.0, 100.0 );
+    ASSERT_EQ( range.count(), 3 );
+    for (size_t j=0; j<range.count(); j++)
+    {
+      if( range.timeAt(j) == i ){
+        EXPECT_EQ( range.valueAt(j), i*10 );
+      }
+      else{
+        EXPECT_TRUE( std::isnan( range.valueAt(j) ) );
+      }
+    }
+  }
+}
+
+TEST(SampleHistory, Clear)
+{
+  SampleHistory history(4);
+  for (int i=0; i<6; i++)
+  {
+    history.push( double(i), Sample(i*10, i*100) );
+  }
+  history.clear();
+  EXPECT_EQ( history.size(), 0 );
+  EXPECT_EQ( history.findKey("topic/a"), -1 );
+  EXPECT_TRUE( std::isnan( history.latestTime() ) );
+
+  // older timestamps are accepted, nothing from before clear() is returned
+  RenamedValues values;
+  values.push_back( std::make_pair( std::string("topic/c"), Variant(1.0) ) );
+  history.push( 1.0, values );
+  values.push_back( std::make_pair( std::string("topic/a"), Variant(2.0) ) );
+  history.push( 2.0, values );
+
+  EXPECT_EQ( history.size(), 2 );
+  EXPECT_EQ( history.outOfOrderCount(), 0 );
+  EXPECT_EQ( history.findKey("topic/b"), -1 );
+  // the memory of the old columns is reused
+  EXPECT_EQ( history.keys().size(), 2 );
+
+  const int a = history.findKey("topic/a");
+  const int c = history.findKey("topic/c");
+  ASSERT_GE( a, 0 );
+  ASSERT_GE( c, 0 );
+  SampleHistory::Range range = history.range( a, 0.0, 100.0 );
+  ASSERT_EQ( range.count(), 2 );
+  EXPECT_TRUE( std::isnan( range.valueAt(0) ) );
+  EXPECT_EQ( range.valueAt(1), 2 );
+  EXPECT_EQ( history.range( c, 0.0, 100.0 ).count(), 2 );
+  EXPECT_EQ( history.latest(c), 1 );
+
+  // the same layout as before clear() is not mistaken for the current one
+  history.clear();
+  history.push( 5.0, Sample(7, 8) );
+  EXPECT_EQ( history.latest( history.findKey("topic/a") ), 7 );
+  EXPECT_EQ( history.latest( history.findKey("topic/b") ), 8 );
+  EXPECT_EQ( history.range( history.findKey("topic/b"), 0.0, 100.0 ).count(), 1 );
+}
+
+TEST(SampleHistory, FlatMessage)
+{
+  RosIntrospection::Parser parser;
+
+  parser.registerMessageDefinition(
+        "JointState",
+        ROSType(DataType<sensor_msgs::JointState>::value()),
+        Definition<sensor_msgs::JointState>::value());
+
+  sensor_msgs::JointState joint_state;
+  joint_state.name.resize(2);
+  joint_state.position.resize(2);
+
+  SampleHistory history(100);
+  FlatMessage flat_container;
+  std::vector<uint8_t> buffer;
+
+  for (int i=0; i<10; i++)
+  {
+    joint_state.header.stamp = ros::Time(100 + i);
+    joint_state.position[0] = i;
+    joint_state.position[1] = -i;
+
+    buffer = Serialize( joint_state );
+
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    history.push( joint_state.header.stamp.toSec(), flat_container );
+  }
+
+  const int pos_1 = history.findKey("JointState/position.1");
+  ASSERT_GE( pos_1, 0 );
+  SampleHistory::Range range = history.range( pos_1, 102, 104 );
+  ASSERT_EQ( range.count(), 3 );
+  EXPECT_EQ( range.valueAt(0), -2 );
+  EXPECT_EQ( range.valueAt(2), -4 );
+  EXPECT_EQ( history.latest( history.findKey("JointState/header/stamp") ), 109 );
+}
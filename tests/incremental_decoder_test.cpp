@@ -0,0 +1,221 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Image.h>
+#include <tf2_msgs/TFMessage.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/incremental_decoder.hpp>
+#include <random>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+typedef std::vector<std::pair<std::string, std::string>> Leaves;
+
+// Feed the buffer split at the given positions; blob fragments are merged.
+static Leaves Decode(const MessageSchema& schema, std::vector<uint8_t> buffer,
+                     const std::vector<size_t>& splits, uint32_t max_array_size = 100)
+{
+  IncrementalDecoder decoder( schema, max_array_size );
+  Leaves leaves;
+  std::string key;
+
+  auto callback = [&](const IncrementalLeaf& leaf)
+  {
+    const std::string bytes( reinterpret_cast<const char*>( leaf.bytes.data() ), leaf.bytes.size() );
+    if( leaf.is_blob && leaf.blob_offset > 0 )
+    {
+      leaves.back().second.append( bytes );
+      return;
+    }
+    decoder.key( key );
+    leaves.push_back( std::make_pair( key, bytes ) );
+  };
+
+  size_t position = 0;
+  for (size_t split: splits)
+  {
+    EXPECT_EQ( decoder.feed( Span<uint8_t>( buffer.data() + position, split - position ), callback ),
+               split - position );
+    EXPECT_FALSE( decoder.finished() );
+    position = split;
+  }
+  Span<uint8_t> last( buffer.data() + position, buffer.size() - position );
+  EXPECT_EQ( decoder.feed( last, callback ), last.size() );
+  EXPECT_TRUE( decoder.finished() );
+  EXPECT_EQ( decoder.bytesConsumed(), buffer.size() );
+  return leaves;
+}
+
+static std::vector<size_t> EverySplit(size_t step, size_t size)
+{
+  std::vector<size_t> splits;
+  for (size_t split = step; split < size; split += step){
+    splits.push_back( split );
+  }
+  return splits;
+}
+
+TEST(IncrementalDecoder, JointStateSameAsParser)
+{
+  Parser parser;
+  const MessageSchema schema = Schema<sensor_msgs::JointState>( parser, "JointState" );
+
+  sensor_msgs::JointState joint_state;
+  joint_state.header.seq = 2016;
+  joint_state.header.stamp.sec  = 1234;
+  joint_state.header.stamp.nsec = 567*1000*1000;
+  joint_state.header.frame_id = "pippo";
+  const char* names[3] = {"hola", "ciao", "bye"};
+  for (int i=0; i<3; i++)
+  {
+    joint_state.name.push_back( names[i] );
+    joint_state.position.push_back( 11+i );
+    joint_state.velocity.push_back( 21+i );
+    joint_state.effort.push_back( 31+i );
+  }
+  std::vector<uint8_t> buffer = Serialize( joint_state );
+
+  FlatMessage flat_container;
+  parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+
+  IncrementalDecoder decoder( schema );
+  std::vector<std::pair<std::string, double>> values;
+  std::vector<std::pair<std::string, std::string>> strings;
+  std::string key;
+
+  auto callback = [&](const IncrementalLeaf& leaf)
+  {
+    decoder.key( key );
+    if( leaf.field->type_id == STRING ){
+      strings.push_back( std::make_pair( "JointState/" + key,
+                                         std::string( reinterpret_cast<const char*>( leaf.bytes.data() ),
+                                                      leaf.bytes.size() ) ) );
+    }
+    else{
+      size_t offset = 0;
+      const Variant value = ReadFromBufferToVariant( leaf.field->type_id, leaf.bytes, offset );
+      values.push_back( std::make_pair( "JointState/" + key, value.convert<double>() ) );
+    }
+  };
+  // one byte at a time
+  for (size_t i=0; i<buffer.size(); i++)
+  {
+    decoder.feed( Span<uint8_t>( buffer.data() + i, 1 ), callback );
+  }
+  ASSERT_TRUE( decoder.finished() );
+
+  ASSERT_EQ( values.size(), flat_container.value.size() );
+  for (size_t i=0; i<values.size(); i++)
+  {
+    EXPECT_EQ( values[i].first, flat_container.value[i].first.toStdString() );
+    EXPECT_EQ( values[i].second, flat_container.value[i].second.convert<double>() );
+  }
+  ASSERT_EQ( strings.size(), flat_container.name.size() );
+  for (size_t i=0; i<strings.size(); i++)
+  {
+    EXPECT_EQ( strings[i].first, flat_container.name[i].first.toStdString() );
+    EXPECT_EQ( strings[i].second, flat_container.name[i].second );
+  }
+}
+
+TEST(IncrementalDecoder, AnyChunking)
+{
+  Parser parser;
+  const MessageSchema schema = Schema<tf2_msgs::TFMessage>( parser, "tf" );
+
+  tf2_msgs::TFMessage tf_msg;
+  for (int i=0; i<3; i++)
+  {
+    geometry_msgs::TransformStamped transform;
+    transform.header.frame_id = "frame_" + std::to_string(i);
+    transform.child_frame_id = "child_" + std::to_string(i);
+    transform.transform.translation.x = 100 + i;
+    tf_msg.transforms.push_back( transform );
+  }
+  const std::vector<uint8_t> buffer = Serialize( tf_msg );
+  const Leaves expected = Decode( schema, buffer, {} );
+
+  // 3 transforms, each with 3 values in the header, a string and 7 values
+  ASSERT_EQ( expected.size(), 3 * 11 );
+  EXPECT_EQ( expected[2].first, "transforms.0/header/frame_id" );
+  EXPECT_EQ( expected[2].second, "frame_0" );
+  EXPECT_EQ( expected[4].first, "transforms.0/transform/translation/x" );
+
+  for (size_t step=1; step <= buffer.size(); step++)
+  {
+    ASSERT_EQ( Decode( schema, buffer, EverySplit( step, buffer.size() ) ), expected ) << step;
+  }
+
+  std::mt19937 rng( 7 );
+  for (int i=0; i<200; i++)
+  {
+    std::vector<size_t> splits;
+    size_t position = 0;
+    while( true )
+    {
+      position += 1 + rng() % 40;
+      if( position >= buffer.size() ) break;
+      splits.push_back( position );
+    }
+    ASSERT_EQ( Decode( schema, buffer, splits ), expected );
+  }
+}
+
+TEST(IncrementalDecoder, ImageBlob)
+{
+  Parser parser;
+  const MessageSchema schema = Schema<sensor_msgs::Image>( parser, "image" );
+
+  sensor_msgs::Image image;
+  image.header.frame_id = "camera";
+  image.height = 100;
+  image.width  = 100;
+  image.encoding = "mono8";
+  image.step = 100;
+  image.data.resize( 100*100 );
+  for (size_t i=0; i<image.data.size(); i++){
+    image.data[i] = static_cast<uint8_t>( i * 7 );
+  }
+  std::vector<uint8_t> buffer = Serialize( image );
+
+  // the pixels are never assembled by the decoder: the fragments point to the chunks
+  IncrementalDecoder decoder( schema, 100 );
+  size_t blob_bytes = 0;
+  size_t fragments = 0;
+  bool all_equal = true;
+
+  auto callback = [&](const IncrementalLeaf& leaf)
+  {
+    if( !leaf.is_blob ){
+      return;
+    }
+    EXPECT_EQ( leaf.field->name, "data" );
+    EXPECT_EQ( leaf.blob_size, image.data.size() );
+    EXPECT_EQ( leaf.blob_offset, blob_bytes );
+    for (size_t i=0; i<leaf.bytes.size(); i++){
+      all_equal = all_equal && ( leaf.bytes[i] == image.data[leaf.blob_offset + i] );
+    }
+    blob_bytes += leaf.bytes.size();
+    fragments++;
+  };
+
+  const size_t chunk_size = 1500; // a typical MTU
+  for (size_t position=0; position < buffer.size(); position += chunk_size)
+  {
+    const size_t size = std::min( chunk_size, buffer.size() - position );
+    decoder.feed( Span<uint8_t>( buffer.data() + position, size ), callback );
+  }
+  EXPECT_TRUE( decoder.finished() );
+  EXPECT_EQ( blob_bytes, image.data.size() );
+  EXPECT_TRUE( all_equal );
+  EXPECT_GE( fragments, image.data.size() / chunk_size );
+
+  // same leaves with any chunking
+  const Leaves expected = Decode( schema, buffer, {} );
+  EXPECT_EQ( Decode( schema, buffer, EverySplit( 333, buffer.size() ) ), expected );
+  EXPECT_EQ( expected.back().first, "data" );
+  EXPECT_EQ( expected.back().second.size(), image.data.size() );
+}
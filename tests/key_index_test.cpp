@@ -0,0 +1,101 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/key_index.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(KeyIndex, FlatMessage)
+{
+  RosIntrospection::Parser parser;
+  parser.registerMessageDefinition("JointState",
+                                   ROSType(DataType<sensor_msgs::JointState>::value()),
+                                   Definition<sensor_msgs::JointState>::value());
+  FlatMessage flat_container;
+  FlatKeyIndex index;
+
+  for (int i=0; i<3; i++)
+  {
+    std::vector<uint8_t> buffer = SerializedJointState( 3, i );
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    index.sync( flat_container );
+
+    EXPECT_EQ( index.value("JointState/header/seq")->convert<double>(), 2016 );
+    EXPECT_EQ( index.value("JointState/velocity.2")->convert<double>(), 22 + i );
+    EXPECT_EQ( *index.name("JointState/name.1"), "ciao" );
+    EXPECT_EQ( index.value("JointState/velocity.3"), nullptr );
+    EXPECT_EQ( index.name("JointState/name.3"), nullptr );
+  }
+  // built once for the values and once for the names
+  EXPECT_EQ( index.rebuildCount(), 2 );
+
+  // different layout
+  std::vector<uint8_t> buffer = SerializedJointState( 5, 0 );
+  parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+  index.sync( flat_container );
+  EXPECT_EQ( index.value("JointState/velocity.4")->convert<double>(), 24 );
+  EXPECT_EQ( index.rebuildCount(), 3 );
+  EXPECT_EQ( *index.name("JointState/name.3"), "hola" );
+  EXPECT_EQ( index.rebuildCount(), 4 );
+
+  FlatKeyIndex not_synced;
+  EXPECT_EQ( not_synced.value("JointState/header/seq"), nullptr );
+}
+
+TEST(KeyIndex, RenamedValues)
+{
+  RosIntrospection::Parser parser;
+  ROSType main_type( DataType<sensor_msgs::JointState>::value() );
+  parser.registerMessageDefinition("JointState", main_type,
+                                   Definition<sensor_msgs::JointState>::value());
+  std::vector<SubstitutionRule> rules;
+  rules.push_back( SubstitutionRule("position.#", "name.#", "@/pos") );
+  parser.registerRenamingRules( main_type, rules );
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+  RenamedKeyIndex index;
+
+  for (int i=0; i<3; i++)
+  {
+    std::vector<uint8_t> buffer = SerializedJointState( 3, i );
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    parser.applyNameTransform("JointState", flat_container, &renamed_values);
+    index.sync( renamed_values );
+
+    EXPECT_EQ( index.get("JointState/hola/pos")->convert<double>(), 10 + i );
+    EXPECT_EQ( index.get("JointState/bye/pos")->convert<double>(), 12 + i );
+    EXPECT_EQ( index.get("JointState/nobody/pos"), nullptr );
+    EXPECT_EQ( index.get("JointState/nobody/vel"), nullptr );
+  }
+  EXPECT_EQ( index.rebuildCount(), 1 );
+
+  // a key that is missing from the index, but not from the new message
+  std::vector<uint8_t> buffer = SerializedJointState( 4, 0 );
+  parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+  parser.applyNameTransform("JointState", flat_container, &renamed_values);
+  index.sync( renamed_values );
+  EXPECT_EQ( index.get("JointState/velocity.3")->convert<double>(), 23 );
+  EXPECT_EQ( index.rebuildCount(), 2 );
+}
+
+TEST(KeyIndex, HashTable)
+{
+  KeyHashTable table;
+  std::vector<std::string> keys;
+  for (int i=0; i<2000; i++)
+  {
+    keys.push_back( "expression/" + std::to_string(i) );
+  }
+  table.build( keys );
+  for (int i=0; i<2000; i++)
+  {
+    EXPECT_EQ( table.find( keys[i] ), i );
+  }
+  EXPECT_EQ( table.find("expression/2000"), -1 );
+  EXPECT_EQ( table.find(""), -1 );
+}
@@ -0,0 +1,148 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/parser_probe.hpp>
+#include <atomic>
+#include <thread>
+
+using namespace RosIntrospection;
+
+// compiled with -DROS_INTROSPECTION_TEST_PROBES=1 (see CMakeLists.txt)
+static_assert( ParserProbe::enabled(), "the probes must be enabled in this test" );
+
+TEST(ParserProbe, CountersAndReset)
+{
+  Parser parser;
+  Register<sensor_msgs::JointState>( parser, "joints" );
+  Register<sensor_msgs::JointState>( parser, "other_joints" );
+
+  ParserProbe probe;
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+  size_t bytes = 0;
+
+  for (int i=0; i<10; i++)
+  {
+    std::vector<uint8_t> buffer = SerializedJointState( 3, i );
+    bytes += buffer.size();
+    EXPECT_TRUE( probe.deserializeIntoFlatContainer( parser, "joints", Span<uint8_t>(buffer),
+                                                     &flat_container, 100 ) );
+    probe.applyNameTransform( parser, "joints", flat_container, &renamed_values );
+  }
+  // the arrays are larger than max_array_size
+  std::vector<uint8_t> large = SerializedJointState( 10, 0 );
+  EXPECT_FALSE( probe.deserializeIntoFlatContainer( parser, "other_joints", Span<uint8_t>(large),
+                                                    &flat_container, 5 ) );
+
+  std::map<std::string, ProbeCounters> snapshot = probe.snapshot();
+  ASSERT_EQ( snapshot.size(), 2 );
+  const ProbeCounters& joints = snapshot["joints"];
+  EXPECT_EQ( joints.messages, 10 );
+  EXPECT_EQ( joints.bytes, bytes );
+  EXPECT_EQ( joints.truncated, 0 );
+  // seq, stamp and 3 arrays of 3 values
+  EXPECT_EQ( joints.flat_values, 10 * (2 + 3*3) );
+  EXPECT_EQ( joints.renamed_values, 10 * (2 + 3*3) );
+  EXPECT_EQ( snapshot["other_joints"].messages, 1 );
+  EXPECT_EQ( snapshot["other_joints"].truncated, 1 );
+
+  probe.reset();
+  snapshot = probe.snapshot();
+  ASSERT_EQ( snapshot.size(), 2 );
+  EXPECT_EQ( snapshot["joints"].messages, 0 );
+  EXPECT_EQ( snapshot["joints"].bytes, 0 );
+  EXPECT_EQ( snapshot["joints"].totalTimeNs(), 0 );
+  EXPECT_EQ( snapshot["other_joints"].truncated, 0 );
+}
+
+TEST(ParserProbe, TraceHook)
+{
+  Parser parser;
+  Register<sensor_msgs::JointState>( parser, "joints" );
+
+  ParserProbe probe;
+  std::vector<ProbeEvent> events;
+  std::vector<std::string> topics;
+  probe.setTraceHook( [&](const ProbeEvent& event)
+  {
+    events.push_back( event );
+    topics.push_back( *event.topic );
+  });
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+  std::vector<uint8_t> buffer = SerializedJointState( 3, 0 );
+  probe.deserializeIntoFlatContainer( parser, "joints", Span<uint8_t>(buffer), &flat_container, 100 );
+  probe.applyNameTransform( parser, "joints", flat_container, &renamed_values );
+
+  ASSERT_EQ( events.size(), 4 );
+  EXPECT_EQ( events[0].phase, ProbeEvent::BEGIN );
+  EXPECT_EQ( events[1].phase, ProbeEvent::END );
+  EXPECT_EQ( std::string(events[0].name), "deserialize" );
+  EXPECT_EQ( std::string(events[2].name), "rename" );
+  EXPECT_EQ( events[3].phase, ProbeEvent::END );
+  EXPECT_LE( events[0].timestamp_ns, events[1].timestamp_ns );
+  for (const std::string& topic: topics){
+    EXPECT_EQ( topic, "joints" );
+  }
+
+  probe.setTraceHook( ParserProbe::TraceHook() );
+  probe.deserializeIntoFlatContainer( parser, "joints", Span<uint8_t>(buffer), &flat_container, 100 );
+  EXPECT_EQ( events.size(), 4 );
+
+  // a TopicProbe resolved before the hook was replaced uses the new one
+  ParserProbe::TopicProbe topic = probe.topic( "joints" );
+  EXPECT_EQ( topic.name(), "joints" );
+  probe.deserializeIntoFlatContainer( parser, topic, Span<uint8_t>(buffer), &flat_container, 100 );
+  EXPECT_EQ( events.size(), 4 );
+  probe.setTraceHook( [&](const ProbeEvent& event)
+  {
+    events.push_back( event );
+    topics.push_back( *event.topic );
+  });
+  probe.deserializeIntoFlatContainer( parser, topic, Span<uint8_t>(buffer), &flat_container, 100 );
+  probe.applyNameTransform( parser, topic, flat_container, &renamed_values );
+  EXPECT_EQ( events.size(), 8 );
+  EXPECT_EQ( topics.back(), "joints" );
+  EXPECT_EQ( probe.snapshot()["joints"].messages, 3 );
+}
+
+TEST(ParserProbe, ResetAndHookWhileRunning)
+{
+  Parser parser;
+  Register<sensor_msgs::JointState>( parser, "joints" );
+  const std::vector<uint8_t> buffer = SerializedJointState( 3, 0 );
+
+  ParserProbe probe;
+  std::atomic<uint64_t> hook_calls( 0 );
+  std::atomic<bool> stop( false );
+  const ParserProbe::TraceHook hook = [&hook_calls](const ProbeEvent&) { hook_calls++; };
+  probe.setTraceHook( hook );
+
+  std::thread worker( [&]()
+  {
+    FlatMessage flat_container;
+    std::vector<uint8_t> message = buffer;
+    ParserProbe::TopicProbe topic = probe.topic( "joints" );
+    while( !stop )
+    {
+      probe.deserializeIntoFlatContainer( parser, topic, Span<uint8_t>(message),
+                                          &flat_container, 100 );
+    }
+  });
+
+  for (int i=0; i<200; i++)
+  {
+    probe.setTraceHook( hook );
+    probe.reset();
+    std::this_thread::yield();
+  }
+  stop = true;
+  worker.join();
+
+  // BEGIN and END of every message counted after the last reset
+  EXPECT_LE( probe.snapshot()["joints"].messages * 2, hook_calls.load() );
+}
@@ -0,0 +1,139 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/message_patcher.hpp>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(Patcher, JointStateFrameIdAndTruncate)
+{
+  RosIntrospection::Parser parser;
+
+  parser.registerMessageDefinition(
+        "JointState",
+        ROSType(DataType<sensor_msgs::JointState>::value()),
+        Definition<sensor_msgs::JointState>::value());
+
+  sensor_msgs::JointState joint_state;
+  joint_state.header.seq = 2016;
+  joint_state.header.stamp.sec  = 1234;
+  joint_state.header.stamp.nsec = 567*1000*1000;
+  joint_state.header.frame_id = "pippo";
+
+  const int NUM = 5;
+  const char* names[3] = {"hola", "ciao", "bye"};
+  for (int i=0; i<NUM; i++)
+  {
+    joint_state.name.push_back( names[i%3] );
+    joint_state.position.push_back( 10+i );
+    joint_state.velocity.push_back( 30+i );
+    joint_state.effort.push_back( 50+i );
+  }
+
+  std::vector<uint8_t> buffer = Serialize(joint_state);
+
+  MessagePatcher patcher(parser, "JointState");
+  // this is what applyVisitorToBuffer can NOT do: the size of the message changes
+  patcher.replaceString("header/frame_id", "a_much_longer_frame_id");
+  patcher.truncateArray("position", 2);
+  patcher.truncateArray("name", 1);
+
+  std::vector<uint8_t> patched;
+  EXPECT_EQ( patcher.apply( Span<uint8_t>(buffer), &patched ), 3 );
+
+  sensor_msgs::JointState result = Deserialize<sensor_msgs::JointState>(patched);
+
+  EXPECT_EQ( patched.size(), ros::serialization::serializationLength(result) );
+  EXPECT_EQ( result.header.seq,      joint_state.header.seq );
+  EXPECT_EQ( result.header.stamp,    joint_state.header.stamp );
+  EXPECT_EQ( result.header.frame_id, "a_much_longer_frame_id" );
+
+  ASSERT_EQ( result.name.size(), 1 );
+  EXPECT_EQ( result.name[0], "hola" );
+  ASSERT_EQ( result.position.size(), 2 );
+  EXPECT_EQ( result.position[0], 10 );
+  EXPECT_EQ( result.position[1], 11 );
+  EXPECT_EQ( result.velocity, joint_state.velocity );
+  EXPECT_EQ( result.effort,   joint_state.effort );
+
+  // without edits, the output is identical to the input
+  patcher.clear();
+  EXPECT_EQ( patcher.apply( Span<uint8_t>(buffer), &patched ), 0 );
+  EXPECT_EQ( patched, buffer );
+
+  EXPECT_THROW( patcher.replaceString("header/seq", "foo"), std::runtime_error );
+  EXPECT_THROW( patcher.truncateArray("header", 1), std::runtime_error );
+  EXPECT_THROW( patcher.replaceString("name.2", "foo"), std::runtime_error );
+  EXPECT_THROW( patcher.replaceString("not_a_field", "foo"), std::runtime_error );
+}
+
+TEST(Patcher, TFMessageHeaders)
+{
+  RosIntrospection::Parser parser;
+
+  parser.registerMessageDefinition(
+        "tf",
+        ROSType(DataType<tf2_msgs::TFMessage>::value()),
+        Definition<tf2_msgs::TFMessage>::value());
+
+  tf2_msgs::TFMessage tf_msg;
+  for (int i=0; i<4; i++)
+  {
+    geometry_msgs::TransformStamped transform;
+    transform.header.seq = i;
+    transform.header.frame_id = "parent_" + std::to_string(i);
+    transform.child_frame_id  = "child_" + std::to_string(i);
+    transform.transform.translation.x = i;
+    transform.transform.rotation.w = 1;
+    tf_msg.transforms.push_back( transform );
+  }
+
+  std::vector<uint8_t> buffer = Serialize(tf_msg);
+  std::vector<uint8_t> patched;
+
+  // by path: all the elements of the array
+  MessagePatcher by_path(parser, "tf");
+  by_path.replaceString("transforms.#/header/frame_id", "world");
+  EXPECT_EQ( by_path.apply( Span<uint8_t>(buffer), &patched ), 4 );
+
+  tf2_msgs::TFMessage result = Deserialize<tf2_msgs::TFMessage>(patched);
+  ASSERT_EQ( result.transforms.size(), 4 );
+  for (int i=0; i<4; i++)
+  {
+    EXPECT_EQ( result.transforms[i].header.frame_id, "world" );
+    EXPECT_EQ( result.transforms[i].header.seq, i );
+    EXPECT_EQ( result.transforms[i].child_frame_id, tf_msg.transforms[i].child_frame_id );
+    EXPECT_EQ( result.transforms[i].transform.translation.x, i );
+  }
+
+  // by type: every std_msgs/Header, deserialized and serialized again
+  MessagePatcher by_type(parser, "tf");
+  by_type.rewriteType( ROSType(DataType<std_msgs::Header>::value()),
+                       [](const ROSType&, const Span<uint8_t>& original, std::vector<uint8_t>& output)
+  {
+    std_msgs::Header header;
+    ros::serialization::IStream is( original.data(), original.size() );
+    ros::serialization::deserialize(is, header);
+
+    header.frame_id = "prefix/" + header.frame_id;
+
+    const size_t offset = output.size();
+    output.resize( offset + ros::serialization::serializationLength(header) );
+    ros::serialization::OStream os( &output[offset], output.size() - offset );
+    ros::serialization::serialize(os, header);
+  });
+  EXPECT_EQ( by_type.apply( Span<uint8_t>(buffer), &patched ), 4 );
+
+  result = Deserialize<tf2_msgs::TFMessage>(patched);
+  ASSERT_EQ( result.transforms.size(), 4 );
+  for (int i=0; i<4; i++)
+  {
+    EXPECT_EQ( result.transforms[i].header.frame_id, "prefix/parent_" + std::to_string(i) );
+    EXPECT_EQ( result.transforms[i].child_frame_id, tf_msg.transforms[i].child_frame_id );
+  }
+}
@@ -0,0 +1,107 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <ros_introspection_test/FrankaError.h>
+#include <ros_introspection_test/MotorStatus.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/raw_predicate.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(RawPredicate, FrankaError)
+{
+  using ros_introspection_test::FrankaError;
+  Parser parser;
+  const MessageSchema schema = Schema<FrankaError>( parser, "topic" );
+
+  RawPredicate any_error( schema, "*" );
+  EXPECT_EQ( any_error.readersCount(), 36 );
+
+  RawPredicate reflex( schema, "cartesian_reflex == true && !joint_reflex" );
+
+  FrankaError error{};
+  std::vector<uint8_t> buffer = Serialize( error );
+  EXPECT_FALSE( any_error.evaluate( Span<uint8_t>(buffer) ) );
+  EXPECT_FALSE( reflex.evaluate( Span<uint8_t>(buffer) ) );
+
+  error.cartesian_reflex = true;
+  buffer = Serialize( error );
+  EXPECT_TRUE( any_error.evaluate( Span<uint8_t>(buffer) ) );
+  EXPECT_TRUE( reflex.evaluate( Span<uint8_t>(buffer) ) );
+
+  error.joint_reflex = true;
+  buffer = Serialize( error );
+  EXPECT_FALSE( reflex.evaluate( Span<uint8_t>(buffer) ) );
+
+  EXPECT_THROW( RawPredicate( schema, "not_a_field > 1" ), std::runtime_error );
+  EXPECT_THROW( RawPredicate( schema, "joint_reflex >" ), std::runtime_error );
+  EXPECT_THROW( RawPredicate( schema, "(joint_reflex" ), std::runtime_error );
+  EXPECT_THROW( RawPredicate( schema, "joint_reflex == 'yes'" ), std::runtime_error );
+}
+
+TEST(RawPredicate, MotorStatus)
+{
+  using ros_introspection_test::MotorStatus;
+  Parser parser;
+  const MessageSchema schema = Schema<MotorStatus>( parser, "topic" );
+
+  RawPredicate error( schema, "error[*] != 0" );
+  RawPredicate overheat( schema, "motortemperature.# > 80 || error.2 < 0" );
+  RawPredicate combined( schema, "(error[*] != 0) && drivertemperature[0] >= 50" );
+
+  MotorStatus status;
+  status.position.resize( 6, 1 );
+  status.speed.resize( 6, 2 );
+  status.torque.resize( 6, 3 );
+  status.drivertemperature.resize( 6, 20 );
+  status.motortemperature.resize( 6, 20 );
+  status.error.resize( 6, 0 );
+
+  std::vector<uint8_t> buffer = Serialize( status );
+  EXPECT_FALSE( error.evaluate( Span<uint8_t>(buffer) ) );
+  EXPECT_FALSE( overheat.evaluate( Span<uint8_t>(buffer) ) );
+
+  // the walk must fail on a truncated buffer, if it reaches the end
+  std::vector<uint8_t> truncated( buffer.begin(), buffer.end() - 3 );
+  EXPECT_THROW( error.evaluate( Span<uint8_t>(truncated) ), std::runtime_error );
+
+  status.error[4] = -3;
+  buffer = Serialize( status );
+  EXPECT_TRUE( error.evaluate( Span<uint8_t>(buffer) ) );
+  EXPECT_FALSE( overheat.evaluate( Span<uint8_t>(buffer) ) );
+  EXPECT_FALSE( combined.evaluate( Span<uint8_t>(buffer) ) );
+
+  status.drivertemperature[0] = 90;
+  status.motortemperature[5] = 90;
+  buffer = Serialize( status );
+  EXPECT_TRUE( overheat.evaluate( Span<uint8_t>(buffer) ) );
+  EXPECT_TRUE( combined.evaluate( Span<uint8_t>(buffer) ) );
+}
+
+TEST(RawPredicate, Strings)
+{
+  Parser parser;
+  const MessageSchema schema = Schema<sensor_msgs::JointState>( parser, "topic" );
+
+  sensor_msgs::JointState joint_state;
+  joint_state.header.frame_id = "base";
+  joint_state.header.stamp.sec = 1234;
+  const char* names[3] = {"hola", "ciao", "bye"};
+  for (int i=0; i<4; i++)
+  {
+    joint_state.name.push_back( names[i%3] );
+    joint_state.position.push_back( 10 + i );
+  }
+  const std::vector<uint8_t> buffer = Serialize( joint_state );
+  const Span<uint8_t> span( buffer );
+
+  EXPECT_TRUE(  RawPredicate( schema, "name.# == 'ciao'" ).evaluate( span ) );
+  EXPECT_FALSE( RawPredicate( schema, "name.# == \"hello\"" ).evaluate( span ) );
+  EXPECT_TRUE(  RawPredicate( schema, "header/* == 'base'" ).evaluate( span ) );
+  EXPECT_TRUE(  RawPredicate( schema, "header/stamp > 1000 && position[3] == 13" ).evaluate( span ) );
+  EXPECT_TRUE(  RawPredicate( schema, "header/frame_id" ).evaluate( span ) );
+  EXPECT_THROW( RawPredicate( schema, "header/frame_id > 3" ), std::runtime_error );
+}
@@ -0,0 +1,87 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/bag_prefetcher.hpp>
+#include <rosbag/bag.h>
+#include <algorithm>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(BagPrefetcher, SameMessagesAsView)
+{
+  TemporaryDirectory directory;
+  const std::string filename = directory.path( "prefetcher_test.bag" );
+  {
+    rosbag::Bag bag( filename, rosbag::bagmode::Write );
+    bag.setCompression( rosbag::compression::LZ4 );
+    // many small chunks
+    bag.setChunkThreshold( 4096 );
+    for (int i=0; i<2000; i++)
+    {
+      const ros::Time time( 1000 + i / 100, (i % 100) * 10000000 );
+      sensor_msgs::Imu imu;
+      imu.linear_acceleration.z = i;
+      bag.write( "/imu", time, imu );
+
+      sensor_msgs::JointState joint_state;
+      joint_state.position.resize( i % 50, i );
+      bag.write( "/joint_states", time, joint_state );
+    }
+    bag.close();
+  }
+
+  rosbag::Bag bag( filename, rosbag::bagmode::Read );
+
+  // reference: the messages read directly from the View
+  std::vector<std::vector<uint8_t>> expected;
+  std::vector<std::string> expected_topics;
+  {
+    rosbag::View view( bag );
+    for(const rosbag::MessageInstance& msg_instance: view)
+    {
+      std::vector<uint8_t> buffer( msg_instance.size() );
+      ros::serialization::OStream stream( buffer.data(), buffer.size() );
+      msg_instance.write( stream );
+      expected.push_back( buffer );
+      expected_topics.push_back( msg_instance.getTopic() );
+    }
+  }
+  ASSERT_EQ( expected.size(), 4000 );
+
+  // batches smaller than a message, of a few messages, and larger than the bag
+  for (size_t batch_size: {16, 1024, 64*1024*1024})
+  {
+    rosbag::View view( bag );
+    BagPrefetcher prefetcher( view, batch_size, 3 );
+    PrefetchedMessage message;
+    size_t count = 0;
+
+    while( prefetcher.next( message ) )
+    {
+      ASSERT_LT( count, expected.size() );
+      EXPECT_EQ( *message.topic, expected_topics[count] );
+      ASSERT_EQ( message.buffer.size(), expected[count].size() );
+      EXPECT_TRUE( std::equal( message.buffer.begin(), message.buffer.end(),
+                               expected[count].begin() ) );
+      count++;
+    }
+    EXPECT_EQ( count, expected.size() );
+    EXPECT_FALSE( prefetcher.next( message ) );
+  }
+
+  // destroyed while the background thread is waiting for a free batch
+  {
+    rosbag::View view( bag );
+    BagPrefetcher prefetcher( view, 1024 );
+    PrefetchedMessage message;
+    ASSERT_TRUE( prefetcher.next( message ) );
+  }
+
+  rosbag::View view( bag );
+  EXPECT_THROW( BagPrefetcher( view, 1024, 1 ), std::runtime_error );
+}
@@ -1,8 +1,11 @@
 #include "config.h"
+#include "test_helpers.hpp"
 #include <gtest/gtest.h>
 
 #include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
 #include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/linear_renamer.hpp>
 
 using namespace ros::message_traits;
 using namespace RosIntrospection;
@@ -141,9 +144,7 @@ TEST(Renamer2, DeserializeJointStateAndRename)
     joint_state.effort[i]= 31+i;
   }
 
-  std::vector<uint8_t> buffer( ros::serialization::serializationLength(joint_state) );
-  ros::serialization::OStream stream(buffer.data(), buffer.size());
-  ros::serialization::Serializer<sensor_msgs::JointState>::write(stream, joint_state);
+  std::vector<uint8_t> buffer = Serialize( joint_state );
 
   FlatMessage flat_container;
   RenamedValues renamed_value;
@@ -201,3 +202,205 @@ TEST(Renamer2, DeserializeJointStateAndRename)
 
 }
 
+
+TEST(LinearRenamer, SameAsParserJointState)
+{
+  RosIntrospection::Parser parser;
+  LinearRenamer renamer;
+
+  std::vector<SubstitutionRule> rules;
+  rules.push_back( SubstitutionRule("position.#", "name.#", "@/pos") );
+  rules.push_back( SubstitutionRule("velocity.#", "name.#", "@/vel") );
+  rules.push_back( SubstitutionRule("effort.#",   "name.#", "@/eff") );
+  renamer.addRule("position.#", "name.#", "@/pos");
+  renamer.addRule("velocity.#", "name.#", "@/vel");
+  renamer.addRule("effort.#",   "name.#", "@/eff");
+
+  ROSType main_type( DataType<sensor_msgs::JointState>::value() );
+  parser.registerMessageDefinition("JointState", main_type,
+                                   Definition<sensor_msgs::JointState>::value());
+  parser.registerRenamingRules( main_type, rules);
+
+  sensor_msgs::JointState joint_state;
+  joint_state.header.frame_id = "pippo";
+  const char* names[4] = {"hola", "ciao", "bye", "hello"};
+  for (int i=0; i<4; i++)
+  {
+    joint_state.name.push_back( names[i] );
+    joint_state.position.push_back( 11+i );
+    joint_state.velocity.push_back( 21+i );
+    joint_state.effort.push_back( 31+i );
+  }
+  // a value without name keeps its original key
+  joint_state.position.push_back( 15 );
+
+  std::vector<uint8_t> buffer = Serialize( joint_state );
+
+  FlatMessage flat_container;
+  RenamedValues expected;
+  RenamedValues renamed_value;
+
+  parser.deserializeIntoFlatContainer("JointState",  Span<uint8_t>(buffer),  &flat_container,100);
+  parser.applyNameTransform("JointState",  flat_container, &expected);
+  renamer.apply( flat_container, &renamed_value );
+
+  ASSERT_EQ( renamed_value.size(), expected.size() );
+  for (size_t i=0; i<expected.size(); i++)
+  {
+    EXPECT_EQ( renamed_value[i].first, expected[i].first );
+    EXPECT_EQ( renamed_value[i].second.convert<double>(), expected[i].second.convert<double>() );
+  }
+  EXPECT_EQ( renamed_value[6].first, "JointState/position.4" );
+}
+
+TEST(LinearRenamer, TFMessage)
+{
+  RosIntrospection::Parser parser;
+  LinearRenamer renamer;
+  const ROSType tf_type( DataType<tf2_msgs::TFMessage>::value() );
+  parser.registerMessageDefinition("tf", tf_type, Definition<tf2_msgs::TFMessage>::value());
+  parser.registerRenamingRules( tf_type, RenamingRules() );
+  for (const auto& rule: RENAMING_RULES)
+  {
+    renamer.addRule( rule[0], rule[1], rule[2] );
+  }
+
+  FlatMessage flat_container;
+  RenamedValues expected;
+  RenamedValues renamed_value;
+
+  for (int size: {3, 1, 10, 50, 300, 2})
+  {
+    std::vector<uint8_t> buffer = SerializedTF( size, 100 );
+    parser.deserializeIntoFlatContainer("tf",  Span<uint8_t>(buffer),  &flat_container, 1000);
+    parser.applyNameTransform("tf", flat_container, &expected);
+    renamer.apply( flat_container, &renamed_value );
+
+    // 2 values in the header, 7 in the transform
+    ASSERT_EQ( renamed_value.size(), size * 9 );
+    ASSERT_EQ( renamed_value.size(), expected.size() );
+    for (size_t i=0; i<expected.size(); i++)
+    {
+      EXPECT_EQ( renamed_value[i].first, expected[i].first );
+      EXPECT_EQ( renamed_value[i].second.convert<double>(), expected[i].second.convert<double>() );
+    }
+    EXPECT_EQ( renamed_value[2].first, "tf/transforms.frame_0/translation/x" );
+    EXPECT_EQ( renamed_value[2].second.convert<double>(), 100 );
+  }
+}
+
+TEST(LinearRenamer, NestedArrays)
+{
+  // an array of groups, each with its own names and values
+  RosIntrospection::Parser parser;
+  parser.registerMessageDefinition("groups", ROSType("test_msgs/Groups"),
+                                   "test_msgs/Group[] groups\n"
+                                   "================================================================================\n"
+                                   "MSG: test_msgs/Group\n"
+                                   "string[] names\n"
+                                   "float64[] values\n");
+  LinearRenamer renamer;
+  renamer.addRule("groups.#.values.#", "groups.#.names.#", "@");
+
+  std::vector<uint8_t> buffer;
+  auto Write = [&buffer](const void* data, size_t size)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert( buffer.end(), bytes, bytes + size );
+  };
+  const std::vector<std::vector<std::string>> names = { {"a", "b"}, {"c"} };
+  const std::vector<std::vector<double>> values = { {1, 2}, {3, 4} };
+  const uint32_t groups_count = 2;
+  Write( &groups_count, 4 );
+  for (int g=0; g<2; g++)
+  {
+    const uint32_t names_count = names[g].size();
+    Write( &names_count, 4 );
+    for (const std::string& name: names[g])
+    {
+      const uint32_t length = name.size();
+      Write( &length, 4 );
+      Write( name.data(), name.size() );
+    }
+    const uint32_t values_count = values[g].size();
+    Write( &values_count, 4 );
+    Write( values[g].data(), values[g].size() * sizeof(double) );
+  }
+
+  FlatMessage flat_container;
+  RenamedValues renamed_value;
+  parser.deserializeIntoFlatContainer("groups", Span<uint8_t>(buffer), &flat_container, 100);
+  renamer.apply( flat_container, &renamed_value );
+
+  // both indices select the name; a value without name keeps its key
+  ASSERT_EQ( renamed_value.size(), 4 );
+  EXPECT_EQ( renamed_value[0].first, "groups/a" );
+  EXPECT_EQ( renamed_value[1].first, "groups/b" );
+  EXPECT_EQ( renamed_value[2].first, "groups/c" );
+  EXPECT_EQ( renamed_value[3].first, "groups/groups.1/values.1" );
+  for (int i=0; i<4; i++)
+  {
+    EXPECT_EQ( renamed_value[i].second.convert<double>(), i + 1 );
+  }
+
+  EXPECT_THROW( renamer.addRule("groups.#.values", "groups.#.names.#", "@"), std::runtime_error );
+}
+
+TEST(LinearRenamer, NameEncoder)
+{
+  RosIntrospection::Parser parser;
+  LinearRenamer renamer;
+  renamer.addRule("position.#", "name.#", "@/pos");
+  parser.registerMessageDefinition("JointState",
+                                   ROSType(DataType<sensor_msgs::JointState>::value()),
+                                   Definition<sensor_msgs::JointState>::value());
+  NameEncoder names;
+  FlatMessage flat_container;
+  RenamedValues renamed_value;
+
+  auto update = [&](const std::vector<std::string>& joint_names, double offset) -> bool
+  {
+    sensor_msgs::JointState joint_state;
+    joint_state.header.frame_id = "base";
+    for (size_t i=0; i<joint_names.size(); i++)
+    {
+      joint_state.name.push_back( joint_names[i] );
+      joint_state.position.push_back( offset + i );
+    }
+    std::vector<uint8_t> buffer = Serialize( joint_state );
+
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    const bool unchanged = names.update( flat_container );
+    renamer.apply( flat_container, names, &renamed_value );
+    return unchanged;
+  };
+
+  // frame_id and 3 names
+  EXPECT_FALSE( update( {"hola", "ciao", "bye"}, 10 ) );
+  EXPECT_EQ( names.codes(), std::vector<uint32_t>({0, 1, 2, 3}) );
+
+  EXPECT_TRUE( update( {"hola", "ciao", "bye"}, 20 ) );
+  EXPECT_TRUE( update( {"hola", "ciao", "bye"}, 30 ) );
+  EXPECT_EQ( names.generation(), 1 );
+
+  // the keys are reused, the values are new
+  const auto findValue = [&](const std::string& key) -> double
+  {
+    for (const auto& it: renamed_value){
+      if( it.first == key ) return it.second.convert<double>();
+    }
+    return -1.0;
+  };
+  EXPECT_EQ( findValue("JointState/ciao/pos"), 31 );
+
+  // same strings, different order: the codes are the same, the keys are not
+  EXPECT_FALSE( update( {"hola", "bye", "ciao"}, 40 ) );
+  EXPECT_EQ( names.codes(), std::vector<uint32_t>({0, 1, 3, 2}) );
+  EXPECT_EQ( findValue("JointState/ciao/pos"), 42 );
+  EXPECT_EQ( names.dictionary().size(), 4 );
+
+  EXPECT_FALSE( update( {"hola", "bye"}, 50 ) );
+  EXPECT_TRUE( update( {"hola", "bye"}, 60 ) );
+  EXPECT_EQ( findValue("JointState/bye/pos"), 61 );
+  EXPECT_EQ( findValue("JointState/ciao/pos"), -1 );
+}
@@ -0,0 +1,192 @@
+#include <ros_type_introspection/ros_introspection.hpp>
+#include <ros_introspection_test/message_corpus.hpp>
+#include <ros_introspection_test/perf_counters.hpp>
+#include "test_helpers.hpp"
+#include <set>
+#include <iostream>
+
+#include <benchmark/benchmark.h>
+
+using namespace RosIntrospection;
+
+// usage: ros_introspection_replay file.corpus [--benchmark_filter=...]
+//                                 [--benchmark_out=run.json --benchmark_out_format=json]
+//
+// Replays the messages of a MessageCorpus (see example/generate_corpus.cpp), always
+// in the same order, through the Parser. For all the topics together and for each
+// topic separately, it measures these stages:
+//
+//   Register:     registerMessageDefinition of the topics (and renaming rules).
+//   Deserialize:  deserializeIntoFlatContainer of each message.
+//   Rename:       Deserialize + applyNameTransform.
+//   Convert:      Rename + convert<double> of every value.
+//
+// Each stage includes the previous one: the cost of a stage is the difference.
+// The hardware counters (per message, per topic for Register) are reported when
+// perf_event is available. Two JSON outputs can be compared with tools/compare.py
+// of Google Benchmark.
+
+static const uint32_t MAX_ARRAY_SIZE = 100;
+
+enum Stage
+{
+  REGISTER,
+  DESERIALIZE,
+  RENAME,
+  CONVERT
+};
+
+static MessageCorpus corpus;
+
+struct ReplaySet
+{
+  std::vector<uint32_t> topics;
+  std::vector<size_t> messages;
+  size_t bytes;
+};
+
+static void RegisterTopics(Parser& parser, const std::vector<uint32_t>& topics)
+{
+  std::set<std::string> renamed_types;
+  for(uint32_t index: topics)
+  {
+    const CorpusTopic& topic = corpus.topics()[index];
+    const ROSType type( topic.datatype );
+    parser.registerMessageDefinition( topic.name, type, topic.definition );
+
+    if( ( topic.datatype == "sensor_msgs/JointState" || topic.datatype == "tf2_msgs/TFMessage" ) &&
+        renamed_types.insert( topic.datatype ).second )
+    {
+      parser.registerRenamingRules( type, RenamingRules() );
+    }
+  }
+}
+
+static void BM_Replay(benchmark::State& state, Stage stage, const ReplaySet& set)
+{
+  Parser parser;
+  if( stage != REGISTER ){
+    RegisterTopics( parser, set.topics );
+  }
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+  double sum = 0;
+
+  PerfCounters counters;
+  counters.start();
+
+  while (state.KeepRunning())
+  {
+    if( stage == REGISTER )
+    {
+      Parser new_parser;
+      RegisterTopics( new_parser, set.topics );
+      continue;
+    }
+    for(size_t index: set.messages)
+    {
+      const std::string& topic_name = corpus.topics()[ corpus.message(index).topic ].name;
+      parser.deserializeIntoFlatContainer( topic_name, corpus.buffer(index),
+                                           &flat_container, MAX_ARRAY_SIZE );
+      if( stage == DESERIALIZE ){
+        continue;
+      }
+      parser.applyNameTransform( topic_name, flat_container, &renamed_values );
+      if( stage == CONVERT )
+      {
+        for(const auto& value: renamed_values){
+          sum += value.second.convert<double>();
+        }
+      }
+    }
+  }
+  counters.stop();
+  benchmark::DoNotOptimize( sum );
+
+  const size_t items = ( stage == REGISTER ) ? set.topics.size() : set.messages.size();
+  state.SetItemsProcessed( state.iterations() * items );
+  if( stage != REGISTER ){
+    state.SetBytesProcessed( state.iterations() * set.bytes );
+  }
+
+  const double total_items = static_cast<double>( state.iterations() * items );
+  for(int i=0; i < PerfCounters::EVENTS_COUNT; i++)
+  {
+    const PerfCounters::Event event = static_cast<PerfCounters::Event>(i);
+    if( counters.available(event) && total_items > 0 ){
+      state.counters[ PerfCounters::Name(event) ] = counters.value(event) / total_items;
+    }
+  }
+  if( counters.multiplexed() ){
+    // the counters above are estimated from a fraction of the run
+    state.counters[ "multiplexed" ] = 1;
+  }
+}
+
+static void RegisterReplay(const std::string& name, const ReplaySet& set)
+{
+  const char* stage_names[] = { "Register", "Deserialize", "Rename", "Convert" };
+  for(int stage = REGISTER; stage <= CONVERT; stage++)
+  {
+    const std::string benchmark_name = std::string("Replay/") + stage_names[stage] + "/" + name;
+    benchmark::RegisterBenchmark( benchmark_name.c_str(),
+                                  [stage, set](benchmark::State& state)
+    {
+      BM_Replay( state, static_cast<Stage>(stage), set );
+    });
+  }
+}
+
+int main(int argc, char** argv)
+{
+  // removes the --benchmark_* arguments
+  benchmark::Initialize( &argc, argv );
+  if( argc != 2 ){
+    std::cout << "Usage: ros_introspection_replay file.corpus [benchmark options]" << std::endl;
+    return 1;
+  }
+
+  try{
+    corpus.load( argv[1] );
+  }
+  catch( std::exception& ex )
+  {
+    std::cout << ex.what() << std::endl;
+    return 1;
+  }
+
+  // the whole corpus, then each topic
+  std::vector<ReplaySet> topic_sets( corpus.topics().size() );
+  ReplaySet all_set;
+  all_set.bytes = 0;
+  for(uint32_t t=0; t < corpus.topics().size(); t++)
+  {
+    all_set.topics.push_back( t );
+    topic_sets[t].topics.push_back( t );
+    topic_sets[t].bytes = 0;
+  }
+  for(size_t i=0; i < corpus.messagesCount(); i++)
+  {
+    const CorpusMessage& msg = corpus.message(i);
+    all_set.messages.push_back( i );
+    all_set.bytes += msg.size;
+    topic_sets[msg.topic].messages.push_back( i );
+    topic_sets[msg.topic].bytes += msg.size;
+  }
+
+  PerfCounters counters;
+  std::cout << argv[1] << ": " << corpus.topics().size() << " topics, "
+            << corpus.messagesCount() << " messages, " << corpus.totalBytes() << " bytes. "
+            << "Hardware counters " << ( counters.available() ? "available" : "not available" )
+            << std::endl;
+
+  RegisterReplay( "all", all_set );
+  for(uint32_t t=0; t < corpus.topics().size(); t++)
+  {
+    RegisterReplay( corpus.topics()[t].name, topic_sets[t] );
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
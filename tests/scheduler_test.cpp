@@ -0,0 +1,156 @@
+#include "config.h"
+#include <gtest/gtest.h>
+
+#include <ros_introspection_test/topic_scheduler.hpp>
+
+using namespace RosIntrospection;
+
+TEST(BoundedQueue, PushPop)
+{
+  BoundedQueue<int> queue(5);
+  EXPECT_EQ( queue.capacity(), 8 );
+  EXPECT_TRUE( queue.empty() );
+
+  for (int i=0; i<8; i++)
+  {
+    int value = i;
+    EXPECT_TRUE( queue.tryPush(value) );
+  }
+  int extra = 42;
+  EXPECT_FALSE( queue.tryPush(extra) );
+  EXPECT_EQ( extra, 42 );
+
+  for (int i=0; i<8; i++)
+  {
+    int value = -1;
+    EXPECT_TRUE( queue.tryPop(value) );
+    EXPECT_EQ( value, i );
+  }
+  int value;
+  EXPECT_FALSE( queue.tryPop(value) );
+  EXPECT_TRUE( queue.empty() );
+}
+
+TEST(TopicScheduler, OrderPreservedPerTopic)
+{
+  const int NUM_TOPICS = 8;
+  const int NUM_MSGS   = 2000;
+
+  std::vector<std::vector<int>> received( NUM_TOPICS );
+  std::vector<std::unique_ptr<std::mutex>> mutexes;
+  for (int t=0; t<NUM_TOPICS; t++) {
+    mutexes.push_back( std::unique_ptr<std::mutex>(new std::mutex) );
+  }
+
+  TopicScheduler<int> scheduler(4, [&](size_t topic, int& value)
+  {
+    // a topic is never processed by two workers at the same time
+    std::unique_lock<std::mutex> lock( *mutexes[topic], std::try_to_lock );
+    ASSERT_TRUE( lock.owns_lock() );
+    received[topic].push_back( value );
+  }, 4);
+
+  for (int t=0; t<NUM_TOPICS; t++) {
+    scheduler.addTopic( 64, TopicScheduler<int>::BLOCK );
+  }
+  scheduler.start();
+
+  std::vector<std::thread> producers;
+  for (int t=0; t<NUM_TOPICS; t++)
+  {
+    producers.push_back( std::thread([&scheduler, t, NUM_MSGS]()
+    {
+      for (int i=0; i<NUM_MSGS; i++) {
+        scheduler.push( t, i );
+      }
+    }));
+  }
+  for (auto& producer: producers) {
+    producer.join();
+  }
+  scheduler.waitIdle();
+  scheduler.stop();
+
+  for (int t=0; t<NUM_TOPICS; t++)
+  {
+    ASSERT_EQ( received[t].size(), NUM_MSGS );
+    for (int i=0; i<NUM_MSGS; i++) {
+      EXPECT_EQ( received[t][i], i );
+    }
+    EXPECT_EQ( scheduler.stats(t).processed, NUM_MSGS );
+    EXPECT_EQ( scheduler.stats(t).dropped, 0 );
+  }
+}
+
+TEST(TopicScheduler, DropPolicies)
+{
+  std::vector<int> newest_kept;
+  std::vector<int> oldest_kept;
+
+  // workers not started: queues fill up
+  TopicScheduler<int> scheduler(1, [&](size_t topic, int& value)
+  {
+    if( topic == 0 ) newest_kept.push_back( value );
+    else             oldest_kept.push_back( value );
+  });
+
+  const size_t drop_newest = scheduler.addTopic( 4, TopicScheduler<int>::DROP_NEWEST );
+  const size_t drop_oldest = scheduler.addTopic( 4, TopicScheduler<int>::DROP_OLDEST );
+
+  for (int i=0; i<10; i++)
+  {
+    EXPECT_EQ( scheduler.push( drop_newest, i ), i < 4 );
+    EXPECT_TRUE( scheduler.push( drop_oldest, i ) );
+  }
+  EXPECT_EQ( scheduler.stats(drop_newest).dropped, 6 );
+  EXPECT_EQ( scheduler.stats(drop_oldest).dropped, 6 );
+  // not running: does not wait for the queued items
+  scheduler.waitIdle();
+
+  scheduler.start();
+  scheduler.waitIdle();
+
+  EXPECT_EQ( newest_kept, std::vector<int>({0, 1, 2, 3}) );
+  EXPECT_EQ( oldest_kept, std::vector<int>({6, 7, 8, 9}) );
+  // the items pushed after stop() stay in the queue
+  scheduler.stop();
+  EXPECT_TRUE( scheduler.push( drop_newest, 10 ) );
+  scheduler.waitIdle();
+  EXPECT_EQ( newest_kept.size(), 4 );
+}
+
+TEST(TopicScheduler, SlowTopicDoesNotStarveOthers)
+{
+  std::atomic<int> fast_processed(0);
+  std::atomic<bool> release_slow(false);
+
+  TopicScheduler<int> scheduler(2, [&](size_t topic, int&)
+  {
+    if( topic == 0 ) {
+      while( !release_slow ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+      }
+    }
+    else{
+      fast_processed++;
+    }
+  });
+
+  const size_t slow = scheduler.addTopic( 16, TopicScheduler<int>::DROP_OLDEST );
+  const size_t fast = scheduler.addTopic( 16, TopicScheduler<int>::BLOCK );
+  scheduler.start();
+
+  scheduler.push( slow, 0 );
+  for (int i=0; i<100; i++) {
+    scheduler.push( fast, i );
+  }
+
+  // the slow topic keeps one worker busy, the other one serves the fast topic
+  for (int i=0; i<1000 && fast_processed < 100; i++) {
+    std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+  }
+  EXPECT_EQ( fast_processed, 100 );
+
+  release_slow = true;
+  scheduler.waitIdle();
+}
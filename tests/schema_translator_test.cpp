@@ -0,0 +1,162 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <tf2_msgs/TFMessage.h>
+#include <ros_introspection_test/MotorStatus.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/schema_translator.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+// key without the name of the topic -> value
+static std::map<std::string, std::string> Decode(Parser& parser, const std::string& topic,
+                                                 std::vector<uint8_t>& buffer)
+{
+  FlatMessage flat_container;
+  parser.deserializeIntoFlatContainer( topic, Span<uint8_t>(buffer), &flat_container, 100 );
+  std::map<std::string, std::string> output;
+  for(const auto& it: flat_container.value)
+  {
+    const std::string key = it.first.toStdString();
+    output[ key.substr( key.find('/') ) ] = std::to_string( it.second.convert<double>() );
+  }
+  for(const auto& it: flat_container.name)
+  {
+    const std::string key = it.first.toStdString();
+    output[ key.substr( key.find('/') ) ] = it.second;
+  }
+  return output;
+}
+
+static bool HasChange(const SchemaTranslator& translator, SchemaChange::Kind kind,
+                      const std::string& field)
+{
+  for(const SchemaChange& change: translator.changes())
+  {
+    if( change.kind == kind && change.field == field ){
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST(SchemaTranslator, MotorStatus)
+{
+  using ros_introspection_test::MotorStatus;
+  const std::string datatype = DataType<MotorStatus>::value();
+
+  Parser parser;
+  const MessageSchema old_schema = Schema( parser, "old", datatype, Definition<MotorStatus>::value() );
+  // reordered, drivertemperature removed, torque changed type, three fields added
+  const MessageSchema new_schema = Schema( parser, "new", datatype,
+                                           "int32[] speed\n"
+                                           "int32[] position\n"
+                                           "float64 voltage\n"
+                                           "int16[] motortemperature\n"
+                                           "int8[] error\n"
+                                           "string label\n"
+                                           "float32[] torque\n"
+                                           "uint8[3] mode\n" );
+  SchemaTranslator translator( old_schema, new_schema );
+  EXPECT_FALSE( translator.isIdentity() );
+  EXPECT_EQ( translator.changes().size(), 5 );
+  EXPECT_TRUE( HasChange( translator, SchemaChange::ADDED,   datatype + "/voltage" ) );
+  EXPECT_TRUE( HasChange( translator, SchemaChange::ADDED,   datatype + "/label" ) );
+  EXPECT_TRUE( HasChange( translator, SchemaChange::ADDED,   datatype + "/mode" ) );
+  EXPECT_TRUE( HasChange( translator, SchemaChange::CHANGED, datatype + "/torque" ) );
+  EXPECT_TRUE( HasChange( translator, SchemaChange::REMOVED, datatype + "/drivertemperature" ) );
+
+  MotorStatus status;
+  status.position = {1, 2};
+  status.speed = {3};
+  status.torque = {4};
+  status.drivertemperature = {5};
+  status.motortemperature = {6, 7};
+  status.error = {8};
+  std::vector<uint8_t> old_buffer = Serialize( status );
+
+  std::vector<uint8_t> new_buffer;
+  EXPECT_EQ( translator.translate( Span<uint8_t>(old_buffer), new_buffer ), old_buffer.size() );
+
+  std::map<std::string, std::string> values = Decode( parser, "new", new_buffer );
+  std::map<std::string, std::string> expected;
+  expected["/speed.0"]    = std::to_string(3.0);
+  expected["/position.0"] = std::to_string(1.0);
+  expected["/position.1"] = std::to_string(2.0);
+  expected["/voltage"]    = std::to_string(0.0);
+  expected["/motortemperature.0"] = std::to_string(6.0);
+  expected["/motortemperature.1"] = std::to_string(7.0);
+  expected["/error.0"]    = std::to_string(8.0);
+  expected["/label"]      = "";
+  expected["/mode.0"]     = std::to_string(0.0);
+  expected["/mode.1"]     = std::to_string(0.0);
+  expected["/mode.2"]     = std::to_string(0.0);
+  EXPECT_EQ( values, expected );
+
+  // the same definition: plain copy
+  SchemaTranslator identity( old_schema, old_schema );
+  EXPECT_TRUE( identity.isIdentity() );
+  EXPECT_TRUE( identity.changes().empty() );
+  identity.translate( Span<uint8_t>(old_buffer), new_buffer );
+  EXPECT_EQ( new_buffer, old_buffer );
+
+  std::vector<uint8_t> truncated( old_buffer.begin(), old_buffer.end() - 1 );
+  EXPECT_THROW( translator.translate( Span<uint8_t>(truncated), new_buffer ), std::runtime_error );
+}
+
+TEST(SchemaTranslator, NestedArray)
+{
+  const std::string datatype = DataType<tf2_msgs::TFMessage>::value();
+  std::string definition = Definition<tf2_msgs::TFMessage>::value();
+
+  Parser parser;
+  const MessageSchema old_schema = Schema( parser, "old", datatype, definition );
+
+  // a field added to geometry_msgs/TransformStamped
+  const std::string child_field = "string child_frame_id\n";
+  definition.insert( definition.find( child_field ) + child_field.size(), "float64 confidence\n" );
+  const MessageSchema new_schema = Schema( parser, "new", datatype, definition );
+
+  SchemaTranslator translator( old_schema, new_schema );
+  ASSERT_EQ( translator.changes().size(), 1 );
+  EXPECT_EQ( translator.changes()[0].kind, SchemaChange::ADDED );
+  EXPECT_EQ( translator.changes()[0].field, "geometry_msgs/TransformStamped/confidence" );
+
+  tf2_msgs::TFMessage tf_msg;
+  tf_msg.transforms.resize( 3 );
+  for (int i=0; i<3; i++)
+  {
+    geometry_msgs::TransformStamped& transform = tf_msg.transforms[i];
+    transform.header.seq = i;
+    transform.header.frame_id = std::string("frame_").append( std::to_string(i) );
+    transform.child_frame_id  = std::string("child_").append( std::to_string(i) );
+    transform.transform.translation.x = i;
+    transform.transform.rotation.w = 1.0;
+  }
+  std::vector<uint8_t> old_buffer = Serialize( tf_msg );
+  std::vector<uint8_t> new_buffer;
+  translator.translate( Span<uint8_t>(old_buffer), new_buffer );
+  EXPECT_EQ( new_buffer.size(), old_buffer.size() + 3 * sizeof(double) );
+
+  std::map<std::string, std::string> old_values = Decode( parser, "old", old_buffer );
+  std::map<std::string, std::string> new_values = Decode( parser, "new", new_buffer );
+  for (int i=0; i<3; i++)
+  {
+    const std::string key = "/transforms." + std::to_string(i) + "/confidence";
+    EXPECT_EQ( new_values[key], std::to_string(0.0) );
+    new_values.erase( key );
+  }
+  EXPECT_EQ( new_values, old_values );
+
+  // and back: the new field is dropped
+  SchemaTranslator reverse( new_schema, old_schema );
+  std::vector<uint8_t> back;
+  reverse.translate( Span<uint8_t>(new_buffer), back );
+  EXPECT_EQ( back, old_buffer );
+
+  EXPECT_THROW( SchemaTranslator( old_schema, Schema( parser, "motor", "ros_introspection_test/MotorStatus",
+                                                      "int32[] position\n" ) ),
+                std::runtime_error );
+}
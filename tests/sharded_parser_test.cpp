@@ -0,0 +1,259 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/sharded_parser.hpp>
+#include <map>
+#include <thread>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(ConsistentHashRing, Distribution)
+{
+  ConsistentHashRing ring(8);
+  ConsistentHashRing same_ring(8);
+  ConsistentHashRing larger_ring(9);
+
+  std::vector<size_t> count(8, 0);
+  size_t moved = 0;
+  const size_t num_keys = 2000;
+
+  for (size_t i=0; i<num_keys; i++)
+  {
+    const std::string topic = "/robot_" + std::to_string(i) + "/joint_states";
+    const size_t shard = ring.shardOf( topic );
+    ASSERT_LT( shard, 8 );
+    EXPECT_EQ( shard, same_ring.shardOf( topic ) );
+    count[shard]++;
+
+    const size_t new_shard = larger_ring.shardOf( topic );
+    if( new_shard != shard )
+    {
+      // keys move only to the new shard
+      EXPECT_EQ( new_shard, 8 );
+      moved++;
+    }
+  }
+  for (size_t shard=0; shard<8; shard++)
+  {
+    EXPECT_GT( count[shard], num_keys / 16 );
+    EXPECT_LT( count[shard], num_keys / 4 );
+  }
+  // about 1/9 of the keys
+  EXPECT_GT( moved, num_keys / 20 );
+  EXPECT_LT( moved, num_keys / 5 );
+
+  EXPECT_THROW( ConsistentHashRing(0), std::runtime_error );
+}
+
+TEST(ShardedParser, SameOutputInOrder)
+{
+  const ROSType joint_type( DataType<sensor_msgs::JointState>::value() );
+  const ROSType tf_type( DataType<tf2_msgs::TFMessage>::value() );
+
+  std::vector<SubstitutionRule> rules;
+  rules.push_back( SubstitutionRule( "position.#", "name.#", "@.position" ) );
+  rules.push_back( SubstitutionRule( "transforms.#.transform",
+                                     "transforms.#.header.frame_id",
+                                     "transforms.#" ) );
+
+  // reference: a single Parser
+  RosIntrospection::Parser parser;
+  ShardedParser sharded(4, false, 8);
+
+  std::vector<std::string> topics;
+  for (int i=0; i<16; i++)
+  {
+    const bool is_tf = (i % 2 == 1);
+    topics.push_back( (is_tf ? "/tf_" : "/joints_") + std::to_string(i) );
+    const ROSType& type = is_tf ? tf_type : joint_type;
+    const std::string definition = is_tf ? Definition<tf2_msgs::TFMessage>::value() :
+                                           Definition<sensor_msgs::JointState>::value();
+    parser.registerMessageDefinition( topics.back(), type, definition );
+    sharded.registerMessageDefinition( topics.back(), type, definition );
+  }
+  parser.registerRenamingRules( joint_type, rules );
+  parser.registerRenamingRules( tf_type, rules );
+  sharded.registerRenamingRules( joint_type, rules );
+  sharded.registerRenamingRules( tf_type, rules );
+
+  EXPECT_THROW( sharded.registerMessageDefinition( topics.front(), joint_type,
+                                                   Definition<sensor_msgs::JointState>::value() ),
+                std::runtime_error );
+
+  const int num_messages = 500;
+  std::vector<std::vector<uint8_t>> buffers;
+  std::vector<RenamedValues> expected( num_messages );
+  FlatMessage flat_container;
+
+  for (int i=0; i<num_messages; i++)
+  {
+    const std::string& topic = topics[ (i * 7) % topics.size() ];
+    const bool is_tf = topic.compare(0, 4, "/tf_") == 0;
+    buffers.push_back( is_tf ? SerializedTF( 1 + i % 5, i ) : SerializedJointState( 1 + i % 4, i ) );
+    parser.deserializeIntoFlatContainer( topic, Span<uint8_t>(buffers.back()), &flat_container, 100 );
+    parser.applyNameTransform( topic, flat_container, &expected[i] );
+  }
+
+  uint64_t next_sequence = 0;
+  bool wrong_shard = false;
+  bool error = false;
+  std::vector<std::string> received_topics;
+
+  sharded.start( [&](const ShardedResult& result)
+  {
+    // called by a single thread, in order
+    EXPECT_EQ( result.sequence, next_sequence );
+    next_sequence++;
+    received_topics.push_back( *result.topic );
+    wrong_shard |= ( sharded.shardOf( *result.topic ) != result.shard );
+    if( result.error )
+    {
+      error = true;
+      return;
+    }
+    const RenamedValues& reference = expected[ result.sequence % num_messages ];
+    ASSERT_EQ( result.renamed->size(), reference.size() );
+    for (size_t k=0; k < reference.size(); k++)
+    {
+      EXPECT_EQ( (*result.renamed)[k].first, reference[k].first );
+      EXPECT_EQ( (*result.renamed)[k].second.convert<double>(),
+                 reference[k].second.convert<double>() );
+    }
+  });
+
+  EXPECT_THROW( sharded.push( "/not_registered", Span<uint8_t>(buffers.front()) ),
+                std::runtime_error );
+
+  for (int i=0; i<num_messages; i++)
+  {
+    sharded.push( topics[ (i * 7) % topics.size() ], Span<uint8_t>(buffers[i]) );
+  }
+  sharded.flush();
+
+  EXPECT_EQ( next_sequence, num_messages );
+  EXPECT_FALSE( wrong_shard );
+  EXPECT_FALSE( error );
+  for (int i=0; i<num_messages; i++)
+  {
+    EXPECT_EQ( received_topics[i], topics[ (i * 7) % topics.size() ] );
+  }
+
+  uint64_t total = 0;
+  size_t busy_shards = 0;
+  for (size_t shard=0; shard < sharded.shardsCount(); shard++)
+  {
+    total += sharded.processedCount( shard );
+    busy_shards += sharded.processedCount( shard ) > 0 ? 1 : 0;
+    EXPECT_FALSE( sharded.isPinned( shard ) );
+  }
+  EXPECT_EQ( total, num_messages );
+  EXPECT_GT( busy_shards, 1 );
+
+  // a truncated message doesn't break the order of the following ones
+  std::vector<uint8_t> truncated( buffers[0].begin(), buffers[0].begin() + 6 );
+  sharded.push( topics[0], Span<uint8_t>(truncated) );
+  sharded.push( topics[0], Span<uint8_t>(buffers[0]) );
+  sharded.flush();
+  EXPECT_TRUE( error );
+  EXPECT_EQ( next_sequence, num_messages + 2 );
+
+  sharded.stop();
+  EXPECT_THROW( sharded.push( topics[0], Span<uint8_t>(buffers[0]) ), std::runtime_error );
+}
+
+TEST(ShardedParser, HandlerException)
+{
+  ShardedParser sharded(2, true);
+  sharded.registerMessageDefinition( "/joints", ROSType(DataType<sensor_msgs::JointState>::value()),
+                                     Definition<sensor_msgs::JointState>::value() );
+  int calls = 0;
+  sharded.start( [&](const ShardedResult&)
+  {
+    if( ++calls == 2 ){
+      throw std::runtime_error("handler");
+    }
+  });
+
+  std::vector<uint8_t> buffer = SerializedJointState( 3, 0 );
+  for (int i=0; i<5; i++){
+    sharded.push( "/joints", Span<uint8_t>(buffer) );
+  }
+  EXPECT_THROW( sharded.flush(), std::runtime_error );
+  // the other messages are still delivered
+  EXPECT_EQ( calls, 5 );
+  EXPECT_NO_THROW( sharded.flush() );
+}
+
+TEST(ShardedParser, ManyProducers)
+{
+  const ROSType joint_type( DataType<sensor_msgs::JointState>::value() );
+  const int num_producers = 4;
+  const int topics_per_producer = 3;
+  const int num_messages = 200;
+
+  RosIntrospection::Parser parser;
+  ShardedParser sharded(3, false, 4);
+  std::vector<std::string> topics;
+  for (int i=0; i < num_producers * topics_per_producer; i++)
+  {
+    topics.push_back( "/joints_" + std::to_string(i) );
+    parser.registerMessageDefinition( topics.back(), joint_type, Definition<sensor_msgs::JointState>::value() );
+    sharded.registerMessageDefinition( topics.back(), joint_type, Definition<sensor_msgs::JointState>::value() );
+  }
+
+  // growing messages: the buffers of the slots are enlarged by push()
+  std::vector<std::vector<uint8_t>> buffers;
+  std::vector<FlatMessage> expected( num_messages );
+  for (int i=0; i<num_messages; i++)
+  {
+    buffers.push_back( SerializedJointState( 1 + i / 20, i ) );
+    parser.deserializeIntoFlatContainer( topics[0], Span<uint8_t>(buffers.back()), &expected[i], 100 );
+  }
+
+  // the messages of a topic are pushed by a single producer: their order is preserved
+  uint64_t next_sequence = 0;
+  std::map<std::string, int> next_message;
+  int mismatches = 0;
+  sharded.start( [&](const ShardedResult& result)
+  {
+    EXPECT_EQ( result.sequence, next_sequence++ );
+    ASSERT_EQ( result.error, nullptr );
+    const FlatMessage& reference = expected[ next_message[*result.topic]++ ];
+    bool equal = ( result.flat->value.size() == reference.value.size() );
+    for (size_t k=0; equal && k < reference.value.size(); k++)
+    {
+      equal = ( result.flat->value[k].second.convert<double>() == reference.value[k].second.convert<double>() );
+    }
+    mismatches += equal ? 0 : 1;
+  });
+
+  std::vector<std::thread> producers;
+  for (int p=0; p<num_producers; p++)
+  {
+    producers.push_back( std::thread( [&, p]()
+    {
+      for (int i=0; i<num_messages; i++)
+      {
+        for (int t=0; t<topics_per_producer; t++)
+        {
+          sharded.push( topics[ p * topics_per_producer + t ], Span<uint8_t>(buffers[i]) );
+        }
+      }
+    }));
+  }
+  for (std::thread& producer: producers){
+    producer.join();
+  }
+  sharded.flush();
+
+  EXPECT_EQ( next_sequence, num_messages * topics.size() );
+  EXPECT_EQ( mismatches, 0 );
+  for (const std::string& topic: topics){
+    EXPECT_EQ( next_message[topic], num_messages );
+  }
+}
@@ -0,0 +1,161 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/shared_sample_ring.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <sys/wait.h>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+static const char* kRingName = "/ros_introspection_shared_ring_test";
+
+// Runs in a child process: reads until the last sample, returns 0 if every sample is consistent.
+static int ReadAll(int ready_fd, uint64_t total, bool expect_all)
+{
+  try{
+    SharedSampleReader reader( kRingName );
+    const char ready = 'r';
+    if( write( ready_fd, &ready, 1 ) != 1 ){
+      return 1;
+    }
+    SharedSample sample;
+    uint64_t received = 0;
+    int64_t last_index = -1;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+    while( last_index + 1 < static_cast<int64_t>(total) )
+    {
+      if( !reader.next( sample ) )
+      {
+        if( std::chrono::steady_clock::now() > deadline ){
+          return 2;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      received++;
+      if( static_cast<int64_t>(sample.index) <= last_index ){
+        return 3;
+      }
+      last_index = sample.index;
+
+      // position.k = index * (k+1): a torn sample would break it
+      const std::vector<std::string>& keys = reader.keys();
+      for (int k=0; k<3; k++)
+      {
+        const std::string key = "JointState/position." + std::to_string(k);
+        const auto it = std::find( keys.begin(), keys.end(), key );
+        if( it == keys.end() || sample.values.at( it - keys.begin() ) != double(sample.index * (k+1)) ){
+          return 4;
+        }
+      }
+      if( sample.time != double(sample.index) ){
+        return 5;
+      }
+    }
+    if( received + reader.lostCount() != total ){
+      return 6;
+    }
+    if( expect_all && received != total ){
+      return 7;
+    }
+  }
+  catch( std::exception& ){
+    return 8;
+  }
+  return 0;
+}
+
+static void PublishToReaders(uint32_t capacity, uint64_t total, bool expect_all)
+{
+  RosIntrospection::Parser parser;
+  parser.registerMessageDefinition("JointState",
+                                   ROSType(DataType<sensor_msgs::JointState>::value()),
+                                   Definition<sensor_msgs::JointState>::value());
+
+  SharedSampleWriter writer( kRingName, capacity, 64 );
+
+  int ready[2];
+  ASSERT_EQ( pipe(ready), 0 );
+
+  // three processes, as a logger, a plotter and a monitor would do
+  std::vector<pid_t> readers;
+  for (int r=0; r<3; r++)
+  {
+    const pid_t pid = fork();
+    ASSERT_GE( pid, 0 );
+    if( pid == 0 ){
+      _exit( ReadAll( ready[1], total, expect_all ) );
+    }
+    readers.push_back( pid );
+  }
+  for (size_t r=0; r<readers.size(); r++)
+  {
+    char c;
+    ASSERT_EQ( read( ready[0], &c, 1 ), 1 );
+  }
+
+  FlatMessage flat_container;
+  std::vector<uint8_t> buffer;
+
+  for (uint64_t i=0; i<total; i++)
+  {
+    sensor_msgs::JointState joint_state;
+    joint_state.name = {"a", "b", "c"};
+    joint_state.position = { double(i), double(2*i), double(3*i) };
+    buffer = Serialize( joint_state );
+
+    // deserialized once, read by all the readers
+    parser.deserializeIntoFlatContainer("JointState", Span<uint8_t>(buffer), &flat_container, 100);
+    writer.publish( i, flat_container );
+
+    if( i % 100 == 0 ){
+      std::this_thread::sleep_for( std::chrono::microseconds(200) );
+    }
+  }
+  EXPECT_EQ( writer.publishedCount(), total );
+  EXPECT_EQ( writer.droppedKeys(), 0 );
+
+  for (pid_t pid: readers)
+  {
+    int status = 0;
+    ASSERT_EQ( waitpid( pid, &status, 0 ), pid );
+    ASSERT_TRUE( WIFEXITED(status) );
+    EXPECT_EQ( WEXITSTATUS(status), 0 );
+  }
+  close( ready[0] );
+  close( ready[1] );
+}
+
+TEST(SharedSampleRing, MultipleReaderProcesses)
+{
+  // large enough: no sample can be lost
+  PublishToReaders( 4096, 4000, true );
+}
+
+TEST(SharedSampleRing, SlowReadersLoseOldSamples)
+{
+  // the writer never waits: readers skip the overwritten samples, but never read a torn one
+  PublishToReaders( 16, 50000, false );
+}
+
+TEST(SharedSampleRing, Errors)
+{
+  EXPECT_THROW( SharedSampleReader("/ros_introspection_ring_not_found"), std::runtime_error );
+  EXPECT_THROW( SharedSampleWriter( kRingName, 0 ), std::runtime_error );
+
+  {
+    SharedSampleWriter writer( kRingName, 8 );
+    SharedSampleReader reader( kRingName );
+    SharedSample sample;
+    EXPECT_FALSE( reader.next( sample ) );
+  }
+  // removed by the writer
+  EXPECT_THROW( SharedSampleReader( kRingName ), std::runtime_error );
+}
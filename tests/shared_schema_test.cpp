@@ -0,0 +1,133 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/shared_schema_parser.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(SharedSchema, SameTypeRegisteredOnce)
+{
+  SharedSchemaParser parser;
+
+  const ROSType joint_type( DataType<sensor_msgs::JointState>::value() );
+  const ROSType imu_type( DataType<sensor_msgs::Imu>::value() );
+
+  const char* joint_topics[3] = {"/arm/joint_states", "/leg/joint_states", "/head/joint_states"};
+  for (int i=0; i<3; i++)
+  {
+    bool new_type = parser.registerMessageDefinition( joint_topics[i], joint_type,
+                                                      Definition<sensor_msgs::JointState>::value(),
+                                                      MD5Sum<sensor_msgs::JointState>::value() );
+    EXPECT_EQ( new_type, i == 0 );
+  }
+  EXPECT_TRUE( parser.registerMessageDefinition( "/imu", imu_type,
+                                                 Definition<sensor_msgs::Imu>::value(),
+                                                 MD5Sum<sensor_msgs::Imu>::value() ) );
+  EXPECT_EQ( parser.topicsCount(), 4 );
+  EXPECT_EQ( parser.typesCount(), 2 );
+  EXPECT_EQ( parser.getMessageInfo("/arm/joint_states"), parser.getMessageInfo("/head/joint_states") );
+  EXPECT_NE( parser.getMessageInfo("/arm/joint_states"), parser.getMessageInfo("/imu") );
+  EXPECT_THROW( parser.typeIdentifier("/not_registered"), std::runtime_error );
+
+  std::vector<SubstitutionRule> rules;
+  rules.push_back( SubstitutionRule("position.#", "name.#", "@/pos") );
+  parser.registerRenamingRules( joint_type, rules );
+
+  sensor_msgs::JointState joint_state;
+  joint_state.name.push_back("hola");
+  joint_state.position.push_back(42);
+
+  std::vector<uint8_t> buffer = Serialize( joint_state );
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+  for (int i=0; i<3; i++)
+  {
+    parser.deserializeIntoFlatContainer( joint_topics[i], Span<uint8_t>(buffer), &flat_container, 100 );
+    parser.applyNameTransform( joint_topics[i], flat_container, &renamed_values );
+
+    ASSERT_EQ( renamed_values.size(), 3 );
+    EXPECT_EQ( renamed_values[0].first, std::string(joint_topics[i]) + "/header/seq" );
+    EXPECT_EQ( renamed_values[2].first, std::string(joint_topics[i]) + "/hola/pos" );
+    EXPECT_EQ( renamed_values[2].second.convert<double>(), 42 );
+
+    std::string key;
+    parser.leafToString( joint_topics[i], flat_container.name[0].first, key );
+    EXPECT_EQ( key, std::string(joint_topics[i]) + "/header/frame_id" );
+  }
+}
+
+TEST(SharedSchema, MemoryReport)
+{
+  SharedSchemaParser parser;
+  const ROSType joint_type( DataType<sensor_msgs::JointState>::value() );
+
+  for (int i=0; i<10; i++)
+  {
+    parser.registerMessageDefinition( "/joint_states_" + std::to_string(i), joint_type,
+                                      Definition<sensor_msgs::JointState>::value(),
+                                      MD5Sum<sensor_msgs::JointState>::value() );
+  }
+  std::vector<TypeMemory> types = parser.typesMemory();
+  ASSERT_EQ( types.size(), 1 );
+  EXPECT_EQ( types[0].datatype, "sensor_msgs/JointState" );
+  EXPECT_EQ( types[0].topics, 10 );
+  EXPECT_GT( types[0].string_tree_nodes, 0 );
+  EXPECT_GT( types[0].totalBytes(), 0 );
+
+  std::vector<TopicMemory> topics = parser.topicsMemory();
+  ASSERT_EQ( topics.size(), 10 );
+  for (const TopicMemory& topic: topics)
+  {
+    EXPECT_EQ( topic.shared_bytes, types[0].totalBytes() / 10 );
+    EXPECT_GT( topic.own_bytes, 0 );
+  }
+}
+
+TEST(SharedSchema, CachedKeys)
+{
+  SharedSchemaParser parser;
+  const ROSType joint_type( DataType<sensor_msgs::JointState>::value() );
+
+  const char* topics[2] = {"/arm/joint_states", "/leg/joint_states"};
+  for (int i=0; i<2; i++)
+  {
+    parser.registerMessageDefinition( topics[i], joint_type,
+                                      Definition<sensor_msgs::JointState>::value(),
+                                      MD5Sum<sensor_msgs::JointState>::value() );
+  }
+
+  FlatMessage flat_container;
+  RenamedValues renamed_values;
+  std::vector<uint8_t> buffer;
+  std::string key;
+
+  // the same output alternates between topics, the layout changes with the size
+  const int sizes[] = {2, 2, 2, 3, 3, 1, 2};
+  for (int s=0; s<7; s++)
+  {
+    for (int n=0; n<4; n++)
+    {
+      const int t = n / 2;
+      buffer = SerializedJointState( sizes[s], s*10 + n );
+      parser.deserializeIntoFlatContainer( topics[t], Span<uint8_t>(buffer), &flat_container, 100 );
+      parser.applyNameTransform( topics[t], flat_container, &renamed_values );
+
+      ASSERT_EQ( renamed_values.size(), flat_container.value.size() );
+      for (size_t i=0; i<renamed_values.size(); i++)
+      {
+        parser.leafToString( topics[t], flat_container.value[i].first, key );
+        EXPECT_EQ( renamed_values[i].first, key );
+        EXPECT_EQ( renamed_values[i].second.convert<double>(),
+                   flat_container.value[i].second.convert<double>() );
+      }
+      EXPECT_EQ( renamed_values.back().first,
+                 std::string(topics[t]) + "/effort." + std::to_string( sizes[s] - 1 ) );
+    }
+  }
+}
@@ -0,0 +1,112 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <std_msgs/Header.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/stamp_extractor.hpp>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+TEST(StampExtractor, FixedOffset)
+{
+  Parser parser;
+  Register<sensor_msgs::Imu>( parser, "/imu" );
+  Register<sensor_msgs::JointState>( parser, "/joints" );
+  Register<tf2_msgs::TFMessage>( parser, "/tf" );
+  Register<std_msgs::Header>( parser, "/header" );
+
+  StampExtractor extractor;
+  EXPECT_TRUE( extractor.registerTopic( parser, "/imu" ) );
+  EXPECT_TRUE( extractor.registerTopic( parser, "/joints" ) );
+  EXPECT_TRUE( extractor.registerTopic( parser, "/header" ) );
+  // the headers are inside an array
+  EXPECT_FALSE( extractor.registerTopic( parser, "/tf" ) );
+  EXPECT_THROW( extractor.registerTopic( parser, "/not_registered" ), std::runtime_error );
+
+  // after header.seq
+  EXPECT_EQ( extractor.locator("/imu")->fixedOffset(), 4 );
+  EXPECT_EQ( extractor.locator("/joints")->fixedOffset(), 4 );
+  EXPECT_EQ( extractor.locator("/header")->fixedOffset(), 4 );
+  EXPECT_EQ( extractor.locator("/tf")->fixedOffset(), -1 );
+  EXPECT_EQ( extractor.locator("/not_registered"), nullptr );
+
+  sensor_msgs::Imu imu;
+  imu.header.seq = 42;
+  imu.header.stamp = ros::Time(1234, 5678);
+  imu.header.frame_id = "imu_link";
+  std::vector<uint8_t> buffer = Serialize( imu );
+
+  ros::Time stamp;
+  EXPECT_TRUE( extractor.extractStamp( "/imu", Span<uint8_t>(buffer), stamp ) );
+  EXPECT_EQ( stamp, ros::Time(1234, 5678) );
+
+  sensor_msgs::JointState joint_state;
+  joint_state.header.stamp = ros::Time(99, 1);
+  joint_state.name.push_back("hola");
+  buffer = Serialize( joint_state );
+  EXPECT_TRUE( extractor.extractStamp( "/joints", Span<uint8_t>(buffer), stamp ) );
+  EXPECT_EQ( stamp, ros::Time(99, 1) );
+
+  tf2_msgs::TFMessage tf_msg;
+  buffer = Serialize( tf_msg );
+  EXPECT_FALSE( extractor.extractStamp( "/tf", Span<uint8_t>(buffer), stamp ) );
+  EXPECT_FALSE( extractor.extractStamp( "/not_registered", Span<uint8_t>(buffer), stamp ) );
+
+  std::vector<uint8_t> truncated( 10, 0 );
+  EXPECT_THROW( extractor.extractStamp( "/imu", Span<uint8_t>(truncated), stamp ), std::runtime_error );
+}
+
+TEST(StampExtractor, VariableFieldsBefore)
+{
+  // the header comes after a string and a dynamic array
+  const std::string definition =
+      "string label\n"
+      "float64[] values\n"
+      "uint8 mode\n"
+      "Header header\n"
+      "float64 x\n"
+      "================================================================================\n"
+      "MSG: std_msgs/Header\n" + std::string( Definition<std_msgs::Header>::value() );
+
+  Parser parser;
+  parser.registerMessageDefinition( "/custom", ROSType("my_msgs/Custom"), definition );
+  StampExtractor extractor;
+  EXPECT_TRUE( extractor.registerTopic( parser, "/custom" ) );
+  EXPECT_EQ( extractor.locator("/custom")->fixedOffset(), -1 );
+
+  // serialize it by hand
+  std::vector<uint8_t> buffer;
+  auto Write = [&buffer](const void* data, size_t size)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert( buffer.end(), bytes, bytes + size );
+  };
+  const std::string label = "hello";
+  const uint32_t label_size = label.size();
+  Write( &label_size, 4 );
+  Write( label.data(), label.size() );
+  const uint32_t values_count = 3;
+  const double values[3] = {1, 2, 3};
+  Write( &values_count, 4 );
+  Write( values, sizeof(values) );
+  const uint8_t mode = 7;
+  Write( &mode, 1 );
+  const uint32_t header[3] = { 42, 1500, 77 }; // seq, stamp.sec, stamp.nsec
+  Write( header, sizeof(header) );
+  const uint32_t frame_size = 0;
+  Write( &frame_size, 4 );
+  const double x = 3.5;
+  Write( &x, sizeof(x) );
+
+  ros::Time stamp;
+  EXPECT_TRUE( extractor.extractStamp( "/custom", Span<uint8_t>(buffer), stamp ) );
+  EXPECT_EQ( stamp, ros::Time(1500, 77) );
+
+  std::vector<uint8_t> truncated( buffer.begin(), buffer.begin() + 30 );
+  EXPECT_THROW( extractor.extractStamp( "/custom", Span<uint8_t>(truncated), stamp ), std::runtime_error );
+}
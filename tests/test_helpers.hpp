@@ -0,0 +1,156 @@
+#ifndef ROS_INTROSPECTION_TESTS_TEST_HELPERS_HPP
+#define ROS_INTROSPECTION_TESTS_TEST_HELPERS_HPP
+
+#include <ros/serialization.h>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/message_schema.hpp>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+// Helpers shared by the tests.
+
+template <typename Message>
+inline std::vector<uint8_t> Serialize(const Message& msg)
+{
+  std::vector<uint8_t> buffer( ros::serialization::serializationLength(msg) );
+  ros::serialization::OStream stream(buffer.data(), buffer.size());
+  ros::serialization::Serializer<Message>::write(stream, msg);
+  return buffer;
+}
+
+template <typename Message>
+inline Message Deserialize(std::vector<uint8_t>& buffer)
+{
+  Message msg;
+  ros::serialization::IStream stream(buffer.data(), buffer.size());
+  ros::serialization::Serializer<Message>::read(stream, msg);
+  return msg;
+}
+
+/// Register the definition of Message for the topic.
+template <typename Message>
+inline void Register(RosIntrospection::Parser& parser, const std::string& topic)
+{
+  parser.registerMessageDefinition( topic,
+                                    RosIntrospection::ROSType( ros::message_traits::DataType<Message>::value() ),
+                                    ros::message_traits::Definition<Message>::value() );
+}
+
+/// Register a topic and return the schema of its type.
+inline RosIntrospection::MessageSchema Schema(RosIntrospection::Parser& parser,
+                                              const std::string& topic,
+                                              const std::string& datatype,
+                                              const std::string& definition)
+{
+  parser.registerMessageDefinition( topic, RosIntrospection::ROSType(datatype), definition );
+  return RosIntrospection::MessageSchema( *parser.getMessageInfo(topic) );
+}
+
+template <typename Message>
+inline RosIntrospection::MessageSchema Schema(RosIntrospection::Parser& parser,
+                                              const std::string& topic)
+{
+  return Schema( parser, topic, ros::message_traits::DataType<Message>::value(),
+                 ros::message_traits::Definition<Message>::value() );
+}
+
+/// JointState with the names "hola", "ciao", "bye" (repeated) and values that depend on offset.
+inline std::vector<uint8_t> SerializedJointState(int size, double offset)
+{
+  sensor_msgs::JointState joint_state;
+  joint_state.header.seq = 2016;
+  joint_state.header.frame_id = "pippo";
+
+  const char* names[3] = {"hola", "ciao", "bye"};
+  for (int i=0; i<size; i++)
+  {
+    joint_state.name.push_back( names[i%3] );
+    joint_state.position.push_back( offset + 10 + i );
+    joint_state.velocity.push_back( offset + 20 + i );
+    joint_state.effort.push_back( offset + 30 + i );
+  }
+  return Serialize( joint_state );
+}
+
+/// TFMessage with the frames "frame_N" and "child_N"; the translations depend on offset.
+inline std::vector<uint8_t> SerializedTF(int num_transforms, double offset = 0)
+{
+  tf2_msgs::TFMessage tf_msg;
+  tf_msg.transforms.resize( num_transforms );
+  for (int i=0; i<num_transforms; i++)
+  {
+    geometry_msgs::TransformStamped& transform = tf_msg.transforms[i];
+    transform.header.seq = i;
+    transform.header.stamp.sec = 1234;
+    transform.header.frame_id = std::string("frame_").append( std::to_string(i) );
+    transform.child_frame_id  = std::string("child_").append( std::to_string(i) );
+    transform.transform.translation.x = offset + i;
+    transform.transform.rotation.w = 1.0;
+  }
+  return Serialize( tf_msg );
+}
+
+/// Pattern, alias and substitution of the renaming rules of TFMessage and JointState.
+static const char* const RENAMING_RULES[5][3] = {
+  { "transforms.#.transform", "transforms.#.header.frame_id", "transforms.#" },
+  { "transforms.#.header",    "transforms.#.header.frame_id", "transforms.#.header" },
+  { "position.#", "name.#", "@.position" },
+  { "velocity.#", "name.#", "@.velocity" },
+  { "effort.#",   "name.#", "@.effort"   }
+};
+
+inline std::vector<RosIntrospection::SubstitutionRule> RenamingRules()
+{
+  std::vector<RosIntrospection::SubstitutionRule> rules;
+  for (const auto& rule: RENAMING_RULES)
+  {
+    rules.push_back( RosIntrospection::SubstitutionRule( rule[0], rule[1], rule[2] ) );
+  }
+  return rules;
+}
+
+/**
+ * Directory with a unique name in $TMPDIR (or /tmp): tests running in parallel
+ * don't share their files. The destructor removes it, with the files named by path().
+ */
+class TemporaryDirectory
+{
+public:
+  TemporaryDirectory()
+  {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string name = std::string( (tmp && tmp[0]) ? tmp : "/tmp" ) + "/ros_introspection_test_XXXXXX";
+    if( !mkdtemp( &name[0] ) ){
+      throw std::runtime_error( "TemporaryDirectory: can't create " + name );
+    }
+    _path = name;
+  }
+
+  ~TemporaryDirectory()
+  {
+    for (const std::string& file: _files){
+      std::remove( file.c_str() );
+    }
+    rmdir( _path.c_str() );
+  }
+
+  TemporaryDirectory(const TemporaryDirectory&) = delete;
+  TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+  /// Full path of a file in this directory.
+  std::string path(const std::string& filename)
+  {
+    _files.push_back( _path + "/" + filename );
+    return _files.back();
+  }
+
+private:
+  std::string _path;
+  std::vector<std::string> _files;
+};
+
+#endif // ROS_INTROSPECTION_TESTS_TEST_HELPERS_HPP
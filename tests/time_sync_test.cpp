@@ -0,0 +1,154 @@
+#include "config.h"
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/time_sync_join.hpp>
+
+using namespace RosIntrospection;
+
+static RenamedValues Values(const std::string& topic, double stamp, double x)
+{
+  RenamedValues values;
+  values.push_back( std::make_pair( topic + "/header/stamp", Variant( ros::Time(stamp) ) ) );
+  values.push_back( std::make_pair( topic + "/x", Variant( x ) ) );
+  return values;
+}
+
+TEST(TimeSyncJoin, Nearest)
+{
+  TimeSyncJoin join( TimeSyncJoin::NEAREST, 0.5, 0.2 );
+  const size_t joints = join.addTopic("joints");
+  const size_t imu    = join.addTopic("imu");
+  const size_t motor  = join.addTopic("motor");
+
+  for (int i=0; i<100; i++)
+  {
+    join.push( joints, i*0.1, Values("joints", i*0.1, i) );
+    if( i % 2 == 0 ){
+      join.push( imu, i*0.1 + 0.04, Values("imu", i*0.1 + 0.04, 1000 + i) );
+    }
+    // the motor stops after 3 seconds
+    if( i < 30 ){
+      join.push( motor, i*0.1 - 0.01, Values("motor", i*0.1 - 0.01, 2000 + i) );
+    }
+  }
+  // bounded by the watermark
+  EXPECT_LT( join.bufferedCount(), 20 );
+  join.flush();
+
+  const JoinTable& table = join.output();
+  ASSERT_EQ( table.rows(), 100 );
+  const int joints_x = join.findKey("joints/x");
+  const int imu_x    = join.findKey("imu/x");
+  const int motor_x  = join.findKey("motor/x");
+  ASSERT_GE( joints_x, 0 );
+  ASSERT_GE( imu_x, 0 );
+  ASSERT_GE( motor_x, 0 );
+  EXPECT_EQ( join.findKey("not_a_key"), -1 );
+
+  for (size_t row=0; row < table.rows(); row++)
+  {
+    EXPECT_NEAR( table.time[row], row*0.1, 1e-6 );
+    EXPECT_EQ( table.columns[joints_x][row], row );
+    // the closest one is at +0.04 or -0.06
+    const double expected_imu = (row % 2 == 0) ? 1000 + row : 1000 + row - 1;
+    EXPECT_EQ( table.columns[imu_x][row], expected_imu );
+    if( row < 30 ){
+      EXPECT_EQ( table.columns[motor_x][row], 2000 + row );
+    }
+    else if( row > 31 ){
+      // farther than the tolerance
+      EXPECT_TRUE( std::isnan( table.columns[motor_x][row] ) );
+    }
+  }
+}
+
+TEST(TimeSyncJoin, InOrderSmallLateness)
+{
+  // all the messages in stamp order: the imu message after a row arrives after it
+  for (TimeSyncJoin::Alignment alignment: {TimeSyncJoin::NEAREST, TimeSyncJoin::INTERPOLATE})
+  {
+    TimeSyncJoin join( alignment, 0.001, 0.5 );
+    const size_t joints = join.addTopic("joints");
+    const size_t imu    = join.addTopic("imu");
+
+    for (int i=0; i<50; i++)
+    {
+      join.push( joints, Values("joints", i*0.1, i) );
+      // value = 2 * time
+      const double imu_stamp = i*0.1 + 0.03;
+      join.push( imu, Values("imu", imu_stamp, 2 * imu_stamp) );
+      // rows wait for the next imu message
+      EXPECT_LE( join.output().rows(), size_t(i) );
+    }
+    join.flush();
+    EXPECT_EQ( join.lateCount(), 0 );
+
+    const JoinTable& table = join.output();
+    ASSERT_EQ( table.rows(), 50 );
+    const int imu_x = join.findKey("imu/x");
+    for (size_t row=1; row < table.rows(); row++)
+    {
+      const double t = table.time[row];
+      if( alignment == TimeSyncJoin::NEAREST ){
+        // +0.03 is closer than -0.07
+        EXPECT_NEAR( table.columns[imu_x][row], 2 * (t + 0.03), 1e-6 );
+      }
+      else{
+        EXPECT_NEAR( table.columns[imu_x][row], 2 * t, 1e-6 );
+      }
+    }
+  }
+}
+
+TEST(TimeSyncJoin, InterpolateOutOfOrder)
+{
+  TimeSyncJoin join( TimeSyncJoin::INTERPOLATE, 1.0 );
+  const size_t joints = join.addTopic("joints");
+  const size_t imu    = join.addTopic("imu");
+
+  // imu messages swapped in pairs; value = 2 * time
+  std::vector<double> imu_stamps;
+  for (int i=0; i<50; i++){
+    imu_stamps.push_back( i*0.3 + 0.01 );
+  }
+  for (size_t i=0; i+1 < imu_stamps.size(); i += 2){
+    std::swap( imu_stamps[i], imu_stamps[i+1] );
+  }
+
+  size_t next_imu = 0;
+  for (int i=0; i<100; i++)
+  {
+    const double stamp = i*0.15;
+    join.push( joints, Values("joints", stamp, i) );
+    while( next_imu < imu_stamps.size() && imu_stamps[next_imu] < stamp + 0.5 )
+    {
+      const double imu_stamp = imu_stamps[next_imu++];
+      join.push( imu, Values("imu", imu_stamp, 2 * imu_stamp) );
+    }
+  }
+  EXPECT_EQ( join.lateCount(), 0 );
+  EXPECT_FALSE( join.push( imu, 0.0, Values("imu", 0.0, 0.0) ) );
+  EXPECT_EQ( join.lateCount(), 1 );
+  join.flush();
+
+  const JoinTable& table = join.output();
+  ASSERT_EQ( table.rows(), 100 );
+  const int imu_x = join.findKey("imu/x");
+  for (size_t row=1; row < table.rows(); row++)
+  {
+    if( table.time[row] < 49*0.3 ){
+      EXPECT_NEAR( table.columns[imu_x][row], 2 * table.time[row], 1e-6 );
+    }
+  }
+
+  join.clearOutput();
+  EXPECT_EQ( join.output().rows(), 0 );
+  EXPECT_EQ( join.output().columns[imu_x].size(), 0 );
+  EXPECT_EQ( join.output().keys.size(), 4 );
+
+  RenamedValues no_stamp;
+  no_stamp.push_back( std::make_pair( std::string("joints/x"), Variant(1.0) ) );
+  EXPECT_THROW( join.push( joints, no_stamp ), std::runtime_error );
+}
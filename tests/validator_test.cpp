@@ -0,0 +1,197 @@
+#include "config.h"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include "ros_type_introspection/ros_introspection.hpp"
+#include <ros_introspection_test/buffer_validator.hpp>
+#include <ros_introspection_test/field_reader.hpp>
+#include <random>
+
+using namespace ros::message_traits;
+using namespace RosIntrospection;
+
+static sensor_msgs::JointState JointState(int joints)
+{
+  sensor_msgs::JointState joint_state;
+  joint_state.header.frame_id = "pippo";
+  for (int i=0; i<joints; i++)
+  {
+    joint_state.name.push_back( "joint_" + std::to_string(i) );
+    joint_state.position.push_back( i );
+    joint_state.velocity.push_back( 2*i );
+    joint_state.effort.push_back( 3*i );
+  }
+  return joint_state;
+}
+
+static tf2_msgs::TFMessage Transforms(int count)
+{
+  tf2_msgs::TFMessage tf_msg;
+  for (int i=0; i<count; i++)
+  {
+    geometry_msgs::TransformStamped transform;
+    transform.header.frame_id = "world";
+    transform.child_frame_id = "frame_" + std::to_string(i);
+    transform.transform.rotation.w = 1;
+    tf_msg.transforms.push_back( transform );
+  }
+  return tf_msg;
+}
+
+TEST(BufferValidator, JointState)
+{
+  Parser parser;
+  parser.registerMessageDefinition("JointState",
+                                   ROSType(DataType<sensor_msgs::JointState>::value()),
+                                   Definition<sensor_msgs::JointState>::value());
+  const MessageSchema schema( *parser.getMessageInfo("JointState") );
+  const BufferValidator validator( schema );
+
+  // header (seq, stamp, empty frame_id) and 4 empty arrays
+  EXPECT_EQ( validator.minimumSize(0), 16 + 16 );
+
+  const std::vector<uint8_t> buffer = Serialize( JointState(5) );
+  ValidationError error;
+  EXPECT_TRUE( validator.validate( Span<uint8_t>(buffer), &error ) );
+
+  std::vector<uint8_t> truncated( buffer.begin(), buffer.end() - 1 );
+  EXPECT_FALSE( validator.validate( Span<uint8_t>(truncated), &error ) );
+
+  std::vector<uint8_t> trailing = buffer;
+  trailing.push_back( 0 );
+  EXPECT_FALSE( validator.validate( Span<uint8_t>(trailing), &error ) );
+  EXPECT_STREQ( error.reason, "unexpected bytes after the end of the message" );
+
+  // length of the array "name": after seq, stamp and frame_id "pippo"
+  std::vector<uint8_t> huge_prefix = buffer;
+  const uint32_t huge = 0x7fffffff;
+  const size_t name_offset = 4 + 8 + 4 + 5;
+  memcpy( &huge_prefix[name_offset], &huge, sizeof(huge) );
+  EXPECT_FALSE( validator.validate( Span<uint8_t>(huge_prefix), &error ) );
+  EXPECT_EQ( error.offset, name_offset );
+  EXPECT_STREQ( error.reason, "array length exceeds the size of the buffer" );
+
+  const BufferValidator short_arrays( schema, 3 );
+  EXPECT_FALSE( short_arrays.validate( Span<uint8_t>(buffer), &error ) );
+  EXPECT_STREQ( error.reason, "array longer than max_array_length" );
+  EXPECT_EQ( error.offset, name_offset );
+
+  const std::vector<uint8_t> empty;
+  EXPECT_FALSE( validator.validate( Span<uint8_t>(empty) ) );
+}
+
+TEST(BufferValidator, RandomCorruption)
+{
+  Parser parser;
+  parser.registerMessageDefinition("JointState",
+                                   ROSType(DataType<sensor_msgs::JointState>::value()),
+                                   Definition<sensor_msgs::JointState>::value());
+  parser.registerMessageDefinition("tf",
+                                   ROSType(DataType<tf2_msgs::TFMessage>::value()),
+                                   Definition<tf2_msgs::TFMessage>::value());
+  const MessageSchema joint_schema( *parser.getMessageInfo("JointState") );
+  const MessageSchema tf_schema( *parser.getMessageInfo("tf") );
+  const BufferValidator joint_validator( joint_schema );
+  const BufferValidator tf_validator( tf_schema );
+
+  const std::vector<uint8_t> joint_buffer = Serialize( JointState(5) );
+  const std::vector<uint8_t> tf_buffer = Serialize( Transforms(4) );
+
+  std::mt19937 rng( 42 );
+  int accepted = 0;
+
+  for (int i=0; i<10000; i++)
+  {
+    const bool is_tf = (i % 2 == 0);
+    const MessageSchema& schema = is_tf ? tf_schema : joint_schema;
+    const BufferValidator& validator = is_tf ? tf_validator : joint_validator;
+    std::vector<uint8_t> buffer = is_tf ? tf_buffer : joint_buffer;
+
+    const int flips = 1 + rng() % 3;
+    for (int f=0; f<flips; f++)
+    {
+      buffer[ rng() % buffer.size() ] = static_cast<uint8_t>( rng() );
+    }
+    if( rng() % 4 == 0 ){
+      buffer.resize( rng() % buffer.size() );
+    }
+    const Span<uint8_t> span( buffer );
+
+    if( validator.validate( span ) )
+    {
+      // the unchecked walk must agree with the checked one
+      accepted++;
+      EXPECT_EQ( schema.skipMessage<false>( 0, span, 0 ), buffer.size() );
+      EXPECT_EQ( schema.skipMessage( 0, span, 0 ), buffer.size() );
+    }
+    else{
+      bool thrown = false;
+      size_t end = 0;
+      try{
+        end = schema.skipMessage( 0, span, 0 );
+      }
+      catch( std::runtime_error& ){
+        thrown = true;
+      }
+      EXPECT_TRUE( thrown || end != buffer.size() );
+    }
+  }
+  // flips in the values of the leaves don't change the layout
+  EXPECT_GT( accepted, 1000 );
+}
+
+TEST(BufferValidator, VisitValidated)
+{
+  Parser parser;
+  parser.registerMessageDefinition("tf",
+                                   ROSType(DataType<tf2_msgs::TFMessage>::value()),
+                                   Definition<tf2_msgs::TFMessage>::value());
+  const MessageSchema schema( *parser.getMessageInfo("tf") );
+  const BufferValidator validator( schema );
+
+  const std::vector<uint8_t> buffer = Serialize( Transforms(4) );
+  ASSERT_TRUE( validator.validate( Span<uint8_t>(buffer) ) );
+
+  FieldReader reader( schema, "transforms.#/child_frame_id" );
+  std::vector<std::string> frames;
+  auto collect = [&](const SchemaField&, const Span<uint8_t>& buf, size_t offset,
+                     const std::vector<uint32_t>&)
+  {
+    std::string frame;
+    ReadLeafString( buf, offset, frame );
+    frames.push_back( frame );
+    return false;
+  };
+  reader.visitValidated( Span<uint8_t>(buffer), collect );
+  ASSERT_EQ( frames.size(), 4 );
+  EXPECT_EQ( frames[3], "frame_3" );
+}
+
+TEST(BufferValidator, ArrayOfEmptyMessages)
+{
+  Parser parser;
+  const MessageSchema schema = Schema( parser, "empty", "test_msgs/EmptyArray",
+                                       "std_msgs/Empty[] items\n"
+                                       "uint8 last\n"
+                                       "================================================================================\n"
+                                       "MSG: std_msgs/Empty\n" );
+  const BufferValidator validator( schema );
+  EXPECT_EQ( validator.minimumSize(0), 4 + 1 );
+
+  // 1000 empty elements take no space
+  std::vector<uint8_t> buffer( 5, 0 );
+  const uint32_t length = 1000;
+  memcpy( buffer.data(), &length, sizeof(length) );
+  ValidationError error;
+  EXPECT_TRUE( validator.validate( Span<uint8_t>(buffer), &error ) );
+
+  const BufferValidator short_arrays( schema, 100 );
+  EXPECT_FALSE( short_arrays.validate( Span<uint8_t>(buffer), &error ) );
+  EXPECT_STREQ( error.reason, "array longer than max_array_length" );
+  EXPECT_EQ( error.offset, 0 );
+
+  buffer.pop_back();
+  EXPECT_FALSE( validator.validate( Span<uint8_t>(buffer), &error ) );
+}